@@ -43,6 +43,13 @@ DEFINE_double(suggested_presentation_delay,
               0.0,
               "Specifies a delay, in seconds, to be added to the media "
               "presentation time. This value is used for live profile only.");
+DEFINE_double(mpd_flush_coalescing_window,
+              -1.0,
+              "Live MPD updates made within this window, in seconds, are "
+              "written out together, on a separate thread. The MPD is written "
+              "as soon as all the Representations have new segments. Negative "
+              "(default) writes the MPD on every update. This value is used "
+              "for live profile only.");
 DEFINE_bool(generate_dash_if_iop_compliant_mpd,
             false,
             "Try to generate DASH-IF IOPv3 compliant MPD. This is best effort "
@@ -50,4 +50,39 @@ DEFINE_string(temp_dir,
               "",
               "Specify a directory in which to store temporary (intermediate) "
               " files. Used only if single_segment=true.");
+DEFINE_uint64(header_reserve_size,
+              0,
+              "For ISO BMFF only. Number of bytes reserved at the start of "
+              "single segment outputs for the header (ftyp, moov and sidx), "
+              "so that the media data is written to the output once instead "
+              "of being copied from a temp file. About 100KB is enough for a "
+              "few hours of content. If 0, or if the header does not fit, "
+              "the media data is written twice.");
+DEFINE_int32(num_encryption_threads,
+             0,
+             "For ISO BMFF only. Number of threads used to encrypt the "
+             "samples of a fragment. If 0 or 1, samples are encrypted "
+             "serially. The output is the same regardless of the value.");
+DEFINE_bool(low_latency_mode,
+            false,
+            "For ISO BMFF live profile only. Write every fragment to the "
+            "segment file and flush it as soon as the fragment is complete, "
+            "so that segments can be served with chunked transfer encoding "
+            "while they are written. fragment_duration sets the chunk "
+            "duration. No SIDX box is generated. The MPD advertises "
+            "segments segment_duration - fragment_duration seconds early "
+            "with SegmentTemplate@availabilityTimeOffset. Other output "
+            "formats, including text, are rejected in this mode.");
+DEFINE_int32(num_parallel_segments,
+             0,
+             "For ISO BMFF on-demand outputs with multiple segments only. "
+             "Number of segments whose encryption may be in flight. If more "
+             "than 1, the encryption of each fragment runs on worker threads "
+             "while the muxer produces the following fragments, and up to "
+             "this number of complete segments are held in memory until "
+             "their encryption completes. Only the encryption overlaps: "
+             "demuxing, fragmenting and writing the segments stay sequential. "
+             "Segments are written in order, and the output is the same "
+             "regardless of the value. Combine with --num_encryption_threads "
+             "to also split the encryption of each fragment.");
 
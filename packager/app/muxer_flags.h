@@ -20,5 +20,9 @@ DECLARE_double(fragment_duration);
 DECLARE_bool(fragment_sap_aligned);
 DECLARE_int32(num_subsegments_per_sidx);
 DECLARE_string(temp_dir);
+DECLARE_uint64(header_reserve_size);
+DECLARE_int32(num_encryption_threads);
+DECLARE_bool(low_latency_mode);
+DECLARE_int32(num_parallel_segments);
 
 #endif  // APP_MUXER_FLAGS_H_
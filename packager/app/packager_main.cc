@@ -13,6 +13,7 @@
 #include "packager/app/mpd_flags.h"
 #include "packager/app/muxer_flags.h"
 #include "packager/app/packager_util.h"
+#include "packager/app/segment_store_flags.h"
 #include "packager/app/stream_descriptor.h"
 #include "packager/app/vlog_flags.h"
 #include "packager/app/widevine_encryption_flags.h"
@@ -22,11 +23,13 @@
 #include "packager/base/logging.h"
 #include "packager/base/stl_util.h"
 #include "packager/base/strings/string_split.h"
+#include "packager/base/strings/string_util.h"
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/threading/simple_thread.h"
 #include "packager/base/time/clock.h"
 #include "packager/hls/base/hls_notifier.h"
 #include "packager/hls/base/simple_hls_notifier.h"
+#include "packager/media/base/buffer_pool.h"
 #include "packager/media/base/container_names.h"
 #include "packager/media/base/demuxer.h"
 #include "packager/media/base/fourccs.h"
@@ -37,6 +40,9 @@
 #include "packager/media/event/mpd_notify_muxer_listener.h"
 #include "packager/media/event/vod_media_info_dump_muxer_listener.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/file/segment_store.h"
+#include "packager/media/file/segment_store_http_server.h"
 #include "packager/media/formats/mp2t/ts_muxer.h"
 #include "packager/media/formats/mp4/mp4_muxer.h"
 #include "packager/media/formats/webm/webm_muxer.h"
@@ -51,6 +57,25 @@ DEFINE_bool(use_fake_clock_for_muxer,
             "Set to true to use a fake clock for muxer. With this flag set, "
             "creation time and modification time in outputs are set to 0. "
             "Should only be used for testing.");
+DEFINE_bool(use_muxer_threads,
+            false,
+            "Run each muxer on its own thread, fed by the demuxer thread "
+            "through a bounded sample queue, so that an input with multiple "
+            "outputs is packaged on multiple cores. If false (default), "
+            "demuxing and muxing of an input run on a single thread.");
+DEFINE_bool(mmap_input,
+            false,
+            "Map local input files in memory and reference the samples in "
+            "place instead of reading the files through a copy buffer. The "
+            "input files must not be modified while they are packaged. Local "
+            "input files can also be mapped individually with the mmap:// "
+            "prefix.");
+DEFINE_bool(mp4_random_access,
+            false,
+            "Read the samples of non-fragmented MP4 inputs by seeking to each "
+            "chunk of samples, so that memory use does not depend on how the "
+            "tracks are interleaved in the input. Slower than sequential reads "
+            "for inputs interleaved in small chunks.");
 
 namespace shaka {
 namespace media {
@@ -104,12 +129,42 @@ enum ExitStatus {
 // and for supporting live/segmenting (muxing).  With a demuxer and a muxer,
 // CreateRemuxJobs() shouldn't treat text as a special case.
 std::string DetermineTextFileFormat(const std::string& file) {
-  std::string content;
-  if (!File::ReadFileToString(file.c_str(), &content)) {
+  // WebVTT is recognized by its first bytes, so only a prefix is read.
+  const size_t kPrefixSize = 0x10000;  // 64KB.
+  scoped_ptr<File, FileCloser> input(File::Open(file.c_str(), "r"));
+  if (!input) {
     LOG(ERROR) << "Failed to open file " << file
                << " to determine file format.";
     return "";
   }
+  std::string content(kPrefixSize, 0);
+  size_t bytes_read = 0;
+  while (bytes_read < kPrefixSize) {
+    const int64_t result =
+        input->Read(&content[bytes_read], kPrefixSize - bytes_read);
+    if (result < 0) {
+      LOG(ERROR) << "Failed to read file " << file
+                 << " to determine file format.";
+      return "";
+    }
+    if (result == 0)
+      break;
+    bytes_read += result;
+  }
+  content.resize(bytes_read);
+  input.reset();
+
+  // TTML is recognized by parsing the whole document, which is only read if
+  // the prefix looks like XML.
+  if (bytes_read == kPrefixSize &&
+      base::StartsWith(content, "<?xml", base::CompareCase::SENSITIVE)) {
+    content.clear();
+    if (!File::ReadFileToString(file.c_str(), &content)) {
+      LOG(ERROR) << "Failed to read file " << file
+                 << " to determine file format.";
+      return "";
+    }
+  }
   MediaContainerName container_name = DetermineContainer(
       reinterpret_cast<const uint8_t*>(content.data()), content.size());
   if (container_name == CONTAINER_WEBVTT) {
@@ -145,7 +200,9 @@ class FakeClock : public base::Clock {
   base::Time Now() override { return base::Time(); }
 };
 
-// Demux, Mux(es) and worker thread used to remux a source file/stream.
+// Demux, Mux(es) and worker thread used to remux a source file/stream. With
+// --use_muxer_threads, the worker thread runs the demuxer only and every muxer
+// runs on its own thread.
 class RemuxJob : public base::SimpleThread {
  public:
   RemuxJob(scoped_ptr<Demuxer> demuxer)
@@ -260,6 +317,12 @@ bool CreateRemuxJobs(const StreamDescriptorList& stream_descriptors,
 
     // Handle text input.
     if (stream_iter->stream_selector == "text") {
+      if (stream_muxer_options.low_latency_mode) {
+        LOG(ERROR) << "--low_latency_mode is only supported for MP4 output, "
+                      "not for text output "
+                   << stream_muxer_options.output_file_name;
+        return false;
+      }
       MediaInfo text_media_info;
       if (!StreamInfoToTextMediaInfo(*stream_iter, stream_muxer_options,
                                      &text_media_info)) {
@@ -289,6 +352,8 @@ bool CreateRemuxJobs(const StreamDescriptorList& stream_descriptors,
     if (stream_iter->input != previous_input) {
       // New remux job needed. Create demux and job thread.
       scoped_ptr<Demuxer> demuxer(new Demuxer(stream_iter->input));
+      demuxer->set_mmap_input(FLAGS_mmap_input);
+      demuxer->set_mp4_random_access(FLAGS_mp4_random_access);
       if (FLAGS_enable_widevine_decryption ||
           FLAGS_enable_fixed_key_decryption) {
         scoped_ptr<KeySource> key_source(CreateDecryptionKeySource());
@@ -307,6 +372,7 @@ bool CreateRemuxJobs(const StreamDescriptorList& stream_descriptors,
         if (stream_iter->output.empty())
           continue;  // just need stream info.
       }
+      demuxer->set_async_push(FLAGS_use_muxer_threads);
       remux_jobs->push_back(new RemuxJob(demuxer.Pass()));
       previous_input = stream_iter->input;
     }
@@ -323,6 +389,15 @@ bool CreateRemuxJobs(const StreamDescriptorList& stream_descriptors,
         return false;
       }
     }
+    // Only MP4 segments are written chunk by chunk, while the MPD advertises
+    // the chunks of all the representations.
+    if (stream_muxer_options.low_latency_mode &&
+        output_format != CONTAINER_MOV) {
+      LOG(ERROR) << "--low_latency_mode is only supported for MP4 output, "
+                    "not for "
+                 << stream_muxer_options.output_file_name;
+      return false;
+    }
 
     scoped_ptr<Muxer> muxer(
         CreateOutputMuxer(stream_muxer_options, output_format));
@@ -412,6 +487,49 @@ Status RunRemuxJobs(const std::vector<RemuxJob*>& remux_jobs) {
   return status;
 }
 
+// Sets up the eviction of the segments written to the segment store and
+// starts its HTTP server, if enabled.
+bool StartSegmentStore(const StreamDescriptorList& stream_descriptors,
+                       scoped_ptr<SegmentStoreHttpServer>* server) {
+  DCHECK(server);
+
+  SegmentStore* store = SegmentStore::GetInstance();
+  // Segments are kept for the time shift buffer, plus some time for the
+  // clients still downloading them.
+  const base::TimeDelta retention =
+      base::TimeDelta::FromMilliseconds(static_cast<int64_t>(
+          (FLAGS_time_shift_buffer_depth + 2 * FLAGS_segment_duration) * 1000));
+  store->set_retention(retention);
+  // A segment which gets no data for that long would be evicted by now if it
+  // were complete, so its writer is considered stalled.
+  if (retention > base::TimeDelta())
+    store->set_max_wait(retention);
+  for (const StreamDescriptor& descriptor : stream_descriptors) {
+    if (base::StartsWith(descriptor.segment_template, kSegmentStoreFilePrefix,
+                         base::CompareCase::SENSITIVE)) {
+      store->AddEvictionPattern(descriptor.segment_template.substr(
+          strlen(kSegmentStoreFilePrefix)));
+    }
+  }
+
+  if (FLAGS_segment_store_http_port == 0)
+    return true;
+  if (FLAGS_segment_store_http_port < 0 ||
+      FLAGS_segment_store_http_port > 65535) {
+    LOG(ERROR) << "Invalid --segment_store_http_port "
+               << FLAGS_segment_store_http_port;
+    return false;
+  }
+  if (FLAGS_segment_store_http_max_connections <= 0) {
+    LOG(ERROR) << "--segment_store_http_max_connections should be positive.";
+    return false;
+  }
+  server->reset(new SegmentStoreHttpServer(store));
+  (*server)->set_max_connections(FLAGS_segment_store_http_max_connections);
+  return (*server)->Start(FLAGS_segment_store_http_address,
+                          FLAGS_segment_store_http_port);
+}
+
 bool RunPackager(const StreamDescriptorList& stream_descriptors) {
   const FourCC protection_scheme = GetProtectionScheme(FLAGS_protection_scheme);
   if (protection_scheme == FOURCC_NULL)
@@ -486,6 +604,10 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
         master_playlist_name.value()));
   }
 
+  scoped_ptr<SegmentStoreHttpServer> segment_store_server;
+  if (!StartSegmentStore(stream_descriptors, &segment_store_server))
+    return false;
+
   std::vector<RemuxJob*> remux_jobs;
   STLElementDeleter<std::vector<RemuxJob*> > scoped_jobs_deleter(&remux_jobs);
   FakeClock fake_clock;
@@ -496,6 +618,8 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
   }
 
   Status status = RunRemuxJobs(remux_jobs);
+  VLOG(1) << "Buffer pool stats: "
+          << BufferPool::GetInstance()->GetStats().ToString();
   if (!status.ok()) {
     LOG(ERROR) << "Packaging Error: " << status.ToString();
     return false;
@@ -509,6 +633,10 @@ bool RunPackager(const StreamDescriptorList& stream_descriptors) {
     if (!mpd_notifier->Flush())
       return false;
   }
+  if (!File::WaitForPendingWrites()) {
+    LOG(ERROR) << "Packaging Error: failed to write output files.";
+    return false;
+  }
 
   printf("Packaging completed successfully.\n");
   return true;
@@ -87,6 +87,10 @@ scoped_ptr<KeySource> CreateEncryptionKeySource() {
         return scoped_ptr<KeySource>();
       widevine_key_source->set_signer(request_signer.Pass());
     }
+    // Keys are prefetched far enough ahead to cover the key server response
+    // time with key rotation.
+    widevine_key_source->set_crypto_period_duration(
+        FLAGS_crypto_period_duration);
 
     std::vector<uint8_t> content_id;
     if (!base::HexStringToBytes(FLAGS_content_id, &content_id)) {
@@ -159,6 +163,38 @@ bool GetMuxerOptions(MuxerOptions* muxer_options) {
   muxer_options->fragment_sap_aligned = FLAGS_fragment_sap_aligned;
   muxer_options->num_subsegments_per_sidx = FLAGS_num_subsegments_per_sidx;
   muxer_options->temp_dir = FLAGS_temp_dir;
+  muxer_options->header_reserve_size = FLAGS_header_reserve_size;
+  if (FLAGS_num_encryption_threads < 0) {
+    LOG(ERROR) << "--num_encryption_threads should not be negative.";
+    return false;
+  }
+  muxer_options->num_encryption_threads = FLAGS_num_encryption_threads;
+  if (FLAGS_low_latency_mode) {
+    if (FLAGS_single_segment) {
+      LOG(ERROR) << "--low_latency_mode requires multiple segments.";
+      return false;
+    }
+    if (FLAGS_fragment_duration <= 0 ||
+        FLAGS_fragment_duration >= FLAGS_segment_duration) {
+      LOG(ERROR) << "--low_latency_mode requires --fragment_duration to be "
+                    "positive and smaller than --segment_duration.";
+      return false;
+    }
+    LOG_IF(WARNING, FLAGS_num_subsegments_per_sidx >= 0)
+        << "No SIDX box is generated in --low_latency_mode.";
+  }
+  muxer_options->low_latency_mode = FLAGS_low_latency_mode;
+  if (FLAGS_num_parallel_segments < 0) {
+    LOG(ERROR) << "--num_parallel_segments should not be negative.";
+    return false;
+  }
+  if (FLAGS_num_parallel_segments > 1 &&
+      (FLAGS_single_segment || FLAGS_low_latency_mode)) {
+    LOG(ERROR) << "--num_parallel_segments requires multiple segments and is "
+                  "not supported in --low_latency_mode.";
+    return false;
+  }
+  muxer_options->num_parallel_segments = FLAGS_num_parallel_segments;
   if (FLAGS_override_version_string)
     muxer_options->packager_version_string = FLAGS_test_version_string;
   return true;
@@ -173,6 +209,13 @@ bool GetMpdOptions(MpdOptions* mpd_options) {
   mpd_options->time_shift_buffer_depth = FLAGS_time_shift_buffer_depth;
   mpd_options->suggested_presentation_delay =
       FLAGS_suggested_presentation_delay;
+  mpd_options->flush_coalescing_window = FLAGS_mpd_flush_coalescing_window;
+  // Segments are complete segment_duration after they start, but their first
+  // chunk is available fragment_duration after they start.
+  if (FLAGS_low_latency_mode) {
+    mpd_options->segment_availability_time_offset =
+        FLAGS_segment_duration - FLAGS_fragment_duration;
+  }
   if (FLAGS_override_version_string)
     mpd_options->packager_version_string = FLAGS_test_version_string;
   return true;
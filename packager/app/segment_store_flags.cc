@@ -0,0 +1,26 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/app/segment_store_flags.h"
+
+DEFINE_int32(segment_store_http_port,
+             0,
+             "Port of the HTTP server of the in-memory segment store. Outputs "
+             "and segment templates prefixed with store:// are written to the "
+             "segment store, and served from http://<address>:<port>/<name> "
+             "while they are written. Segments older than "
+             "--time_shift_buffer_depth are evicted from the store. Specify 0 "
+             "to disable the server.");
+DEFINE_string(segment_store_http_address,
+              "127.0.0.1",
+              "IPv4 address of the interface on which the HTTP server of the "
+              "segment store listens.");
+DEFINE_int32(segment_store_http_max_connections,
+             64,
+             "Maximum number of connections served at the same time by the "
+             "HTTP server of the segment store. Each connection is served on "
+             "a thread of its own; further connections are answered with "
+             "503 Service Unavailable.");
@@ -0,0 +1,16 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_APP_SEGMENT_STORE_FLAGS_H_
+#define PACKAGER_APP_SEGMENT_STORE_FLAGS_H_
+
+#include <gflags/gflags.h>
+
+DECLARE_int32(segment_store_http_port);
+DECLARE_string(segment_store_http_address);
+DECLARE_int32(segment_store_http_max_connections);
+
+#endif  // PACKAGER_APP_SEGMENT_STORE_FLAGS_H_
@@ -125,6 +125,23 @@ bool AesCryptor::GenerateRandomIv(FourCC protection_scheme,
   return true;
 }
 
+bool AesCryptor::CryptStridedInternal(const uint8_t* text,
+                                      uint8_t* crypt_text,
+                                      size_t block_size,
+                                      size_t stride,
+                                      size_t num_blocks) {
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const size_t offset = i * stride;
+    size_t crypt_size = block_size;
+    if (!CryptInternal(text + offset, block_size, crypt_text + offset,
+                       &crypt_size)) {
+      return false;
+    }
+    DCHECK_EQ(block_size, crypt_size);
+  }
+  return true;
+}
+
 size_t AesCryptor::NumPaddingBytes(size_t size) const {
   // No padding by default.
   return 0;
@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 
+#include "packager/base/logging.h"
 #include "packager/base/macros.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/fourccs.h"
@@ -68,6 +69,26 @@ class AesCryptor {
   }
   /// @}
 
+  /// Crypt @a num_blocks spans of @a block_size bytes each, with consecutive
+  /// spans starting @a stride bytes apart. The bytes between the spans are not
+  /// touched in @a crypt_text. This is used by pattern encryption to crypt a
+  /// whole subsample in one call. The text and crypt_text pointers can be the
+  /// same address for in place encryption/decryption.
+  /// @return true on success, false otherwise.
+  bool CryptStrided(const uint8_t* text,
+                    uint8_t* crypt_text,
+                    size_t block_size,
+                    size_t stride,
+                    size_t num_blocks) {
+    DCHECK_LE(block_size, stride);
+    if (constant_iv_flag_ == kUseConstantIv)
+      SetIvInternal();
+    else
+      num_crypt_bytes_ += block_size * num_blocks;
+    return CryptStridedInternal(text, crypt_text, block_size, stride,
+                                num_blocks);
+  }
+
   /// Set IV.
   /// @return true if successful, false if the input is invalid.
   bool SetIv(const std::vector<uint8_t>& iv);
@@ -77,6 +98,14 @@ class AesCryptor {
   /// This is used by encryptors only. It is a NOP if using kUseConstantIv.
   void UpdateIv();
 
+  /// Account for @a num_bytes crypted with the current iv by another cryptor,
+  /// e.g. on a worker thread, so that UpdateIv() advances the iv as if the
+  /// bytes were crypted by this cryptor. It is a NOP if using kUseConstantIv.
+  void AddCryptBytes(size_t num_bytes) {
+    if (constant_iv_flag_ != kUseConstantIv)
+      num_crypt_bytes_ += num_bytes;
+  }
+
   /// @return The current iv.
   const std::vector<uint8_t>& iv() const { return iv_; }
 
@@ -94,6 +123,15 @@ class AesCryptor {
   const AES_KEY* aes_key() const { return aes_key_.get(); }
   AES_KEY* mutable_aes_key() { return aes_key_.get(); }
 
+  // Internal implementation of CryptStrided. The default implementation calls
+  // CryptInternal for every span. |block_size| should be a crypt size that
+  // does not change the output size, i.e. no padding.
+  virtual bool CryptStridedInternal(const uint8_t* text,
+                                    uint8_t* crypt_text,
+                                    size_t block_size,
+                                    size_t stride,
+                                    size_t num_blocks);
+
  private:
   // Internal implementation of crypt function.
   // |text| points to the input text.
@@ -220,6 +220,47 @@ TEST_F(AesCtrEncryptorTest, 128BitIVBoundaryCaseEncryption) {
   EXPECT_EQ(encrypted, encrypted_verify);
 }
 
+TEST_F(AesCtrEncryptorTest, 64BitCounterWrapAcrossSubsamples) {
+  const size_t kNumBlocks = 64;
+  const uint8_t kNumBlocksBeforeWrap = 5;
+  std::vector<uint8_t> iv(kIv128Max64, kIv128Max64 + arraysize(kIv128Max64));
+  iv.back() -= kNumBlocksBeforeWrap - 1;
+
+  std::vector<uint8_t> plaintext(kNumBlocks * kAesBlockSize);
+  for (size_t i = 0; i < plaintext.size(); ++i)
+    plaintext[i] = static_cast<uint8_t>(i * 7);
+
+  // Encrypt block by block, with the counter computed independently.
+  std::vector<uint8_t> expected(plaintext.size());
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    std::vector<uint8_t> block_iv(kIv128Zero,
+                                  kIv128Zero + arraysize(kIv128Zero));
+    if (i < kNumBlocksBeforeWrap) {
+      block_iv = iv;
+      block_iv.back() += i;
+    } else {
+      block_iv.back() = i - kNumBlocksBeforeWrap;
+    }
+    ASSERT_TRUE(encryptor_.InitializeWithIv(key_, block_iv));
+    ASSERT_TRUE(encryptor_.Crypt(&plaintext[i * kAesBlockSize], kAesBlockSize,
+                                 &expected[i * kAesBlockSize]));
+  }
+
+  // Encrypt in odd-sized subsamples crossing the wrap-around boundary.
+  ASSERT_TRUE(encryptor_.InitializeWithIv(key_, iv));
+  std::vector<uint8_t> encrypted(plaintext.size());
+  const size_t kSubsampleSizes[] = {7, 50, 13, 300, 1, 653};
+  size_t offset = 0;
+  for (size_t subsample_size : kSubsampleSizes) {
+    ASSERT_TRUE(encryptor_.Crypt(&plaintext[offset], subsample_size,
+                                 &encrypted[offset]));
+    offset += subsample_size;
+    EXPECT_EQ(offset % kAesBlockSize, encryptor_.block_offset());
+  }
+  ASSERT_EQ(plaintext.size(), offset);
+  EXPECT_EQ(expected, encrypted);
+}
+
 TEST_F(AesCtrEncryptorTest, 64BitIvUpdate) {
   std::vector<uint8_t> iv_zero(kIv64Zero, kIv64Zero + arraysize(kIv64Zero));
   ASSERT_TRUE(encryptor_.InitializeWithIv(key_, iv_zero));
@@ -153,6 +153,28 @@ bool AesCbcDecryptor::CryptInternal(const uint8_t* ciphertext,
   return true;
 }
 
+bool AesCbcDecryptor::CryptStridedInternal(const uint8_t* ciphertext,
+                                            uint8_t* plaintext,
+                                            size_t block_size,
+                                            size_t stride,
+                                            size_t num_blocks) {
+  DCHECK(aes_key());
+
+  if (padding_scheme_ != kNoPadding || block_size % AES_BLOCK_SIZE != 0) {
+    return AesCryptor::CryptStridedInternal(ciphertext, plaintext, block_size,
+                                            stride, num_blocks);
+  }
+
+  // The cipher block chain continues from one span to the next, skipping the
+  // bytes in between.
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const size_t offset = i * stride;
+    AES_cbc_encrypt(ciphertext + offset, plaintext + offset, block_size,
+                    aes_key(), internal_iv_.data(), AES_DECRYPT);
+  }
+  return true;
+}
+
 void AesCbcDecryptor::SetIvInternal() {
   internal_iv_ = iv();
   internal_iv_.resize(AES_BLOCK_SIZE, 0);
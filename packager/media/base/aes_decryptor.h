@@ -53,6 +53,11 @@ class AesCbcDecryptor : public AesCryptor {
                      size_t ciphertext_size,
                      uint8_t* plaintext,
                      size_t* plaintext_size) override;
+  bool CryptStridedInternal(const uint8_t* ciphertext,
+                            uint8_t* plaintext,
+                            size_t block_size,
+                            size_t stride,
+                            size_t num_blocks) override;
   void SetIvInternal() override;
 
   const CbcPaddingScheme padding_scheme_;
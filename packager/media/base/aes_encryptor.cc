@@ -12,14 +12,16 @@
 
 namespace {
 
-// Increment an 8-byte counter by 1. Return true if overflowed.
-bool Increment64(uint8_t* counter) {
+// Offset of the 64 bit block counter in the 16 byte AES-CTR counter block.
+const size_t kCencCounterOffset = 8;
+
+// Read an 8-byte big endian counter.
+uint64_t ReadCounter64(const uint8_t* counter) {
   DCHECK(counter);
-  for (int i = 7; i >= 0; --i) {
-    if (++counter[i] != 0)
-      return false;
-  }
-  return true;
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+    value = (value << 8) | counter[i];
+  return value;
 }
 
 // AES defines three key sizes: 128, 192 and 256 bits.
@@ -57,7 +59,6 @@ AesCtrEncryptor::AesCtrEncryptor()
 
 AesCtrEncryptor::~AesCtrEncryptor() {}
 
-
 bool AesCtrEncryptor::CryptInternal(const uint8_t* plaintext,
                                     size_t plaintext_size,
                                     uint8_t* ciphertext,
@@ -74,18 +75,38 @@ bool AesCtrEncryptor::CryptInternal(const uint8_t* plaintext,
   }
   *ciphertext_size = plaintext_size;
 
-  for (size_t i = 0; i < plaintext_size; ++i) {
-    if (block_offset_ == 0) {
-      AES_encrypt(&counter_[0], &encrypted_counter_[0], aes_key());
-      // As mentioned in ISO/IEC 23001-7:2016 CENC spec, of the 16 byte counter
-      // block, bytes 8 to 15 (i.e. the least significant bytes) are used as a
-      // simple 64 bit unsigned integer that is incremented by one for each
-      // subsequent block of sample data processed and is kept in network byte
-      // order.
-      Increment64(&counter_[8]);
+  // As mentioned in ISO/IEC 23001-7:2016 CENC spec, of the 16 byte counter
+  // block, bytes 8 to 15 (i.e. the least significant bytes) are used as a
+  // simple 64 bit unsigned integer that is incremented by one for each
+  // subsequent block of sample data processed and is kept in network byte
+  // order. AES_ctr128_encrypt, which generates the key stream for multiple
+  // counter blocks at once, increments the whole 128 bit counter instead, so
+  // the input is split at 64 bit counter wrap-around boundaries and bytes 0 to
+  // 7 are restored after each run.
+  uint8_t counter_high[kCencCounterOffset];
+  memcpy(counter_high, &counter_[0], kCencCounterOffset);
+
+  while (plaintext_size > 0) {
+    // Bytes remaining in the key stream of the current (partial) block.
+    const size_t carry_size =
+        block_offset_ == 0 ? 0 : AES_BLOCK_SIZE - block_offset_;
+    // Number of new counter blocks until the 64 bit counter wraps around.
+    // Zero means 2^64, which is never reached.
+    const uint64_t blocks_to_wrap =
+        0 - ReadCounter64(&counter_[kCencCounterOffset]);
+    size_t run_size = plaintext_size;
+    if (blocks_to_wrap != 0 && plaintext_size > carry_size &&
+        (plaintext_size - carry_size - 1) / AES_BLOCK_SIZE >= blocks_to_wrap) {
+      run_size = carry_size + blocks_to_wrap * AES_BLOCK_SIZE;
     }
-    ciphertext[i] = plaintext[i] ^ encrypted_counter_[block_offset_];
-    block_offset_ = (block_offset_ + 1) % AES_BLOCK_SIZE;
+
+    AES_ctr128_encrypt(plaintext, ciphertext, run_size, aes_key(),
+                       &counter_[0], &encrypted_counter_[0], &block_offset_);
+    memcpy(&counter_[0], counter_high, kCencCounterOffset);
+
+    plaintext += run_size;
+    ciphertext += run_size;
+    plaintext_size -= run_size;
   }
   return true;
 }
@@ -184,6 +205,28 @@ bool AesCbcEncryptor::CryptInternal(const uint8_t* plaintext,
   return true;
 }
 
+bool AesCbcEncryptor::CryptStridedInternal(const uint8_t* plaintext,
+                                            uint8_t* ciphertext,
+                                            size_t block_size,
+                                            size_t stride,
+                                            size_t num_blocks) {
+  DCHECK(aes_key());
+
+  if (padding_scheme_ != kNoPadding || block_size % AES_BLOCK_SIZE != 0) {
+    return AesCryptor::CryptStridedInternal(plaintext, ciphertext, block_size,
+                                            stride, num_blocks);
+  }
+
+  // The cipher block chain continues from one span to the next, skipping the
+  // bytes in between.
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const size_t offset = i * stride;
+    AES_cbc_encrypt(plaintext + offset, ciphertext + offset, block_size,
+                    aes_key(), internal_iv_.data(), AES_ENCRYPT);
+  }
+  return true;
+}
+
 void AesCbcEncryptor::SetIvInternal() {
   internal_iv_ = iv();
   internal_iv_.resize(AES_BLOCK_SIZE, 0);
@@ -100,6 +100,11 @@ class AesCbcEncryptor : public AesEncryptor {
                      size_t plaintext_size,
                      uint8_t* ciphertext,
                      size_t* ciphertext_size) override;
+  bool CryptStridedInternal(const uint8_t* plaintext,
+                            uint8_t* ciphertext,
+                            size_t block_size,
+                            size_t stride,
+                            size_t num_blocks) override;
   void SetIvInternal() override;
   size_t NumPaddingBytes(size_t size) const override;
 
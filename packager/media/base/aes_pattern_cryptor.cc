@@ -57,33 +57,30 @@ bool AesPatternCryptor::CryptInternal(const uint8_t* text,
     const size_t crypt_byte_size = text_size / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
     if (!cryptor_->Crypt(text, crypt_byte_size, crypt_text))
       return false;
-    memcpy(crypt_text + crypt_byte_size, text + crypt_byte_size,
-           text_size - crypt_byte_size);
+    if (text != crypt_text) {
+      memcpy(crypt_text + crypt_byte_size, text + crypt_byte_size,
+             text_size - crypt_byte_size);
+    }
     return true;
   }
 
-  while (text_size > 0) {
-    const size_t crypt_byte_size = crypt_byte_block_ * AES_BLOCK_SIZE;
-    if (NeedEncrypt(text_size, crypt_byte_size)) {
-      if (!cryptor_->Crypt(text, crypt_byte_size, crypt_text))
-        return false;
-    } else {
-      // If there is not enough data, just keep it in clear.
-      memcpy(crypt_text, text, text_size);
-      return true;
-    }
-    text += crypt_byte_size;
-    text_size -= crypt_byte_size;
-    crypt_text += crypt_byte_size;
+  // Every pattern, including the last partial one if it has enough data,
+  // starts with |crypt_byte_size| bytes to be encrypted, followed by up to
+  // |skip_byte_size| bytes in clear.
+  const size_t crypt_byte_size = crypt_byte_block_ * AES_BLOCK_SIZE;
+  const size_t pattern_size =
+      (crypt_byte_block_ + skip_byte_block_) * AES_BLOCK_SIZE;
+  size_t num_crypt_spans = text_size / pattern_size;
+  if (NeedEncrypt(text_size % pattern_size, crypt_byte_size))
+    ++num_crypt_spans;
 
-    const size_t skip_byte_size = std::min(
-        static_cast<size_t>(skip_byte_block_ * AES_BLOCK_SIZE), text_size);
-    memcpy(crypt_text, text, skip_byte_size);
-    text += skip_byte_size;
-    text_size -= skip_byte_size;
-    crypt_text += skip_byte_size;
-  }
-  return true;
+  // The clear bytes are already in place for in place encryption.
+  if (text != crypt_text)
+    memcpy(crypt_text, text, text_size);
+  if (num_crypt_spans == 0)
+    return true;
+  return cryptor_->CryptStrided(text, crypt_text, crypt_byte_size,
+                                pattern_size, num_crypt_spans);
 }
 
 void AesPatternCryptor::SetIvInternal() {
@@ -7,7 +7,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/base/aes_decryptor.h"
+#include "packager/media/base/aes_encryptor.h"
 #include "packager/media/base/aes_pattern_cryptor.h"
 
 using ::testing::_;
@@ -249,5 +253,44 @@ TEST(FullSampleSpecialPatternTest, Test) {
   EXPECT_EQ(std::string(96, 'e') + std::string(4, 'c'), crypt_text);
 }
 
+TEST(AesPatternCryptorCbcTest, InPlaceAndOutOfPlaceCryptMatch) {
+  const uint8_t kCbcsCryptByteBlock = 1;
+  const uint8_t kCbcsSkipByteBlock = 9;
+  std::vector<uint8_t> key(16, 'k');
+  std::vector<uint8_t> iv(16, 'i');
+  AesPatternCryptor encryptor(
+      kCbcsCryptByteBlock, kCbcsSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesPatternCryptor::kUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding)));
+  AesPatternCryptor decryptor(
+      kCbcsCryptByteBlock, kCbcsSkipByteBlock,
+      AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+      AesPatternCryptor::kUseConstantIv,
+      scoped_ptr<AesCryptor>(new AesCbcDecryptor(kNoPadding)));
+  ASSERT_TRUE(encryptor.InitializeWithIv(key, iv));
+  ASSERT_TRUE(decryptor.InitializeWithIv(key, iv));
+
+  // Three full patterns and a partial pattern with one crypt block.
+  std::vector<uint8_t> text(3 * 160 + 20);
+  for (size_t i = 0; i < text.size(); ++i)
+    text[i] = static_cast<uint8_t>(i);
+
+  std::vector<uint8_t> crypt_text(text.size());
+  ASSERT_TRUE(encryptor.Crypt(text.data(), text.size(), crypt_text.data()));
+  EXPECT_NE(text, crypt_text);
+  // Skipped blocks are left in clear.
+  EXPECT_TRUE(std::equal(text.begin() + 16, text.begin() + 160,
+                         crypt_text.begin() + 16));
+  EXPECT_TRUE(std::equal(text.end() - 4, text.end(), crypt_text.end() - 4));
+
+  std::vector<uint8_t> buffer = text;
+  ASSERT_TRUE(encryptor.Crypt(buffer.data(), buffer.size(), buffer.data()));
+  EXPECT_EQ(crypt_text, buffer);
+
+  ASSERT_TRUE(decryptor.Crypt(buffer.data(), buffer.size(), buffer.data()));
+  EXPECT_EQ(text, buffer);
+}
+
 }  // namespace media
 }  // namespace shaka
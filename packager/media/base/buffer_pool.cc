@@ -0,0 +1,140 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/buffer_pool.h"
+
+#include <inttypes.h>
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/stringprintf.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+base::LazyInstance<BufferPool>::Leaky g_buffer_pool =
+    LAZY_INSTANCE_INITIALIZER;
+}  // namespace
+
+const size_t BufferPool::kMinPooledCapacity;
+const size_t BufferPool::kMaxPooledCapacity;
+const uint64_t BufferPool::kDefaultMaxBytesHeld;
+const size_t BufferPool::kNumSizeClasses;
+
+BufferPool::Stats::Stats() : hits(0), misses(0), drops(0), bytes_held(0) {}
+
+std::string BufferPool::Stats::ToString() const {
+  return base::StringPrintf("hits: %" PRIu64 " misses: %" PRIu64
+                            " drops: %" PRIu64 " bytes_held: %" PRIu64,
+                            hits, misses, drops, bytes_held);
+}
+
+BufferPool::BufferPool(uint64_t max_bytes_held)
+    : max_bytes_held_(max_bytes_held) {}
+
+BufferPool::BufferPool() : max_bytes_held_(kDefaultMaxBytesHeld) {}
+
+BufferPool::~BufferPool() {}
+
+// static
+BufferPool* BufferPool::GetInstance() {
+  return g_buffer_pool.Pointer();
+}
+
+void BufferPool::Acquire(size_t min_capacity, std::vector<uint8_t>* buffer) {
+  DCHECK(buffer);
+  buffer->clear();
+  if (min_capacity < kMinPooledCapacity || min_capacity > kMaxPooledCapacity) {
+    buffer->reserve(min_capacity);
+    return;
+  }
+
+  const size_t size_class = GetSizeClassToAcquire(min_capacity);
+  std::vector<uint8_t> discarded_buffer;
+  {
+    base::AutoLock auto_lock(lock_);
+    std::vector<std::vector<uint8_t> >& free_buffers =
+        free_buffers_[size_class];
+    if (!free_buffers.empty()) {
+      ++stats_.hits;
+      stats_.bytes_held -= free_buffers.back().capacity();
+      discarded_buffer.swap(*buffer);
+      buffer->swap(free_buffers.back());
+      free_buffers.pop_back();
+      DCHECK_GE(buffer->capacity(), min_capacity);
+      return;
+    }
+    ++stats_.misses;
+  }
+  // Round up the capacity so the buffer goes back to the same size class when
+  // it is released.
+  std::vector<uint8_t>().swap(*buffer);
+  buffer->reserve(kMinPooledCapacity << size_class);
+}
+
+void BufferPool::Release(std::vector<uint8_t>* buffer) {
+  DCHECK(buffer);
+  // Buffers which are not kept are freed when this goes out of scope, outside
+  // of the lock.
+  std::vector<uint8_t> released_buffer;
+  released_buffer.swap(*buffer);
+
+  const size_t capacity = released_buffer.capacity();
+  if (capacity < kMinPooledCapacity || capacity > kMaxPooledCapacity)
+    return;
+
+  base::AutoLock auto_lock(lock_);
+  if (stats_.bytes_held + capacity > max_bytes_held_) {
+    ++stats_.drops;
+    return;
+  }
+  stats_.bytes_held += capacity;
+  std::vector<std::vector<uint8_t> >& free_buffers =
+      free_buffers_[GetSizeClassToRelease(capacity)];
+  free_buffers.resize(free_buffers.size() + 1);
+  free_buffers.back().swap(released_buffer);
+  free_buffers.back().clear();
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  base::AutoLock auto_lock(lock_);
+  return stats_;
+}
+
+void BufferPool::Clear() {
+  std::vector<std::vector<uint8_t> > buffers_to_free[kNumSizeClasses];
+  base::AutoLock auto_lock(lock_);
+  for (size_t i = 0; i < kNumSizeClasses; ++i)
+    buffers_to_free[i].swap(free_buffers_[i]);
+  stats_.bytes_held = 0;
+}
+
+// static
+size_t BufferPool::GetSizeClassToAcquire(size_t capacity) {
+  DCHECK_GE(capacity, kMinPooledCapacity);
+  DCHECK_LE(capacity, kMaxPooledCapacity);
+  size_t size_class = 0;
+  while ((kMinPooledCapacity << size_class) < capacity)
+    ++size_class;
+  DCHECK_LT(size_class, kNumSizeClasses);
+  return size_class;
+}
+
+// static
+size_t BufferPool::GetSizeClassToRelease(size_t capacity) {
+  DCHECK_GE(capacity, kMinPooledCapacity);
+  DCHECK_LE(capacity, kMaxPooledCapacity);
+  size_t size_class = 0;
+  while (size_class + 1 < kNumSizeClasses &&
+         (kMinPooledCapacity << (size_class + 1)) <= capacity) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+}  // namespace media
+}  // namespace shaka
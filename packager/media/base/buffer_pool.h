@@ -0,0 +1,100 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_BUFFER_POOL_H_
+#define MEDIA_BASE_BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace shaka {
+namespace media {
+
+/// A thread safe pool of byte buffers, used to recycle the storage of sample
+/// payloads and fragment buffers instead of going back to the heap for every
+/// sample and fragment. Buffers are grouped in power-of-two size classes by
+/// capacity. Small buffers are not pooled.
+class BufferPool {
+ public:
+  /// Pool counters.
+  struct Stats {
+    Stats();
+
+    /// Number of Acquire() calls served from the pool.
+    uint64_t hits;
+    /// Number of Acquire() calls which had to allocate a new buffer.
+    uint64_t misses;
+    /// Number of released buffers freed because the pool was full.
+    uint64_t drops;
+    /// Total capacity of the buffers held in the pool, in bytes.
+    uint64_t bytes_held;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
+  /// Create a pool.
+  /// @param max_bytes_held is the maximum total capacity of the buffers held
+  ///        in the pool. Buffers released beyond that are freed.
+  explicit BufferPool(uint64_t max_bytes_held);
+  /// Create a pool holding up to kDefaultMaxBytesHeld bytes.
+  BufferPool();
+  ~BufferPool();
+
+  /// @return the pool shared by the process.
+  static BufferPool* GetInstance();
+
+  /// Get an empty buffer with a capacity of at least @a min_capacity bytes.
+  /// @param min_capacity is the capacity needed.
+  /// @param[out] buffer receives the buffer. Its previous content is
+  ///             discarded.
+  void Acquire(size_t min_capacity, std::vector<uint8_t>* buffer);
+
+  /// Return the storage of @a buffer to the pool. @a buffer is left empty
+  /// with no capacity.
+  void Release(std::vector<uint8_t>* buffer);
+
+  /// @return a snapshot of the pool counters.
+  Stats GetStats() const;
+
+  /// Free all the buffers held in the pool. The counters are kept.
+  void Clear();
+
+  /// Buffers with less capacity than this are not pooled.
+  static const size_t kMinPooledCapacity = 4096;
+  /// Buffers with more capacity than this are not pooled.
+  static const size_t kMaxPooledCapacity = 64 * 1024 * 1024;
+  /// Default maximum total capacity of the buffers held in a pool.
+  static const uint64_t kDefaultMaxBytesHeld = 64 * 1024 * 1024;
+
+ private:
+  // Number of power-of-two size classes between kMinPooledCapacity and
+  // kMaxPooledCapacity, inclusive.
+  static const size_t kNumSizeClasses = 15;
+
+  // @return the size class of buffers which can hold |capacity| bytes.
+  static size_t GetSizeClassToAcquire(size_t capacity);
+  // @return the size class a buffer with |capacity| bytes belongs to.
+  static size_t GetSizeClassToRelease(size_t capacity);
+
+  const uint64_t max_bytes_held_;
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  std::vector<std::vector<uint8_t> > free_buffers_[kNumSizeClasses];
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // MEDIA_BASE_BUFFER_POOL_H_
@@ -0,0 +1,89 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/media/base/buffer_pool.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const uint64_t kMaxBytesHeld = 1024 * 1024;
+}  // namespace
+
+class BufferPoolTest : public ::testing::Test {
+ public:
+  BufferPoolTest() : pool_(kMaxBytesHeld) {}
+
+ protected:
+  BufferPool pool_;
+};
+
+TEST_F(BufferPoolTest, AcquireMissThenHit) {
+  std::vector<uint8_t> buffer;
+  pool_.Acquire(5000, &buffer);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_GE(buffer.capacity(), 5000u);
+  buffer.resize(5000, 0x55);
+  const uint8_t* storage = buffer.data();
+
+  pool_.Release(&buffer);
+  EXPECT_EQ(0u, buffer.capacity());
+  BufferPool::Stats stats = pool_.GetStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(8192u, stats.bytes_held);
+
+  // A request in the same size class gets the same storage back.
+  pool_.Acquire(6000, &buffer);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(storage, buffer.data());
+  stats = pool_.GetStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(0u, stats.bytes_held);
+}
+
+TEST_F(BufferPoolTest, DifferentSizeClass) {
+  std::vector<uint8_t> buffer;
+  pool_.Acquire(5000, &buffer);
+  pool_.Release(&buffer);
+
+  pool_.Acquire(9000, &buffer);
+  EXPECT_GE(buffer.capacity(), 9000u);
+  BufferPool::Stats stats = pool_.GetStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(8192u, stats.bytes_held);
+}
+
+TEST_F(BufferPoolTest, SmallBuffersNotPooled) {
+  std::vector<uint8_t> buffer;
+  pool_.Acquire(100, &buffer);
+  EXPECT_GE(buffer.capacity(), 100u);
+  pool_.Release(&buffer);
+  BufferPool::Stats stats = pool_.GetStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(0u, stats.misses);
+  EXPECT_EQ(0u, stats.bytes_held);
+}
+
+TEST_F(BufferPoolTest, DropWhenFull) {
+  std::vector<uint8_t> buffers[2];
+  pool_.Acquire(kMaxBytesHeld, &buffers[0]);
+  pool_.Acquire(kMaxBytesHeld, &buffers[1]);
+  pool_.Release(&buffers[0]);
+  pool_.Release(&buffers[1]);
+  BufferPool::Stats stats = pool_.GetStats();
+  EXPECT_EQ(1u, stats.drops);
+  EXPECT_EQ(kMaxBytesHeld, stats.bytes_held);
+
+  pool_.Clear();
+  EXPECT_EQ(0u, pool_.GetStats().bytes_held);
+}
+
+}  // namespace media
+}  // namespace shaka
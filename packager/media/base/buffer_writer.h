@@ -50,6 +50,12 @@ class BufferWriter {
   void AppendArray(const uint8_t* buf, size_t size);
   void AppendBuffer(const BufferWriter& buffer);
 
+  /// Grow the buffer by @a size bytes, to be filled in place by the caller,
+  /// e.g. by serializers which know their output size up front.
+  /// @return A pointer to the first byte added. It is valid until the buffer
+  ///         is modified again.
+  uint8_t* Grow(size_t size);
+
   void Swap(BufferWriter* buffer) { buf_.swap(buffer->buf_); }
   void SwapBuffer(std::vector<uint8_t>* buffer) { buf_.swap(*buffer); }
 
@@ -57,6 +63,9 @@ class BufferWriter {
   size_t Size() const { return buf_.size(); }
   /// @return Underlying buffer. Behavior is undefined if the buffer size is 0.
   const uint8_t* Buffer() const { return buf_.data(); }
+  /// @return Underlying mutable buffer, e.g. for in place encryption of data
+  ///         already appended. Behavior is undefined if the buffer size is 0.
+  uint8_t* MutableBuffer() { return buf_.data(); }
 
   /// Write the buffer to file. The internal buffer will be cleared after
   /// writing.
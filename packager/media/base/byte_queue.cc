@@ -4,6 +4,8 @@
 
 #include "packager/media/base/byte_queue.h"
 
+#include <algorithm>
+
 #include "packager/base/logging.h"
 
 namespace shaka {
@@ -12,8 +14,21 @@ namespace media {
 // Default starting size for the queue.
 enum { kDefaultQueueSize = 1024 };
 
+// Bytes of the queue's own storage are referenced instead of copied only if
+// they take at least 1 / kMaxPinnedRatio of the storage, and at least
+// kMinSharedSize bytes, for which copying costs more than it saves.
+enum { kMinSharedSize = 64 * 1024, kMaxPinnedRatio = 4 };
+
+namespace {
+scoped_refptr<base::RefCountedBytes> CreateBuffer(size_t size) {
+  scoped_refptr<base::RefCountedBytes> buffer(new base::RefCountedBytes);
+  buffer->data().resize(size);
+  return buffer;
+}
+}  // namespace
+
 ByteQueue::ByteQueue()
-    : buffer_(new uint8_t[kDefaultQueueSize]),
+    : buffer_(CreateBuffer(kDefaultQueueSize)),
       size_(kDefaultQueueSize),
       offset_(0),
       used_(0) {
@@ -22,6 +37,10 @@ ByteQueue::ByteQueue()
 ByteQueue::~ByteQueue() {}
 
 void ByteQueue::Reset() {
+  external_buffer_ = NULL;
+  // The shared bytes must not be overwritten.
+  if (IsBufferShared())
+    buffer_ = CreateBuffer(size_);
   offset_ = 0;
   used_ = 0;
 }
@@ -30,33 +49,66 @@ void ByteQueue::Push(const uint8_t* data, int size) {
   DCHECK(data);
   DCHECK_GT(size, 0);
 
+  if (external_buffer_)
+    MoveExternalBytes();
+
   size_t size_needed = used_ + size;
 
-  // Check to see if we need a bigger buffer.
-  if (size_needed > size_) {
-    size_t new_size = 2 * size_;
-    while (size_needed > new_size && new_size > size_)
-      new_size *= 2;
+  // Check to see if we need a bigger buffer, or a new buffer because the
+  // data in the queue needs to be moved but the buffer is shared.
+  const bool needs_move = (offset_ + used_ + size) > size_;
+  if (size_needed > size_ || (needs_move && IsBufferShared())) {
+    size_t new_size = size_;
+    if (size_needed > size_) {
+      new_size = 2 * size_;
+      while (size_needed > new_size && new_size > size_)
+        new_size *= 2;
 
-    // Sanity check to make sure we didn't overflow.
-    CHECK_GT(new_size, size_);
+      // Sanity check to make sure we didn't overflow.
+      CHECK_GT(new_size, size_);
+    }
 
-    scoped_ptr<uint8_t[]> new_buffer(new uint8_t[new_size]);
+    scoped_refptr<base::RefCountedBytes> new_buffer = CreateBuffer(new_size);
 
     // Copy the data from the old buffer to the start of the new one.
     if (used_ > 0)
-      memcpy(new_buffer.get(), front(), used_);
+      memcpy(&new_buffer->data()[0], front(), used_);
 
-    buffer_.reset(new_buffer.release());
+    buffer_ = new_buffer;
     size_ = new_size;
     offset_ = 0;
-  } else if ((offset_ + used_ + size) > size_) {
+  } else if (needs_move) {
     // The buffer is big enough, but we need to move the data in the queue.
-    memmove(buffer_.get(), front(), used_);
+    memmove(&buffer_->data()[0], front(), used_);
     offset_ = 0;
   }
 
-  memcpy(front() + used_, data, size);
+  memcpy(&buffer_->data()[0] + offset_ + used_, data, size);
+  used_ += size;
+}
+
+void ByteQueue::PushShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                           size_t offset,
+                           int size) {
+  DCHECK(buffer);
+  DCHECK_GE(size, 0);
+  DCHECK_LE(offset + size, buffer->size());
+  // An empty range, e.g. of an empty mapped file, adds nothing to the queue.
+  if (size == 0)
+    return;
+
+  if (used_ > 0 && (external_buffer_.get() != buffer.get() ||
+                    offset_ + used_ != offset)) {
+    Push(buffer->front() + offset, size);
+    return;
+  }
+
+  if (used_ == 0) {
+    // |buffer_| is empty, or holds no byte of the queue. It is used again,
+    // from its start, by the next Push().
+    external_buffer_ = buffer;
+    offset_ = offset;
+  }
   used_ += size;
 }
 
@@ -67,21 +119,57 @@ void ByteQueue::Peek(const uint8_t** data, int* size) const {
   *size = used_;
 }
 
+void ByteQueue::PeekShared(scoped_refptr<base::RefCountedMemory>* buffer,
+                           size_t* offset) const {
+  DCHECK(buffer);
+  DCHECK(offset);
+  if (external_buffer_)
+    *buffer = external_buffer_;
+  else
+    *buffer = buffer_;
+  *offset = offset_;
+}
+
+int ByteQueue::MinSharedSize() const {
+  if (external_buffer_)
+    return 0;
+  return std::max<int>(kMinSharedSize,
+                       (size_ + kMaxPinnedRatio - 1) / kMaxPinnedRatio);
+}
+
 void ByteQueue::Pop(int count) {
   DCHECK_LE(count, used_);
 
   offset_ += count;
   used_ -= count;
 
-  // Move the offset back to 0 if we have reached the end of the buffer.
-  if (offset_ == size_) {
+  // Move the offset back to 0 if we have reached the end of the buffer. The
+  // next Push() switches to a new buffer if this one is shared.
+  if (!external_buffer_ && offset_ == size_ && !IsBufferShared()) {
     DCHECK_EQ(used_, 0);
     offset_ = 0;
   }
 }
 
-uint8_t* ByteQueue::front() const {
-  return buffer_.get() + offset_;
+const uint8_t* ByteQueue::front() const {
+  if (external_buffer_)
+    return external_buffer_->front() + offset_;
+  return &buffer_->data()[0] + offset_;
+}
+
+void ByteQueue::MoveExternalBytes() {
+  scoped_refptr<base::RefCountedMemory> external_buffer;
+  external_buffer.swap(external_buffer_);
+  const size_t external_offset = offset_;
+  const int external_used = used_;
+
+  // The shared bytes must not be overwritten.
+  if (IsBufferShared())
+    buffer_ = CreateBuffer(size_);
+  offset_ = 0;
+  used_ = 0;
+  if (external_used > 0)
+    Push(external_buffer->front() + external_offset, external_used);
 }
 
 }  // namespace media
@@ -7,7 +7,9 @@
 
 #include <stdint.h>
 
-#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
 
 namespace shaka {
 namespace media {
@@ -17,6 +19,14 @@ namespace media {
 /// The contents of the queue can be observed via the Peek() method. This class
 /// manages the underlying storage of the queue and tries to minimize the
 /// number of buffer copies when data is appended and removed.
+///
+/// The underlying storage can be shared with the users of the queue, see
+/// PeekShared(). Bytes in the storage are never modified while it is shared;
+/// the queue switches to a new storage instead. A reference to a few bytes
+/// keeps the whole storage alive, so the users only reference ranges of at
+/// least MinSharedSize() bytes and copy smaller ones. Bytes which already live
+/// in an immutable shared buffer, e.g. a memory mapped file, can be queued
+/// without copying them with PushShared().
 class ByteQueue {
  public:
   ByteQueue();
@@ -28,24 +38,61 @@ class ByteQueue {
   /// Append new bytes to the end of the queue.
   void Push(const uint8_t* data, int size);
 
+  /// Append bytes held in an immutable shared buffer to the end of the queue.
+  /// The bytes are referenced instead of copied if the queue is empty or if
+  /// they follow the bytes pushed by the previous PushShared() call in the
+  /// same buffer. They are copied otherwise.
+  /// @param buffer contains the bytes to append. Its bytes must not be
+  ///        modified while it is referenced.
+  /// @param offset is the offset of the bytes to append in @a buffer.
+  /// @param size is the number of bytes to append.
+  void PushShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                  size_t offset,
+                  int size);
+
   /// Get a pointer to the front of the queue and the queue size.
   /// These values are only valid until the next Push() or Pop() call.
   void Peek(const uint8_t** data, int* size) const;
 
+  /// Get the storage backing the queue and the offset of the front of the
+  /// queue in it. Unlike the pointer returned by Peek(), the bytes stay valid
+  /// and unchanged as long as a reference to @a buffer is held.
+  void PeekShared(scoped_refptr<base::RefCountedMemory>* buffer,
+                  size_t* offset) const;
+
+  /// @return the minimum number of bytes worth referencing in the storage
+  ///         returned by PeekShared() instead of copying them: 0 for bytes
+  ///         pushed with PushShared(), a fraction of the storage size
+  ///         otherwise, so that references never pin much more memory than
+  ///         the bytes they reference.
+  int MinSharedSize() const;
+
   /// Remove a number of bytes from the front of the queue.
   /// @param count specifies number of bytes to be popped.
   void Pop(int count);
 
  private:
   // Returns a pointer to the front of the queue.
-  uint8_t* front() const;
+  const uint8_t* front() const;
 
-  scoped_ptr<uint8_t[]> buffer_;
+  // Returns true if |buffer_| is referenced outside of the queue.
+  bool IsBufferShared() const { return !buffer_->HasOneRef(); }
+
+  // Copy the bytes of |external_buffer_| in the queue to |buffer_| and release
+  // |external_buffer_|.
+  void MoveExternalBytes();
+
+  scoped_refptr<base::RefCountedBytes> buffer_;
 
   // Size of |buffer_|.
   size_t size_;
 
-  // Offset from the start of |buffer_| that marks the front of the queue.
+  // Buffer holding the bytes in the queue when they were pushed with
+  // PushShared(), in which case |buffer_| is not used. NULL otherwise.
+  scoped_refptr<base::RefCountedMemory> external_buffer_;
+
+  // Offset from the start of |buffer_|, or of |external_buffer_| if set, that
+  // marks the front of the queue.
   size_t offset_;
 
   // Number of bytes stored in the queue.
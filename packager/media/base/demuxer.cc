@@ -6,15 +6,22 @@
 
 #include "packager/media/base/demuxer.h"
 
+#include <inttypes.h>
+
+#include <algorithm>
+
 #include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/stl_util.h"
+#include "packager/base/strings/string_util.h"
+#include "packager/base/strings/stringprintf.h"
 #include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/stream_info.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/mapped_file.h"
 #include "packager/media/formats/mp2t/mp2t_media_parser.h"
 #include "packager/media/formats/mp4/mp4_media_parser.h"
 #include "packager/media/formats/webm/webm_media_parser.h"
@@ -25,6 +32,11 @@ namespace {
 // 65KB, sufficient to determine the container and likely all init data.
 const size_t kInitBufSize = 0x10000;
 const size_t kBufSize = 0x200000;  // 2MB
+// Live inputs are received at their bitrate, so the container is determined
+// as soon as a few MPEG-2 TS packets are in, rather than after 64KB. Reads of
+// live inputs return the data received so far, so they are kept small.
+const size_t kLiveInitBufSize = 0x2000;  // 8KB
+const size_t kLiveBufSize = 0x10000;     // 64KB
 // Maximum number of allowed queued samples. If we are receiving a lot of
 // samples before seeing init_event, something is not right. The number
 // set here is arbitrary though.
@@ -39,8 +51,23 @@ Demuxer::Demuxer(const std::string& file_name)
       media_file_(NULL),
       init_event_received_(false),
       container_name_(CONTAINER_UNKNOWN),
-      buffer_(new uint8_t[kBufSize]),
-      cancelled_(false) {
+      random_access_mp4_parser_(NULL),
+      read_size_(kInitBufSize),
+      min_read_size_(kInitBufSize),
+      max_read_size_(kBufSize),
+      mapped_position_(0),
+      cancelled_(false),
+      async_push_(false),
+      mmap_input_(false),
+      mp4_random_access_(false) {
+}
+
+Demuxer::ReadStats::ReadStats() : bytes(0), calls(0) {}
+
+std::string Demuxer::ReadStats::ToString() const {
+  return base::StringPrintf("bytes: %" PRIu64 " calls: %" PRIu64
+                            " stall_time_ms: %" PRId64,
+                            bytes, calls, stall_time.InMilliseconds());
 }
 
 Demuxer::~Demuxer() {
@@ -55,28 +82,53 @@ void Demuxer::SetKeySource(scoped_ptr<KeySource> key_source) {
 
 Status Demuxer::Initialize() {
   DCHECK(!media_file_);
+  DCHECK(!mapped_data_);
   DCHECK(!init_event_received_);
 
   LOG(INFO) << "Initialize Demuxer for file '" << file_name_ << "'.";
 
-  media_file_ = File::Open(file_name_.c_str(), "r");
-  if (!media_file_) {
-    return Status(error::FILE_FAILURE,
-                  "Cannot open file for reading " + file_name_);
+  if (mmap_input_ ||
+      base::StartsWith(file_name_, kMmapFilePrefix,
+                       base::CompareCase::SENSITIVE)) {
+    mapped_data_ = MappedFile::Map(file_name_.c_str());
+    if (!mapped_data_) {
+      LOG(WARNING) << "Cannot map file '" << file_name_
+                   << "' in memory. Reading it instead.";
+    }
   }
 
-  // Read enough bytes before detecting the container.
+  const uint8_t* init_data = NULL;
   size_t bytes_read = 0;
-  while (bytes_read < kInitBufSize) {
-    int64_t read_result =
-        media_file_->Read(buffer_.get() + bytes_read, kInitBufSize);
-    if (read_result < 0)
-      return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
-    if (read_result == 0)
-      break;
-    bytes_read += read_result;
+  if (mapped_data_) {
+    init_data = mapped_data_->front();
+    bytes_read = std::min(kInitBufSize, mapped_data_->size());
+  } else {
+    media_file_ = File::Open(file_name_.c_str(), "r");
+    if (!media_file_) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot open file for reading " + file_name_);
+    }
+    const bool live = base::StartsWith(file_name_, kUdpFilePrefix,
+                                       base::CompareCase::INSENSITIVE_ASCII);
+    const size_t init_buf_size = live ? kLiveInitBufSize : kInitBufSize;
+    min_read_size_ = init_buf_size;
+    max_read_size_ = live ? kLiveBufSize : kBufSize;
+    read_size_ = min_read_size_;
+    buffer_.reset(new uint8_t[max_read_size_]);
+    init_data = buffer_.get();
+
+    // Read enough bytes before detecting the container.
+    while (bytes_read < init_buf_size) {
+      int64_t read_result = ReadInput(buffer_.get() + bytes_read,
+                                      init_buf_size - bytes_read);
+      if (read_result < 0)
+        return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
+      if (read_result == 0)
+        break;
+      bytes_read += read_result;
+    }
   }
-  container_name_ = DetermineContainer(buffer_.get(), bytes_read);
+  container_name_ = DetermineContainer(init_data, bytes_read);
 
   // Initialize media parser.
   switch (container_name_) {
@@ -104,11 +156,25 @@ Status Demuxer::Initialize() {
                 base::Bind(&Demuxer::NewSampleEvent, base::Unretained(this)),
                 key_source_.get());
 
+  if (container_name_ == CONTAINER_MOV && mp4_random_access_ &&
+      !mapped_data_) {
+    mp4::MP4MediaParser* mp4_parser =
+        static_cast<mp4::MP4MediaParser*>(parser_.get());
+    if (mp4_parser->InitRandomAccess(file_name_)) {
+      random_access_mp4_parser_ = mp4_parser;
+      // The parser reads the file on its own.
+      media_file_->Close();
+      media_file_ = NULL;
+      buffer_.reset();
+      return Status::OK;
+    }
+  }
+
   // Handle trailing 'moov'.
   if (container_name_ == CONTAINER_MOV)
     static_cast<mp4::MP4MediaParser*>(parser_.get())->LoadMoov(file_name_);
 
-  if (!parser_->Parse(buffer_.get(), bytes_read)) {
+  if (!ParseData(bytes_read)) {
     init_parsing_status_ =
         Status(error::PARSER_FAILURE, "Cannot parse media file " + file_name_);
   }
@@ -176,16 +242,26 @@ Status Demuxer::Run() {
   LOG(INFO) << "Demuxer::Run() on file '" << file_name_ << "'.";
 
   // Start the streams.
+  const MediaStream::MediaStreamOperation operation =
+      async_push_ ? MediaStream::kAsyncPush : MediaStream::kPush;
   for (std::vector<MediaStream*>::iterator it = streams_.begin();
        it != streams_.end();
        ++it) {
-    status = (*it)->Start(MediaStream::kPush);
-    if (!status.ok())
+    status = (*it)->Start(operation);
+    if (!status.ok()) {
+      StopStreams();
       return status;
+    }
   }
 
   while (!cancelled_ && (status = Parse()).ok())
     continue;
+  VLOG(1) << "Read stats of file '" << file_name_
+          << "': " << read_stats_.ToString();
+  // Muxer threads, if any, are joined when end of stream is pushed. Stop them
+  // otherwise.
+  if (status.error_code() != error::END_OF_STREAM)
+    StopStreams();
 
   if (cancelled_ && status.ok())
     return Status(error::CANCELLED, "Demuxer run cancelled");
@@ -197,24 +273,54 @@ Status Demuxer::Run() {
          it != streams_.end();
          ++it) {
       status = (*it)->PushSample(sample);
-      if (!status.ok())
+      if (!status.ok()) {
+        StopStreams();
         return status;
+      }
     }
   }
   return status;
 }
 
+void Demuxer::StopStreams() {
+  for (std::vector<MediaStream*>::iterator it = streams_.begin();
+       it != streams_.end();
+       ++it) {
+    (*it)->Stop();
+  }
+}
+
 Status Demuxer::Parse() {
-  DCHECK(media_file_);
   DCHECK(parser_);
-  DCHECK(buffer_);
+  DCHECK(mapped_data_ || random_access_mp4_parser_ ||
+         (media_file_ && buffer_));
 
   // Return early and avoid call Parse(...) again if it has already failed at
   // the initialization.
   if (!init_parsing_status_.ok())
     return init_parsing_status_;
 
-  int64_t bytes_read = media_file_->Read(buffer_.get(), kBufSize);
+  if (random_access_mp4_parser_) {
+    bool end_of_stream = false;
+    if (!random_access_mp4_parser_->ReadSamples(kBufSize, &end_of_stream)) {
+      return Status(error::PARSER_FAILURE,
+                    "Cannot parse media file " + file_name_);
+    }
+    if (end_of_stream) {
+      if (!parser_->Flush())
+        return Status(error::PARSER_FAILURE, "Failed to flush.");
+      return Status(error::END_OF_STREAM, "");
+    }
+    return Status::OK;
+  }
+
+  int64_t bytes_read = 0;
+  if (mapped_data_) {
+    bytes_read = std::min(kBufSize, mapped_data_->size() - mapped_position_);
+  } else {
+    bytes_read = ReadInput(buffer_.get(), read_size_);
+    AdaptReadSize(bytes_read);
+  }
   if (bytes_read == 0) {
     if (!parser_->Flush())
       return Status(error::PARSER_FAILURE, "Failed to flush.");
@@ -223,12 +329,46 @@ Status Demuxer::Parse() {
     return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
   }
 
-  return parser_->Parse(buffer_.get(), bytes_read)
+  return ParseData(bytes_read)
              ? Status::OK
              : Status(error::PARSER_FAILURE,
                       "Cannot parse media file " + file_name_);
 }
 
+bool Demuxer::ParseData(size_t size) {
+  // Nothing to parse, e.g. the input file is empty.
+  if (size == 0)
+    return true;
+  if (!mapped_data_)
+    return parser_->Parse(buffer_.get(), size);
+
+  // The parser may reference the samples in the mapping.
+  const bool result =
+      parser_->ParseShared(mapped_data_, mapped_position_, size);
+  mapped_position_ += size;
+  return result;
+}
+
+int64_t Demuxer::ReadInput(uint8_t* buffer, size_t size) {
+  const base::TimeTicks start = base::TimeTicks::Now();
+  const int64_t bytes_read = media_file_->Read(buffer, size);
+  read_stats_.stall_time += base::TimeTicks::Now() - start;
+  ++read_stats_.calls;
+  if (bytes_read > 0)
+    read_stats_.bytes += bytes_read;
+  return bytes_read;
+}
+
+void Demuxer::AdaptReadSize(int64_t bytes_read) {
+  if (bytes_read <= 0)
+    return;
+  const size_t size = static_cast<size_t>(bytes_read);
+  if (size == read_size_)
+    read_size_ = std::min(read_size_ * 2, max_read_size_);
+  else if (size < read_size_ / 4)
+    read_size_ = std::max(read_size_ / 2, min_read_size_);
+}
+
 void Demuxer::Cancel() {
   cancelled_ = true;
 }
@@ -8,11 +8,14 @@
 #define MEDIA_BASE_DEMUXER_H_
 
 #include <deque>
+#include <string>
 #include <vector>
 
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/time/time.h"
 #include "packager/media/base/container_names.h"
 #include "packager/media/base/status.h"
 
@@ -27,16 +30,54 @@ class MediaSample;
 class MediaStream;
 class StreamInfo;
 
+namespace mp4 {
+class MP4MediaParser;
+}  // namespace mp4
+
 /// Demuxer is responsible for extracting elementary stream samples from a
 /// media file, e.g. an ISO BMFF file.
 class Demuxer {
  public:
+  /// Counters of the reads from the input file.
+  struct ReadStats {
+    ReadStats();
+
+    /// Number of bytes read.
+    uint64_t bytes;
+    /// Number of File::Read() calls.
+    uint64_t calls;
+    /// Time spent in File::Read(), i.e. waiting for the input.
+    base::TimeDelta stall_time;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
   /// @param file_name specifies the input source. It uses prefix matching to
   ///        create a proper File object. The user can extend File to support
   ///        a custom File object with its own prefix.
   explicit Demuxer(const std::string& file_name);
   ~Demuxer();
 
+  /// Set whether Initialize() maps a local input file in memory and passes the
+  /// mapping to the parser, which then references the samples in place
+  /// instead of copying the file through a read buffer. Inputs with the
+  /// mmap:// prefix are always mapped. Must be called before Initialize().
+  /// Default false.
+  void set_mmap_input(bool mmap_input) { mmap_input_ = mmap_input; }
+
+  /// Set whether Initialize() sets up the parser to read the samples of a
+  /// non-fragmented MP4 input by random access, fetching each run of samples
+  /// at its offset, so that memory use does not depend on how the tracks are
+  /// interleaved in the file. Each run of samples is read with its own seek
+  /// and read, so this is slower than sequential reads for files interleaved
+  /// in small chunks. Ignored for other inputs, for mapped inputs and for
+  /// inputs which cannot be seeked. Must be called before Initialize().
+  /// Default false.
+  void set_mp4_random_access(bool mp4_random_access) {
+    mp4_random_access_ = mp4_random_access;
+  }
+
   /// Set the KeySource for media decryption.
   /// @param key_source points to the source of decryption keys. The key
   ///        source must support fetching of keys for the type of media being
@@ -54,6 +95,11 @@ class Demuxer {
   /// the Data to Muxer until Eof.
   Status Run();
 
+  /// Set whether Run() pushes the samples to each Muxer on a dedicated muxer
+  /// thread through a bounded queue (MediaStream::kAsyncPush), so parsing
+  /// and muxing of different streams run in parallel. Default false.
+  void set_async_push(bool async_push) { async_push_ = async_push; }
+
   /// Read from the source and send it to the parser.
   Status Parse();
 
@@ -71,6 +117,11 @@ class Demuxer {
   ///         is not initialized.
   MediaContainerName container_name() { return container_name_; }
 
+  /// @return the counters of the reads from the input file. Inputs mapped in
+  ///         memory and MP4 inputs read by random access are not counted.
+  ///         Must not be called while Run() or Parse() is in progress.
+  const ReadStats& read_stats() const { return read_stats_; }
+
  private:
   struct QueuedSample {
     QueuedSample(uint32_t track_id, scoped_refptr<MediaSample> sample);
@@ -89,6 +140,17 @@ class Demuxer {
                       const scoped_refptr<MediaSample>& sample);
   // Helper function to push the sample to corresponding stream.
   bool PushSample(uint32_t track_id, const scoped_refptr<MediaSample>& sample);
+  // Stop the streams, which waits for their muxer threads if any.
+  void StopStreams();
+  // Pass the next |size| bytes of the input, in |buffer_| or at
+  // |mapped_position_| in |mapped_data_|, to the parser.
+  bool ParseData(size_t size);
+  // Read up to |size| bytes of |media_file_| into |buffer|, updating
+  // |read_stats_|.
+  int64_t ReadInput(uint8_t* buffer, size_t size);
+  // Grow |read_size_| while reads fill it, and shrink it while they return
+  // much less, within [|min_read_size_|, |max_read_size_|].
+  void AdaptReadSize(int64_t bytes_read);
 
   std::string file_name_;
   File* media_file_;
@@ -99,9 +161,25 @@ class Demuxer {
   scoped_ptr<MediaParser> parser_;
   std::vector<MediaStream*> streams_;
   MediaContainerName container_name_;
+  // |parser_| if it reads the samples of a non-fragmented MP4 file by random
+  // access, in which case |buffer_| is not used. Not owned.
+  mp4::MP4MediaParser* random_access_mp4_parser_;
   scoped_ptr<uint8_t[]> buffer_;
+  // Size of the next read into |buffer_|, which has |max_read_size_| bytes.
+  size_t read_size_;
+  size_t min_read_size_;
+  size_t max_read_size_;
+  ReadStats read_stats_;
+  // Data of the input file if it is mapped in memory, in which case
+  // |media_file_| and |buffer_| are not used.
+  scoped_refptr<base::RefCountedMemory> mapped_data_;
+  // Position of the next byte of |mapped_data_| to pass to the parser.
+  size_t mapped_position_;
   scoped_ptr<KeySource> key_source_;
   bool cancelled_;
+  bool async_push_;
+  bool mmap_input_;
+  bool mp4_random_access_;
 
   DISALLOW_COPY_AND_ASSIGN(Demuxer);
 };
@@ -0,0 +1,126 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/gather_buffer.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/base/buffer_pool.h"
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/file/file.h"
+
+namespace shaka {
+namespace media {
+
+GatherBuffer::Block::Block() : data(NULL), size(0) {}
+GatherBuffer::Block::~Block() {}
+
+GatherBuffer::GatherBuffer() : size_(0) {}
+
+GatherBuffer::~GatherBuffer() {
+  Clear();
+}
+
+void GatherBuffer::AppendBuffer(BufferWriter* buffer) {
+  DCHECK(buffer);
+  if (buffer->Size() == 0)
+    return;
+
+  Block block;
+  block.bytes = new base::RefCountedBytes;
+  buffer->SwapBuffer(&block.bytes->data());
+  block.data = block.bytes->front();
+  block.size = block.bytes->size();
+  blocks_.push_back(block);
+  size_ += block.size;
+}
+
+void GatherBuffer::AppendSample(const scoped_refptr<MediaSample>& sample) {
+  DCHECK(sample);
+  if (sample->data_size() == 0)
+    return;
+
+  Block block;
+  block.data = sample->data();
+  block.size = sample->data_size();
+  block.sample = sample;
+  blocks_.push_back(block);
+  size_ += block.size;
+}
+
+void GatherBuffer::Append(GatherBuffer* buffer) {
+  DCHECK(buffer);
+  DCHECK_NE(this, buffer);
+  blocks_.insert(blocks_.end(), buffer->blocks_.begin(),
+                 buffer->blocks_.end());
+  size_ += buffer->size_;
+  pending_work_.insert(pending_work_.end(), buffer->pending_work_.begin(),
+                       buffer->pending_work_.end());
+  buffer->blocks_.clear();
+  buffer->size_ = 0;
+  buffer->pending_work_.clear();
+}
+
+void GatherBuffer::AddPendingWork(const scoped_refptr<PendingWork>& work) {
+  DCHECK(work);
+  pending_work_.push_back(work);
+}
+
+void GatherBuffer::Clear() {
+  // The blocks may still be in use by the pending work.
+  WaitForPendingWork();
+  for (Block& block : blocks_) {
+    if (block.bytes && block.bytes->HasOneRef())
+      BufferPool::GetInstance()->Release(&block.bytes->data());
+  }
+  blocks_.clear();
+  size_ = 0;
+}
+
+Status GatherBuffer::WriteToFile(File* file) {
+  DCHECK(file);
+  WaitForPendingWork();
+
+  std::vector<File::IoBuffer> buffers(blocks_.size());
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    buffers[i].data = blocks_[i].data;
+    buffers[i].length = blocks_[i].size;
+  }
+
+  size_t first_buffer = 0;
+  while (first_buffer < buffers.size()) {
+    const int64_t size_written =
+        file->WriteV(&buffers[first_buffer], buffers.size() - first_buffer);
+    if (size_written <= 0) {
+      return Status(error::FILE_FAILURE,
+                    "Fail to write to file in GatherBuffer");
+    }
+    // Skip the buffers written, then the part written of the next buffer.
+    uint64_t remaining_size = size_written;
+    while (first_buffer < buffers.size() &&
+           remaining_size >= buffers[first_buffer].length) {
+      remaining_size -= buffers[first_buffer].length;
+      ++first_buffer;
+    }
+    if (remaining_size > 0) {
+      DCHECK_LT(first_buffer, buffers.size());
+      File::IoBuffer& buffer = buffers[first_buffer];
+      buffer.data = static_cast<const uint8_t*>(buffer.data) + remaining_size;
+      buffer.length -= remaining_size;
+    }
+  }
+  Clear();
+  return Status::OK;
+}
+
+void GatherBuffer::WaitForPendingWork() {
+  for (const scoped_refptr<PendingWork>& work : pending_work_)
+    work->Wait();
+  pending_work_.clear();
+}
+
+}  // namespace media
+}  // namespace shaka
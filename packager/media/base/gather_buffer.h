@@ -0,0 +1,105 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MEDIA_BASE_GATHER_BUFFER_H_
+#define MEDIA_BASE_GATHER_BUFFER_H_
+
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
+#include "packager/media/base/status.h"
+
+namespace shaka {
+namespace media {
+
+class BufferWriter;
+class File;
+class MediaSample;
+
+/// A sequence of byte blocks written out in order with a single vectored
+/// write, File::WriteV(). Blocks are either buffers taken over from a
+/// BufferWriter, or references to the data of media samples, so the data is
+/// not copied until it is written.
+class GatherBuffer {
+ public:
+  /// Work on the blocks, e.g. in place encryption, running on other threads.
+  /// It is waited for before the blocks are written or released.
+  class PendingWork : public base::RefCountedThreadSafe<PendingWork> {
+   public:
+    /// Block until the work is complete. It may be called more than once.
+    virtual void Wait() = 0;
+
+   protected:
+    friend class base::RefCountedThreadSafe<PendingWork>;
+    PendingWork() {}
+    virtual ~PendingWork() {}
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(PendingWork);
+  };
+
+  GatherBuffer();
+  ~GatherBuffer();
+
+  /// Append the content of @a buffer without copying it.
+  /// @param buffer is left empty.
+  void AppendBuffer(BufferWriter* buffer);
+
+  /// Append the data of @a sample without copying it. The sample is
+  /// referenced, and must not be modified, until the data is written or
+  /// cleared.
+  void AppendSample(const scoped_refptr<MediaSample>& sample);
+
+  /// Move the blocks and the pending work of @a buffer to the end of this
+  /// buffer.
+  /// @param buffer is left empty.
+  void Append(GatherBuffer* buffer);
+
+  /// Add @a work on the blocks appended so far, which must be complete before
+  /// they are written out.
+  void AddPendingWork(const scoped_refptr<PendingWork>& work);
+
+  /// Wait for the pending work, then release all the blocks. Buffers no
+  /// longer referenced are returned to the BufferPool.
+  void Clear();
+
+  /// @return the total size of the blocks in bytes.
+  size_t Size() const { return size_; }
+
+  /// Wait for the pending work, then write the blocks to file. The blocks are
+  /// cleared after writing.
+  /// @param file should not be NULL.
+  /// @return OK on success.
+  Status WriteToFile(File* file);
+
+ private:
+  struct Block {
+    Block();
+    ~Block();
+
+    const uint8_t* data;
+    size_t size;
+    // Exactly one of the two below keeps |data| alive.
+    scoped_refptr<base::RefCountedBytes> bytes;
+    scoped_refptr<MediaSample> sample;
+  };
+
+  // Wait for and release |pending_work_|.
+  void WaitForPendingWork();
+
+  std::vector<Block> blocks_;
+  size_t size_;
+  std::vector<scoped_refptr<PendingWork> > pending_work_;
+
+  DISALLOW_COPY_AND_ASSIGN(GatherBuffer);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // MEDIA_BASE_GATHER_BUFFER_H_
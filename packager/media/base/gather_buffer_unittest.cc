@@ -0,0 +1,187 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/base/gather_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/media_sample.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/file/file.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const uint8_t kHeader[] = {'h', 'e', 'a', 'd'};
+const uint8_t kSample1[] = {'s', 'a', 'm', 'p', 'l', 'e', '1'};
+const uint8_t kSample2[] = {'s', '2'};
+
+// A file recording the blocks passed to WriteV(), which writes at most
+// |max_write_size| bytes per call.
+class RecordingFile : public File {
+ public:
+  explicit RecordingFile(uint64_t max_write_size)
+      : File("recording"), max_write_size_(max_write_size), num_writes_(0) {}
+
+  bool Close() override {
+    delete this;
+    return true;
+  }
+  int64_t Read(void* buffer, uint64_t length) override { return -1; }
+  int64_t Write(const void* buffer, uint64_t length) override {
+    const uint64_t size = std::min(length, max_write_size_);
+    content_.append(static_cast<const char*>(buffer), size);
+    return size;
+  }
+  int64_t WriteV(const IoBuffer* buffers, size_t count) override {
+    ++num_writes_;
+    for (size_t i = 0; i < count; ++i)
+      block_data_.push_back(buffers[i].data);
+    return File::WriteV(buffers, count);
+  }
+  int64_t Size() override { return content_.size(); }
+  bool Flush() override { return true; }
+  bool Seek(uint64_t position) override { return false; }
+  bool Tell(uint64_t* position) override { return false; }
+
+  const std::string& content() const { return content_; }
+  const std::vector<const void*>& block_data() const { return block_data_; }
+  int num_writes() const { return num_writes_; }
+
+ protected:
+  ~RecordingFile() override {}
+
+  bool Open() override { return true; }
+
+ private:
+  const uint64_t max_write_size_;
+  std::string content_;
+  std::vector<const void*> block_data_;
+  int num_writes_;
+};
+
+// Pending work modifying the first byte of |data| when it is waited for.
+class FakePendingWork : public GatherBuffer::PendingWork {
+ public:
+  explicit FakePendingWork(uint8_t* data) : data_(data), num_waits_(0) {}
+
+  void Wait() override {
+    if (num_waits_++ == 0)
+      *data_ = 'H';
+  }
+
+  int num_waits() const { return num_waits_; }
+
+ private:
+  ~FakePendingWork() override {}
+
+  uint8_t* data_;
+  int num_waits_;
+};
+
+// Deletes |file| on scope exit.
+struct FileDeleter {
+  explicit FileDeleter(File* file) : file(file) {}
+  ~FileDeleter() { file->Close(); }
+  File* file;
+};
+}  // namespace
+
+class GatherBufferTest : public testing::Test {
+ public:
+  GatherBufferTest()
+      : sample1_(MediaSample::CopyFrom(kSample1, sizeof(kSample1), true)),
+        sample2_(MediaSample::CopyFrom(kSample2, sizeof(kSample2), false)) {}
+
+ protected:
+  void SetUp() override {
+    BufferWriter header;
+    header.AppendArray(kHeader, sizeof(kHeader));
+    buffer_.AppendBuffer(&header);
+    EXPECT_EQ(0u, header.Size());
+    buffer_.AppendSample(sample1_);
+    buffer_.AppendSample(sample2_);
+  }
+
+  scoped_refptr<MediaSample> sample1_;
+  scoped_refptr<MediaSample> sample2_;
+  GatherBuffer buffer_;
+};
+
+TEST_F(GatherBufferTest, WriteToFile) {
+  EXPECT_EQ(sizeof(kHeader) + sizeof(kSample1) + sizeof(kSample2),
+            buffer_.Size());
+  RecordingFile* file = new RecordingFile(1000);
+  FileDeleter deleter(file);
+  ASSERT_OK(buffer_.WriteToFile(file));
+
+  EXPECT_EQ("headsample1s2", file->content());
+  EXPECT_EQ(0u, buffer_.Size());
+  // All the blocks are written with one call, and the sample data is written
+  // from the samples without being copied.
+  EXPECT_EQ(1, file->num_writes());
+  ASSERT_EQ(3u, file->block_data().size());
+  EXPECT_EQ(sample1_->data(), file->block_data()[1]);
+  EXPECT_EQ(sample2_->data(), file->block_data()[2]);
+}
+
+TEST_F(GatherBufferTest, PartialWrites) {
+  RecordingFile* file = new RecordingFile(3);
+  FileDeleter deleter(file);
+  ASSERT_OK(buffer_.WriteToFile(file));
+  EXPECT_EQ("headsample1s2", file->content());
+}
+
+TEST_F(GatherBufferTest, Append) {
+  GatherBuffer other;
+  other.AppendSample(sample2_);
+  buffer_.Append(&other);
+  EXPECT_EQ(0u, other.Size());
+
+  RecordingFile* file = new RecordingFile(1000);
+  FileDeleter deleter(file);
+  ASSERT_OK(buffer_.WriteToFile(file));
+  EXPECT_EQ("headsample1s2s2", file->content());
+}
+
+TEST_F(GatherBufferTest, WaitForPendingWork) {
+  BufferWriter header;
+  header.AppendArray(kHeader, sizeof(kHeader));
+  uint8_t* header_data = header.MutableBuffer();
+  GatherBuffer other;
+  other.AppendBuffer(&header);
+  scoped_refptr<FakePendingWork> work(new FakePendingWork(header_data));
+  other.AddPendingWork(work);
+  buffer_.Append(&other);
+  EXPECT_EQ(0, work->num_waits());
+
+  RecordingFile* file = new RecordingFile(1000);
+  FileDeleter deleter(file);
+  ASSERT_OK(buffer_.WriteToFile(file));
+  // The data is written once the work is complete.
+  EXPECT_EQ("headsample1s2Head", file->content());
+  EXPECT_EQ(1, work->num_waits());
+
+  other.AddPendingWork(work);
+  other.Clear();
+  EXPECT_EQ(2, work->num_waits());
+}
+
+TEST_F(GatherBufferTest, Clear) {
+  buffer_.Clear();
+  EXPECT_EQ(0u, buffer_.Size());
+  // Samples are no longer referenced.
+  EXPECT_TRUE(sample1_->HasOneRef());
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -27,6 +27,8 @@
         'audio_timestamp_helper.h',
         'bit_reader.cc',
         'bit_reader.h',
+        'buffer_pool.cc',
+        'buffer_pool.h',
         'buffer_reader.cc',
         'buffer_reader.h',
         'buffer_writer.cc',
@@ -47,6 +49,8 @@
         'fixed_key_source.cc',
         'fixed_key_source.h',
         'fourccs.h',
+        'gather_buffer.cc',
+        'gather_buffer.h',
         'http_key_fetcher.cc',
         'http_key_fetcher.h',
         'key_fetcher.cc',
@@ -123,11 +127,13 @@
         'aes_pattern_cryptor_unittest.cc',
         'audio_timestamp_helper_unittest.cc',
         'bit_reader_unittest.cc',
+        'buffer_pool_unittest.cc',
         'buffer_writer_unittest.cc',
         'closure_thread_unittest.cc',
         'container_names_unittest.cc',
         'decryptor_source_unittest.cc',
         'fixed_key_source_unittest.cc',
+        'gather_buffer_unittest.cc',
         'http_key_fetcher_unittest.cc',
         'muxer_util_unittest.cc',
         'offset_byte_queue_unittest.cc',
@@ -13,6 +13,7 @@
 #include "packager/base/callback.h"
 #include "packager/base/compiler_specific.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/container_names.h"
 
@@ -63,6 +64,21 @@ class MediaParser {
   /// @return true if successful.
   virtual bool Parse(const uint8_t* buf, int size) WARN_UNUSED_RESULT = 0;
 
+  /// Like Parse(), but the new data is held in an immutable shared buffer,
+  /// e.g. a memory mapped file, so the parser may reference it in the media
+  /// samples instead of copying it. Consecutive calls should pass consecutive
+  /// ranges of the same buffer for the data not to be copied at all.
+  /// @param buffer holds the data. Its bytes must not be modified while it is
+  ///        referenced.
+  /// @param offset is the offset of the data in @a buffer.
+  /// @param size is the size of the data in bytes.
+  /// @return true if successful.
+  virtual bool ParseShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                           size_t offset,
+                           int size) WARN_UNUSED_RESULT {
+    return Parse(buffer->front() + offset, size);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(MediaParser);
 };
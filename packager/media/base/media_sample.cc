@@ -10,6 +10,7 @@
 
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/buffer_pool.h"
 
 namespace shaka {
 namespace media {
@@ -23,11 +24,14 @@ MediaSample::MediaSample(const uint8_t* data,
       pts_(0),
       duration_(0),
       is_key_frame_(is_key_frame),
-      is_encrypted_(false) {
+      is_encrypted_(false),
+      shared_data_offset_(0),
+      shared_data_size_(0) {
   if (!data) {
     CHECK_EQ(size, 0u);
   }
 
+  BufferPool::GetInstance()->Acquire(size, &data_);
   data_.assign(data, data + size);
   if (side_data)
     side_data_.assign(side_data, side_data + side_data_size);
@@ -37,9 +41,23 @@ MediaSample::MediaSample() : dts_(0),
                              pts_(0),
                              duration_(0),
                              is_key_frame_(false),
-                             is_encrypted_(false) {}
+                             is_encrypted_(false),
+                             shared_data_offset_(0),
+                             shared_data_size_(0) {}
 
-MediaSample::~MediaSample() {}
+MediaSample::~MediaSample() {
+  BufferPool::GetInstance()->Release(&data_);
+}
+
+void MediaSample::ReleaseSharedBuffer() {
+  DCHECK(shared_buffer_);
+  const uint8_t* shared_data = shared_buffer_->front() + shared_data_offset_;
+  BufferPool::GetInstance()->Acquire(shared_data_size_, &data_);
+  data_.assign(shared_data, shared_data + shared_data_size_);
+  shared_buffer_ = NULL;
+  shared_data_offset_ = 0;
+  shared_data_size_ = 0;
+}
 
 // static
 scoped_refptr<MediaSample> MediaSample::CopyFrom(const uint8_t* data,
@@ -63,6 +81,23 @@ scoped_refptr<MediaSample> MediaSample::CopyFrom(const uint8_t* data,
       data, data_size, side_data, side_data_size, is_key_frame));
 }
 
+// static
+scoped_refptr<MediaSample> MediaSample::CreateFromSharedBuffer(
+    scoped_refptr<base::RefCountedMemory> buffer,
+    size_t offset,
+    size_t size,
+    bool is_key_frame) {
+  // If you hit this CHECK you likely have a bug in a demuxer. Go fix it.
+  CHECK(buffer);
+  CHECK_LE(offset + size, buffer->size());
+  MediaSample* media_sample = new MediaSample();
+  media_sample->is_key_frame_ = is_key_frame;
+  media_sample->shared_buffer_ = buffer;
+  media_sample->shared_data_offset_ = offset;
+  media_sample->shared_data_size_ = size;
+  return make_scoped_refptr(media_sample);
+}
+
 // static
 scoped_refptr<MediaSample> MediaSample::FromMetadata(const uint8_t* metadata,
                                                      size_t metadata_size) {
@@ -91,7 +126,7 @@ std::string MediaSample::ToString() const {
       pts_,
       duration_,
       is_key_frame_ ? "true" : "false",
-      data_.size(),
+      data_size(),
       side_data_.size());
 }
 
@@ -13,6 +13,7 @@
 
 #include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/base/memory/scoped_ptr.h"
 
 namespace shaka {
@@ -45,6 +46,22 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
                                              size_t side_data_size,
                                              bool is_key_frame);
 
+  /// Create a MediaSample object referencing a range of a shared buffer
+  /// without copying it. The sample data is copied on the first call to
+  /// writable_data(), resize_data() or set_data(), so @a buffer is never
+  /// modified through the sample.
+  /// @param buffer is the shared buffer containing the sample data. The bytes
+  ///        in the range must not be modified while @a buffer is referenced.
+  ///        Must not be NULL.
+  /// @param offset is the offset of the sample data in @a buffer.
+  /// @param size indicates sample size in bytes.
+  /// @param is_key_frame indicates whether the sample is a key frame.
+  static scoped_refptr<MediaSample> CreateFromSharedBuffer(
+      scoped_refptr<base::RefCountedMemory> buffer,
+      size_t offset,
+      size_t size,
+      bool is_key_frame);
+
   /// Create a MediaSample object from metadata.
   /// Unlike other factory methods, this cannot be a key frame. It must be only
   /// for metadata.
@@ -97,19 +114,28 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   }
   const uint8_t* data() const {
     DCHECK(!end_of_stream());
-    return &data_[0];
+    return shared_buffer_ ? shared_buffer_->front() + shared_data_offset_
+                          : &data_[0];
   }
 
+  /// @return a pointer to the sample data which can be modified. The data is
+  ///         copied first if it references a shared buffer.
   uint8_t* writable_data() {
     DCHECK(!end_of_stream());
+    if (shared_buffer_)
+      ReleaseSharedBuffer();
     return &data_[0];
   }
 
   size_t data_size() const {
     DCHECK(!end_of_stream());
-    return data_.size();
+    return shared_buffer_ ? shared_data_size_ : data_.size();
   }
 
+  /// @return true if the sample data references a shared buffer, i.e. it has
+  ///         not been copied.
+  bool is_data_shared() const { return shared_buffer_.get() != NULL; }
+
   const uint8_t* side_data() const {
     return &side_data_[0];
   }
@@ -119,10 +145,13 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   }
 
   void set_data(const uint8_t* data, const size_t data_size) {
+    shared_buffer_ = NULL;
     data_.assign(data, data + data_size);
   }
 
   void resize_data(const size_t data_size) {
+    if (shared_buffer_)
+      ReleaseSharedBuffer();
     data_.resize(data_size);
   }
 
@@ -135,7 +164,9 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   }
 
   // If there's no data in this buffer, it represents end of stream.
-  bool end_of_stream() const { return data_.size() == 0; }
+  bool end_of_stream() const {
+    return shared_buffer_ ? shared_data_size_ == 0 : data_.size() == 0;
+  }
 
   const std::string& config_id() const { return config_id_; }
   void set_config_id(const std::string& config_id) {
@@ -159,6 +190,10 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   MediaSample();
   virtual ~MediaSample();
 
+  // Copy the referenced range of |shared_buffer_| to |data_| and release
+  // |shared_buffer_|.
+  void ReleaseSharedBuffer();
+
   // Decoding time stamp.
   int64_t dts_;
   // Presentation time stamp.
@@ -168,8 +203,14 @@ class MediaSample : public base::RefCountedThreadSafe<MediaSample> {
   // is sample encrypted ?
   bool is_encrypted_;
 
-  // Main buffer data.
+  // Main buffer data. Not used if |shared_buffer_| is set. The storage is
+  // recycled through BufferPool.
   std::vector<uint8_t> data_;
+  // Shared buffer containing the main buffer data at |shared_data_offset_|,
+  // with size |shared_data_size_|.
+  scoped_refptr<base::RefCountedMemory> shared_buffer_;
+  size_t shared_data_offset_;
+  size_t shared_data_size_;
   // Contain additional buffers to complete the main one. Needed by WebM
   // http://www.matroska.org/technical/specs/index.html BlockAdditional[A5].
   // Not used by mp4 and other containers.
@@ -6,20 +6,30 @@
 
 #include "packager/media/base/media_stream.h"
 
+#include "packager/base/bind.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/media/base/closure_thread.h"
 #include "packager/media/base/demuxer.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/muxer.h"
+#include "packager/media/base/producer_consumer_queue.h"
 #include "packager/media/base/stream_info.h"
 
 namespace shaka {
 namespace media {
 
+namespace {
+// Maximum number of samples queued for the muxer thread in kAsyncPush mode.
+// Demuxer blocks when the queue is full, which bounds the memory used by the
+// samples in flight.
+const size_t kAsyncQueueCapacity = 256;
+}  // namespace
+
 MediaStream::MediaStream(scoped_refptr<StreamInfo> info, Demuxer* demuxer)
     : info_(info), demuxer_(demuxer), muxer_(NULL), state_(kIdle) {}
 
-MediaStream::~MediaStream() {}
+MediaStream::~MediaStream() { Stop(); }
 
 Status MediaStream::PullSample(scoped_refptr<MediaSample>* sample) {
   DCHECK_EQ(state_, kPulling);
@@ -46,12 +56,43 @@ Status MediaStream::PushSample(const scoped_refptr<MediaSample>& sample) {
       return Status::OK;
     case kPushing:
       return muxer_->AddSample(this, sample);
+    case kAsyncPushing: {
+      Status status = async_queue_->Push(sample, kInfiniteTimeout);
+      if (status.ok() && !sample->end_of_stream())
+        return Status::OK;
+      // The muxer thread exits on end of stream or on error.
+      Stop();
+      return muxer_thread_status_.ok() ? status : muxer_thread_status_;
+    }
     default:
       NOTREACHED() << "Unexpected State " << state_;
       return Status::UNKNOWN;
   }
 }
 
+void MediaStream::Stop() {
+  if (!muxer_thread_ || muxer_thread_->HasBeenJoined())
+    return;
+  async_queue_->Stop();
+  muxer_thread_->Join();
+}
+
+void MediaStream::DrainAsyncQueue() {
+  Status status;
+  while (true) {
+    scoped_refptr<MediaSample> sample;
+    status = async_queue_->Pop(&sample, kInfiniteTimeout);
+    if (!status.ok())
+      break;
+    status = muxer_->AddSample(this, sample);
+    if (!status.ok() || sample->end_of_stream())
+      break;
+  }
+  // Unblock the demuxer if the muxer fails.
+  async_queue_->Stop();
+  muxer_thread_status_ = status;
+}
+
 void MediaStream::Connect(Muxer* muxer) {
   DCHECK(muxer);
   DCHECK(!muxer_);
@@ -61,7 +102,8 @@ void MediaStream::Connect(Muxer* muxer) {
 
 Status MediaStream::Start(MediaStreamOperation operation) {
   DCHECK(demuxer_);
-  DCHECK(operation == kPush || operation == kPull);
+  DCHECK(operation == kPush || operation == kPull ||
+         operation == kAsyncPush);
 
   switch (state_) {
     case kIdle:
@@ -70,6 +112,23 @@ Status MediaStream::Start(MediaStreamOperation operation) {
       samples_.clear();
       return Status::OK;
     case kConnected:
+      if (operation == kAsyncPush) {
+        state_ = kAsyncPushing;
+        async_queue_.reset(new SampleQueue(kAsyncQueueCapacity));
+        muxer_thread_.reset(new ClosureThread(
+            "MuxerThread", base::Bind(&MediaStream::DrainAsyncQueue,
+                                      base::Unretained(this))));
+        muxer_thread_->Start();
+        // Queue the samples received before the stream started if there is
+        // any.
+        while (!samples_.empty()) {
+          Status status = PushSample(samples_.front());
+          if (!status.ok())
+            return status;
+          samples_.pop_front();
+        }
+        return Status::OK;
+      }
       state_ = (operation == kPush) ? kPushing : kPulling;
       if (operation == kPush) {
         // Push samples in the queue to muxer if there is any.
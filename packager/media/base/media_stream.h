@@ -16,10 +16,12 @@
 namespace shaka {
 namespace media {
 
+class ClosureThread;
 class Demuxer;
 class Muxer;
 class MediaSample;
 class StreamInfo;
+template <class T> class ProducerConsumerQueue;
 
 /// MediaStream connects Demuxer to Muxer. It is an abstraction for a media
 /// elementary stream.
@@ -28,6 +30,11 @@ class MediaStream {
   enum MediaStreamOperation {
     kPush,
     kPull,
+    /// Like kPush, but samples pushed by Demuxer are queued in a bounded
+    /// queue and added to Muxer on a dedicated muxer thread. Demuxer blocks
+    /// when the queue is full. The connected Muxer should not have other
+    /// streams.
+    kAsyncPush,
   };
   /// Create MediaStream from StreamInfo and Demuxer.
   /// @param demuxer cannot be NULL.
@@ -41,9 +48,17 @@ class MediaStream {
   /// Start the stream for pushing or pulling.
   Status Start(MediaStreamOperation operation);
 
-  /// Push sample to Muxer (triggered by Demuxer).
+  /// Push sample to Muxer (triggered by Demuxer). In kAsyncPush mode, the
+  /// sample is queued for the muxer thread; pushing the end of stream sample
+  /// waits for the muxer thread to complete.
+  /// @return OK on success. In kAsyncPush mode, the muxer thread status if
+  ///         the muxer thread has failed.
   Status PushSample(const scoped_refptr<MediaSample>& sample);
 
+  /// Stop the stream. In kAsyncPush mode, the muxer thread is stopped once
+  /// it drains the queued samples. No-op in other modes.
+  void Stop();
+
   /// Pull sample from Demuxer (triggered by Muxer).
   Status PullSample(scoped_refptr<MediaSample>* sample);
 
@@ -62,7 +77,13 @@ class MediaStream {
     kDisconnected,
     kPushing,
     kPulling,
+    kAsyncPushing,
   };
+  typedef ProducerConsumerQueue<scoped_refptr<MediaSample> > SampleQueue;
+
+  // Add the samples in |async_queue_| to Muxer until end of stream or error.
+  // Runs on |muxer_thread_|.
+  void DrainAsyncQueue();
 
   scoped_refptr<StreamInfo> info_;
   Demuxer* demuxer_;
@@ -71,6 +92,12 @@ class MediaStream {
   // An internal buffer to store samples temporarily.
   std::deque<scoped_refptr<MediaSample> > samples_;
 
+  // Used in kAsyncPush mode only.
+  scoped_ptr<SampleQueue> async_queue_;
+  scoped_ptr<ClosureThread> muxer_thread_;
+  // Status of |muxer_thread_|. Accessed after |muxer_thread_| is joined.
+  Status muxer_thread_status_;
+
   DISALLOW_COPY_AND_ASSIGN(MediaStream);
 };
 
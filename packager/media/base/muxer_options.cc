@@ -17,6 +17,10 @@ MuxerOptions::MuxerOptions()
       segment_sap_aligned(false),
       fragment_sap_aligned(false),
       num_subsegments_per_sidx(0),
+      header_reserve_size(0),
+      num_encryption_threads(0),
+      low_latency_mode(false),
+      num_parallel_segments(0),
       bandwidth(0),
       packager_version_string(kPackagerVersion) {}
 MuxerOptions::~MuxerOptions() {}
@@ -63,6 +63,37 @@ struct MuxerOptions {
   /// Specify temporary directory for intermediate files.
   std::string temp_dir;
 
+  /// For ISO BMFF only.
+  /// Number of bytes reserved at the start of single segment outputs for the
+  /// 'ftyp', 'moov' and 'sidx' boxes. If non-zero and the output is seekable,
+  /// the fragments are written to the output after the reserved space,
+  /// instead of to a temp file which is copied to the output once the
+  /// header is known. The space left is filled with a 'free' box. If 0, or
+  /// if the header does not fit, the data is written twice.
+  uint64_t header_reserve_size;
+
+  /// For ISO BMFF only.
+  /// Number of threads used to encrypt the samples of a fragment. If 0 or 1,
+  /// samples are encrypted serially as they are added.
+  size_t num_encryption_threads;
+
+  /// For ISO BMFF only, with multiple segments.
+  /// Write every fragment to the segment file as soon as it is complete,
+  /// instead of writing the whole segment once it ends, so that segments can
+  /// be served chunk by chunk while they are produced. No 'sidx' box is
+  /// generated.
+  bool low_latency_mode;
+
+  /// For ISO BMFF only, with multiple segments, for on-demand content.
+  /// Number of segments whose encryption may be in flight. If more than 1,
+  /// the samples of every fragment are encrypted on the worker pool while the
+  /// following samples are fragmented, and up to this number of complete
+  /// segments are held in memory while their encryption completes. Only the
+  /// encryption runs in parallel; the segments are still fragmented, written
+  /// and reported to the muxer listener in order, on the muxer thread. The
+  /// output is identical. Ignored in low_latency_mode.
+  size_t num_parallel_segments;
+
   /// User-specified bit rate for the media stream. If zero, the muxer will
   /// attempt to estimate.
   uint32_t bandwidth;
@@ -27,6 +27,15 @@ void OffsetByteQueue::Push(const uint8_t* buf, int size) {
   DVLOG(4) << "Buffer pushed. head=" << head() << " tail=" << tail();
 }
 
+void OffsetByteQueue::PushShared(
+    const scoped_refptr<base::RefCountedMemory>& buffer,
+    size_t offset,
+    int size) {
+  queue_.PushShared(buffer, offset, size);
+  Sync();
+  DVLOG(4) << "Shared buffer pushed. head=" << head() << " tail=" << tail();
+}
+
 void OffsetByteQueue::Peek(const uint8_t** buf, int* size) {
   *buf = size_ > 0 ? buf_ : NULL;
   *size = size_;
@@ -48,6 +57,19 @@ void OffsetByteQueue::PeekAt(int64_t offset, const uint8_t** buf, int* size) {
   *size = tail() - offset;
 }
 
+bool OffsetByteQueue::PeekSharedAt(
+    int64_t offset,
+    scoped_refptr<base::RefCountedMemory>* buffer,
+    size_t* buffer_offset,
+    int* size) {
+  if (offset < head() || offset >= tail())
+    return false;
+  queue_.PeekShared(buffer, buffer_offset);
+  *buffer_offset += offset - head();
+  *size = tail() - offset;
+  return true;
+}
+
 bool OffsetByteQueue::Trim(int64_t max_offset) {
   if (max_offset < head_) return true;
   if (max_offset > tail()) {
@@ -25,6 +25,9 @@ class OffsetByteQueue {
   /// @{
   void Reset();
   void Push(const uint8_t* buf, int size);
+  void PushShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                  size_t offset,
+                  int size);
   void Peek(const uint8_t** buf, int* size);
   void Pop(int count);
   /// @}
@@ -37,6 +40,19 @@ class OffsetByteQueue {
   /// a null @a buf and a @a size of zero.
   void PeekAt(int64_t offset, const uint8_t** buf, int* size);
 
+  /// Like PeekAt(), but get the storage backing the queue and the position of
+  /// @a offset in it instead, see ByteQueue::PeekShared(). Used to reference
+  /// the buffered bytes without copying them.
+  /// @return false if @a offset is not buffered, true otherwise.
+  bool PeekSharedAt(int64_t offset,
+                    scoped_refptr<base::RefCountedMemory>* buffer,
+                    size_t* buffer_offset,
+                    int* size);
+
+  /// @return the minimum number of bytes worth referencing with
+  ///         PeekSharedAt(), see ByteQueue::MinSharedSize().
+  int MinSharedSize() const { return queue_.MinSharedSize(); }
+
   /// Mark the bytes up to (but not including) @a max_offset as ready for
   /// deletion. This is relatively inexpensive, but will not necessarily reduce
   /// the resident buffer size right away (or ever).
@@ -6,6 +6,9 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <vector>
+
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/offset_byte_queue.h"
 
@@ -90,5 +93,108 @@ TEST_F(OffsetByteQueueTest, Trim) {
   EXPECT_TRUE(queue_->Trim(512));
 }
 
+TEST_F(OffsetByteQueueTest, PeekSharedAt) {
+  scoped_refptr<base::RefCountedMemory> buffer;
+  size_t buffer_offset;
+  int size;
+  EXPECT_FALSE(queue_->PeekSharedAt(512, &buffer, &buffer_offset, &size));
+  ASSERT_TRUE(queue_->PeekSharedAt(400, &buffer, &buffer_offset, &size));
+  EXPECT_EQ(queue_->tail() - 400, size);
+  EXPECT_EQ(400 - 256, buffer->front()[buffer_offset]);
+
+  // The shared bytes are not overwritten by later operations on the queue.
+  uint8_t new_data[1024];
+  memset(new_data, 0xAA, sizeof(new_data));
+  queue_->Pop(128);
+  queue_->Push(new_data, 512);
+  queue_->Pop(256);
+  queue_->Push(new_data, sizeof(new_data));
+  queue_->Reset();
+  queue_->Push(new_data, sizeof(new_data));
+  for (int i = 0; i < size; ++i)
+    EXPECT_EQ(400 - 256 + i, buffer->front()[buffer_offset + i]);
+}
+
+TEST_F(OffsetByteQueueTest, PushShared) {
+  std::vector<uint8_t> data(1024);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i & 0xff;
+  scoped_refptr<base::RefCountedMemory> shared(
+      new base::RefCountedStaticMemory(&data[0], data.size()));
+
+  // Consecutive ranges of the buffer are referenced, not copied.
+  queue_->Reset();
+  queue_->PushShared(shared, 0, 256);
+  queue_->PushShared(shared, 256, 256);
+  const uint8_t* buf;
+  int size;
+  queue_->Peek(&buf, &size);
+  EXPECT_EQ(shared->front(), buf);
+  EXPECT_EQ(512, size);
+
+  scoped_refptr<base::RefCountedMemory> buffer;
+  size_t buffer_offset;
+  ASSERT_TRUE(queue_->PeekSharedAt(300, &buffer, &buffer_offset, &size));
+  EXPECT_EQ(shared.get(), buffer.get());
+  EXPECT_EQ(300u, buffer_offset);
+  EXPECT_EQ(212, size);
+
+  // Other ranges are copied after the queued bytes.
+  queue_->Pop(100);
+  queue_->PushShared(shared, 768, 256);
+  queue_->Peek(&buf, &size);
+  ASSERT_EQ(668, size);
+  EXPECT_NE(shared->front() + 100, buf);
+  EXPECT_EQ(100, buf[0]);
+  EXPECT_EQ(255, buf[411]);
+  EXPECT_EQ(0, buf[412]);
+
+  // The buffer is referenced again once the queue is empty.
+  queue_->Pop(size);
+  queue_->PushShared(shared, 512, 256);
+  queue_->Peek(&buf, &size);
+  EXPECT_EQ(shared->front() + 512, buf);
+  EXPECT_EQ(256, size);
+  EXPECT_EQ(1024, queue_->tail());
+}
+
+TEST_F(OffsetByteQueueTest, PushSharedEmptyRange) {
+  queue_->Reset();
+  // The mapping of an empty file.
+  queue_->PushShared(new base::RefCountedStaticMemory(), 0, 0);
+  const uint8_t* buf;
+  int size;
+  queue_->Peek(&buf, &size);
+  EXPECT_EQ(0, size);
+  EXPECT_EQ(0, queue_->tail());
+
+  uint8_t data[16] = {};
+  scoped_refptr<base::RefCountedMemory> shared(
+      new base::RefCountedStaticMemory(data, sizeof(data)));
+  queue_->PushShared(shared, 0, 8);
+  queue_->PushShared(shared, 8, 0);
+  queue_->Peek(&buf, &size);
+  EXPECT_EQ(shared->front(), buf);
+  EXPECT_EQ(8, size);
+}
+
+TEST_F(OffsetByteQueueTest, MinSharedSize) {
+  // Only ranges taking a good part of the queue's own storage are worth
+  // referencing.
+  const int min_shared_size = queue_->MinSharedSize();
+  EXPECT_GT(min_shared_size, 512);
+  std::vector<uint8_t> data(4 * min_shared_size);
+  queue_->Push(&data[0], data.size());
+  EXPECT_LT(min_shared_size, queue_->MinSharedSize());
+  EXPECT_GE(static_cast<int>(data.size()), queue_->MinSharedSize());
+
+  // Bytes pushed with PushShared() are held by the caller anyway.
+  scoped_refptr<base::RefCountedMemory> shared(
+      new base::RefCountedStaticMemory(&data[0], data.size()));
+  queue_->Reset();
+  queue_->PushShared(shared, 0, 256);
+  EXPECT_EQ(0, queue_->MinSharedSize());
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -84,6 +84,25 @@ class ProducerConsumerQueue {
     new_element_cv_.Broadcast();
   }
 
+  /// Increase the capacity of the queue. Producers waiting for spare capacity
+  /// are woken up.
+  /// @param capacity is the new capacity. It has no effect if it is not larger
+  ///        than the current capacity, or if the capacity is unlimited.
+  void IncreaseCapacity(size_t capacity) {
+    base::AutoLock l(lock_);
+    if (capacity_ == kUnlimitedCapacity || capacity <= capacity_)
+      return;
+    capacity_ = capacity;
+    not_full_cv_.Broadcast();
+  }
+
+  /// @return The maximum number of elements that the queue can hold at once.
+  ///         A value of zero means unlimited capacity.
+  size_t Capacity() const {
+    base::AutoLock l(lock_);
+    return capacity_;
+  }
+
   /// @return true if there are no elements in the queue.
   bool Empty() const {
     base::AutoLock l(lock_);
@@ -121,8 +140,8 @@ class ProducerConsumerQueue {
   // Move head_pos_ to center on pos.
   void SlideHeadOnCenter(size_t pos);
 
-  const size_t capacity_;  // Maximum number of elements; zero means unlimited.
   mutable base::Lock lock_;  // Lock protecting all other variables below.
+  size_t capacity_;  // Maximum number of elements; zero means unlimited.
   size_t head_pos_;          // Head position.
   std::deque<T> q_;          // Internal queue holding the elements.
   base::ConditionVariable not_empty_cv_;
@@ -87,6 +87,29 @@ TEST(ProducerConsumerQueueTest, PeekOnPoppedElement) {
             queue.Peek(kCapacity / 2 - 2, &val, kInfiniteTimeout).error_code());
 }
 
+TEST(ProducerConsumerQueueTest, IncreaseCapacity) {
+  ProducerConsumerQueue<size_t> queue(kCapacity);
+  for (size_t i = 0; i < kCapacity; ++i)
+    ASSERT_OK(queue.Push(i, kInfiniteTimeout));
+  ASSERT_EQ(error::TIME_OUT, queue.Push(kCapacity, 0).error_code());
+
+  // Capacity is never decreased.
+  queue.IncreaseCapacity(kCapacity - 1);
+  EXPECT_EQ(kCapacity, queue.Capacity());
+
+  queue.IncreaseCapacity(kCapacity * 2);
+  EXPECT_EQ(kCapacity * 2, queue.Capacity());
+  for (size_t i = kCapacity; i < kCapacity * 2; ++i)
+    ASSERT_OK(queue.Push(i, 0));
+  ASSERT_EQ(error::TIME_OUT, queue.Push(kCapacity * 2, 0).error_code());
+
+  // The peek window grows with the capacity.
+  size_t val;
+  ASSERT_OK(queue.Peek(kCapacity, &val, 0));
+  EXPECT_EQ(kCapacity, val);
+  EXPECT_EQ(0u, queue.HeadPos());
+}
+
 TEST(ProducerConsumerQueueTest, PushWithTimeout) {
   scoped_ptr<base::ElapsedTimer> timer;
   ProducerConsumerQueue<int> queue(kCapacity);
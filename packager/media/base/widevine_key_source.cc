@@ -6,6 +6,10 @@
 
 #include "packager/media/base/widevine_key_source.h"
 
+#include <inttypes.h>
+
+#include <algorithm>
+#include <cmath>
 #include <set>
 
 #include "packager/base/base64.h"
@@ -14,6 +18,7 @@
 #include "packager/base/json/json_writer.h"
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/stl_util.h"
+#include "packager/base/strings/stringprintf.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/http_key_fetcher.h"
 #include "packager/media/base/producer_consumer_queue.h"
@@ -42,6 +47,9 @@ const int kFirstRetryDelayMilliseconds = 1000;
 const int kDefaultCryptoPeriodCount = 10;
 const int kGetKeyTimeoutInSeconds = 5 * 60;  // 5 minutes.
 const int kKeyFetchTimeoutInSeconds = 60;  // 1 minute.
+// Upper bound of the key pool depth, in crypto periods, when it is deepened
+// to cover slow key server responses.
+const size_t kMaxKeyPoolCapacity = 10 * kDefaultCryptoPeriodCount;
 
 const uint8_t kWidevineSystemId[] = {0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6,
                                      0x4a, 0xce, 0xa3, 0xc8, 0x27, 0xdc,
@@ -138,6 +146,17 @@ class WidevineKeySource::RefCountedEncryptionKeyMap
   DISALLOW_COPY_AND_ASSIGN(RefCountedEncryptionKeyMap);
 };
 
+WidevineKeySource::KeyPrefetchStats::KeyPrefetchStats()
+    : fetches(0), stalls(0), key_pool_capacity(0) {}
+
+std::string WidevineKeySource::KeyPrefetchStats::ToString() const {
+  return base::StringPrintf(
+      "fetches: %" PRIu64 " max_fetch_time_ms: %" PRId64 " stalls: %" PRIu64
+      " stall_time_ms: %" PRId64 " key_pool_capacity: %zu",
+      fetches, max_fetch_time.InMilliseconds(), stalls,
+      stall_time.InMilliseconds(), key_pool_capacity);
+}
+
 WidevineKeySource::WidevineKeySource(const std::string& server_url,
                                      bool add_common_pssh)
     : key_production_thread_("KeyProductionThread",
@@ -149,7 +168,8 @@ WidevineKeySource::WidevineKeySource(const std::string& server_url,
       add_common_pssh_(add_common_pssh),
       key_production_started_(false),
       start_key_production_(false, false),
-      first_crypto_period_index_(0) {
+      first_crypto_period_index_(0),
+      crypto_period_duration_in_seconds_(0) {
   key_production_thread_.Start();
 }
 
@@ -163,6 +183,8 @@ WidevineKeySource::~WidevineKeySource() {
     key_production_thread_.Join();
   }
   STLDeleteValues(&encryption_key_map_);
+  if (key_pool_)
+    VLOG(1) << "Key prefetch stats: " << GetKeyPrefetchStats().ToString();
 }
 
 Status WidevineKeySource::FetchKeys(const std::vector<uint8_t>& content_id,
@@ -274,6 +296,10 @@ Status WidevineKeySource::GetCryptoPeriodKey(uint32_t crypto_period_index,
       DCHECK(!key_pool_);
       key_pool_.reset(new EncryptionKeyQueue(crypto_period_count_,
                                              first_crypto_period_index_));
+      {
+        base::AutoLock scoped_stats_lock(stats_lock_);
+        key_prefetch_stats_.key_pool_capacity = crypto_period_count_;
+      }
       start_key_production_.Signal();
       key_production_started_ = true;
     }
@@ -289,6 +315,12 @@ void WidevineKeySource::set_key_fetcher(scoped_ptr<KeyFetcher> key_fetcher) {
   key_fetcher_ = key_fetcher.Pass();
 }
 
+WidevineKeySource::KeyPrefetchStats WidevineKeySource::GetKeyPrefetchStats()
+    const {
+  base::AutoLock scoped_lock(stats_lock_);
+  return key_prefetch_stats_;
+}
+
 Status WidevineKeySource::GetKeyInternal(uint32_t crypto_period_index,
                                          TrackType track_type,
                                          EncryptionKey* key) {
@@ -299,8 +331,20 @@ Status WidevineKeySource::GetKeyInternal(uint32_t crypto_period_index,
 
   scoped_refptr<RefCountedEncryptionKeyMap> ref_counted_encryption_key_map;
   Status status =
-      key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map,
-                      kGetKeyTimeoutInSeconds * 1000);
+      key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map, 0);
+  if (status.error_code() == error::TIME_OUT) {
+    // The key has not been fetched yet. The muxer stalls until it is.
+    const base::TimeTicks start = base::TimeTicks::Now();
+    status =
+        key_pool_->Peek(crypto_period_index, &ref_counted_encryption_key_map,
+                        kGetKeyTimeoutInSeconds * 1000);
+    const base::TimeDelta stall_time = base::TimeTicks::Now() - start;
+    VLOG(1) << "Waited " << stall_time.InMilliseconds()
+            << "ms for the key of crypto period " << crypto_period_index;
+    base::AutoLock scoped_lock(stats_lock_);
+    ++key_prefetch_stats_.stalls;
+    key_prefetch_stats_.stall_time += stall_time;
+  }
   if (!status.ok()) {
     if (status.error_code() == error::STOPPED) {
       CHECK(!common_encryption_request_status_.ok());
@@ -357,7 +401,10 @@ Status WidevineKeySource::FetchKeysInternal(bool enable_key_rotation,
   // Perform client side retries if seeing server transient error to workaround
   // server limitation.
   for (int i = 0; i < kNumTransientErrorRetries; ++i) {
+    const base::TimeTicks start = base::TimeTicks::Now();
     status = key_fetcher_->FetchKeys(server_url_, message, &raw_response);
+    if (enable_key_rotation)
+      OnKeyRotationFetch(base::TimeTicks::Now() - start);
     if (status.ok()) {
       VLOG(1) << "Retry [" << i << "] Response:" << raw_response;
 
@@ -615,5 +662,35 @@ bool WidevineKeySource::PushToKeyPool(
   return true;
 }
 
+void WidevineKeySource::OnKeyRotationFetch(base::TimeDelta fetch_time) {
+  DCHECK(key_pool_);
+  base::AutoLock scoped_lock(stats_lock_);
+  ++key_prefetch_stats_.fetches;
+  key_prefetch_stats_.max_fetch_time =
+      std::max(key_prefetch_stats_.max_fetch_time, fetch_time);
+  if (crypto_period_duration_in_seconds_ <= 0)
+    return;
+
+  // The next request is sent once all the keys of this request are in the key
+  // pool, which holds as many crypto periods after the one being peeked as
+  // before it. So up to half of the pool, less the crypto period in use, is
+  // left to cover the next response. One more crypto period is kept as margin.
+  const double fetch_periods =
+      key_prefetch_stats_.max_fetch_time.InSecondsF() /
+      crypto_period_duration_in_seconds_;
+  const size_t periods_to_cover =
+      static_cast<size_t>(std::ceil(fetch_periods)) + 1;
+  const size_t capacity =
+      std::min(2 * (periods_to_cover + 1), kMaxKeyPoolCapacity);
+  if (capacity <= key_prefetch_stats_.key_pool_capacity)
+    return;
+  VLOG(1) << "Key server responded in "
+          << key_prefetch_stats_.max_fetch_time.InMilliseconds()
+          << "ms. Deepening the key pool to " << capacity
+          << " crypto periods.";
+  key_pool_->IncreaseCapacity(capacity);
+  key_prefetch_stats_.key_pool_capacity = capacity;
+}
+
 }  // namespace media
 }  // namespace shaka
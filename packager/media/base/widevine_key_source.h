@@ -8,9 +8,12 @@
 #define MEDIA_BASE_WIDEVINE_KEY_SOURCE_H_
 
 #include <map>
+#include <string>
 
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
 #include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/time/time.h"
 #include "packager/base/values.h"
 #include "packager/media/base/closure_thread.h"
 #include "packager/media/base/key_source.h"
@@ -25,6 +28,26 @@ template <class T> class ProducerConsumerQueue;
 /// acquire the encryption keys.
 class WidevineKeySource : public KeySource {
  public:
+  /// Key rotation counters.
+  struct KeyPrefetchStats {
+    KeyPrefetchStats();
+
+    /// Number of key rotation requests sent to the key server.
+    uint64_t fetches;
+    /// Longest key server response time to a key rotation request.
+    base::TimeDelta max_fetch_time;
+    /// Number of GetCryptoPeriodKey() calls which had to wait for the key to
+    /// be fetched.
+    uint64_t stalls;
+    /// Time spent waiting for keys in GetCryptoPeriodKey().
+    base::TimeDelta stall_time;
+    /// Maximum number of crypto periods held in the key pool.
+    size_t key_pool_capacity;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
   /// @param server_url is the Widevine common encryption server url.
   WidevineKeySource(const std::string& server_url, bool add_common_pssh);
 
@@ -59,6 +82,20 @@ class WidevineKeySource : public KeySource {
   /// @param key_fetcher points to the @b KeyFetcher object to be injected.
   void set_key_fetcher(scoped_ptr<KeyFetcher> key_fetcher);
 
+  /// Set the duration of the crypto periods, assuming that the content is
+  /// produced in real time, e.g. live. It is used to prefetch the keys far
+  /// enough ahead for a key rotation request to complete before its keys are
+  /// needed: the key pool is deepened from the slowest key server response
+  /// seen so far. It should be called before the first GetCryptoPeriodKey().
+  /// @param crypto_period_duration_in_seconds is the crypto period duration.
+  ///        A value of zero disables the adaptation.
+  void set_crypto_period_duration(double crypto_period_duration_in_seconds) {
+    crypto_period_duration_in_seconds_ = crypto_period_duration_in_seconds;
+  }
+
+  /// @return a snapshot of the key rotation counters.
+  KeyPrefetchStats GetKeyPrefetchStats() const;
+
  protected:
    ClosureThread key_production_thread_;
 
@@ -102,6 +139,9 @@ class WidevineKeySource : public KeySource {
                             bool* transient_error);
   // Push the keys to the key pool.
   bool PushToKeyPool(EncryptionKeyMap* encryption_key_map);
+  // Record a key rotation request which took |fetch_time|, and deepen the key
+  // pool if needed to cover it.
+  void OnKeyRotationFetch(base::TimeDelta fetch_time);
 
   // The fetcher object used to fetch keys from the license service.
   // It is initialized to a default fetcher on class initialization.
@@ -120,6 +160,10 @@ class WidevineKeySource : public KeySource {
   scoped_ptr<EncryptionKeyQueue> key_pool_;
   EncryptionKeyMap encryption_key_map_;  // For non key rotation request.
   Status common_encryption_request_status_;
+  double crypto_period_duration_in_seconds_;
+  // Lock protecting |key_prefetch_stats_|.
+  mutable base::Lock stats_lock_;
+  KeyPrefetchStats key_prefetch_stats_;
 
   DISALLOW_COPY_AND_ASSIGN(WidevineKeySource);
 };
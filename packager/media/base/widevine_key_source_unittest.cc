@@ -10,8 +10,11 @@
 #include <algorithm>
 
 #include "packager/base/base64.h"
+#include "packager/base/json/json_reader.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/base/values.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/key_fetcher.h"
 #include "packager/media/base/request_signer.h"
@@ -514,6 +517,91 @@ TEST_P(WidevineKeySourceTest, KeyRotationTest) {
   EXPECT_EQ(error::INVALID_ARGUMENT, status.error_code());
 }
 
+namespace {
+
+// A local key server answering every request after |latency|, to exercise
+// key prefetching with a slow key server.
+class FakeKeyFetcher : public KeyFetcher {
+ public:
+  explicit FakeKeyFetcher(base::TimeDelta latency) : latency_(latency) {}
+  ~FakeKeyFetcher() override {}
+
+  Status FetchKeys(const std::string& service_address,
+                   const std::string& data,
+                   std::string* response) override {
+    base::PlatformThread::Sleep(latency_);
+
+    scoped_ptr<base::Value> message(base::JSONReader::Read(data));
+    const base::DictionaryValue* message_dict = NULL;
+    std::string request_base64_string;
+    std::string request;
+    if (!message || !message->GetAsDictionary(&message_dict) ||
+        !message_dict->GetString("request", &request_base64_string) ||
+        !base::Base64Decode(request_base64_string, &request)) {
+      return Status(error::SERVER_ERROR, "Bad request message.");
+    }
+    scoped_ptr<base::Value> request_value(base::JSONReader::Read(request));
+    const base::DictionaryValue* request_dict = NULL;
+    if (!request_value || !request_value->GetAsDictionary(&request_dict))
+      return Status(error::SERVER_ERROR, "Bad request.");
+
+    int first_crypto_period_index = 0;
+    int crypto_period_count = 0;
+    const std::string license =
+        request_dict->GetInteger("first_crypto_period_index",
+                                 &first_crypto_period_index) &&
+                request_dict->GetInteger("crypto_period_count",
+                                         &crypto_period_count)
+            ? GenerateMockKeyRotationLicenseResponse(
+                  first_crypto_period_index, crypto_period_count)
+            : GenerateMockLicenseResponse();
+    *response = base::StringPrintf(kHttpResponseFormat,
+                                   Base64Encode(license).c_str());
+    return Status::OK;
+  }
+
+ private:
+  const base::TimeDelta latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeKeyFetcher);
+};
+
+}  // namespace
+
+TEST_P(WidevineKeySourceTest, KeyRotationPrefetchWithSlowServer) {
+  const int64_t kLatencyInMilliseconds = 50;
+  const double kCryptoPeriodDurationInSeconds = 0.01;
+  // Keys are needed every 10ms, so a 50ms response needs 5 crypto periods
+  // ahead, plus one in use and one as margin, on both sides of the pool.
+  const size_t kExpectedMinKeyPoolCapacity = 2 * (5 + 2);
+  const uint32_t kNumCryptoPeriods = 30;
+
+  widevine_key_source_.reset(new WidevineKeySource(kServerUrl, GetParam()));
+  widevine_key_source_->set_key_fetcher(scoped_ptr<KeyFetcher>(
+      new FakeKeyFetcher(
+          base::TimeDelta::FromMilliseconds(kLatencyInMilliseconds))));
+  widevine_key_source_->set_crypto_period_duration(
+      kCryptoPeriodDurationInSeconds);
+  ASSERT_OK(widevine_key_source_->FetchKeys(content_id_, kPolicy));
+
+  EncryptionKey encryption_key;
+  for (uint32_t i = 0; i < kNumCryptoPeriods; ++i) {
+    ASSERT_OK(widevine_key_source_->GetCryptoPeriodKey(
+        i, KeySource::TRACK_TYPE_SD, &encryption_key));
+    EXPECT_EQ(GetMockKey("SD", i), ToString(encryption_key.key));
+  }
+
+  WidevineKeySource::KeyPrefetchStats stats =
+      widevine_key_source_->GetKeyPrefetchStats();
+  // The keys are requested kDefaultCryptoPeriodCount (10) at a time.
+  EXPECT_LE(kNumCryptoPeriods / 10, stats.fetches);
+  EXPECT_LE(kLatencyInMilliseconds, stats.max_fetch_time.InMilliseconds());
+  // At least the first key is waited for.
+  EXPECT_LE(1u, stats.stalls);
+  EXPECT_LE(kLatencyInMilliseconds / 2, stats.stall_time.InMilliseconds());
+  EXPECT_LE(kExpectedMinKeyPoolCapacity, stats.key_pool_capacity);
+}
+
 INSTANTIATE_TEST_CASE_P(WidevineKeySourceInstance,
                         WidevineKeySourceTest,
                         ::testing::Bool());
@@ -5,14 +5,62 @@
 #include "packager/base/logging.h"
 #include "packager/media/codecs/h26x_bit_reader.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace shaka {
 namespace media {
 
+namespace {
+
+// Size of the bit cache.
+const int kCacheBits = 64;
+
+// Exp-Golomb codes with fewer leading zero bits than this are decoded from
+// the cache directly.
+const int kMaxFastPathLeadingZeroBits = 16;
+
+inline uint64_t LoadBigEndian64(const uint8_t* data) {
+  return static_cast<uint64_t>(data[0]) << 56 |
+         static_cast<uint64_t>(data[1]) << 48 |
+         static_cast<uint64_t>(data[2]) << 40 |
+         static_cast<uint64_t>(data[3]) << 32 |
+         static_cast<uint64_t>(data[4]) << 24 |
+         static_cast<uint64_t>(data[5]) << 16 |
+         static_cast<uint64_t>(data[6]) << 8 |
+         static_cast<uint64_t>(data[7]);
+}
+
+// Return true if any of the eight bytes of |word| is 0.
+inline bool HasZeroByte(uint64_t word) {
+  return ((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) != 0;
+}
+
+inline int CountLeadingZeros(uint64_t value) {
+  DCHECK_NE(value, 0u);
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - static_cast<int>(index);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if (_BitScanReverse(&index, static_cast<uint32_t>(value >> 32)))
+    return 31 - static_cast<int>(index);
+  _BitScanReverse(&index, static_cast<uint32_t>(value));
+  return 63 - static_cast<int>(index);
+#else
+  return __builtin_clzll(value);
+#endif
+}
+
+}  // namespace
+
 H26xBitReader::H26xBitReader()
     : data_(NULL),
       bytes_left_(0),
-      curr_byte_(0),
-      num_remaining_bits_in_curr_byte_(0),
+      cache_(0),
+      num_cached_bits_(0),
       prev_two_bytes_(0),
       emulation_prevention_bytes_(0) {}
 
@@ -26,7 +74,8 @@ bool H26xBitReader::Initialize(const uint8_t* data, off_t size) {
 
   data_ = data;
   bytes_left_ = size;
-  num_remaining_bits_in_curr_byte_ = 0;
+  cache_ = 0;
+  num_cached_bits_ = 0;
   // Initially set to 0xffff to accept all initial two-byte sequences.
   prev_two_bytes_ = 0xffff;
   emulation_prevention_bytes_ = 0;
@@ -34,7 +83,35 @@ bool H26xBitReader::Initialize(const uint8_t* data, off_t size) {
   return true;
 }
 
-bool H26xBitReader::UpdateCurrByte() {
+bool H26xBitReader::Refill() {
+  while (num_cached_bits_ <= kCacheBits - 8) {
+    // An emulation prevention byte is a 0x03 following two zero bytes, so
+    // there is none in the next eight bytes if none of them is zero and the
+    // last two loaded bytes are not both zero. Load them all at once then.
+    if (bytes_left_ >= 8 && (prev_two_bytes_ & 0xffff) != 0) {
+      const uint64_t word = LoadBigEndian64(data_);
+      if (!HasZeroByte(word)) {
+        const int num_bytes = (kCacheBits - num_cached_bits_) / 8;
+        const int num_bits = num_bytes * 8;
+        const uint64_t loaded = word >> (kCacheBits - num_bits);
+        cache_ |= loaded << (kCacheBits - num_cached_bits_ - num_bits);
+        num_cached_bits_ += num_bits;
+        data_ += num_bytes;
+        bytes_left_ -= num_bytes;
+        prev_two_bytes_ = num_bytes >= 2
+                              ? static_cast<int>(loaded & 0xffff)
+                              : ((prev_two_bytes_ << 8) | loaded) & 0xffff;
+        continue;
+      }
+    }
+
+    if (!LoadByte())
+      break;
+  }
+  return num_cached_bits_ > 0;
+}
+
+bool H26xBitReader::LoadByte() {
   if (bytes_left_ < 1)
     return false;
 
@@ -53,52 +130,71 @@ bool H26xBitReader::UpdateCurrByte() {
   }
 
   // Load a new byte and advance pointers.
-  curr_byte_ = *data_++ & 0xff;
+  const int byte = *data_++ & 0xff;
   --bytes_left_;
-  num_remaining_bits_in_curr_byte_ = 8;
+  DCHECK_LE(num_cached_bits_, kCacheBits - 8);
+  cache_ |= static_cast<uint64_t>(byte) << (kCacheBits - 8 - num_cached_bits_);
+  num_cached_bits_ += 8;
 
-  prev_two_bytes_ = (prev_two_bytes_ << 8) | curr_byte_;
+  prev_two_bytes_ = ((prev_two_bytes_ << 8) | byte) & 0xffff;
 
   return true;
 }
 
+void H26xBitReader::ConsumeBits(int num_bits) {
+  DCHECK_LE(num_bits, num_cached_bits_);
+  cache_ = num_bits < kCacheBits ? cache_ << num_bits : 0;
+  num_cached_bits_ -= num_bits;
+}
+
 // Read |num_bits| (1 to 31 inclusive) from the stream and return them
 // in |out|, with first bit in the stream as MSB in |out| at position
 // (|num_bits| - 1).
 bool H26xBitReader::ReadBits(int num_bits, int* out) {
-  int bits_left = num_bits;
-  *out = 0;
   DCHECK(num_bits <= 31);
+  *out = 0;
+  if (num_bits <= 0)
+    return true;
 
-  while (num_remaining_bits_in_curr_byte_ < bits_left) {
-    // Take all that's left in current byte, shift to make space for the rest.
-    *out |= (curr_byte_ << (bits_left - num_remaining_bits_in_curr_byte_));
-    bits_left -= num_remaining_bits_in_curr_byte_;
-
-    if (!UpdateCurrByte())
-      return false;
-  }
-
-  *out |= (curr_byte_ >> (num_remaining_bits_in_curr_byte_ - bits_left));
-  *out &= ((1 << num_bits) - 1);
-  num_remaining_bits_in_curr_byte_ -= bits_left;
+  if (num_cached_bits_ < num_bits && !Refill())
+    return false;
+  if (num_cached_bits_ < num_bits)
+    return false;
 
+  *out = static_cast<int>(cache_ >> (kCacheBits - num_bits));
+  ConsumeBits(num_bits);
   return true;
 }
 
 bool H26xBitReader::SkipBits(int num_bits) {
-  int bits_left = num_bits;
-  while (num_remaining_bits_in_curr_byte_ < bits_left) {
-    bits_left -= num_remaining_bits_in_curr_byte_;
-    if (!UpdateCurrByte())
+  while (num_cached_bits_ < num_bits) {
+    num_bits -= num_cached_bits_;
+    ConsumeBits(num_cached_bits_);
+    if (!Refill())
       return false;
   }
 
-  num_remaining_bits_in_curr_byte_ -= bits_left;
+  ConsumeBits(num_bits);
   return true;
 }
 
 bool H26xBitReader::ReadUE(int* val) {
+  // Fast path: the whole code is in the cache.
+  if (num_cached_bits_ < 2 * kMaxFastPathLeadingZeroBits)
+    Refill();
+  if (cache_ != 0) {
+    const int num_bits = CountLeadingZeros(cache_);
+    if (num_bits < kMaxFastPathLeadingZeroBits &&
+        2 * num_bits + 1 <= num_cached_bits_) {
+      *val = static_cast<int>(cache_ >> (kCacheBits - (2 * num_bits + 1))) - 1;
+      ConsumeBits(2 * num_bits + 1);
+      return true;
+    }
+  }
+  return ReadUESlow(val);
+}
+
+bool H26xBitReader::ReadUESlow(int* val) {
   int num_bits = -1;
   int bit;
   int rest;
@@ -141,24 +237,24 @@ bool H26xBitReader::ReadSE(int* val) {
 }
 
 off_t H26xBitReader::NumBitsLeft() {
-  return (num_remaining_bits_in_curr_byte_ + bytes_left_ * 8);
+  return (num_cached_bits_ + bytes_left_ * 8);
 }
 
 bool H26xBitReader::HasMoreRBSPData() {
-  // Make sure we have more bits, if we are at 0 bits in current byte
-  // and updating current byte fails, we don't have more data anyway.
-  if (num_remaining_bits_in_curr_byte_ == 0 && !UpdateCurrByte())
+  // Make sure we have more bits, if we are at 0 bits in the cache
+  // and refilling fails, we don't have more data anyway.
+  if (num_cached_bits_ == 0 && !Refill())
     return false;
 
+  // The cache holds the rest of the current byte followed by whole bytes.
   // On last byte?
-  if (bytes_left_)
+  if (bytes_left_ || num_cached_bits_ > 8)
     return true;
 
   // Last byte, look for stop bit;
   // We have more RBSP data if the last non-zero bit we find is not the
   // first available bit.
-  return (curr_byte_ &
-          ((1 << (num_remaining_bits_in_curr_byte_ - 1)) - 1)) != 0;
+  return (cache_ << 1) != 0;
 }
 
 size_t H26xBitReader::NumEmulationPreventionBytesRead() {
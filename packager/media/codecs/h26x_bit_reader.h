@@ -58,34 +58,52 @@ class H26xBitReader {
   // Read one signed exp-Golomb code from the stream and return in |*val|.
   bool ReadSE(int* val);
 
-  // Return the number of bits left in the stream.
+  // Return the number of bits left in the stream. The emulation prevention
+  // bytes counted by NumEmulationPreventionBytesRead() are not included, so
+  // the number of bits read is always
+  //   (size - NumEmulationPreventionBytesRead()) * 8 - NumBitsLeft().
   off_t NumBitsLeft();
 
   // See the definition of more_rbsp_data() in spec.
   bool HasMoreRBSPData();
 
-  // Return the number of emulation prevention bytes already read.
+  // Return the number of emulation prevention bytes already skipped. The
+  // reader loads up to eight bytes ahead, so this may include bytes past the
+  // current position.
   size_t NumEmulationPreventionBytesRead();
 
  private:
-  // Advance to the next byte, loading it into curr_byte_.
+  // Load whole bytes into cache_ until it holds more than 56 bits or the end
+  // of the stream is reached, skipping emulation prevention bytes.
+  // Return false if the cache is empty afterwards.
+  bool Refill();
+
+  // Append the next byte of the stream to cache_, skipping an emulation
+  // prevention byte in front of it if needed.
   // Return false on end of stream.
-  bool UpdateCurrByte();
+  bool LoadByte();
+
+  // Drop |num_bits| (at most num_cached_bits_) bits from the cache.
+  void ConsumeBits(int num_bits);
+
+  // Slow path of ReadUE(), reading one bit at a time.
+  bool ReadUESlow(int* val);
 
-  // Pointer to the next unread (not in curr_byte_) byte in the stream.
+  // Pointer to the next unread (not in cache_) byte in the stream.
   const uint8_t* data_;
 
-  // Bytes left in the stream (without the curr_byte_).
+  // Bytes left in the stream (without the bytes in cache_).
   off_t bytes_left_;
 
-  // Contents of the current byte; first unread bit starting at position
-  // 8 - num_remaining_bits_in_curr_byte_ from MSB.
-  int curr_byte_;
+  // Bits loaded from the stream but not read yet, starting from the MSB.
+  // The bits below the first num_cached_bits_ bits are 0.
+  uint64_t cache_;
 
-  // Number of bits remaining in curr_byte_
-  int num_remaining_bits_in_curr_byte_;
+  // Number of bits in cache_.
+  int num_cached_bits_;
 
-  // Used in emulation prevention three byte detection (see spec).
+  // Last two bytes loaded into cache_, used in emulation prevention three
+  // byte detection (see spec).
   // Initially set to 0xffff to accept all initial two-byte sequences.
   int prev_two_bytes_;
 
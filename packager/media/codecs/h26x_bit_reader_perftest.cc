@@ -0,0 +1,111 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Throughput micro-benchmarks for slice header parsing, which runs for every
+// video slice when encrypting. Run them with:
+//   packager_perftest --gtest_filter=*SliceHeaderPerfTest*
+
+#include <gtest/gtest.h>
+
+#include "packager/base/logging.h"
+#include "packager/base/time/time.h"
+#include "packager/media/codecs/h264_parser.h"
+#include "packager/media/codecs/h265_parser.h"
+#include "packager/media/test/test_data_util.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+const size_t kNumIterations = 2000;
+
+// Reads all the NAL units of the Annex B stream in |data|.
+std::vector<Nalu> ReadNalus(Nalu::CodecType codec_type,
+                            const std::vector<uint8_t>& data) {
+  std::vector<Nalu> nalus;
+  NaluReader reader(codec_type, kIsAnnexbByteStream, data.data(),
+                    data.size());
+  Nalu nalu;
+  while (reader.Advance(&nalu) == NaluReader::kOk)
+    nalus.push_back(nalu);
+  return nalus;
+}
+
+void ReportThroughput(const char* label,
+                      size_t num_slices,
+                      base::TimeDelta elapsed) {
+  LOG(INFO) << label << ": " << num_slices / elapsed.InSecondsF()
+            << " slice headers/s";
+}
+
+}  // namespace
+
+TEST(SliceHeaderPerfTest, H264) {
+  const std::vector<uint8_t> data = ReadTestDataFile("test-25fps.h264");
+  const std::vector<Nalu> nalus = ReadNalus(Nalu::kH264, data);
+  ASSERT_FALSE(nalus.empty());
+
+  H264Parser parser;
+  std::vector<const Nalu*> slices;
+  for (const Nalu& nalu : nalus) {
+    int id;
+    if (nalu.type() == Nalu::H264_SPS) {
+      ASSERT_EQ(H264Parser::kOk, parser.ParseSps(nalu, &id));
+    } else if (nalu.type() == Nalu::H264_PPS) {
+      ASSERT_EQ(H264Parser::kOk, parser.ParsePps(nalu, &id));
+    } else if (nalu.is_video_slice()) {
+      slices.push_back(&nalu);
+    }
+  }
+  ASSERT_FALSE(slices.empty());
+
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    for (const Nalu* slice : slices) {
+      H264SliceHeader slice_header;
+      ASSERT_EQ(H264Parser::kOk,
+                parser.ParseSliceHeader(*slice, &slice_header));
+    }
+  }
+  ReportThroughput("H.264", kNumIterations * slices.size(),
+                   base::TimeTicks::Now() - start);
+}
+
+TEST(SliceHeaderPerfTest, H265) {
+  const std::vector<uint8_t> data =
+      ReadTestDataFile("hevc-byte-stream-frame.h265");
+  const std::vector<Nalu> nalus = ReadNalus(Nalu::kH265, data);
+  ASSERT_FALSE(nalus.empty());
+
+  H265Parser parser;
+  std::vector<const Nalu*> slices;
+  for (const Nalu& nalu : nalus) {
+    int id;
+    if (nalu.type() == Nalu::H265_SPS) {
+      ASSERT_EQ(H265Parser::kOk, parser.ParseSps(nalu, &id));
+    } else if (nalu.type() == Nalu::H265_PPS) {
+      ASSERT_EQ(H265Parser::kOk, parser.ParsePps(nalu, &id));
+    } else if (nalu.is_video_slice()) {
+      slices.push_back(&nalu);
+    }
+  }
+  ASSERT_FALSE(slices.empty());
+
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    for (const Nalu* slice : slices) {
+      H265SliceHeader slice_header;
+      ASSERT_EQ(H265Parser::kOk,
+                parser.ParseSliceHeader(*slice, &slice_header));
+    }
+  }
+  ReportThroughput("H.265", kNumIterations * slices.size(),
+                   base::TimeTicks::Now() - start);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -112,5 +112,64 @@ TEST(H26xBitReaderTest, StopBitOccupyFullByte) {
   EXPECT_FALSE(reader.HasMoreRBSPData());
 }
 
+TEST(H26xBitReaderTest, SkipEmulationPreventionBytes) {
+  H26xBitReader reader;
+  // 0x000003 sequences, including one spanning the eight byte refills.
+  const unsigned char rbsp[] = {0xff, 0x00, 0x00, 0x03, 0x01, 0xfe,
+                                0xfd, 0xfc, 0x00, 0x00, 0x03, 0x00,
+                                0x00, 0x03, 0x03, 0xab, 0x80};
+  int dummy = 0;
+
+  EXPECT_TRUE(reader.Initialize(rbsp, sizeof(rbsp)));
+  EXPECT_TRUE(reader.ReadBits(8, &dummy));
+  EXPECT_EQ(0xff, dummy);
+  EXPECT_TRUE(reader.ReadBits(24, &dummy));
+  EXPECT_EQ(0x000001, dummy);
+  EXPECT_TRUE(reader.ReadBits(24, &dummy));
+  EXPECT_EQ(0xfefdfc, dummy);
+  EXPECT_TRUE(reader.ReadBits(16, &dummy));
+  EXPECT_EQ(0x0000, dummy);
+  // The second 0x03 after 0x000003 is data.
+  EXPECT_TRUE(reader.ReadBits(24, &dummy));
+  EXPECT_EQ(0x000003, dummy);
+  EXPECT_EQ(3u, reader.NumEmulationPreventionBytesRead());
+
+  EXPECT_TRUE(reader.ReadBits(8, &dummy));
+  EXPECT_EQ(0xab, dummy);
+  EXPECT_EQ(8, reader.NumBitsLeft());
+  EXPECT_FALSE(reader.HasMoreRBSPData());
+  // Bits read = (size - emulation prevention bytes) * 8 - bits left.
+  EXPECT_EQ(13 * 8, static_cast<int>((sizeof(rbsp) -
+                                      reader.NumEmulationPreventionBytesRead()) *
+                                         8 -
+                                     reader.NumBitsLeft()));
+}
+
+TEST(H26xBitReaderTest, ReadExpGolomb) {
+  H26xBitReader reader;
+  // ue(v): 0 (1), 1 (010), 2 (011), 7 (0001000), then se(v): -1 (011),
+  // 1 (010), then ue(v): 65534 (15 zero bits followed by 16 one bits), then
+  // zero bits only.
+  const unsigned char rbsp[] = {0xa6, 0x21, 0xa0, 0x00, 0x1f, 0xff, 0xe0};
+  int value = 0;
+
+  EXPECT_TRUE(reader.Initialize(rbsp, sizeof(rbsp)));
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(0, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(7, value);
+  EXPECT_TRUE(reader.ReadSE(&value));
+  EXPECT_EQ(-1, value);
+  EXPECT_TRUE(reader.ReadSE(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(reader.ReadUE(&value));
+  EXPECT_EQ(65534, value);
+  EXPECT_FALSE(reader.ReadUE(&value));
+}
+
 }  // namespace media
 }  // namespace shaka
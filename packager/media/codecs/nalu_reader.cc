@@ -8,6 +8,22 @@
 
 #include <iostream>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NALU_READER_USE_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 is selected at runtime, which needs the GCC/Clang target attribute.
+#if defined(NALU_READER_USE_SSE2) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define NALU_READER_USE_AVX2
+#include <immintrin.h>
+#endif
+
 #include "packager/base/logging.h"
 #include "packager/media/base/buffer_reader.h"
 #include "packager/media/codecs/h264_parser.h"
@@ -19,6 +35,104 @@ namespace {
 inline bool IsStartCode(const uint8_t* data) {
   return data[0] == 0x00 && data[1] == 0x00 && data[2] == 0x01;
 }
+
+// The functions below return the first position p in [|data|, |end| - 3] at
+// which a three-byte start code begins, or NULL if there is none.
+typedef const uint8_t* (*StartCodeScanner)(const uint8_t* data,
+                                          const uint8_t* end);
+
+const uint8_t* ScanStartCodeScalar(const uint8_t* data, const uint8_t* end) {
+  while (end - data >= 3) {
+    // No start code can begin at |data|, |data| + 1 or |data| + 2 unless
+    // |data[2]| is 0 or 1.
+    if (data[2] > 0x01) {
+      data += 3;
+    } else if (data[2] == 0x01) {
+      if (data[0] == 0x00 && data[1] == 0x00)
+        return data;
+      data += 3;
+    } else {
+      ++data;
+    }
+  }
+  return NULL;
+}
+
+#if defined(NALU_READER_USE_SSE2)
+inline int CountTrailingZeros(uint32_t mask) {
+  DCHECK_NE(mask, 0u);
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Checks 16 positions at a time: a start code begins at position i if bytes
+// i and i + 1 are 0 and byte i + 2 is 1.
+const uint8_t* ScanStartCodeSse2(const uint8_t* data, const uint8_t* end) {
+  const __m128i kZero = _mm_setzero_si128();
+  const __m128i kOne = _mm_set1_epi8(1);
+  while (end - data >= 16 + 2) {
+    const __m128i byte0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i byte1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 1));
+    const __m128i byte2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 2));
+    const __m128i matches = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(byte0, kZero),
+                      _mm_cmpeq_epi8(byte1, kZero)),
+        _mm_cmpeq_epi8(byte2, kOne));
+    const uint32_t mask = _mm_movemask_epi8(matches);
+    if (mask != 0)
+      return data + CountTrailingZeros(mask);
+    data += 16;
+  }
+  return ScanStartCodeScalar(data, end);
+}
+#endif  // defined(NALU_READER_USE_SSE2)
+
+#if defined(NALU_READER_USE_AVX2)
+// Same as ScanStartCodeSse2, 32 positions at a time.
+__attribute__((target("avx2"))) const uint8_t* ScanStartCodeAvx2(
+    const uint8_t* data,
+    const uint8_t* end) {
+  const __m256i kZero = _mm256_setzero_si256();
+  const __m256i kOne = _mm256_set1_epi8(1);
+  while (end - data >= 32 + 2) {
+    const __m256i byte0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i byte1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 1));
+    const __m256i byte2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 2));
+    const __m256i matches = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(byte0, kZero),
+                         _mm256_cmpeq_epi8(byte1, kZero)),
+        _mm256_cmpeq_epi8(byte2, kOne));
+    const uint32_t mask = _mm256_movemask_epi8(matches);
+    if (mask != 0)
+      return data + CountTrailingZeros(mask);
+    data += 32;
+  }
+  return ScanStartCodeSse2(data, end);
+}
+#endif  // defined(NALU_READER_USE_AVX2)
+
+StartCodeScanner GetStartCodeScanner() {
+#if defined(NALU_READER_USE_AVX2)
+  if (__builtin_cpu_supports("avx2"))
+    return &ScanStartCodeAvx2;
+#endif
+#if defined(NALU_READER_USE_SSE2)
+  return &ScanStartCodeSse2;
+#else
+  return &ScanStartCodeScalar;
+#endif
+}
 }  // namespace
 
 Nalu::Nalu()
@@ -247,31 +361,27 @@ bool NaluReader::FindStartCode(const uint8_t* data,
                                uint64_t data_size,
                                uint64_t* offset,
                                uint8_t* start_code_size) {
-  uint64_t bytes_left = data_size;
-
-  while (bytes_left >= 3) {
-    if (IsStartCode(data)) {
-      // Found three-byte start code, set pointer at its beginning.
-      *offset = data_size - bytes_left;
-      *start_code_size = 3;
-
-      // If there is a zero byte before this start code,
-      // then it's actually a four-byte start code, so backtrack one byte.
-      if (*offset > 0 && *(data - 1) == 0x00) {
-        --(*offset);
-        ++(*start_code_size);
-      }
-
-      return true;
+  static const StartCodeScanner scan_start_code = GetStartCodeScanner();
+
+  const uint8_t* start_code = scan_start_code(data, data + data_size);
+  if (start_code) {
+    // Found three-byte start code, set pointer at its beginning.
+    *offset = start_code - data;
+    *start_code_size = 3;
+
+    // If there is a zero byte before this start code,
+    // then it's actually a four-byte start code, so backtrack one byte.
+    if (*offset > 0 && *(start_code - 1) == 0x00) {
+      --(*offset);
+      ++(*start_code_size);
     }
 
-    ++data;
-    --bytes_left;
+    return true;
   }
 
   // End of data: offset is pointing to the first byte that was not considered
   // as a possible start of a start code.
-  *offset = data_size - bytes_left;
+  *offset = data_size >= 3 ? data_size - 2 : 0;
   *start_code_size = 0;
   return false;
 }
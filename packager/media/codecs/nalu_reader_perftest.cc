@@ -0,0 +1,53 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Throughput micro-benchmark for the Annex B start code scan. Run it with:
+//   packager_perftest --gtest_filter=*NaluReaderPerfTest*
+
+#include <gtest/gtest.h>
+
+#include "packager/base/logging.h"
+#include "packager/base/time/time.h"
+#include "packager/media/codecs/nalu_reader.h"
+#include "packager/media/test/test_data_util.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const size_t kNumIterations = 200;
+}  // namespace
+
+// Scans a transport stream for start codes, the way the TS demuxer looks for
+// NAL units in the video PES payload.
+TEST(NaluReaderPerfTest, FindStartCodeInTransportStream) {
+  const std::vector<uint8_t> data = ReadTestDataFile("bear-640x360.ts");
+  ASSERT_FALSE(data.empty());
+
+  size_t num_start_codes = 0;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const uint8_t* remaining = data.data();
+    uint64_t remaining_size = data.size();
+    uint64_t offset;
+    uint8_t start_code_size;
+    while (NaluReader::FindStartCode(remaining, remaining_size, &offset,
+                                     &start_code_size)) {
+      ++num_start_codes;
+      remaining += offset + start_code_size;
+      remaining_size -= offset + start_code_size;
+    }
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  LOG(INFO) << "Found " << num_start_codes / kNumIterations
+            << " start codes per iteration, "
+            << kNumIterations * data.size() / elapsed.InSecondsF() /
+                   (1024 * 1024)
+            << " MB/s";
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -5,12 +5,35 @@
 // https://developers.google.com/open-source/licenses/bsd
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <vector>
 
 #include "packager/media/codecs/nalu_reader.h"
 
 namespace shaka {
 namespace media {
 
+namespace {
+// Byte by byte reference implementation of NaluReader::FindStartCode.
+bool FindStartCodeReference(const uint8_t* data,
+                            uint64_t data_size,
+                            uint64_t* offset,
+                            uint8_t* start_code_size) {
+  for (uint64_t i = 0; i + 3 <= data_size; ++i) {
+    if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01) {
+      const bool four_bytes = i > 0 && data[i - 1] == 0x00;
+      *offset = four_bytes ? i - 1 : i;
+      *start_code_size = four_bytes ? 4 : 3;
+      return true;
+    }
+  }
+  *offset = data_size >= 3 ? data_size - 2 : 0;
+  *start_code_size = 0;
+  return false;
+}
+}  // namespace
+
 TEST(NaluReaderTest, StartCodeSearch) {
   const uint8_t kNaluData[] = {
       0x01, 0x00, 0x00, 0x04, 0x23, 0x56,
@@ -75,6 +98,43 @@ TEST(NaluReaderTest, StartCodeSearchWithStartCodeInsideNalUnit) {
   EXPECT_EQ(NaluReader::kEOStream, reader.Advance(&nalu));
 }
 
+// FindStartCode scans several bytes at a time when it can. Compare it against
+// the reference on all buffer sizes and alignments around the vector widths.
+TEST(NaluReaderTest, FindStartCodeMatchesReference) {
+  const size_t kMaxDataSize = 100;
+  const size_t kMaxAlignment = 32;
+  const int kNumIterations = 20;
+  std::vector<uint8_t> buffer(kMaxDataSize + kMaxAlignment);
+
+  srand(0);
+  for (int iteration = 0; iteration < kNumIterations; ++iteration) {
+    for (size_t alignment = 0; alignment < kMaxAlignment; ++alignment) {
+      for (size_t data_size = 0; data_size <= kMaxDataSize; ++data_size) {
+        // Mostly zeros and ones so that start codes and near misses show up
+        // at all positions.
+        uint8_t* data = &buffer[alignment];
+        for (size_t i = 0; i < data_size; ++i) {
+          const int r = rand() % 16;
+          data[i] = r < 8 ? 0x00 : (r < 10 ? 0x01 : static_cast<uint8_t>(r));
+        }
+
+        uint64_t expected_offset;
+        uint8_t expected_start_code_size;
+        const bool expected_found =
+            FindStartCodeReference(data, data_size, &expected_offset,
+                                   &expected_start_code_size);
+        uint64_t offset;
+        uint8_t start_code_size;
+        ASSERT_EQ(expected_found, NaluReader::FindStartCode(
+                                      data, data_size, &offset,
+                                      &start_code_size));
+        ASSERT_EQ(expected_offset, offset);
+        ASSERT_EQ(expected_start_code_size, start_code_size);
+      }
+    }
+  }
+}
+
 TEST(NaluReaderTest, OneByteNaluLength) {
   const uint8_t kNaluData[] = {
       // First NALU
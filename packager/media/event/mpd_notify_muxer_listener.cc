@@ -154,7 +154,7 @@ void MpdNotifyMuxerListener::OnNewSegment(const std::string& file_name,
     // TODO(kqyang): Check return result.
     mpd_notifier_->NotifyNewSegment(
         notification_id_, start_time, duration, segment_file_size);
-    mpd_notifier_->Flush();
+    mpd_notifier_->RequestFlush();
   } else {
     SubsegmentInfo subsegment = {start_time, duration, segment_file_size};
     subsegments_.push_back(subsegment);
@@ -9,14 +9,33 @@
 #include <algorithm>
 
 #include <gflags/gflags.h>
+#include "packager/base/files/file_util.h"
 #include "packager/base/logging.h"
 #include "packager/base/memory/scoped_ptr.h"
+#include "packager/build/build_config.h"
 #include "packager/media/file/local_file.h"
+#include "packager/media/file/mapped_file.h"
 #include "packager/media/file/memory_file.h"
+#include "packager/media/file/output_writer_pool.h"
+#include "packager/media/file/segment_store.h"
+#include "packager/media/file/segment_store_file.h"
 #include "packager/media/file/threaded_io_file.h"
 #include "packager/media/file/udp_file.h"
+#if defined(OS_LINUX)
+#include "packager/media/file/uring_file.h"
+#endif
 #include "packager/base/strings/string_util.h"
 
+#if defined(OS_LINUX)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+#if defined(OS_POSIX)
+#include <sys/stat.h>
+#endif
+
 DEFINE_uint64(io_cache_size,
               32ULL << 20,
               "Size of the threaded I/O cache, in bytes. Specify 0 to disable "
@@ -24,6 +43,21 @@ DEFINE_uint64(io_cache_size,
 DEFINE_uint64(io_block_size,
               2ULL << 20,
               "Size of the block size used for threaded I/O, in bytes.");
+DEFINE_uint64(io_writer_threads,
+              0,
+              "Number of threads writing output files. The threads and the "
+              "--io_cache_size bytes of buffers are shared by all the output "
+              "files, so opening and closing segments is cheap. 0 (default) "
+              "uses a threaded I/O cache per output file instead.");
+DEFINE_bool(io_uring,
+            false,
+            "Access local files through io_uring instead of threaded I/O, "
+            "where supported (Linux). Local files can also be accessed "
+            "through io_uring individually with the uring:// prefix.");
+DEFINE_uint64(io_uring_queue_depth,
+              4,
+              "Number of io_uring reads or writes of --io_block_size bytes "
+              "kept in flight per file.");
 
 namespace shaka {
 namespace media {
@@ -31,6 +65,9 @@ namespace media {
 const char* kLocalFilePrefix = "file://";
 const char* kUdpFilePrefix = "udp://";
 const char* kMemoryFilePrefix = "memory://";
+const char* kMmapFilePrefix = "mmap://";
+const char* kUringFilePrefix = "uring://";
+const char* kSegmentStoreFilePrefix = "store://";
 
 namespace {
 
@@ -45,6 +82,24 @@ struct SupportedTypeInfo {
 };
 
 File* CreateLocalFile(const char* file_name, const char* mode) {
+#if defined(OS_LINUX)
+  if (FLAGS_io_uring && UringFile::IsSupported(mode)) {
+    return new UringFile(file_name, mode, FLAGS_io_uring_queue_depth,
+                         FLAGS_io_block_size);
+  }
+#endif
+  return new LocalFile(file_name, mode);
+}
+
+File* CreateUringFile(const char* file_name, const char* mode) {
+#if defined(OS_LINUX)
+  if (UringFile::IsSupported(mode)) {
+    return new UringFile(file_name, mode, FLAGS_io_uring_queue_depth,
+                         FLAGS_io_block_size);
+  }
+#endif
+  LOG(WARNING) << "io_uring is not supported for mode '" << mode
+               << "'. Falling back to LocalFile.";
   return new LocalFile(file_name, mode);
 }
 
@@ -69,6 +124,22 @@ bool DeleteMemoryFile(const char* file_name) {
   return true;
 }
 
+File* CreateSegmentStoreFile(const char* file_name, const char* mode) {
+  return new SegmentStoreFile(file_name, mode);
+}
+
+bool DeleteSegmentStoreFile(const char* file_name) {
+  return SegmentStore::GetInstance()->Delete(file_name);
+}
+
+File* CreateMappedFile(const char* file_name, const char* mode) {
+  if (base::strcasecmp(mode, "r")) {
+    NOTIMPLEMENTED() << "MappedFile only supports read mode.";
+    return NULL;
+  }
+  return new MappedFile(file_name);
+}
+
 static const SupportedTypeInfo kSupportedTypeInfo[] = {
   {
     kLocalFilePrefix,
@@ -88,8 +159,124 @@ static const SupportedTypeInfo kSupportedTypeInfo[] = {
     &CreateMemoryFile,
     &DeleteMemoryFile
   },
+  {
+    kUringFilePrefix,
+    strlen(kUringFilePrefix),
+    &CreateUringFile,
+    &DeleteLocalFile
+  },
+  {
+    kMmapFilePrefix,
+    strlen(kMmapFilePrefix),
+    &CreateMappedFile,
+    &DeleteLocalFile
+  },
+  {
+    kSegmentStoreFilePrefix,
+    strlen(kSegmentStoreFilePrefix),
+    &CreateSegmentStoreFile,
+    &DeleteSegmentStoreFile
+  },
 };
 
+bool HasPrefix(const char* file_name, const char* prefix) {
+  return strncmp(file_name, prefix, strlen(prefix)) == 0;
+}
+
+// Returns true if |file_name| opened with |mode| is accessed through io_uring,
+// which does its own asynchronous I/O.
+bool IsUringFile(const char* file_name, const char* mode) {
+#if defined(OS_LINUX)
+  if (!UringFile::IsSupported(mode))
+    return false;
+  if (HasPrefix(file_name, kUringFilePrefix))
+    return true;
+  if (!FLAGS_io_uring)
+    return false;
+  if (HasPrefix(file_name, kLocalFilePrefix))
+    return true;
+  // Names without a known prefix are local files.
+  for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
+    if (HasPrefix(file_name, kSupportedTypeInfo[i].type))
+      return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Returns |file_name| without its prefix, as internal files are named.
+const char* GetInternalFileName(const char* file_name) {
+  for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
+    if (HasPrefix(file_name, kSupportedTypeInfo[i].type))
+      return file_name + kSupportedTypeInfo[i].type_length;
+  }
+  return file_name;
+}
+
+// Returns the path of |file_name| if it is a local file, or NULL otherwise.
+const char* GetLocalFilePath(const char* file_name) {
+  if (HasPrefix(file_name, kLocalFilePrefix))
+    return file_name + strlen(kLocalFilePrefix);
+  for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
+    if (HasPrefix(file_name, kSupportedTypeInfo[i].type))
+      return NULL;
+  }
+  return file_name;
+}
+
+// Returns the path of the local file behind |file_name|, whichever prefix is
+// used to access it, or NULL if it is not a local file.
+const char* GetUnderlyingLocalFilePath(const char* file_name) {
+  if (HasPrefix(file_name, kMmapFilePrefix))
+    return file_name + strlen(kMmapFilePrefix);
+  if (HasPrefix(file_name, kUringFilePrefix))
+    return file_name + strlen(kUringFilePrefix);
+  return GetLocalFilePath(file_name);
+}
+
+// Returns true if |file_name1| and |file_name2| are the same existing local
+// file, possibly spelled differently, e.g. "file://x", "./x" or a link to x.
+bool IsSameLocalFile(const char* file_name1, const char* file_name2) {
+  const char* path1 = GetUnderlyingLocalFilePath(file_name1);
+  const char* path2 = GetUnderlyingLocalFilePath(file_name2);
+  if (!path1 || !path2)
+    return false;
+#if defined(OS_POSIX)
+  struct stat stat1;
+  struct stat stat2;
+  return stat(path1, &stat1) == 0 && stat(path2, &stat2) == 0 &&
+         stat1.st_dev == stat2.st_dev && stat1.st_ino == stat2.st_ino;
+#else
+  const base::FilePath absolute_path1 =
+      base::MakeAbsoluteFilePath(base::FilePath(path1));
+  return !absolute_path1.empty() &&
+         absolute_path1 == base::MakeAbsoluteFilePath(base::FilePath(path2));
+#endif
+}
+
+// Makes |to_path| a copy-on-write clone of |from_path|, on file systems which
+// support it, e.g. Btrfs and XFS. The data is not copied.
+// Returns false if the file cannot be cloned.
+bool CloneLocalFile(const char* from_path, const char* to_path) {
+#if defined(OS_LINUX) && defined(FICLONE)
+  const int source = open(from_path, O_RDONLY | O_CLOEXEC);
+  if (source < 0)
+    return false;
+  const int destination =
+      open(to_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  const bool cloned =
+      destination >= 0 && ioctl(destination, FICLONE, source) == 0;
+  if (destination >= 0)
+    close(destination);
+  close(source);
+  return cloned;
+#else
+  return false;
+#endif
+}
+
 }  // namespace
 
 File* File::Create(const char* file_name, const char* mode) {
@@ -101,6 +288,27 @@ File* File::Create(const char* file_name, const char* mode) {
     return internal_file.release();
   }
 
+  if (!strncmp(file_name, kSegmentStoreFilePrefix,
+               strlen(kSegmentStoreFilePrefix))) {
+    // The segment store is in memory already.
+    return internal_file.release();
+  }
+
+  if (!strncmp(file_name, kMmapFilePrefix, strlen(kMmapFilePrefix))) {
+    // Mapped files are read in by the kernel, on access.
+    return internal_file.release();
+  }
+
+  if (!strncmp(file_name, kUdpFilePrefix, strlen(kUdpFilePrefix))) {
+    // UDP files receive on their own thread.
+    return internal_file.release();
+  }
+
+  if (IsUringFile(file_name, mode)) {
+    // io_uring keeps I/O in flight without a thread.
+    return internal_file.release();
+  }
+
   if (FLAGS_io_cache_size) {
     // Enable threaded I/O for "r", "w", and "a" modes only.
     if (!strcmp(mode, "r")) {
@@ -109,6 +317,10 @@ File* File::Create(const char* file_name, const char* mode) {
                                 FLAGS_io_cache_size,
                                 FLAGS_io_block_size);
     } else if (!strcmp(mode, "w") || !strcmp(mode, "a")) {
+      if (FLAGS_io_writer_threads) {
+        return new PooledOutputFile(internal_file.Pass(),
+                                    OutputWriterPool::GetInstance());
+      }
       return new ThreadedIoFile(internal_file.Pass(),
                                 ThreadedIoFile::kOutputMode,
                                 FLAGS_io_cache_size,
@@ -122,6 +334,10 @@ File* File::Create(const char* file_name, const char* mode) {
 }
 
 File* File::CreateInternalFile(const char* file_name, const char* mode) {
+  // A file written again must not be overwritten by the pending writes of its
+  // previous contents.
+  if (!strcmp(mode, "w") || !strcmp(mode, "a"))
+    WaitForPendingWritesToFile(file_name);
   scoped_ptr<File, FileCloser> internal_file;
   for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
     const SupportedTypeInfo& type_info = kSupportedTypeInfo[i];
@@ -159,6 +375,19 @@ File* File::OpenWithNoBuffering(const char* file_name, const char* mode) {
   return file;
 }
 
+int64_t File::WriteV(const IoBuffer* buffers, size_t count) {
+  int64_t bytes_written = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const int64_t result = Write(buffers[i].data, buffers[i].length);
+    if (result < 0)
+      return result;
+    bytes_written += result;
+    if (static_cast<uint64_t>(result) < buffers[i].length)
+      break;
+  }
+  return bytes_written;
+}
+
 bool File::Delete(const char* file_name) {
   for (size_t i = 0; i < arraysize(kSupportedTypeInfo); ++i) {
     const SupportedTypeInfo& type_info = kSupportedTypeInfo[i];
@@ -172,6 +401,26 @@ bool File::Delete(const char* file_name) {
   return DeleteLocalFile(file_name);
 }
 
+bool File::WaitForPendingWrites() {
+  if (!FLAGS_io_writer_threads)
+    return true;
+  return OutputWriterPool::GetInstance()->WaitForAll();
+}
+
+bool File::WaitForPendingWritesToFile(const char* file_name) {
+  if (!FLAGS_io_writer_threads)
+    return true;
+  return OutputWriterPool::GetInstance()->WaitForFile(
+      GetInternalFileName(file_name));
+}
+
+bool File::HasPendingWritesToFile(const char* file_name) {
+  if (!FLAGS_io_writer_threads)
+    return false;
+  return OutputWriterPool::GetInstance()->HasPendingWrites(
+      GetInternalFileName(file_name));
+}
+
 int64_t File::GetFileSize(const char* file_name) {
   File* file = File::Open(file_name, "r");
   if (!file)
@@ -200,30 +449,41 @@ bool File::ReadFileToString(const char* file_name, std::string* contents) {
 }
 
 bool File::Copy(const char* from_file_name, const char* to_file_name) {
-  std::string content;
-  if (!ReadFileToString(from_file_name, &content)) {
+  // Opening the destination for writing would truncate the source. This is
+  // checked before anything is opened.
+  if (!strcmp(from_file_name, to_file_name) ||
+      IsSameLocalFile(from_file_name, to_file_name)) {
+    return true;
+  }
+
+  // Opening a file for read does not wait for its pending writes.
+  WaitForPendingWritesToFile(from_file_name);
+  const char* from_path = GetLocalFilePath(from_file_name);
+  const char* to_path = GetLocalFilePath(to_file_name);
+  if (from_path && to_path) {
+    WaitForPendingWritesToFile(to_file_name);
+    if (CloneLocalFile(from_path, to_path))
+      return true;
+  }
+
+  scoped_ptr<File, FileCloser> input_file(File::Open(from_file_name, "r"));
+  if (!input_file) {
     LOG(ERROR) << "Failed to open file " << from_file_name;
     return false;
   }
 
-  scoped_ptr<File, FileCloser> output_file(File::Open(to_file_name, "w"));
+  File* output_file = File::Open(to_file_name, "w");
   if (!output_file) {
     LOG(ERROR) << "Failed to write to " << to_file_name;
     return false;
   }
 
-  uint64_t bytes_left = content.size();
-  uint64_t total_bytes_written = 0;
-  const char* content_cstr = content.c_str();
-  while (bytes_left > total_bytes_written) {
-    const int64_t bytes_written =
-        output_file->Write(content_cstr + total_bytes_written, bytes_left);
-    if (bytes_written < 0) {
-      LOG(ERROR) << "Failure while writing to " << to_file_name;
-      return false;
-    }
-
-    total_bytes_written += bytes_written;
+  const int64_t bytes_copied = CopyFile(input_file.get(), output_file);
+  const bool closed = output_file->Close();
+  if (bytes_copied < 0 || !closed) {
+    LOG(ERROR) << "Failed to copy " << from_file_name << " to "
+               << to_file_name;
+    return false;
   }
   return true;
 }
@@ -16,23 +16,40 @@
         'file.cc',
         'file.h',
         'file_closer.h',
-        'io_cache.cc',
-        'io_cache.h',
+        'io_block_ring.cc',
+        'io_block_ring.h',
         'local_file.cc',
         'local_file.h',
+        'mapped_file.cc',
+        'mapped_file.h',
         'memory_file.cc',
         'memory_file.h',
+        'output_writer_pool.cc',
+        'output_writer_pool.h',
+        'segment_store.cc',
+        'segment_store.h',
+        'segment_store_file.cc',
+        'segment_store_file.h',
+        'segment_store_http_server.h',
         'threaded_io_file.cc',
         'threaded_io_file.h',
         'udp_file.h',
+        'uring_file.h',
       ],
       'conditions': [
+        ['OS == "linux"', {
+          'sources': [
+            'uring_file_linux.cc',
+          ],
+        }],
         ['OS == "win"', {
           'sources': [
+            'segment_store_http_server_win.cc',
             'udp_file_win.cc',
           ],
         }, {
           'sources': [
+            'segment_store_http_server_posix.cc',
             'udp_file_posix.cc',
           ],
         }],
@@ -48,8 +65,18 @@
       'type': '<(gtest_target_type)',
       'sources': [
         'file_unittest.cc',
-        'io_cache_unittest.cc',
+        'io_block_ring_unittest.cc',
         'memory_file_unittest.cc',
+        'output_writer_pool_unittest.cc',
+        'segment_store_unittest.cc',
+      ],
+      'conditions': [
+        ['OS != "win"', {
+          'sources': [
+            'segment_store_http_server_unittest.cc',
+            'udp_file_unittest.cc',
+          ],
+        }],
       ],
       'dependencies': [
         '../../testing/gtest.gyp:gtest',
@@ -18,11 +18,21 @@ namespace media {
 
 extern const char* kLocalFilePrefix;
 extern const char* kMemoryFilePrefix;
+extern const char* kMmapFilePrefix;
+extern const char* kUringFilePrefix;
+extern const char* kSegmentStoreFilePrefix;
+extern const char* kUdpFilePrefix;
 const int64_t kWholeFile = -1;
 
 /// Define an abstract file interface.
 class File {
  public:
+  /// A block of memory to be written by WriteV().
+  struct IoBuffer {
+    const void* data;
+    uint64_t length;
+  };
+
   /// Open the specified file.
   /// This is a file factory method, it opens a proper file automatically
   /// based on prefix, e.g. "file://" for LocalFile.
@@ -51,6 +61,13 @@ class File {
   ///         INDICATE DATA LOSS.
   virtual bool Close() = 0;
 
+  /// Same as Close(), but may return before the data written is stored.
+  /// Use it where nothing reads the file back right away, e.g. for media
+  /// segments. Errors found after this returns are reported by
+  /// WaitForPendingWritesToFile() and WaitForPendingWrites().
+  /// @return true on success, false if an error is already known.
+  virtual bool CloseInBackground() { return Close(); }
+
   /// Read data and return it in buffer.
   /// @param[out] buffer points to a block of memory with a size of at least
   ///             @a length bytes.
@@ -65,6 +82,14 @@ class File {
   /// @return Number of bytes written, or a value < 0 on error.
   virtual int64_t Write(const void* buffer, uint64_t length) = 0;
 
+  /// Write blocks of data in order, without gathering them into a single
+  /// buffer first. The default implementation calls Write() for each block.
+  /// @param buffers points to an array of @a count blocks.
+  /// @param count indicates the number of blocks to write.
+  /// @return Number of bytes written, or a value < 0 on error. Fewer bytes
+  ///         than in all the blocks may be written.
+  virtual int64_t WriteV(const IoBuffer* buffers, size_t count);
+
   /// @return Size of the file in bytes. A return value less than zero
   ///         indicates a problem getting the size.
   virtual int64_t Size() = 0;
@@ -87,6 +112,11 @@ class File {
   /// @return true on succcess, false otherwise.
   virtual bool Tell(uint64_t* position) = 0;
 
+  /// Hint that the file is read sequentially from now on, so that the system
+  /// can read ahead further. Only implemented by LocalFile on Linux; a no-op
+  /// otherwise.
+  virtual void AdviseSequentialRead() {}
+
   /// @return The file name.
   const std::string& file_name() const { return file_name_; }
 
@@ -104,9 +134,11 @@ class File {
   /// @return true on success, false otherwise.
   static bool ReadFileToString(const char* file_name, std::string* contents);
 
-  /// Copies files. This is not good for copying huge files. Although not
-  /// recommended, it is safe to have source file and destination file name be
-  /// the same.
+  /// Copies files. The content is streamed through a bounded buffer; local
+  /// files are cloned instead where the file system supports it (Linux
+  /// FICLONE). Although not recommended, it is safe to have source file and
+  /// destination file name be the same, or name the same local file, e.g.
+  /// "file://x" and "x".
   /// @param from_file_name is the source file name.
   /// @param to_file_name is the destination file name.
   /// @return true on success, false otherwise.
@@ -125,6 +157,26 @@ class File {
   /// @return Number of bytes written, or a value < 0 on error.
   static int64_t CopyFile(File* source, File* destination, int64_t max_copy);
 
+  /// Wait until the output files closed so far are completely written. Output
+  /// files may be written in the background after CloseInBackground(), see
+  /// --io_writer_threads. Opening a file for write or append waits for its
+  /// own pending writes already. This waits for the files of every writer in the
+  /// process; writers should wait for their own files with
+  /// WaitForPendingWritesToFile() instead.
+  /// @return false if writing an output file failed, and the file was not
+  ///         opened again since.
+  static bool WaitForPendingWrites();
+
+  /// Wait until the output files named @a file_name, closed so far, are
+  /// completely written.
+  /// @return false if writing the file failed, and it was not opened again
+  ///         since.
+  static bool WaitForPendingWritesToFile(const char* file_name);
+
+  /// @return true if the output files named @a file_name, closed so far, are
+  ///         not completely written yet. Does not block.
+  static bool HasPendingWritesToFile(const char* file_name);
+
  protected:
   explicit File(const std::string& file_name) : file_name_(file_name) {}
   /// Do *not* call the destructor directly (with the "delete" keyword)
@@ -135,6 +187,7 @@ class File {
   virtual bool Open() = 0;
 
  private:
+  friend class PooledOutputFile;
   friend class ThreadedIoFile;
 
   // This is a file factory method, it creates a proper file, e.g.
@@ -7,11 +7,17 @@
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
+#include <string.h>
+
+#include <algorithm>
+
 #include "packager/base/files/file_util.h"
 #include "packager/media/file/file.h"
+#include "packager/media/file/mapped_file.h"
 
 DECLARE_uint64(io_cache_size);
 DECLARE_uint64(io_block_size);
+DECLARE_uint64(io_writer_threads);
 
 namespace {
 const int kDataSize = 1024;
@@ -88,6 +94,53 @@ TEST_F(LocalFileTest, Copy) {
   base::DeleteFile(temp_dir, true);
 }
 
+TEST_F(LocalFileTest, CopyToMemoryFile) {
+  // Larger than the copy buffer, so that it is copied in multiple reads.
+  const size_t kLargeDataSize = 0x100000 + 7;
+  std::string large_data(kLargeDataSize, 0);
+  for (size_t i = 0; i < kLargeDataSize; ++i)
+    large_data[i] = static_cast<char>(i * 31);
+  ASSERT_EQ(static_cast<int>(kLargeDataSize),
+            base::WriteFile(test_file_path_, large_data.data(),
+                            kLargeDataSize));
+
+  const std::string destination = std::string(kMemoryFilePrefix) + "copy";
+  ASSERT_TRUE(File::Copy(local_file_name_.c_str(), destination.c_str()));
+
+  std::string copied_data;
+  ASSERT_TRUE(File::ReadFileToString(destination.c_str(), &copied_data));
+  EXPECT_EQ(large_data, copied_data);
+  EXPECT_TRUE(File::Delete(destination.c_str()));
+}
+
+TEST_F(LocalFileTest, CopyToSameFile) {
+  ASSERT_EQ(kDataSize,
+            base::WriteFile(test_file_path_, data_.data(), kDataSize));
+  ASSERT_TRUE(File::Copy(local_file_name_.c_str(), local_file_name_.c_str()));
+
+  std::string copied_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &copied_data));
+  EXPECT_EQ(data_, copied_data);
+}
+
+TEST_F(LocalFileTest, CopyToSameFileWithAnotherName) {
+  ASSERT_EQ(kDataSize,
+            base::WriteFile(test_file_path_, data_.data(), kDataSize));
+  // The same file with and without the prefix, and through a "." component.
+  const std::string other_name = test_file_path_.DirName()
+                                     .Append(FILE_PATH_LITERAL("."))
+                                     .Append(test_file_path_.BaseName())
+                                     .value();
+  ASSERT_TRUE(File::Copy(local_file_name_.c_str(),
+                         local_file_name_no_prefix_.c_str()));
+  ASSERT_TRUE(File::Copy(local_file_name_no_prefix_.c_str(),
+                         other_name.c_str()));
+
+  std::string copied_data;
+  ASSERT_TRUE(base::ReadFileToString(test_file_path_, &copied_data));
+  EXPECT_EQ(data_, copied_data);
+}
+
 TEST_F(LocalFileTest, Write) {
   // Write file using File API.
   File* file = File::Open(local_file_name_.c_str(), "w");
@@ -173,6 +226,78 @@ TEST_F(LocalFileTest, WriteFlushCheckSize) {
   }
 }
 
+// io_uring files fall back to LocalFile where io_uring is not supported, so
+// these tests pass either way.
+TEST_F(LocalFileTest, UringWriteRead) {
+  google::FlagSaver flag_saver;
+  // Several blocks per file, and several reads or writes per block.
+  FLAGS_io_block_size = kDataSize / 10;
+  const std::string uring_file_name =
+      kUringFilePrefix + local_file_name_no_prefix_;
+
+  File* file = File::Open(uring_file_name.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  for (int i = 0; i < kDataSize; i += 7) {
+    const int size = std::min(7, kDataSize - i);
+    EXPECT_EQ(size, file->Write(&data_[i], size));
+  }
+  EXPECT_EQ(kDataSize, file->Size());
+  EXPECT_TRUE(file->Close());
+
+  file = File::Open(uring_file_name.c_str(), "a");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(kDataSize, file->Write(&data_[0], kDataSize));
+  EXPECT_TRUE(file->Close());
+
+  file = File::Open(uring_file_name.c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  std::string read_data(kDataSize * 2, 0);
+  EXPECT_EQ(kDataSize * 2, file->Read(&read_data[0], kDataSize * 2));
+  uint8_t single_byte;
+  EXPECT_EQ(0, file->Read(&single_byte, sizeof(single_byte)));
+  EXPECT_EQ(data_ + data_, read_data);
+
+  // Seek back into the file.
+  ASSERT_TRUE(file->Seek(kDataSize + 10));
+  EXPECT_EQ(1, file->Read(&single_byte, sizeof(single_byte)));
+  EXPECT_EQ(static_cast<uint8_t>(data_[10]), single_byte);
+  uint64_t position;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(kDataSize + 11u, position);
+  EXPECT_TRUE(file->Close());
+}
+
+TEST_F(LocalFileTest, MappedRead) {
+  ASSERT_EQ(kDataSize,
+            base::WriteFile(test_file_path_, data_.data(), kDataSize));
+  const std::string mapped_file_name =
+      kMmapFilePrefix + local_file_name_no_prefix_;
+
+  EXPECT_TRUE(File::Open(mapped_file_name.c_str(), "w") == NULL);
+
+  File* file = File::Open(mapped_file_name.c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(kDataSize, file->Size());
+  std::string read_data(kDataSize, 0);
+  EXPECT_EQ(kDataSize, file->Read(&read_data[0], kDataSize));
+  uint8_t single_byte;
+  EXPECT_EQ(0, file->Read(&single_byte, sizeof(single_byte)));
+  EXPECT_EQ(data_, read_data);
+
+  ASSERT_TRUE(file->Seek(10));
+  EXPECT_EQ(1, file->Read(&single_byte, sizeof(single_byte)));
+  EXPECT_EQ(static_cast<uint8_t>(data_[10]), single_byte);
+  EXPECT_TRUE(file->Close());
+
+  scoped_refptr<base::RefCountedMemory> mapping =
+      MappedFile::Map(local_file_name_.c_str());
+  ASSERT_TRUE(mapping);
+  ASSERT_EQ(static_cast<size_t>(kDataSize), mapping->size());
+  EXPECT_EQ(0, memcmp(data_.data(), mapping->front(), kDataSize));
+
+  EXPECT_FALSE(MappedFile::Map("udp://127.0.0.1:8000"));
+}
+
 class ParamLocalFileTest : public LocalFileTest,
                            public ::testing::WithParamInterface<uint8_t> {
 };
@@ -185,6 +310,8 @@ TEST_P(ParamLocalFileTest, SeekWriteAndSeekRead) {
   google::FlagSaver flag_saver;
   FLAGS_io_block_size = kBlockSize;
   FLAGS_io_cache_size = GetParam();
+  // Use a threaded I/O cache for the output file too.
+  FLAGS_io_writer_threads = 0;
 
   std::vector<uint8_t> buffer(kInitialWriteSize);
   File* file = File::Open(local_file_name_no_prefix_.c_str(), "w");
@@ -0,0 +1,257 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/io_block_ring.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+
+namespace shaka {
+namespace media {
+
+using base::subtle::Acquire_Load;
+using base::subtle::MemoryBarrier;
+using base::subtle::NoBarrier_Load;
+using base::subtle::NoBarrier_Store;
+using base::subtle::Release_Store;
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t power_of_two = 1;
+  while (power_of_two < value)
+    power_of_two <<= 1;
+  return power_of_two;
+}
+
+}  // namespace
+
+// The waiting side publishes its waiting flag and then checks the ring, while
+// the other side updates the ring and then checks the flag. The full memory
+// barriers on both sides guarantee that at least one of them sees the update
+// of the other, so a wakeup is never lost. The waiting side holds |lock_|
+// from its check until it waits, and the notifying side signals with |lock_|
+// held.
+
+IoBlockRing::IoBlockRing(size_t num_blocks, size_t block_size)
+    : num_blocks_(RoundUpToPowerOfTwo(num_blocks)),
+      index_mask_(static_cast<uint32_t>(num_blocks_ - 1)),
+      block_size_(block_size),
+      storage_(num_blocks_ * block_size),
+      block_data_sizes_(num_blocks_),
+      write_index_(0),
+      read_index_(0),
+      read_offset_(0),
+      closed_(0),
+      block_freed_(&lock_),
+      block_committed_(&lock_),
+      producer_waiting_(0),
+      consumer_waiting_(0) {
+  DCHECK_GE(num_blocks, 2u);
+  DCHECK_GT(block_size, 0u);
+  DCHECK_LT(num_blocks, 1u << 30);
+}
+
+IoBlockRing::~IoBlockRing() {
+  Close();
+}
+
+uint8_t* IoBlockRing::AcquireFreeBlock() {
+  if (NumFilledBlocks() == num_blocks_)
+    WaitForFreeBlock();
+  if (Acquire_Load(&closed_))
+    return NULL;
+  return GetBlock(NoBarrier_Load(&write_index_));
+}
+
+void IoBlockRing::CommitBlock(size_t size) {
+  DCHECK_GT(size, 0u);
+  DCHECK_LE(size, block_size_);
+  const uint32_t write_index = NoBarrier_Load(&write_index_);
+  block_data_sizes_[write_index & index_mask_] = size;
+  Release_Store(&write_index_, write_index + 1);
+  NotifyConsumer();
+}
+
+size_t IoBlockRing::AcquireFreeBlocks(size_t max_blocks,
+                                      std::vector<uint8_t*>* blocks) {
+  DCHECK(blocks);
+  blocks->clear();
+  if (NumFilledBlocks() == num_blocks_)
+    WaitForFreeBlock();
+  if (Acquire_Load(&closed_))
+    return 0;
+  const uint32_t write_index = NoBarrier_Load(&write_index_);
+  const size_t num_free_blocks =
+      std::min<size_t>(max_blocks, num_blocks_ - NumFilledBlocks());
+  for (size_t i = 0; i < num_free_blocks; ++i)
+    blocks->push_back(GetBlock(write_index + i));
+  return num_free_blocks;
+}
+
+void IoBlockRing::CommitBlocks(const size_t* sizes, size_t num_blocks) {
+  DCHECK(sizes);
+  DCHECK_LE(num_blocks, num_blocks_ - NumFilledBlocks());
+  if (num_blocks == 0)
+    return;
+  const uint32_t write_index = NoBarrier_Load(&write_index_);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    DCHECK_LE(sizes[i], block_size_);
+    block_data_sizes_[(write_index + i) & index_mask_] = sizes[i];
+  }
+  Release_Store(&write_index_, write_index + num_blocks);
+  NotifyConsumer();
+}
+
+size_t IoBlockRing::Write(const void* buffer, size_t size) {
+  DCHECK(buffer);
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  size_t bytes_left = size;
+  while (bytes_left > 0) {
+    uint8_t* block = AcquireFreeBlock();
+    if (!block)
+      return 0;
+    const size_t block_size = std::min(bytes_left, block_size_);
+    memcpy(block, data, block_size);
+    CommitBlock(block_size);
+    data += block_size;
+    bytes_left -= block_size;
+  }
+  return size;
+}
+
+void IoBlockRing::WaitUntilEmptyOrClosed() {
+  base::AutoLock auto_lock(lock_);
+  NoBarrier_Store(&producer_waiting_, 1);
+  MemoryBarrier();
+  while (NumFilledBlocks() > 0 && !Acquire_Load(&closed_))
+    block_freed_.Wait();
+  NoBarrier_Store(&producer_waiting_, 0);
+}
+
+const uint8_t* IoBlockRing::PeekFilledBlock(size_t* size) {
+  DCHECK(size);
+  if (NumFilledBlocks() == 0) {
+    WaitForFilledBlock();
+    if (NumFilledBlocks() == 0)
+      return NULL;
+  }
+  const uint32_t read_index = NoBarrier_Load(&read_index_);
+  *size = block_data_sizes_[read_index & index_mask_] - read_offset_;
+  return GetBlock(read_index) + read_offset_;
+}
+
+void IoBlockRing::Consume(size_t size) {
+  const uint32_t read_index = NoBarrier_Load(&read_index_);
+  read_offset_ += size;
+  DCHECK_LE(read_offset_, block_data_sizes_[read_index & index_mask_]);
+  if (read_offset_ < block_data_sizes_[read_index & index_mask_])
+    return;
+  read_offset_ = 0;
+  // The producer may only reuse the block once we are done reading it.
+  Release_Store(&read_index_, read_index + 1);
+  NotifyProducer();
+}
+
+size_t IoBlockRing::Read(void* buffer, size_t size) {
+  DCHECK(buffer);
+  uint8_t* data = static_cast<uint8_t*>(buffer);
+  size_t bytes_read = 0;
+  // Only wait for the first block; return what is available after that.
+  while (bytes_read < size && (bytes_read == 0 || !IsEmpty())) {
+    size_t block_size = 0;
+    const uint8_t* block = PeekFilledBlock(&block_size);
+    if (!block)
+      break;
+    block_size = std::min(block_size, size - bytes_read);
+    memcpy(data + bytes_read, block, block_size);
+    Consume(block_size);
+    bytes_read += block_size;
+  }
+  return bytes_read;
+}
+
+bool IoBlockRing::IsEmpty() const {
+  return NumFilledBlocks() == 0;
+}
+
+void IoBlockRing::Close() {
+  Release_Store(&closed_, 1);
+  base::AutoLock auto_lock(lock_);
+  block_freed_.Broadcast();
+  block_committed_.Broadcast();
+}
+
+bool IoBlockRing::closed() const {
+  return Acquire_Load(&closed_) != 0;
+}
+
+void IoBlockRing::Reopen() {
+  ReopenAt(0);
+}
+
+void IoBlockRing::ReopenAtIndexForTesting(uint32_t start_index) {
+  ReopenAt(start_index);
+}
+
+void IoBlockRing::ReopenAt(uint32_t start_index) {
+  CHECK(closed());
+  NoBarrier_Store(&write_index_, start_index);
+  NoBarrier_Store(&read_index_, start_index);
+  read_offset_ = 0;
+  Release_Store(&closed_, 0);
+}
+
+uint32_t IoBlockRing::NumFilledBlocks() const {
+  // Unsigned arithmetic handles the wrap around of the counters. The slots
+  // stay consistent across it as |num_blocks_| is a power of two.
+  return static_cast<uint32_t>(Acquire_Load(&write_index_)) -
+         static_cast<uint32_t>(Acquire_Load(&read_index_));
+}
+
+uint8_t* IoBlockRing::GetBlock(uint32_t index) {
+  return &storage_[(index & index_mask_) * block_size_];
+}
+
+void IoBlockRing::WaitForFreeBlock() {
+  base::AutoLock auto_lock(lock_);
+  NoBarrier_Store(&producer_waiting_, 1);
+  MemoryBarrier();
+  while (NumFilledBlocks() == num_blocks_ && !Acquire_Load(&closed_))
+    block_freed_.Wait();
+  NoBarrier_Store(&producer_waiting_, 0);
+}
+
+void IoBlockRing::WaitForFilledBlock() {
+  base::AutoLock auto_lock(lock_);
+  NoBarrier_Store(&consumer_waiting_, 1);
+  MemoryBarrier();
+  while (NumFilledBlocks() == 0 && !Acquire_Load(&closed_))
+    block_committed_.Wait();
+  NoBarrier_Store(&consumer_waiting_, 0);
+}
+
+void IoBlockRing::NotifyProducer() {
+  MemoryBarrier();
+  if (!NoBarrier_Load(&producer_waiting_))
+    return;
+  base::AutoLock auto_lock(lock_);
+  block_freed_.Signal();
+}
+
+void IoBlockRing::NotifyConsumer() {
+  MemoryBarrier();
+  if (!NoBarrier_Load(&consumer_waiting_))
+    return;
+  base::AutoLock auto_lock(lock_);
+  block_committed_.Signal();
+}
+
+}  // namespace media
+}  // namespace shaka
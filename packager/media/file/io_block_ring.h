@@ -0,0 +1,161 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_IO_BLOCK_RING_H_
+#define PACKAGER_FILE_IO_BLOCK_RING_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/macros.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+
+namespace shaka {
+namespace media {
+
+/// Single producer, single consumer ring of fixed-size blocks. The producer
+/// fills blocks in place and the consumer reads them in place, so data is not
+/// copied in and out of the ring. The ring is lock-free while it is neither
+/// empty nor full; a side only takes a lock to wait for the other one.
+class IoBlockRing {
+ public:
+  /// @param num_blocks is the number of blocks in the ring, at least 2. It is
+  ///        rounded up to a power of two.
+  /// @param block_size is the size of each block, in bytes.
+  IoBlockRing(size_t num_blocks, size_t block_size);
+  ~IoBlockRing();
+
+  /// @name Producer methods.
+  /// @{
+
+  /// Get the next free block to fill. This function may block until a block
+  /// is free.
+  /// @return a block of block_size() bytes, or NULL if the ring is closed.
+  uint8_t* AcquireFreeBlock();
+
+  /// Hand the block obtained from AcquireFreeBlock() to the consumer.
+  /// @param size is the number of bytes written into the block. Must be
+  ///        non-zero.
+  void CommitBlock(size_t size);
+
+  /// Get up to @a max_blocks consecutive free blocks to fill. This function
+  /// may block until a block is free, but returns the blocks free at that
+  /// point without waiting for more.
+  /// @param max_blocks is the maximum number of blocks to get.
+  /// @param[out] blocks receives the blocks, of block_size() bytes each.
+  /// @return the number of blocks in @a blocks, or 0 if the ring is closed.
+  size_t AcquireFreeBlocks(size_t max_blocks, std::vector<uint8_t*>* blocks);
+
+  /// Hand the first @a num_blocks blocks obtained from AcquireFreeBlocks() to
+  /// the consumer at once.
+  /// @param sizes contains the number of bytes written into each block.
+  ///        Unlike with CommitBlock(), a size may be zero; the consumer skips
+  ///        empty blocks.
+  /// @param num_blocks is the number of blocks to commit.
+  void CommitBlocks(const size_t* sizes, size_t num_blocks);
+
+  /// Copy @a size bytes into the ring, one block at a time. This function may
+  /// block until there is room in the ring.
+  /// @return @a size, or 0 if the ring was closed.
+  size_t Write(const void* buffer, size_t size);
+
+  /// Waits until all the committed blocks are consumed or the ring is closed.
+  void WaitUntilEmptyOrClosed();
+
+  /// @}
+
+  /// @name Consumer methods.
+  /// @{
+
+  /// Get the unconsumed data of the oldest committed block. This function may
+  /// block until a block is committed.
+  /// @param[out] size receives the number of unconsumed bytes in the block.
+  /// @return the unconsumed data, or NULL if the ring is closed and empty.
+  const uint8_t* PeekFilledBlock(size_t* size);
+
+  /// Consume data from the block returned by PeekFilledBlock(). The block is
+  /// handed back to the producer once all its data is consumed.
+  /// @param size is the number of bytes consumed.
+  void Consume(size_t size);
+
+  /// Copy up to @a size bytes out of the ring. This function may block until
+  /// there is data in the ring.
+  /// @return the number of bytes read, or 0 if the ring is closed and empty.
+  size_t Read(void* buffer, size_t size);
+
+  /// @return true if there is no committed block left to consume.
+  bool IsEmpty() const;
+
+  /// @}
+
+  /// Close the ring. Blocked calls on both sides return. The consumer can
+  /// still consume the committed blocks.
+  void Close();
+
+  /// @return true if the ring is closed, false otherwise.
+  bool closed() const;
+
+  /// Reopen a closed ring. Any data still in the ring is lost. Neither side
+  /// may be using the ring during this call.
+  void Reopen();
+
+  /// Same as Reopen(), with the block counters starting at @a start_index
+  /// instead of 0, to exercise the wrap around of the counters in tests.
+  void ReopenAtIndexForTesting(uint32_t start_index);
+
+  /// @return the number of committed blocks not fully consumed yet.
+  uint32_t NumFilledBlocks() const;
+
+  /// @return the number of blocks in the ring.
+  size_t num_blocks() const { return num_blocks_; }
+
+  /// @return the size of each block, in bytes.
+  size_t block_size() const { return block_size_; }
+
+ private:
+  void ReopenAt(uint32_t start_index);
+  uint8_t* GetBlock(uint32_t index);
+  void WaitForFreeBlock();
+  void WaitForFilledBlock();
+  // Wakes the other side if it is waiting.
+  void NotifyProducer();
+  void NotifyConsumer();
+
+  // A power of two, so that the slots stay consistent when the 32-bit block
+  // counters wrap around.
+  const size_t num_blocks_;
+  const uint32_t index_mask_;
+  const size_t block_size_;
+  std::vector<uint8_t> storage_;
+  // Number of bytes committed in each block.
+  std::vector<size_t> block_data_sizes_;
+
+  // Monotonic block counters. Block |index| lives in slot
+  // |index & index_mask_|. The producer owns |write_index_| and the consumer
+  // owns |read_index_|.
+  base::subtle::Atomic32 write_index_;
+  base::subtle::Atomic32 read_index_;
+  // Bytes already consumed in the block at |read_index_|. Consumer only.
+  size_t read_offset_;
+  base::subtle::Atomic32 closed_;
+
+  // Only used to wait, when the ring is full or empty.
+  base::Lock lock_;
+  base::ConditionVariable block_freed_;
+  base::ConditionVariable block_committed_;
+  base::subtle::Atomic32 producer_waiting_;
+  base::subtle::Atomic32 consumer_waiting_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoBlockRing);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_IO_BLOCK_RING_H_
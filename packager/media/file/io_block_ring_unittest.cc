@@ -0,0 +1,397 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <algorithm>
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/io_block_ring.h"
+
+namespace {
+const uint64_t kBlockSize = 256;
+const uint64_t kNumBlocks = 16;
+const uint64_t kRingSize = kNumBlocks * kBlockSize;
+}
+
+namespace shaka {
+namespace media {
+
+class IoBlockRingTest : public testing::Test {
+ public:
+  void WriteToRing(const std::vector<uint8_t>& test_buffer,
+                   uint64_t num_writes,
+                   int sleep_between_writes,
+                   bool close_when_done) {
+    for (uint64_t write_idx = 0; write_idx < num_writes; ++write_idx) {
+      uint64_t write_result =
+          ring_->Write(test_buffer.data(), test_buffer.size());
+      if (!write_result) {
+        // Ring was closed.
+        ring_closed_ = true;
+        break;
+      }
+      EXPECT_EQ(test_buffer.size(), write_result);
+      if (sleep_between_writes) {
+        base::PlatformThread::Sleep(
+            base::TimeDelta::FromMilliseconds(sleep_between_writes));
+      }
+    }
+    if (close_when_done)
+      ring_->Close();
+  }
+
+  void ReadFromRing(int sleep_between_reads) {
+    std::vector<uint8_t> read_buffer(kBlockSize);
+    while (ring_->Read(read_buffer.data(), read_buffer.size())) {
+      base::PlatformThread::Sleep(
+          base::TimeDelta::FromMilliseconds(sleep_between_reads));
+    }
+  }
+
+ protected:
+  void SetUp() override {
+    for (unsigned int idx = 0; idx < kBlockSize; ++idx)
+      reference_block_[idx] = idx;
+    ring_.reset(new IoBlockRing(kNumBlocks, kBlockSize));
+    ring_closed_ = false;
+  }
+
+  void TearDown() override {
+    WaitForWriterThread();
+  }
+
+  void GenerateTestBuffer(uint64_t size, std::vector<uint8_t>* test_buffer) {
+    test_buffer->resize(size);
+    uint8_t* w_ptr(test_buffer->data());
+    while (size) {
+      uint64_t copy_size(std::min(size, kBlockSize));
+      memcpy(w_ptr, reference_block_, copy_size);
+        w_ptr += copy_size;
+        size -= copy_size;
+    }
+  }
+
+  void WriteToRingThreaded(const std::vector<uint8_t>& test_buffer,
+                           uint64_t num_writes,
+                           int sleep_between_writes,
+                           bool close_when_done) {
+    writer_thread_.reset(new ClosureThread("WriterThread",
+                                           base::Bind(
+                                               &IoBlockRingTest::WriteToRing,
+                                               base::Unretained(this),
+                                               test_buffer,
+                                               num_writes,
+                                               sleep_between_writes,
+                                               close_when_done)));
+    writer_thread_->Start();
+  }
+
+
+  void WaitForWriterThread() {
+    if (writer_thread_) {
+      writer_thread_->Join();
+      writer_thread_.reset();
+    }
+  }
+
+  scoped_ptr<IoBlockRing> ring_;
+  scoped_ptr<ClosureThread> writer_thread_;
+  uint8_t reference_block_[kBlockSize];
+  bool ring_closed_;
+};
+
+TEST_F(IoBlockRingTest, VerySmallWrite) {
+  const uint64_t kTestBytes(5);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kTestBytes, &write_buffer);
+  WriteToRingThreaded(write_buffer, 1, 0, false);
+
+  std::vector<uint8_t> read_buffer(kTestBytes);
+  EXPECT_EQ(kTestBytes, ring_->Read(read_buffer.data(), kTestBytes));
+  EXPECT_EQ(write_buffer, read_buffer);
+}
+
+TEST_F(IoBlockRingTest, LotsOfAlignedBlocks) {
+  const uint64_t kNumWrites(kRingSize * 1000 / kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToRingThreaded(write_buffer, kNumWrites, 0, false);
+  for (uint64_t num_reads = 0; num_reads < kNumWrites; ++num_reads) {
+    std::vector<uint8_t> read_buffer(kBlockSize);
+    EXPECT_EQ(kBlockSize, ring_->Read(read_buffer.data(), kBlockSize));
+    EXPECT_EQ(write_buffer, read_buffer);
+  }
+}
+
+TEST_F(IoBlockRingTest, LotsOfUnalignedBlocks) {
+  const uint64_t kNumWrites(kRingSize * 1000 / kBlockSize);
+  const uint64_t kUnalignBlockSize(55);
+
+  std::vector<uint8_t> write_buffer1;
+  GenerateTestBuffer(kUnalignBlockSize, &write_buffer1);
+  WriteToRingThreaded(write_buffer1, 1, 0, false);
+  WaitForWriterThread();
+  std::vector<uint8_t> write_buffer2;
+  GenerateTestBuffer(kBlockSize, &write_buffer2);
+  WriteToRingThreaded(write_buffer2, kNumWrites, 0, false);
+
+  std::vector<uint8_t> read_buffer1(kUnalignBlockSize);
+  EXPECT_EQ(kUnalignBlockSize,
+            ring_->Read(read_buffer1.data(), kUnalignBlockSize));
+  EXPECT_EQ(write_buffer1, read_buffer1);
+  std::vector<uint8> verify_buffer;
+  for (uint64_t idx = 0; idx < kNumWrites; ++idx)
+    verify_buffer.insert(verify_buffer.end(),
+                         write_buffer2.begin(),
+                         write_buffer2.end());
+  uint64_t verify_index(0);
+  while (verify_index < verify_buffer.size()) {
+    std::vector<uint8_t> read_buffer2(kBlockSize);
+    uint64_t bytes_read = ring_->Read(read_buffer2.data(), kBlockSize);
+    EXPECT_NE(0U, bytes_read);
+    EXPECT_FALSE(
+        memcmp(&verify_buffer[verify_index], read_buffer2.data(), bytes_read));
+    verify_index += bytes_read;
+  }
+}
+
+TEST_F(IoBlockRingTest, SlowWrite) {
+  const int kWriteDelayMs(50);
+  const uint64_t kNumWrites(kRingSize * 5 / kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToRingThreaded(write_buffer, kNumWrites, kWriteDelayMs, false);
+  for (uint64_t num_reads = 0; num_reads < kNumWrites; ++num_reads) {
+    std::vector<uint8_t> read_buffer(kBlockSize);
+    EXPECT_EQ(kBlockSize, ring_->Read(read_buffer.data(), kBlockSize));
+    EXPECT_EQ(write_buffer, read_buffer);
+  }
+}
+
+TEST_F(IoBlockRingTest, SlowRead) {
+  const int kReadDelayMs(50);
+  const uint64_t kNumWrites(kRingSize * 5 / kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToRingThreaded(write_buffer, kNumWrites, 0, false);
+  for (uint64_t num_reads = 0; num_reads < kNumWrites; ++num_reads) {
+    std::vector<uint8_t> read_buffer(kBlockSize);
+    EXPECT_EQ(kBlockSize, ring_->Read(read_buffer.data(), kBlockSize));
+    EXPECT_EQ(write_buffer, read_buffer);
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(kReadDelayMs));
+  }
+}
+
+TEST_F(IoBlockRingTest, CloseByReader) {
+  const uint64_t kNumWrites(kRingSize * 1000 / kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToRingThreaded(write_buffer, kNumWrites, 0, false);
+  while (ring_->NumFilledBlocks() < kNumBlocks) {
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(10));
+  }
+  ring_->Close();
+  WaitForWriterThread();
+  EXPECT_TRUE(ring_closed_);
+}
+
+TEST_F(IoBlockRingTest, CloseByWriter) {
+  uint8_t test_buffer[kBlockSize];
+  std::vector<uint8_t> write_buffer;
+  WriteToRingThreaded(write_buffer, 0, 0, true);
+  EXPECT_EQ(0U, ring_->Read(test_buffer, kBlockSize));
+  WaitForWriterThread();
+}
+
+TEST_F(IoBlockRingTest, Reopen) {
+  const uint64_t kTestBytes1(5);
+  const uint64_t kTestBytes2(10);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kTestBytes1, &write_buffer);
+  WriteToRingThreaded(write_buffer, 1, 0, true);
+
+  std::vector<uint8_t> read_buffer(kTestBytes1);
+  EXPECT_EQ(kTestBytes1, ring_->Read(read_buffer.data(), kTestBytes1));
+  EXPECT_EQ(write_buffer, read_buffer);
+
+  WaitForWriterThread();
+  ASSERT_TRUE(ring_->closed());
+  ring_->Reopen();
+  ASSERT_FALSE(ring_->closed());
+
+  GenerateTestBuffer(kTestBytes2, &write_buffer);
+  WriteToRingThreaded(write_buffer, 1, 0, false);
+  read_buffer.resize(kTestBytes2);
+  EXPECT_EQ(kTestBytes2, ring_->Read(read_buffer.data(), kTestBytes2));
+  EXPECT_EQ(write_buffer, read_buffer);
+}
+
+TEST_F(IoBlockRingTest, SingleLargeWrite) {
+  const uint64_t kTestBytes(kRingSize * 10);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kTestBytes, &write_buffer);
+  WriteToRingThreaded(write_buffer, 1, 0, false);
+  uint64_t bytes_read(0);
+  std::vector<uint8_t> read_buffer(kTestBytes);
+  while (bytes_read < kTestBytes) {
+    EXPECT_EQ(kBlockSize, ring_->Read(&read_buffer[bytes_read], kBlockSize));
+    bytes_read += kBlockSize;
+  }
+  EXPECT_EQ(write_buffer, read_buffer);
+}
+
+TEST_F(IoBlockRingTest, LargeRead) {
+  const uint64_t kNumWrites(kRingSize * 10 / kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  WriteToRingThreaded(write_buffer, kNumWrites, 0, false);
+  std::vector<uint8_t> verify_buffer;
+  while (verify_buffer.size() < kRingSize) {
+    verify_buffer.insert(verify_buffer.end(),
+                         write_buffer.begin(),
+                         write_buffer.end());
+  }
+  while (ring_->NumFilledBlocks() < kNumBlocks) {
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(10));
+  }
+  std::vector<uint8_t> read_buffer(kRingSize);
+  EXPECT_EQ(kRingSize, ring_->Read(read_buffer.data(), kRingSize));
+  EXPECT_EQ(verify_buffer, read_buffer);
+  ring_->Close();
+}
+
+TEST_F(IoBlockRingTest, BlocksInPlace) {
+  uint8_t* block = ring_->AcquireFreeBlock();
+  ASSERT_TRUE(block);
+  memcpy(block, reference_block_, kBlockSize);
+  ring_->CommitBlock(100);
+  EXPECT_EQ(1u, ring_->NumFilledBlocks());
+
+  size_t size = 0;
+  const uint8_t* data = ring_->PeekFilledBlock(&size);
+  ASSERT_EQ(block, data);
+  EXPECT_EQ(100u, size);
+  ring_->Consume(40);
+  EXPECT_FALSE(ring_->IsEmpty());
+
+  data = ring_->PeekFilledBlock(&size);
+  EXPECT_EQ(block + 40, data);
+  EXPECT_EQ(60u, size);
+  ring_->Consume(60);
+  EXPECT_TRUE(ring_->IsEmpty());
+
+  // The next block follows in the ring.
+  EXPECT_EQ(block + kBlockSize, ring_->AcquireFreeBlock());
+}
+
+TEST_F(IoBlockRingTest, BatchOfBlocks) {
+  // Fill all but two blocks.
+  for (uint64_t i = 0; i < kNumBlocks - 2; ++i)
+    ASSERT_EQ(1u, ring_->Write(reference_block_, 1));
+
+  std::vector<uint8_t*> blocks;
+  ASSERT_EQ(2u, ring_->AcquireFreeBlocks(8, &blocks));
+  ASSERT_EQ(2u, blocks.size());
+  EXPECT_EQ(blocks[0] + kBlockSize, blocks[1]);
+  memcpy(blocks[1], reference_block_, kBlockSize);
+  // Empty blocks are skipped by the consumer.
+  const size_t kSizes[] = {0, 10};
+  ring_->CommitBlocks(kSizes, arraysize(kSizes));
+  EXPECT_EQ(kNumBlocks, ring_->NumFilledBlocks());
+
+  std::vector<uint8_t> read_buffer(kRingSize);
+  ASSERT_EQ(kNumBlocks - 2 + 10,
+            ring_->Read(read_buffer.data(), read_buffer.size()));
+  EXPECT_TRUE(ring_->IsEmpty());
+  EXPECT_EQ(0, memcmp(reference_block_, &read_buffer[kNumBlocks - 2], 10));
+
+  ring_->Close();
+  EXPECT_EQ(0u, ring_->AcquireFreeBlocks(8, &blocks));
+}
+
+TEST_F(IoBlockRingTest, ReadAcrossBlocks) {
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize * 3 / 2, &write_buffer);
+  ASSERT_EQ(write_buffer.size(),
+            ring_->Write(write_buffer.data(), write_buffer.size()));
+  EXPECT_EQ(2u, ring_->NumFilledBlocks());
+
+  std::vector<uint8_t> read_buffer(kRingSize);
+  ASSERT_EQ(write_buffer.size(),
+            ring_->Read(read_buffer.data(), read_buffer.size()));
+  read_buffer.resize(write_buffer.size());
+  EXPECT_EQ(write_buffer, read_buffer);
+}
+
+TEST_F(IoBlockRingTest, NumBlocksRoundedUpToPowerOfTwo) {
+  EXPECT_EQ(kNumBlocks, ring_->num_blocks());
+  IoBlockRing ring(6, kBlockSize);
+  EXPECT_EQ(8u, ring.num_blocks());
+}
+
+TEST_F(IoBlockRingTest, CounterWrapAround) {
+  // The block counters wrap around after 2^32 blocks, on a ring whose
+  // requested size is not a power of two.
+  IoBlockRing ring(6, kBlockSize);
+  ring.Close();
+  ring.ReopenAtIndexForTesting(0xFFFFFFFFu - 5);
+
+  uint8_t value = 0;
+  for (int round = 0; round < 4; ++round) {
+    // Fill the ring, then drain it, so that the blocks cross the wrap around.
+    for (size_t i = 0; i < ring.num_blocks(); ++i) {
+      const uint8_t data = value + i;
+      ASSERT_EQ(1u, ring.Write(&data, 1));
+    }
+    EXPECT_EQ(ring.num_blocks(), ring.NumFilledBlocks());
+    for (size_t i = 0; i < ring.num_blocks(); ++i) {
+      size_t size = 0;
+      const uint8_t* block = ring.PeekFilledBlock(&size);
+      ASSERT_TRUE(block);
+      ASSERT_EQ(1u, size);
+      EXPECT_EQ(static_cast<uint8_t>(value + i), *block);
+      ring.Consume(1);
+    }
+    EXPECT_TRUE(ring.IsEmpty());
+    value += ring.num_blocks();
+  }
+}
+
+TEST_F(IoBlockRingTest, WaitUntilEmpty) {
+  const int kReadDelayMs(10);
+  const uint64_t kNumWrites(kNumBlocks);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kBlockSize, &write_buffer);
+  for (uint64_t i = 0; i < kNumWrites; ++i)
+    ASSERT_EQ(kBlockSize, ring_->Write(write_buffer.data(), kBlockSize));
+
+  ClosureThread reader_thread(
+      "ReaderThread", base::Bind(&IoBlockRingTest::ReadFromRing,
+                                 base::Unretained(this), kReadDelayMs));
+  reader_thread.Start();
+  ring_->WaitUntilEmptyOrClosed();
+  EXPECT_TRUE(ring_->IsEmpty());
+  ring_->Close();
+  reader_thread.Join();
+}
+
+}  // namespace media
+}  // namespace shaka
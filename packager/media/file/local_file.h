@@ -30,10 +30,12 @@ class LocalFile : public File {
   bool Close() override;
   int64_t Read(void* buffer, uint64_t length) override;
   int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t WriteV(const IoBuffer* buffers, size_t count) override;
   int64_t Size() override;
   bool Flush() override;
   bool Seek(uint64_t position) override;
   bool Tell(uint64_t* position) override;
+  void AdviseSequentialRead() override;
   /// @}
 
   /// Delete a local file.
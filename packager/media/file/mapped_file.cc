@@ -0,0 +1,141 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/mapped_file.h"
+
+#include <string.h>  // for memcpy
+
+#include <algorithm>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/files/memory_mapped_file.h"
+#include "packager/base/logging.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/build/build_config.h"
+
+#if defined(OS_POSIX)
+#include <sys/mman.h>
+#endif
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+// Memory mapped file data. The file is unmapped when the last reference is
+// released.
+class MappedMemory : public base::RefCountedMemory {
+ public:
+  explicit MappedMemory(scoped_ptr<base::MemoryMappedFile> mapped_file)
+      : mapped_file_(mapped_file.Pass()) {}
+
+  const unsigned char* front() const override { return mapped_file_->data(); }
+  size_t size() const override { return mapped_file_->length(); }
+
+ private:
+  ~MappedMemory() override {}
+
+  scoped_ptr<base::MemoryMappedFile> mapped_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedMemory);
+};
+
+bool HasPrefix(const std::string& file_name, const char* prefix) {
+  return file_name.compare(0, strlen(prefix), prefix) == 0;
+}
+
+}  // namespace
+
+MappedFile::MappedFile(const char* file_name)
+    : File(file_name), position_(0) {}
+
+bool MappedFile::Close() {
+  mapping_ = NULL;
+  delete this;
+  return true;
+}
+
+int64_t MappedFile::Read(void* buffer, uint64_t length) {
+  DCHECK(buffer != NULL);
+  DCHECK(mapping_);
+  if (position_ >= mapping_->size())
+    return 0;
+  const uint64_t bytes_to_read =
+      std::min<uint64_t>(length, mapping_->size() - position_);
+  memcpy(buffer, mapping_->front() + position_, bytes_to_read);
+  position_ += bytes_to_read;
+  return bytes_to_read;
+}
+
+int64_t MappedFile::Write(const void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "MappedFile is read-only.";
+  return -1;
+}
+
+int64_t MappedFile::Size() {
+  DCHECK(mapping_);
+  return mapping_->size();
+}
+
+bool MappedFile::Flush() {
+  return true;
+}
+
+bool MappedFile::Seek(uint64_t position) {
+  DCHECK(mapping_);
+  if (position > mapping_->size())
+    return false;
+  position_ = position;
+  return true;
+}
+
+bool MappedFile::Tell(uint64_t* position) {
+  *position = position_;
+  return true;
+}
+
+scoped_refptr<base::RefCountedMemory> MappedFile::Map(const char* file_name) {
+  std::string path(file_name);
+  if (HasPrefix(path, kLocalFilePrefix)) {
+    path = path.substr(strlen(kLocalFilePrefix));
+  } else if (HasPrefix(path, kMmapFilePrefix)) {
+    path = path.substr(strlen(kMmapFilePrefix));
+  } else if (path.find("://") != std::string::npos) {
+    // Not a local file.
+    return NULL;
+  }
+
+  // Empty files cannot be mapped.
+  int64_t file_size = 0;
+  if (base::GetFileSize(base::FilePath(path), &file_size) && file_size == 0)
+    return scoped_refptr<base::RefCountedMemory>(
+        new base::RefCountedStaticMemory());
+
+  scoped_ptr<base::MemoryMappedFile> mapped_file(new base::MemoryMappedFile);
+  if (!mapped_file->Initialize(base::FilePath(path))) {
+    LOG(ERROR) << "Cannot map file '" << path << "'.";
+    return NULL;
+  }
+#if defined(OS_POSIX)
+  if (madvise(const_cast<uint8_t*>(mapped_file->data()), mapped_file->length(),
+              MADV_SEQUENTIAL) != 0) {
+    PLOG(WARNING) << "madvise failed for file '" << path << "'.";
+  }
+#endif
+  return scoped_refptr<base::RefCountedMemory>(
+      new MappedMemory(mapped_file.Pass()));
+}
+
+MappedFile::~MappedFile() {}
+
+bool MappedFile::Open() {
+  mapping_ = Map(file_name().c_str());
+  return mapping_.get() != NULL;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,67 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_MAPPED_FILE_H_
+#define PACKAGER_FILE_MAPPED_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
+#include "packager/media/file/file.h"
+
+namespace shaka {
+namespace media {
+
+/// Implements MappedFile, a read-only local file accessed through a memory
+/// mapping. The mapping itself can be obtained with Map(), so that the file
+/// data is referenced in place instead of being read into a buffer.
+class MappedFile : public File {
+ public:
+  /// @param file_name C string containing the name of the file to be accessed.
+  explicit MappedFile(const char* file_name);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+  /// Map a local file in memory, read-only. The kernel is advised that the
+  /// mapping is accessed sequentially, so that it reads ahead aggressively and
+  /// may drop the pages which were read.
+  /// @param file_name is the path of the file to map, optionally prefixed with
+  ///        kLocalFilePrefix or kMmapFilePrefix.
+  /// @return the mapped file data, or NULL if @a file_name is not a local file
+  ///         or cannot be mapped. The file stays mapped as long as the
+  ///         returned object is referenced. The file must not be modified
+  ///         while it is mapped.
+  static scoped_refptr<base::RefCountedMemory> Map(const char* file_name);
+
+ protected:
+  ~MappedFile() override;
+
+  bool Open() override;
+
+ private:
+  scoped_refptr<base::RefCountedMemory> mapping_;
+  uint64_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_MAPPED_FILE_H_
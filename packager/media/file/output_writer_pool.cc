@@ -0,0 +1,413 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/output_writer_pool.h"
+
+#include <algorithm>
+
+#include <gflags/gflags.h>
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+#include "packager/base/stl_util.h"
+#include "packager/media/base/closure_thread.h"
+
+DECLARE_uint64(io_cache_size);
+DECLARE_uint64(io_block_size);
+DECLARE_uint64(io_writer_threads);
+
+namespace shaka {
+namespace media {
+
+namespace {
+// A block is written while another one is filled, so at least two blocks are
+// needed.
+const size_t kMinNumBlocks = 2;
+
+base::LazyInstance<OutputWriterPool>::Leaky g_output_writer_pool =
+    LAZY_INSTANCE_INITIALIZER;
+}  // namespace
+
+OutputWriterPool::Operation::Operation() : type(kWriteOperation) {}
+OutputWriterPool::Operation::~Operation() {}
+
+OutputWriterPool::FileQueue::FileQueue() : scheduled(false), error(0) {}
+OutputWriterPool::FileQueue::~FileQueue() {}
+
+OutputWriterPool::OutputWriterPool(size_t num_threads,
+                                   size_t block_size,
+                                   uint64_t max_buffered_bytes)
+    : num_threads_(std::max<size_t>(1, num_threads)),
+      block_size_(block_size),
+      max_blocks_(std::max<uint64_t>(kMinNumBlocks,
+                                     max_buffered_bytes / block_size)),
+      work_available_(&lock_),
+      progress_(&lock_),
+      num_queued_blocks_(0),
+      shutting_down_(false) {
+  DCHECK_GT(block_size_, 0u);
+}
+
+OutputWriterPool::OutputWriterPool()
+    : OutputWriterPool(FLAGS_io_writer_threads,
+                       FLAGS_io_block_size,
+                       FLAGS_io_cache_size) {}
+
+OutputWriterPool::~OutputWriterPool() {
+  WaitForAll();
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK(queues_.empty()) << "Output files are still open.";
+    shutting_down_ = true;
+    work_available_.Broadcast();
+  }
+  // Joins the threads.
+  STLDeleteElements(&threads_);
+}
+
+// static
+OutputWriterPool* OutputWriterPool::GetInstance() {
+  return g_output_writer_pool.Pointer();
+}
+
+bool OutputWriterPool::WaitForFile(const std::string& file_name) {
+  base::AutoLock auto_lock(lock_);
+  while (IsFileBusy(file_name))
+    progress_.Wait();
+  return failed_files_.find(file_name) == failed_files_.end();
+}
+
+bool OutputWriterPool::HasPendingWrites(const std::string& file_name) {
+  base::AutoLock auto_lock(lock_);
+  return IsFileBusy(file_name);
+}
+
+bool OutputWriterPool::WaitForAll() {
+  base::AutoLock auto_lock(lock_);
+  while (true) {
+    bool busy = false;
+    for (const FileQueue* queue : queues_) {
+      if (IsBusy(queue)) {
+        busy = true;
+        break;
+      }
+    }
+    if (!busy)
+      break;
+    progress_.Wait();
+  }
+  if (failed_files_.empty())
+    return true;
+  for (const std::string& file_name : failed_files_)
+    LOG(ERROR) << "Failed to write output file " << file_name;
+  return false;
+}
+
+OutputWriterPool::FileQueue* OutputWriterPool::AddFile(
+    scoped_ptr<File, FileCloser> file) {
+  DCHECK(file);
+  FileQueue* queue = new FileQueue;
+  queue->file_name = file->file_name();
+  queue->file = file.Pass();
+
+  base::AutoLock auto_lock(lock_);
+  // A file written again is not failed anymore.
+  failed_files_.erase(queue->file_name);
+  queues_.push_back(queue);
+  while (threads_.size() < num_threads_) {
+    ClosureThread* thread = new ClosureThread(
+        "OutputWriter",
+        base::Bind(&OutputWriterPool::ThreadMain, base::Unretained(this)));
+    thread->Start();
+    threads_.push_back(thread);
+  }
+  return queue;
+}
+
+void OutputWriterPool::AcquireBlock(std::vector<uint8_t>* block) {
+  DCHECK(block);
+  base::AutoLock auto_lock(lock_);
+  // Only the blocks queued for writing count against the budget. Blocks being
+  // filled do not, so that open files cannot starve each other.
+  while (num_queued_blocks_ >= max_blocks_)
+    progress_.Wait();
+  if (free_blocks_.empty()) {
+    std::vector<uint8_t>().swap(*block);
+    block->reserve(block_size_);
+    return;
+  }
+  block->swap(free_blocks_.back());
+  free_blocks_.pop_back();
+  block->clear();
+}
+
+void OutputWriterPool::Enqueue(FileQueue* queue,
+                               OperationType type,
+                               std::vector<uint8_t>* block) {
+  DCHECK(queue);
+  base::AutoLock auto_lock(lock_);
+  queue->operations.resize(queue->operations.size() + 1);
+  Operation& operation = queue->operations.back();
+  operation.type = type;
+  if (type == kWriteOperation) {
+    DCHECK(block);
+    operation.block.swap(*block);
+    ++num_queued_blocks_;
+  }
+  if (!queue->scheduled) {
+    queue->scheduled = true;
+    ready_queues_.push_back(queue);
+    work_available_.Signal();
+  }
+}
+
+int64_t OutputWriterPool::WaitForQueue(FileQueue* queue) {
+  DCHECK(queue);
+  base::AutoLock auto_lock(lock_);
+  while (IsBusy(queue))
+    progress_.Wait();
+  return queue->error;
+}
+
+scoped_ptr<File, FileCloser> OutputWriterPool::RemoveFile(FileQueue* queue) {
+  DCHECK(queue);
+  scoped_ptr<FileQueue> queue_to_delete(queue);
+  base::AutoLock auto_lock(lock_);
+  DCHECK(!IsBusy(queue));
+  queues_.remove(queue);
+  return queue->file.Pass();
+}
+
+int64_t OutputWriterPool::GetError(FileQueue* queue) {
+  DCHECK(queue);
+  base::AutoLock auto_lock(lock_);
+  return queue->error;
+}
+
+void OutputWriterPool::ThreadMain() {
+  base::AutoLock auto_lock(lock_);
+  while (true) {
+    while (ready_queues_.empty() && !shutting_down_)
+      work_available_.Wait();
+    if (ready_queues_.empty())
+      return;
+    FileQueue* queue = ready_queues_.front();
+    ready_queues_.pop_front();
+
+    // The queue stays scheduled, and is serviced by this thread only, until
+    // it is empty. Operations queued meanwhile are appended to it.
+    while (!queue->operations.empty()) {
+      Operation* operation = &queue->operations.front();
+      {
+        base::AutoUnlock auto_unlock(lock_);
+        DoOperation(queue, operation);
+      }
+      if (operation->type == kWriteOperation) {
+        --num_queued_blocks_;
+        if (free_blocks_.size() < max_blocks_) {
+          free_blocks_.resize(free_blocks_.size() + 1);
+          free_blocks_.back().swap(operation->block);
+        }
+      }
+      const bool closed = operation->type == kCloseOperation;
+      queue->operations.pop_front();
+      progress_.Broadcast();
+      if (closed) {
+        DCHECK(queue->operations.empty());
+        if (queue->error != 0)
+          failed_files_.insert(queue->file_name);
+        queues_.remove(queue);
+        delete queue;
+        queue = NULL;
+        break;
+      }
+    }
+    if (queue) {
+      queue->scheduled = false;
+      progress_.Broadcast();
+    }
+  }
+}
+
+void OutputWriterPool::DoOperation(FileQueue* queue, Operation* operation) {
+  // |queue->error| is only updated by the thread servicing the queue, and
+  // read under |lock_|.
+  switch (operation->type) {
+    case kWriteOperation: {
+      if (queue->error != 0)
+        return;
+      const std::vector<uint8_t>& block = operation->block;
+      uint64_t bytes_written = 0;
+      while (bytes_written < block.size()) {
+        const int64_t result = queue->file->Write(
+            block.data() + bytes_written, block.size() - bytes_written);
+        if (result < 0) {
+          base::AutoLock auto_lock(lock_);
+          queue->error = result;
+          return;
+        }
+        bytes_written += result;
+      }
+      return;
+    }
+    case kFlushOperation:
+      if (queue->error == 0 && !queue->file->Flush()) {
+        base::AutoLock auto_lock(lock_);
+        queue->error = -1;
+      }
+      return;
+    case kCloseOperation: {
+      const bool closed = queue->file.release()->Close();
+      base::AutoLock auto_lock(lock_);
+      if (!closed && queue->error == 0)
+        queue->error = -1;
+      return;
+    }
+  }
+  NOTREACHED() << "Unknown operation " << operation->type;
+}
+
+// static
+bool OutputWriterPool::IsBusy(const FileQueue* queue) {
+  return queue->scheduled;
+}
+
+bool OutputWriterPool::IsFileBusy(const std::string& file_name) {
+  lock_.AssertAcquired();
+  for (const FileQueue* queue : queues_) {
+    if (queue->file_name == file_name && IsBusy(queue))
+      return true;
+  }
+  return false;
+}
+
+PooledOutputFile::PooledOutputFile(scoped_ptr<File, FileCloser> internal_file,
+                                   OutputWriterPool* pool)
+    : File(internal_file->file_name()),
+      internal_file_(internal_file.Pass()),
+      pool_(pool),
+      queue_(NULL),
+      position_(0),
+      size_(0) {
+  DCHECK(internal_file_);
+  DCHECK(pool_);
+}
+
+PooledOutputFile::~PooledOutputFile() {}
+
+bool PooledOutputFile::Open() {
+  DCHECK(internal_file_);
+
+  if (!internal_file_->Open())
+    return false;
+
+  position_ = 0;
+  size_ = internal_file_->Size();
+  queue_ = pool_->AddFile(internal_file_.Pass());
+  return true;
+}
+
+bool PooledOutputFile::Close() {
+  if (!queue_) {
+    // Never opened.
+    bool result = internal_file_.release()->Close();
+    delete this;
+    return result;
+  }
+
+  QueueWriteBlock();
+  const int64_t error = pool_->WaitForQueue(queue_);
+  bool result = pool_->RemoveFile(queue_).release()->Close();
+  delete this;
+  return result && error == 0;
+}
+
+bool PooledOutputFile::CloseInBackground() {
+  if (!queue_)
+    return Close();
+
+  QueueWriteBlock();
+  const int64_t error = pool_->GetError(queue_);
+  // |queue_| is deleted by the pool once closed.
+  pool_->Enqueue(queue_, OutputWriterPool::kCloseOperation, NULL);
+  delete this;
+  return error == 0;
+}
+
+int64_t PooledOutputFile::Read(void* buffer, uint64_t length) {
+  NOTIMPLEMENTED() << "PooledOutputFile does not support Read().";
+  return -1;
+}
+
+int64_t PooledOutputFile::Write(const void* buffer, uint64_t length) {
+  DCHECK(queue_);
+
+  const int64_t error = pool_->GetError(queue_);
+  if (error != 0)
+    return error;
+
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_written = 0;
+  while (bytes_written < length) {
+    if (write_block_.capacity() == 0)
+      pool_->AcquireBlock(&write_block_);
+    const size_t copy_size = std::min<uint64_t>(
+        length - bytes_written, pool_->block_size() - write_block_.size());
+    write_block_.insert(write_block_.end(), data + bytes_written,
+                        data + bytes_written + copy_size);
+    bytes_written += copy_size;
+    if (write_block_.size() == pool_->block_size())
+      QueueWriteBlock();
+  }
+  position_ += bytes_written;
+  if (position_ > size_)
+    size_ = position_;
+
+  return bytes_written;
+}
+
+int64_t PooledOutputFile::Size() {
+  return size_;
+}
+
+bool PooledOutputFile::Flush() {
+  DCHECK(queue_);
+
+  QueueWriteBlock();
+  pool_->Enqueue(queue_, OutputWriterPool::kFlushOperation, NULL);
+  return pool_->WaitForQueue(queue_) == 0;
+}
+
+bool PooledOutputFile::Seek(uint64_t position) {
+  DCHECK(queue_);
+
+  QueueWriteBlock();
+  if (pool_->WaitForQueue(queue_) != 0)
+    return false;
+  // The queue is idle, so the internal file is not accessed by the pool.
+  if (!queue_->file->Seek(position))
+    return false;
+  position_ = position;
+  return true;
+}
+
+bool PooledOutputFile::Tell(uint64_t* position) {
+  DCHECK(position);
+
+  *position = position_;
+  return true;
+}
+
+void PooledOutputFile::QueueWriteBlock() {
+  if (write_block_.empty())
+    return;
+  pool_->Enqueue(queue_, OutputWriterPool::kWriteOperation, &write_block_);
+  DCHECK_EQ(0u, write_block_.capacity());
+}
+
+}  // namespace media
+}  // namespace shaka
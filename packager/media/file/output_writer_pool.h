@@ -0,0 +1,210 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_OUTPUT_WRITER_POOL_H_
+#define PACKAGER_FILE_OUTPUT_WRITER_POOL_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+
+namespace shaka {
+namespace media {
+
+class ClosureThread;
+
+/// A fixed set of I/O threads and a fixed budget of reusable blocks, shared by
+/// all the output files opened through it. Each file has its own queue of
+/// blocks, which is written in order by one thread at a time. Opening and
+/// closing an output file does not allocate a cache or start a thread, and
+/// closing it does not wait for the queued blocks to be written.
+class OutputWriterPool {
+ public:
+  /// @param num_threads is the number of I/O threads, at least 1. The threads
+  ///        are started when the first file is added.
+  /// @param block_size is the size of each block, in bytes.
+  /// @param max_buffered_bytes is the budget of blocks queued for writing,
+  ///        shared by all the files. Writers wait for blocks to be written
+  ///        when it is spent.
+  OutputWriterPool(size_t num_threads,
+                   size_t block_size,
+                   uint64_t max_buffered_bytes);
+  /// Create a pool configured by --io_writer_threads, --io_block_size and
+  /// --io_cache_size.
+  OutputWriterPool();
+  /// Waits for the queued blocks to be written and stops the threads.
+  ~OutputWriterPool();
+
+  /// @return the pool shared by the process.
+  static OutputWriterPool* GetInstance();
+
+  /// Wait until the blocks queued for the files named @a file_name, as
+  /// returned by File::file_name() of the internal file, are written.
+  /// @return false if writing or closing one of these files failed.
+  bool WaitForFile(const std::string& file_name);
+
+  /// @return true if blocks queued for the files named @a file_name are not
+  ///         written yet. Does not block.
+  bool HasPendingWrites(const std::string& file_name);
+
+  /// Wait until all the queued blocks are written, including those of files
+  /// closed already.
+  /// @return false if writing or closing an output file failed, and the file
+  ///         was not opened again since. The failed files are logged. Failures
+  ///         are kept, so that WaitForFile() still reports them.
+  bool WaitForAll();
+
+ private:
+  friend class PooledOutputFile;
+
+  enum OperationType {
+    kWriteOperation,
+    kFlushOperation,
+    kCloseOperation,
+  };
+
+  struct Operation {
+    Operation();
+    ~Operation();
+
+    OperationType type;
+    // Block to write. Its storage goes back to the pool once written.
+    std::vector<uint8_t> block;
+  };
+
+  // Queue of operations of a file. Owned by the pool, until the close
+  // operation is done.
+  struct FileQueue {
+    FileQueue();
+    ~FileQueue();
+
+    scoped_ptr<File, FileCloser> file;
+    // Name of |file|, kept once it is closed.
+    std::string file_name;
+    std::deque<Operation> operations;
+    // True while the queue is in |ready_queues_| or serviced by a thread.
+    bool scheduled;
+    // Result of the first failed write, flush or close, or 0.
+    int64_t error;
+  };
+
+  // @name Used by PooledOutputFile.
+  // @{
+  // Takes ownership of |file|, which is open.
+  FileQueue* AddFile(scoped_ptr<File, FileCloser> file);
+  // Get an empty block of |block_size_| capacity. This function may block
+  // while the blocks queued for writing are over budget.
+  void AcquireBlock(std::vector<uint8_t>* block);
+  // Queues |type|, with |block| for writes. |queue| is deleted once a close
+  // operation is done.
+  void Enqueue(FileQueue* queue,
+               OperationType type,
+               std::vector<uint8_t>* block);
+  // Waits until the operations queued for |queue| are done.
+  // @return the error of |queue|, or 0.
+  int64_t WaitForQueue(FileQueue* queue);
+  // Deletes |queue|, which is idle, and returns its file.
+  scoped_ptr<File, FileCloser> RemoveFile(FileQueue* queue);
+  // @return the error of |queue| so far, or 0.
+  int64_t GetError(FileQueue* queue);
+  size_t block_size() const { return block_size_; }
+  // @}
+
+  // I/O thread loop.
+  void ThreadMain();
+  // Does |operation| on |queue|. Called without |lock_| held.
+  void DoOperation(FileQueue* queue, Operation* operation);
+  // @return true if |queue| has operations queued or in progress.
+  static bool IsBusy(const FileQueue* queue);
+  // @return true if a queue of the files named |file_name| is busy. Called
+  // with |lock_| held.
+  bool IsFileBusy(const std::string& file_name);
+
+  const size_t num_threads_;
+  const size_t block_size_;
+  const size_t max_blocks_;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  // Signalled when a queue becomes ready, or on shutdown.
+  base::ConditionVariable work_available_;
+  // Signalled when operations are done.
+  base::ConditionVariable progress_;
+  std::vector<ClosureThread*> threads_;
+  std::list<FileQueue*> queues_;
+  std::deque<FileQueue*> ready_queues_;
+  // Written blocks, kept for reuse.
+  std::vector<std::vector<uint8_t> > free_blocks_;
+  // Number of blocks queued for writing.
+  size_t num_queued_blocks_;
+  // Files whose last write failed. A file leaves the set when it is opened
+  // again, never because the failure was reported.
+  std::set<std::string> failed_files_;
+  bool shutting_down_;
+
+  DISALLOW_COPY_AND_ASSIGN(OutputWriterPool);
+};
+
+/// An output file whose writes are queued to an OutputWriterPool. Close()
+/// waits for the queued writes; CloseInBackground() returns once the last
+/// block is queued, and errors found after that are reported by
+/// OutputWriterPool::WaitForFile() and WaitForAll().
+class PooledOutputFile : public File {
+ public:
+  /// @param internal_file is the file written by the pool.
+  /// @param pool is the pool writing the file. It must outlive the file.
+  PooledOutputFile(scoped_ptr<File, FileCloser> internal_file,
+                   OutputWriterPool* pool);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  bool CloseInBackground() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~PooledOutputFile() override;
+
+  bool Open() override;
+
+ private:
+  friend class OutputWriterPoolTest;
+
+  // Queues the block being filled, if any.
+  void QueueWriteBlock();
+
+  scoped_ptr<File, FileCloser> internal_file_;
+  OutputWriterPool* const pool_;
+  // Owned by |pool_|. NULL until the file is open.
+  OutputWriterPool::FileQueue* queue_;
+  // Block being filled by Write().
+  std::vector<uint8_t> write_block_;
+  uint64_t position_;
+  uint64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(PooledOutputFile);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_OUTPUT_WRITER_POOL_H_
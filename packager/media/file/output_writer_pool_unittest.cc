@@ -0,0 +1,214 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/files/file_util.h"
+#include "packager/base/files/scoped_temp_dir.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/local_file.h"
+#include "packager/media/file/output_writer_pool.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const size_t kNumThreads = 2;
+// Small blocks and budget, so that writers wait for blocks to be written.
+const size_t kBlockSize = 16;
+const uint64_t kMaxBufferedBytes = 4 * kBlockSize;
+const size_t kNumFiles = 8;
+const size_t kFileSize = 1000;
+
+std::string GetContent(size_t file_index) {
+  std::string content(kFileSize, 0);
+  for (size_t i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>(file_index * 7 + i);
+  return content;
+}
+
+// A file which cannot be written.
+class FailingFile : public File {
+ public:
+  explicit FailingFile(const std::string& file_name) : File(file_name) {}
+
+  bool Close() override {
+    delete this;
+    return true;
+  }
+  int64_t Read(void* buffer, uint64_t length) override { return -1; }
+  int64_t Write(const void* buffer, uint64_t length) override { return -1; }
+  int64_t Size() override { return 0; }
+  bool Flush() override { return true; }
+  bool Seek(uint64_t position) override { return false; }
+  bool Tell(uint64_t* position) override { return false; }
+
+ protected:
+  ~FailingFile() override {}
+  bool Open() override { return true; }
+};
+}  // namespace
+
+class OutputWriterPoolTest : public testing::Test {
+ public:
+  OutputWriterPoolTest()
+      : pool_(new OutputWriterPool(kNumThreads, kBlockSize,
+                                   kMaxBufferedBytes)) {}
+
+ protected:
+  void SetUp() override { ASSERT_TRUE(temp_dir_.CreateUniqueTempDir()); }
+
+  std::string GetFileName(size_t file_index) {
+    return temp_dir_.path()
+        .AppendASCII("segment" + base::SizeTToString(file_index))
+        .value();
+  }
+
+  // Opens |file_name| for writing through |pool_|.
+  File* OpenOutput(const std::string& file_name) {
+    return OpenPooledFile(
+        scoped_ptr<File, FileCloser>(new LocalFile(file_name.c_str(), "w")));
+  }
+
+  // Opens |internal_file| for writing through |pool_|.
+  File* OpenPooledFile(scoped_ptr<File, FileCloser> internal_file) {
+    PooledOutputFile* file =
+        new PooledOutputFile(internal_file.Pass(), pool_.get());
+    if (!file->Open()) {
+      file->Close();
+      return NULL;
+    }
+    return file;
+  }
+
+  void ExpectFileContent(const std::string& file_name,
+                         const std::string& expected) {
+    std::string content;
+    ASSERT_TRUE(base::ReadFileToString(base::FilePath(file_name), &content));
+    EXPECT_EQ(expected, content);
+  }
+
+  base::ScopedTempDir temp_dir_;
+  scoped_ptr<OutputWriterPool> pool_;
+};
+
+TEST_F(OutputWriterPoolTest, CloseInBackground) {
+  // Interleave the writes to all the files.
+  std::vector<File*> files;
+  for (size_t i = 0; i < kNumFiles; ++i) {
+    files.push_back(OpenOutput(GetFileName(i)));
+    ASSERT_TRUE(files.back());
+  }
+  const size_t kWriteSize = 10;
+  for (size_t offset = 0; offset < kFileSize; offset += kWriteSize) {
+    for (size_t i = 0; i < kNumFiles; ++i) {
+      const std::string content = GetContent(i);
+      EXPECT_EQ(static_cast<int64_t>(kWriteSize),
+                files[i]->Write(content.data() + offset, kWriteSize));
+    }
+  }
+  for (size_t i = 0; i < kNumFiles; ++i) {
+    EXPECT_EQ(static_cast<int64_t>(kFileSize), files[i]->Size());
+    EXPECT_TRUE(files[i]->CloseInBackground());
+  }
+
+  ASSERT_TRUE(pool_->WaitForAll());
+  for (size_t i = 0; i < kNumFiles; ++i)
+    ExpectFileContent(GetFileName(i), GetContent(i));
+}
+
+TEST_F(OutputWriterPoolTest, WaitForFile) {
+  File* file = OpenOutput(GetFileName(0));
+  ASSERT_TRUE(file);
+  const std::string content = GetContent(0);
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            file->Write(content.data(), content.size()));
+  EXPECT_TRUE(file->CloseInBackground());
+
+  ASSERT_TRUE(pool_->WaitForFile(GetFileName(0)));
+  ExpectFileContent(GetFileName(0), content);
+}
+
+TEST_F(OutputWriterPoolTest, CloseWaits) {
+  File* file = OpenOutput(GetFileName(0));
+  ASSERT_TRUE(file);
+  const std::string content = GetContent(0);
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            file->Write(content.data(), content.size()));
+  EXPECT_TRUE(file->Close());
+
+  ExpectFileContent(GetFileName(0), content);
+}
+
+TEST_F(OutputWriterPoolTest, SeekAndWrite) {
+  File* file = OpenOutput(GetFileName(0));
+  ASSERT_TRUE(file);
+  std::string expected = GetContent(0);
+  EXPECT_EQ(static_cast<int64_t>(expected.size()),
+            file->Write(expected.data(), expected.size()));
+
+  // Overwrite a range spanning blocks, as done to update a header.
+  const size_t kPosition = kBlockSize - 3;
+  const std::string kUpdate = "header update";
+  ASSERT_TRUE(file->Seek(kPosition));
+  uint64_t position = 0;
+  ASSERT_TRUE(file->Tell(&position));
+  EXPECT_EQ(kPosition, position);
+  EXPECT_EQ(static_cast<int64_t>(kUpdate.size()),
+            file->Write(kUpdate.data(), kUpdate.size()));
+  expected.replace(kPosition, kUpdate.size(), kUpdate);
+  EXPECT_EQ(static_cast<int64_t>(kFileSize), file->Size());
+  EXPECT_TRUE(file->Close());
+
+  ExpectFileContent(GetFileName(0), expected);
+}
+
+TEST_F(OutputWriterPoolTest, WriteFailureReportedForItsFileOnly) {
+  const std::string kFailingFileName = "failing_file";
+  File* failing_file = OpenPooledFile(
+      scoped_ptr<File, FileCloser>(new FailingFile(kFailingFileName)));
+  ASSERT_TRUE(failing_file);
+  File* file = OpenOutput(GetFileName(0));
+  ASSERT_TRUE(file);
+  const std::string content = GetContent(0);
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            failing_file->Write(content.data(), content.size()));
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            file->Write(content.data(), content.size()));
+  failing_file->CloseInBackground();
+  EXPECT_TRUE(file->CloseInBackground());
+
+  // The failure is reported to the writer of the failed file only.
+  EXPECT_TRUE(pool_->WaitForFile(GetFileName(0)));
+  EXPECT_FALSE(pool_->WaitForFile(kFailingFileName));
+  EXPECT_FALSE(pool_->HasPendingWrites(kFailingFileName));
+  ExpectFileContent(GetFileName(0), content);
+
+  // Waiting for all the files does not consume the failure.
+  EXPECT_FALSE(pool_->WaitForAll());
+  EXPECT_FALSE(pool_->WaitForFile(kFailingFileName));
+  EXPECT_FALSE(pool_->WaitForAll());
+
+  // Writing the file again clears it.
+  failing_file = OpenPooledFile(
+      scoped_ptr<File, FileCloser>(new FailingFile(kFailingFileName)));
+  ASSERT_TRUE(failing_file);
+  EXPECT_TRUE(failing_file->Close());
+  EXPECT_TRUE(pool_->WaitForFile(kFailingFileName));
+  EXPECT_TRUE(pool_->WaitForAll());
+}
+
+TEST_F(OutputWriterPoolTest, OpenFailure) {
+  EXPECT_FALSE(OpenOutput(
+      temp_dir_.path().AppendASCII("no_such_dir").AppendASCII("a").value()));
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,373 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/segment_store.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "packager/base/lazy_instance.h"
+#include "packager/base/logging.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+base::LazyInstance<SegmentStore>::Leaky g_segment_store =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Splits |segment_template| into literals and identifiers, with an empty
+// string for each identifier. "$$" is a literal '$'.
+std::vector<std::string> SplitSegmentTemplate(
+    const std::string& segment_template) {
+  std::vector<std::string> parts;
+  std::string literal;
+  size_t pos = 0;
+  while (pos < segment_template.size()) {
+    const char c = segment_template[pos];
+    if (c != '$') {
+      literal += c;
+      ++pos;
+      continue;
+    }
+    if (pos + 1 < segment_template.size() &&
+        segment_template[pos + 1] == '$') {
+      literal += '$';
+      pos += 2;
+      continue;
+    }
+    const size_t end = segment_template.find('$', pos + 1);
+    if (end == std::string::npos) {
+      // Not a valid identifier. Take it literally.
+      literal += segment_template.substr(pos);
+      break;
+    }
+    if (!literal.empty())
+      parts.push_back(literal);
+    literal.clear();
+    // Consecutive identifiers match like a single one.
+    if (parts.empty() || !parts.back().empty())
+      parts.push_back(std::string());
+    pos = end + 1;
+  }
+  if (!literal.empty())
+    parts.push_back(literal);
+  return parts;
+}
+
+// @return true if |name|, from |name_pos|, matches |parts| from |part_index|.
+bool MatchParts(const std::vector<std::string>& parts,
+                size_t part_index,
+                const std::string& name,
+                size_t name_pos) {
+  if (part_index == parts.size())
+    return name_pos == name.size();
+  const std::string& part = parts[part_index];
+  if (!part.empty()) {
+    return name.compare(name_pos, part.size(), part) == 0 &&
+           MatchParts(parts, part_index + 1, name, name_pos + part.size());
+  }
+  // An identifier matches any number of characters, except '/'.
+  for (size_t end = name_pos; end <= name.size(); ++end) {
+    if (MatchParts(parts, part_index + 1, name, end))
+      return true;
+    if (end < name.size() && name[end] == '/')
+      break;
+  }
+  return false;
+}
+}  // namespace
+
+const size_t SegmentStore::kChunkSize;
+const int SegmentStore::kDefaultMaxWaitSeconds;
+
+SegmentStore::Segment::Segment()
+    : data_available_(&lock_), size_(0), complete_(false), abandoned_(false) {}
+
+SegmentStore::Segment::~Segment() {}
+
+void SegmentStore::Segment::Write(uint64_t position,
+                                  const uint8_t* data,
+                                  uint64_t length) {
+  base::AutoLock auto_lock(lock_);
+  DCHECK(!complete_);
+  DCHECK_LE(position, size_);
+  while (length > 0) {
+    const size_t chunk_index = position / kChunkSize;
+    const size_t chunk_offset = position % kChunkSize;
+    if (chunk_index == chunks_.size()) {
+      chunks_.push_back(new base::RefCountedBytes);
+      chunks_.back()->data().reserve(kChunkSize);
+    }
+    scoped_refptr<base::RefCountedBytes>& chunk = chunks_[chunk_index];
+    const size_t copy_size =
+        std::min<uint64_t>(length, kChunkSize - chunk_offset);
+    std::vector<uint8_t>& chunk_data = chunk->data();
+    if (chunk_offset < chunk_data.size() && !chunk->HasOneRef()) {
+      // Readers hold the data being overwritten. Leave it to them.
+      std::vector<uint8_t> copy;
+      copy.reserve(kChunkSize);
+      copy.assign(chunk_data.begin(), chunk_data.end());
+      chunk = base::RefCountedBytes::TakeVector(&copy);
+    }
+    // Readers may hold the chunk, but only access the data written before
+    // they got it, which is not modified below. The chunk capacity is
+    // reserved, so appending does not move that data.
+    std::vector<uint8_t>& data_to_write = chunk->data();
+    DCHECK_GE(data_to_write.capacity(), kChunkSize);
+    DCHECK_LE(chunk_offset, data_to_write.size());
+    const size_t overwrite_size =
+        std::min<size_t>(copy_size, data_to_write.size() - chunk_offset);
+    if (overwrite_size > 0)
+      memcpy(&data_to_write[chunk_offset], data, overwrite_size);
+    data_to_write.insert(data_to_write.end(), data + overwrite_size,
+                         data + copy_size);
+    data += copy_size;
+    length -= copy_size;
+    position += copy_size;
+    size_ = std::max(size_, position);
+  }
+  data_available_.Broadcast();
+}
+
+void SegmentStore::Segment::Finish() {
+  base::AutoLock auto_lock(lock_);
+  complete_ = true;
+  completion_time_ = base::TimeTicks::Now();
+  data_available_.Broadcast();
+}
+
+void SegmentStore::Segment::Abandon() {
+  base::AutoLock auto_lock(lock_);
+  if (complete_)
+    return;
+  abandoned_ = true;
+  data_available_.Broadcast();
+}
+
+bool SegmentStore::Segment::GetData(
+    uint64_t offset,
+    bool wait,
+    scoped_refptr<base::RefCountedBytes>* chunk,
+    const uint8_t** data,
+    size_t* length) {
+  DCHECK(chunk);
+  DCHECK(data);
+  DCHECK(length);
+  base::AutoLock auto_lock(lock_);
+  if (wait && offset >= size_ && !complete_ && !abandoned_) {
+    const base::TimeTicks deadline = base::TimeTicks::Now() + max_wait_;
+    while (offset >= size_ && !complete_ && !abandoned_) {
+      if (max_wait_ <= base::TimeDelta()) {
+        data_available_.Wait();
+        continue;
+      }
+      const base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+      if (remaining <= base::TimeDelta()) {
+        LOG(WARNING) << "Timed out waiting for a segment to be written.";
+        break;
+      }
+      data_available_.TimedWait(remaining);
+    }
+  }
+  if (offset >= size_)
+    return false;
+
+  *chunk = chunks_[offset / kChunkSize];
+  const std::vector<uint8_t>& chunk_data = (*chunk)->data();
+  const size_t chunk_offset = offset % kChunkSize;
+  *data = &chunk_data[chunk_offset];
+  *length = chunk_data.size() - chunk_offset;
+  return true;
+}
+
+int64_t SegmentStore::Segment::Read(uint64_t offset,
+                                    bool wait,
+                                    void* buffer,
+                                    uint64_t length) {
+  uint8_t* output = static_cast<uint8_t*>(buffer);
+  uint64_t bytes_read = 0;
+  while (bytes_read < length) {
+    scoped_refptr<base::RefCountedBytes> chunk;
+    const uint8_t* data = NULL;
+    size_t size = 0;
+    // Only wait for the first bytes.
+    if (!GetData(offset + bytes_read, wait && bytes_read == 0, &chunk, &data,
+                 &size)) {
+      break;
+    }
+    size = std::min<uint64_t>(size, length - bytes_read);
+    memcpy(output + bytes_read, data, size);
+    bytes_read += size;
+  }
+  return bytes_read;
+}
+
+uint64_t SegmentStore::Segment::Size() {
+  base::AutoLock auto_lock(lock_);
+  return size_;
+}
+
+bool SegmentStore::Segment::IsComplete() {
+  base::AutoLock auto_lock(lock_);
+  return complete_;
+}
+
+bool SegmentStore::Segment::IsAbandoned() {
+  base::AutoLock auto_lock(lock_);
+  return abandoned_;
+}
+
+base::TimeTicks SegmentStore::Segment::GetCompletionTime() {
+  base::AutoLock auto_lock(lock_);
+  return completion_time_;
+}
+
+void SegmentStore::Segment::CopyData(Segment* segment) {
+  base::AutoLock auto_lock(segment->lock_);
+  chunks_ = segment->chunks_;
+  size_ = segment->size_;
+  // Appending to a partial last chunk would change the chunk seen by the
+  // readers of |segment|, so it gets its own copy.
+  if (!chunks_.empty() && chunks_.back()->size() < kChunkSize) {
+    std::vector<uint8_t> copy;
+    copy.reserve(kChunkSize);
+    copy.assign(chunks_.back()->data().begin(), chunks_.back()->data().end());
+    chunks_.back() = base::RefCountedBytes::TakeVector(&copy);
+  }
+}
+
+SegmentStore::SegmentStore()
+    : max_wait_(base::TimeDelta::FromSeconds(kDefaultMaxWaitSeconds)) {}
+
+SegmentStore::~SegmentStore() {}
+
+// static
+SegmentStore* SegmentStore::GetInstance() {
+  return g_segment_store.Pointer();
+}
+
+scoped_refptr<SegmentStore::Segment> SegmentStore::Create(
+    const std::string& name) {
+  return Replace(name, false);
+}
+
+scoped_refptr<SegmentStore::Segment> SegmentStore::Reopen(
+    const std::string& name) {
+  return Replace(name, true);
+}
+
+scoped_refptr<SegmentStore::Segment> SegmentStore::Get(
+    const std::string& name) {
+  base::AutoLock auto_lock(lock_);
+  std::map<std::string, scoped_refptr<Segment> >::const_iterator it =
+      segments_.find(name);
+  if (it == segments_.end())
+    return NULL;
+  return it->second;
+}
+
+bool SegmentStore::Delete(const std::string& name) {
+  scoped_refptr<Segment> deleted_segment;
+  base::AutoLock auto_lock(lock_);
+  std::map<std::string, scoped_refptr<Segment> >::iterator it =
+      segments_.find(name);
+  if (it == segments_.end())
+    return false;
+  deleted_segment.swap(it->second);
+  segments_.erase(it);
+  deleted_segment->Abandon();
+  return true;
+}
+
+void SegmentStore::set_max_wait(base::TimeDelta max_wait) {
+  base::AutoLock auto_lock(lock_);
+  max_wait_ = max_wait;
+}
+
+void SegmentStore::set_retention(base::TimeDelta retention) {
+  base::AutoLock auto_lock(lock_);
+  retention_ = retention;
+}
+
+void SegmentStore::AddEvictionPattern(const std::string& segment_template) {
+  base::AutoLock auto_lock(lock_);
+  eviction_patterns_.push_back(SplitSegmentTemplate(segment_template));
+}
+
+size_t SegmentStore::EvictExpiredSegments(base::TimeTicks now) {
+  std::vector<scoped_refptr<Segment> > evicted_segments;
+  base::AutoLock auto_lock(lock_);
+  if (retention_ <= base::TimeDelta() || eviction_patterns_.empty())
+    return 0;
+
+  std::map<std::string, scoped_refptr<Segment> >::iterator it =
+      segments_.begin();
+  while (it != segments_.end()) {
+    const base::TimeTicks completion_time = it->second->GetCompletionTime();
+    if (completion_time.is_null() || now - completion_time < retention_ ||
+        !IsEvictable(it->first)) {
+      ++it;
+      continue;
+    }
+    VLOG(2) << "Evicting " << it->first << " from the segment store.";
+    evicted_segments.push_back(it->second);
+    segments_.erase(it++);
+  }
+  return evicted_segments.size();
+}
+
+std::vector<std::string> SegmentStore::GetNames() {
+  std::vector<std::string> names;
+  base::AutoLock auto_lock(lock_);
+  for (const auto& segment : segments_)
+    names.push_back(segment.first);
+  return names;
+}
+
+void SegmentStore::Clear() {
+  std::map<std::string, scoped_refptr<Segment> > segments;
+  base::AutoLock auto_lock(lock_);
+  segments.swap(segments_);
+  for (const auto& segment : segments)
+    segment.second->Abandon();
+  eviction_patterns_.clear();
+  retention_ = base::TimeDelta();
+  max_wait_ = base::TimeDelta::FromSeconds(kDefaultMaxWaitSeconds);
+}
+
+scoped_refptr<SegmentStore::Segment> SegmentStore::Replace(
+    const std::string& name,
+    bool keep_data) {
+  EvictExpiredSegments(base::TimeTicks::Now());
+
+  scoped_refptr<Segment> segment(new Segment);
+  // The replaced segment, if any, is released outside of the lock.
+  scoped_refptr<Segment> replaced_segment;
+  base::AutoLock auto_lock(lock_);
+  segment->max_wait_ = max_wait_;
+  scoped_refptr<Segment>& stored_segment = segments_[name];
+  replaced_segment.swap(stored_segment);
+  stored_segment = segment;
+  if (replaced_segment) {
+    if (keep_data)
+      segment->CopyData(replaced_segment.get());
+    replaced_segment->Abandon();
+  }
+  return segment;
+}
+
+bool SegmentStore::IsEvictable(const std::string& name) const {
+  for (const std::vector<std::string>& pattern : eviction_patterns_) {
+    if (MatchParts(pattern, 0, name, 0))
+      return true;
+  }
+  return false;
+}
+
+}  // namespace media
+}  // namespace shaka
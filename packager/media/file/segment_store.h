@@ -0,0 +1,186 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_SEGMENT_STORE_H_
+#define PACKAGER_FILE_SEGMENT_STORE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/time/time.h"
+
+namespace shaka {
+namespace media {
+
+/// A thread safe in-memory store of output files, e.g. segments and
+/// manifests of a live presentation, which can be served without a round trip
+/// to the disk. Files are stored in ref-counted chunks, so readers do not copy
+/// a file to read it, and can read a file while it is being written.
+class SegmentStore {
+ public:
+  /// A stored file. Writes go to the end of the file or overwrite existing
+  /// data; chunks held by readers are copied before they are overwritten.
+  class Segment : public base::RefCountedThreadSafe<Segment> {
+   public:
+    /// Write @a length bytes at @a position, which is at most Size().
+    void Write(uint64_t position, const uint8_t* data, uint64_t length);
+
+    /// Mark the segment complete. Readers waiting for data are woken up.
+    void Finish();
+
+    /// Mark the segment abandoned: it will not be completed. Readers waiting
+    /// for data are woken up, and only get the data written so far.
+    void Abandon();
+
+    /// Get the data at @a offset without copying it.
+    /// @param offset is the offset of the data to get.
+    /// @param wait indicates whether to wait for data to be written at
+    ///        @a offset if the segment is not complete. The wait ends when the
+    ///        segment is abandoned, or after the maximum wait of the store,
+    ///        see SegmentStore::set_max_wait().
+    /// @param[out] chunk receives the chunk holding the data. The data stays
+    ///             valid as long as @a chunk is held.
+    /// @param[out] data receives a pointer to the data.
+    /// @param[out] length receives the number of bytes available at @a data.
+    /// @return false at the end of the segment, or if no data is available at
+    ///         @a offset and @a wait is false.
+    bool GetData(uint64_t offset,
+                 bool wait,
+                 scoped_refptr<base::RefCountedBytes>* chunk,
+                 const uint8_t** data,
+                 size_t* length);
+
+    /// Copy up to @a length bytes at @a offset into @a buffer.
+    /// @param wait indicates whether to wait for data to be written at
+    ///        @a offset if the segment is not complete.
+    /// @return the number of bytes read, 0 at the end of the segment or if no
+    ///         data is available and @a wait is false.
+    int64_t Read(uint64_t offset, bool wait, void* buffer, uint64_t length);
+
+    /// @return the number of bytes written so far.
+    uint64_t Size();
+    /// @return true if Finish() has been called.
+    bool IsComplete();
+    /// @return true if Abandon() has been called before Finish().
+    bool IsAbandoned();
+
+   private:
+    friend class base::RefCountedThreadSafe<Segment>;
+    friend class SegmentStore;
+
+    Segment();
+    ~Segment();
+
+    // @return the time the segment was completed, or a null time if it is
+    //         not complete.
+    base::TimeTicks GetCompletionTime();
+
+    // Take the data written to |segment| so far, sharing its full chunks.
+    // Must be called before the segment is written to or shared.
+    void CopyData(Segment* segment);
+
+    base::Lock lock_;  // Lock protecting the variables below.
+    // Signalled when data is written or the segment is complete.
+    base::ConditionVariable data_available_;
+    std::vector<scoped_refptr<base::RefCountedBytes> > chunks_;
+    uint64_t size_;
+    bool complete_;
+    bool abandoned_;
+    base::TimeTicks completion_time_;
+    // How long readers wait for data. Zero means no limit.
+    base::TimeDelta max_wait_;
+
+    DISALLOW_COPY_AND_ASSIGN(Segment);
+  };
+
+  SegmentStore();
+  ~SegmentStore();
+
+  /// @return the store shared by the process.
+  static SegmentStore* GetInstance();
+
+  /// Create an empty segment named @a name, replacing the existing one if
+  /// any. Readers holding the replaced segment can finish reading it; it is
+  /// abandoned if it is not complete. Expired segments are evicted in the
+  /// process.
+  scoped_refptr<Segment> Create(const std::string& name);
+
+  /// Like Create(), but the new segment starts with the data of the segment
+  /// named @a name, if any, so that data can be appended to it. Readers
+  /// holding the replaced segment keep reading it without the new data.
+  scoped_refptr<Segment> Reopen(const std::string& name);
+
+  /// @return the segment named @a name, or NULL if there is none.
+  scoped_refptr<Segment> Get(const std::string& name);
+
+  /// Remove the segment named @a name, and abandon it if it is not complete.
+  /// @return true if there was such a segment.
+  bool Delete(const std::string& name);
+
+  /// Set how long readers wait for data to be written to a segment, so that
+  /// they do not wait forever for a writer which stopped. Applies to the
+  /// segments created afterwards.
+  /// @param max_wait is the maximum wait. Zero means no limit.
+  void set_max_wait(base::TimeDelta max_wait);
+
+  /// Set how long segments are kept once complete. Only segments whose names
+  /// match a pattern given to AddEvictionPattern() are evicted; init segments
+  /// and manifests are kept.
+  /// @param retention is the retention period. Zero disables eviction.
+  void set_retention(base::TimeDelta retention);
+
+  /// Make the segments generated from @a segment_template evictable.
+  /// @param segment_template is a segment template, see
+  ///        MuxerOptions::segment_template. The $...$ identifiers match any
+  ///        character except '/'.
+  void AddEvictionPattern(const std::string& segment_template);
+
+  /// Evict the evictable segments completed before @a now minus the
+  /// retention period.
+  /// @return the number of segments evicted.
+  size_t EvictExpiredSegments(base::TimeTicks now);
+
+  /// @return the names of the stored segments, in lexicographic order.
+  std::vector<std::string> GetNames();
+
+  /// Remove and abandon all the segments, and remove the eviction patterns.
+  void Clear();
+
+  /// Segments are stored in chunks of this size.
+  static const size_t kChunkSize = 64 * 1024;
+  /// Default maximum wait of the readers, in seconds.
+  static const int kDefaultMaxWaitSeconds = 60;
+
+ private:
+  // Implements Create() and Reopen().
+  scoped_refptr<Segment> Replace(const std::string& name, bool keep_data);
+
+  // @return true if |name| matches one of |eviction_patterns_|.
+  bool IsEvictable(const std::string& name) const;
+
+  base::Lock lock_;  // Lock protecting the variables below.
+  std::map<std::string, scoped_refptr<Segment> > segments_;
+  // Segment templates split into literals, with an empty string for each
+  // identifier.
+  std::vector<std::vector<std::string> > eviction_patterns_;
+  base::TimeDelta retention_;
+  base::TimeDelta max_wait_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentStore);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_SEGMENT_STORE_H_
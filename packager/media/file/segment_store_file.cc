@@ -0,0 +1,89 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/segment_store_file.h"
+
+#include "packager/base/logging.h"
+
+namespace shaka {
+namespace media {
+
+SegmentStoreFile::SegmentStoreFile(const char* file_name, const char* mode)
+    : File(file_name), mode_(mode), position_(0) {}
+
+SegmentStoreFile::~SegmentStoreFile() {}
+
+bool SegmentStoreFile::Close() {
+  if (segment_ && mode_ != "r")
+    segment_->Finish();
+  delete this;
+  return true;
+}
+
+int64_t SegmentStoreFile::Read(void* buffer, uint64_t length) {
+  DCHECK(segment_);
+  DCHECK_EQ("r", mode_);
+  const int64_t bytes_read =
+      segment_->Read(position_, true /* wait */, buffer, length);
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+int64_t SegmentStoreFile::Write(const void* buffer, uint64_t length) {
+  DCHECK(segment_);
+  DCHECK_NE("r", mode_);
+  segment_->Write(position_, static_cast<const uint8_t*>(buffer), length);
+  position_ += length;
+  return length;
+}
+
+int64_t SegmentStoreFile::Size() {
+  DCHECK(segment_);
+  return segment_->Size();
+}
+
+bool SegmentStoreFile::Flush() {
+  return true;
+}
+
+bool SegmentStoreFile::Seek(uint64_t position) {
+  DCHECK(segment_);
+  if (position > segment_->Size())
+    return false;
+  position_ = position;
+  return true;
+}
+
+bool SegmentStoreFile::Tell(uint64_t* position) {
+  DCHECK(position);
+  *position = position_;
+  return true;
+}
+
+bool SegmentStoreFile::Open() {
+  SegmentStore* store = SegmentStore::GetInstance();
+  if (mode_ == "r") {
+    segment_ = store->Get(file_name());
+    if (!segment_)
+      return false;
+    position_ = 0;
+  } else if (mode_ == "w") {
+    segment_ = store->Create(file_name());
+    position_ = 0;
+  } else if (mode_ == "a") {
+    // Continue at the end of the existing file, if any.
+    segment_ = store->Reopen(file_name());
+    position_ = segment_->Size();
+  } else {
+    NOTIMPLEMENTED() << "File mode " << mode_
+                     << " not supported by SegmentStoreFile";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,57 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_SEGMENT_STORE_FILE_H_
+#define PACKAGER_FILE_SEGMENT_STORE_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/memory/ref_counted.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/segment_store.h"
+
+namespace shaka {
+namespace media {
+
+/// Implements a File stored in the SegmentStore of the process. A file opened
+/// for writing is available to readers right away, and readers wait for the
+/// data which is not written yet, until the file is closed.
+class SegmentStoreFile : public File {
+ public:
+  /// @param file_name is the name of the file in the store.
+  /// @param mode is the file access mode: "r", "w" or "a".
+  SegmentStoreFile(const char* file_name, const char* mode);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+ protected:
+  ~SegmentStoreFile() override;
+
+  bool Open() override;
+
+ private:
+  const std::string mode_;
+  scoped_refptr<SegmentStore::Segment> segment_;
+  uint64_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentStoreFile);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_SEGMENT_STORE_FILE_H_
@@ -0,0 +1,109 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_SEGMENT_STORE_HTTP_SERVER_H_
+#define PACKAGER_FILE_SEGMENT_STORE_HTTP_SERVER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/atomicops.h"
+#include "packager/base/macros.h"
+#include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/scoped_ptr.h"
+
+namespace shaka {
+namespace media {
+
+class ClosureThread;
+class SegmentStore;
+
+/// A minimal HTTP/1.1 server of the segments and manifests in a SegmentStore.
+/// GET and HEAD requests for "/<name>" are answered with the segment named
+/// <name>, percent-decoded. Requests are limited to an 8 KiB header without a
+/// body. Complete segments are sent with a Content-Length; segments being
+/// written are streamed with chunked transfer encoding as they are written.
+/// Each connection serves a single request. Responses waiting for segments to
+/// be written end when the segment is abandoned or the maximum wait of the
+/// store expires, see SegmentStore::set_max_wait().
+class SegmentStoreHttpServer {
+ public:
+  /// @param store is the store to serve. It must outlive the server.
+  explicit SegmentStoreHttpServer(SegmentStore* store);
+  /// Stops the server if it is running.
+  ~SegmentStoreHttpServer();
+
+  /// Start listening and serving.
+  /// @param address is the IPv4 address to listen on.
+  /// @param port is the port to listen on, or 0 to let the system pick one.
+  /// @return true on success.
+  bool Start(const std::string& address, uint16_t port);
+
+  /// Stop accepting connections. Responses in progress run to completion.
+  void Stop();
+
+  /// Set the maximum number of connections served at the same time. Further
+  /// connections are answered with 503 Service Unavailable. Call before
+  /// Start().
+  void set_max_connections(int max_connections) {
+    max_connections_ = max_connections;
+  }
+
+  /// @return the port listened on, once started.
+  uint16_t port() const { return port_; }
+
+  /// Default maximum number of connections served at the same time.
+  static const int kDefaultMaxConnections = 64;
+
+ private:
+  // Number of connections being served. It is shared with the tasks serving
+  // the connections, which may outlive the server.
+  class ConnectionCounter
+      : public base::RefCountedThreadSafe<ConnectionCounter> {
+   public:
+    ConnectionCounter();
+
+    // Count a new connection.
+    // @return false if |max_connections| are served already.
+    bool TryAdd(int max_connections);
+    // Uncount a connection which is closed.
+    void Remove();
+
+   private:
+    friend class base::RefCountedThreadSafe<ConnectionCounter>;
+    ~ConnectionCounter();
+
+    base::subtle::Atomic32 count_;
+
+    DISALLOW_COPY_AND_ASSIGN(ConnectionCounter);
+  };
+
+  // Serves the request received on |socket|, then closes it and uncounts it
+  // from |connections|. Runs on a worker thread.
+  static void ServeConnection(
+      SegmentStore* store,
+      int socket,
+      const scoped_refptr<ConnectionCounter>& connections);
+
+  // Accepts connections until Stop() is called.
+  void AcceptLoop();
+
+  SegmentStore* const store_;
+  int socket_;
+  uint16_t port_;
+  int max_connections_;
+  base::subtle::Atomic32 stopping_;
+  scoped_refptr<ConnectionCounter> connections_;
+  scoped_ptr<ClosureThread> accept_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentStoreHttpServer);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_SEGMENT_STORE_HTTP_SERVER_H_
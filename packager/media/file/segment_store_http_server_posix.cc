@@ -0,0 +1,466 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/segment_store_http_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/location.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_split.h"
+#include "packager/base/strings/string_util.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/threading/worker_pool.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/segment_store.h"
+
+namespace shaka {
+namespace media {
+
+using base::subtle::Acquire_Load;
+using base::subtle::Barrier_AtomicIncrement;
+using base::subtle::Release_Store;
+
+namespace {
+
+const int kInvalidSocket(-1);
+const int kListenBacklog = 64;
+// Accept timeout, so that the accept thread notices when the server is
+// stopped.
+const int kAcceptTimeoutMs = 100;
+// Clients which do not send their request, or do not read the response, in
+// this time are disconnected.
+const int kSocketTimeoutSeconds = 10;
+// Maximum size of a request. Requests only have a header: bodies are
+// rejected.
+const size_t kMaxRequestHeaderSize = 8192;
+
+const char kHeaderEnd[] = "\r\n\r\n";
+
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+struct ContentTypeInfo {
+  const char* extension;
+  const char* content_type;
+};
+
+const ContentTypeInfo kContentTypes[] = {
+    {".mpd", "application/dash+xml"},
+    {".m3u8", "application/vnd.apple.mpegurl"},
+    {".m4s", "video/iso.segment"},
+    {".mp4", "video/mp4"},
+    {".m4a", "audio/mp4"},
+    {".ts", "video/mp2t"},
+    {".webm", "video/webm"},
+    {".vtt", "text/vtt"},
+};
+
+std::string GetContentType(const std::string& name) {
+  for (const ContentTypeInfo& info : kContentTypes) {
+    if (base::EndsWith(name, info.extension,
+                       base::CompareCase::INSENSITIVE_ASCII)) {
+      return info.content_type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+bool SendAll(int socket, const void* data, size_t length) {
+  const char* output = static_cast<const char*>(data);
+  while (length > 0) {
+    const ssize_t result = send(socket, output, length, kSendFlags);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      VLOG(1) << "Failed to send HTTP response: " << strerror(errno);
+      return false;
+    }
+    output += result;
+    length -= result;
+  }
+  return true;
+}
+
+bool SendString(int socket, const std::string& data) {
+  return SendAll(socket, data.data(), data.size());
+}
+
+// Reads the request header from |socket|, receiving at most
+// kMaxRequestHeaderSize bytes.
+// @return false if the connection is closed, times out, or the header is too
+//         large.
+bool ReceiveRequestHeader(int socket, std::string* header) {
+  char buffer[1024];
+  while (header->find(kHeaderEnd) == std::string::npos) {
+    if (header->size() >= kMaxRequestHeaderSize)
+      return false;
+    const size_t max_size =
+        std::min(sizeof(buffer), kMaxRequestHeaderSize - header->size());
+    const ssize_t result = recv(socket, buffer, max_size, 0);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    header->append(buffer, result);
+  }
+  return true;
+}
+
+// @return true if the request with |header| has a body.
+bool HasRequestBody(const std::string& header) {
+  const std::vector<std::string> lines =
+      base::SplitString(header.substr(0, header.find(kHeaderEnd)), "\r\n",
+                        base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  const char kContentLength[] = "Content-Length:";
+  for (const std::string& line : lines) {
+    if (base::StartsWith(line, "Transfer-Encoding:",
+                         base::CompareCase::INSENSITIVE_ASCII)) {
+      return true;
+    }
+    if (base::StartsWith(line, kContentLength,
+                         base::CompareCase::INSENSITIVE_ASCII) &&
+        line.find_first_not_of(" \t0", strlen(kContentLength)) !=
+            std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// @return the value of hexadecimal digit |c|, or -1 if it is not one.
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Decodes the percent-encoded characters of |path| into |name|.
+// @return false if |path| has a malformed escape, or an escaped NUL.
+bool UnescapePath(const std::string& path, std::string* name) {
+  name->clear();
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (path[i] != '%') {
+      *name += path[i];
+      continue;
+    }
+    if (i + 2 >= path.size())
+      return false;
+    const int high = HexDigitValue(path[i + 1]);
+    const int low = HexDigitValue(path[i + 2]);
+    if (high < 0 || low < 0 || (high == 0 && low == 0))
+      return false;
+    *name += static_cast<char>(high * 16 + low);
+    i += 2;
+  }
+  return true;
+}
+
+// Reads and drops the data already received on |socket|, so that closing it
+// does not reset the connection before the client reads the response.
+void DiscardReceivedData(int socket) {
+  char buffer[1024];
+  while (recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+  }
+}
+
+void SendError(int socket, const std::string& status) {
+  SendString(socket, base::StringPrintf("HTTP/1.1 %s\r\n"
+                                        "Content-Length: 0\r\n"
+                                        "Connection: close\r\n\r\n",
+                                        status.c_str()));
+}
+
+// Sends the body of |segment| from |segment|'s chunks, waiting for the data
+// not written yet. The data is sent in chunked transfer encoding if
+// |chunked| is true.
+void SendSegment(int socket,
+                 SegmentStore::Segment* segment,
+                 bool chunked) {
+  uint64_t offset = 0;
+  scoped_refptr<base::RefCountedBytes> chunk;
+  const uint8_t* data = NULL;
+  size_t length = 0;
+  while (segment->GetData(offset, true /* wait */, &chunk, &data, &length)) {
+    if (chunked &&
+        !SendString(socket, base::StringPrintf("%zx\r\n", length))) {
+      return;
+    }
+    if (!SendAll(socket, data, length))
+      return;
+    if (chunked && !SendString(socket, "\r\n"))
+      return;
+    offset += length;
+    // Do not hold on to the chunk while waiting for more data.
+    chunk = NULL;
+  }
+  // The segment ends early if it is abandoned or the wait times out. The last
+  // chunk is not sent then, so that the client sees the response as
+  // truncated when the connection is closed.
+  if (!segment->IsComplete()) {
+    VLOG(1) << "Segment not completed, closing the HTTP connection.";
+    return;
+  }
+  if (chunked)
+    SendString(socket, "0\r\n\r\n");
+}
+
+// Serves the request received on |socket|, then closes it.
+void ServeRequest(SegmentStore* store, int socket) {
+  std::string header;
+  if (!ReceiveRequestHeader(socket, &header)) {
+    if (header.size() >= kMaxRequestHeaderSize) {
+      SendError(socket, "431 Request Header Fields Too Large");
+      DiscardReceivedData(socket);
+    }
+    close(socket);
+    return;
+  }
+
+  // Request line: <method> <path> <version>.
+  const std::string request_line = header.substr(0, header.find("\r\n"));
+  std::vector<std::string> tokens = base::SplitString(
+      request_line, " ", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  if (tokens.size() != 3 || tokens[1].empty() || tokens[1][0] != '/') {
+    SendError(socket, "400 Bad Request");
+    close(socket);
+    return;
+  }
+  const std::string& method = tokens[0];
+  const bool head = method == "HEAD";
+  if (method != "GET" && !head) {
+    SendString(socket, "HTTP/1.1 405 Method Not Allowed\r\n"
+                       "Allow: GET, HEAD\r\n"
+                       "Content-Length: 0\r\n"
+                       "Connection: close\r\n\r\n");
+    close(socket);
+    return;
+  }
+  // Chunked transfer encoding is not understood by HTTP/1.0 clients. The end
+  // of the body is signalled by closing the connection instead.
+  const bool http_1_0 = tokens[2] == "HTTP/1.0";
+  std::string name;
+  if (!UnescapePath(tokens[1].substr(1, tokens[1].find('?') - 1), &name)) {
+    SendError(socket, "400 Bad Request");
+    close(socket);
+    return;
+  }
+  if (HasRequestBody(header)) {
+    SendError(socket, "413 Payload Too Large");
+    DiscardReceivedData(socket);
+    close(socket);
+    return;
+  }
+
+  scoped_refptr<SegmentStore::Segment> segment = store->Get(name);
+  if (!segment) {
+    VLOG(1) << "Segment " << name << " not found.";
+    SendError(socket, "404 Not Found");
+    close(socket);
+    return;
+  }
+
+  // Segments are not modified once complete.
+  const bool complete = segment->IsComplete();
+  std::string response_header = base::StringPrintf(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: %s\r\n"
+      "Cache-Control: no-cache\r\n"
+      "Connection: close\r\n",
+      GetContentType(name).c_str());
+  if (complete) {
+    response_header += base::StringPrintf("Content-Length: %" PRIu64 "\r\n",
+                                          segment->Size());
+  } else if (!http_1_0) {
+    response_header += "Transfer-Encoding: chunked\r\n";
+  }
+  response_header += "\r\n";
+  if (SendString(socket, response_header) && !head)
+    SendSegment(socket, segment.get(), !complete && !http_1_0);
+  close(socket);
+}
+
+void SetSocketTimeouts(int socket) {
+  struct timeval timeout;
+  timeout.tv_sec = kSocketTimeoutSeconds;
+  timeout.tv_usec = 0;
+  if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                 sizeof(timeout)) < 0 ||
+      setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                 sizeof(timeout)) < 0) {
+    LOG(WARNING) << "Failed to set HTTP socket timeouts.";
+  }
+#if defined(SO_NOSIGPIPE)
+  const int enable = 1;
+  setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+}
+
+}  // namespace
+
+const int SegmentStoreHttpServer::kDefaultMaxConnections;
+
+SegmentStoreHttpServer::ConnectionCounter::ConnectionCounter() : count_(0) {}
+
+SegmentStoreHttpServer::ConnectionCounter::~ConnectionCounter() {}
+
+bool SegmentStoreHttpServer::ConnectionCounter::TryAdd(int max_connections) {
+  // Connections are only added by the accept thread, so the count cannot grow
+  // between the check and the increment.
+  if (Acquire_Load(&count_) >= max_connections)
+    return false;
+  Barrier_AtomicIncrement(&count_, 1);
+  return true;
+}
+
+void SegmentStoreHttpServer::ConnectionCounter::Remove() {
+  Barrier_AtomicIncrement(&count_, -1);
+}
+
+SegmentStoreHttpServer::SegmentStoreHttpServer(SegmentStore* store)
+    : store_(store),
+      socket_(kInvalidSocket),
+      port_(0),
+      max_connections_(kDefaultMaxConnections),
+      stopping_(0),
+      connections_(new ConnectionCounter) {
+  DCHECK(store_);
+}
+
+SegmentStoreHttpServer::~SegmentStoreHttpServer() {
+  Stop();
+}
+
+bool SegmentStoreHttpServer::Start(const std::string& address,
+                                   uint16_t port) {
+  DCHECK_EQ(kInvalidSocket, socket_);
+
+  struct sockaddr_in local_sock_addr;
+  memset(&local_sock_addr, 0, sizeof(local_sock_addr));
+  local_sock_addr.sin_family = AF_INET;
+  local_sock_addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &local_sock_addr.sin_addr) != 1) {
+    LOG(ERROR) << "Malformed IPv4 address for HTTP server: " << address;
+    return false;
+  }
+
+  const int new_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (new_socket == kInvalidSocket) {
+    PLOG(ERROR) << "Could not allocate HTTP server socket.";
+    return false;
+  }
+  const int enable = 1;
+  setsockopt(new_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  if (bind(new_socket, reinterpret_cast<struct sockaddr*>(&local_sock_addr),
+           sizeof(local_sock_addr)) < 0 ||
+      listen(new_socket, kListenBacklog) < 0) {
+    PLOG(ERROR) << "Could not listen on " << address << ":" << port;
+    close(new_socket);
+    return false;
+  }
+
+  struct sockaddr_in bound_sock_addr;
+  socklen_t bound_sock_addr_size = sizeof(bound_sock_addr);
+  if (getsockname(new_socket,
+                  reinterpret_cast<struct sockaddr*>(&bound_sock_addr),
+                  &bound_sock_addr_size) < 0) {
+    PLOG(ERROR) << "Could not get the HTTP server port.";
+    close(new_socket);
+    return false;
+  }
+
+  socket_ = new_socket;
+  port_ = ntohs(bound_sock_addr.sin_port);
+  Release_Store(&stopping_, 0);
+  accept_thread_.reset(new ClosureThread(
+      "SegmentStoreHttpServer",
+      base::Bind(&SegmentStoreHttpServer::AcceptLoop, base::Unretained(this))));
+  accept_thread_->Start();
+  LOG(INFO) << "Serving the segment store on http://" << address << ":"
+            << port_ << "/";
+  return true;
+}
+
+void SegmentStoreHttpServer::Stop() {
+  if (socket_ == kInvalidSocket)
+    return;
+  Release_Store(&stopping_, 1);
+  // Joins the accept thread.
+  accept_thread_.reset();
+  close(socket_);
+  socket_ = kInvalidSocket;
+}
+
+// static
+void SegmentStoreHttpServer::ServeConnection(
+    SegmentStore* store,
+    int socket,
+    const scoped_refptr<ConnectionCounter>& connections) {
+  ServeRequest(store, socket);
+  connections->Remove();
+}
+
+void SegmentStoreHttpServer::AcceptLoop() {
+  while (!Acquire_Load(&stopping_)) {
+    struct pollfd poll_fd;
+    poll_fd.fd = socket_;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    const int result = poll(&poll_fd, 1, kAcceptTimeoutMs);
+    if (result < 0 && errno != EINTR) {
+      PLOG(ERROR) << "Failed to wait for HTTP connections.";
+      return;
+    }
+    if (result <= 0)
+      continue;
+
+    const int connection = accept(socket_, NULL, NULL);
+    if (connection == kInvalidSocket) {
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+        PLOG(WARNING) << "Failed to accept HTTP connection.";
+      continue;
+    }
+    SetSocketTimeouts(connection);
+    // Responses may wait for segments to be written, so each connection is
+    // served on its own worker thread. The number of threads is bounded by
+    // the number of connections.
+    if (!connections_->TryAdd(max_connections_)) {
+      LOG(WARNING) << "Too many HTTP connections, rejecting a new one.";
+      SendError(connection, "503 Service Unavailable");
+      DiscardReceivedData(connection);
+      close(connection);
+      continue;
+    }
+    base::WorkerPool::PostTask(
+        FROM_HERE,
+        base::Bind(&SegmentStoreHttpServer::ServeConnection, store_,
+                   connection, connections_),
+        true /* task_is_slow */);
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,303 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "packager/media/file/segment_store.h"
+#include "packager/media/file/segment_store_http_server.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const char kLocalhost[] = "127.0.0.1";
+const char kHeaderEnd[] = "\r\n\r\n";
+
+// Appends |content| to |segment|.
+void WriteString(SegmentStore::Segment* segment, const std::string& content) {
+  segment->Write(segment->Size(),
+                 reinterpret_cast<const uint8_t*>(content.data()),
+                 content.size());
+}
+
+// Decodes |body| in chunked transfer encoding.
+std::string DecodeChunks(std::string body) {
+  std::string content;
+  while (true) {
+    const size_t size_end = body.find("\r\n");
+    if (size_end == std::string::npos) {
+      ADD_FAILURE() << "Malformed chunk size.";
+      return content;
+    }
+    const size_t size = strtoul(body.substr(0, size_end).c_str(), NULL, 16);
+    body = body.substr(size_end + 2);
+    if (size == 0)
+      break;
+    if (body.size() < size + 2 || body.substr(size, 2) != "\r\n") {
+      ADD_FAILURE() << "Malformed chunk.";
+      return content;
+    }
+    content += body.substr(0, size);
+    body = body.substr(size + 2);
+  }
+  EXPECT_EQ("\r\n", body);
+  return content;
+}
+}  // namespace
+
+class SegmentStoreHttpServerTest : public testing::Test {
+ public:
+  SegmentStoreHttpServerTest() : server_(&store_) {}
+
+ protected:
+  void SetUp() override { ASSERT_TRUE(server_.Start(kLocalhost, 0)); }
+
+  // Sends |request| to |server_|.
+  // @return the connected socket, or -1 on failure.
+  int SendRequest(const std::string& request) {
+    return SendRequestToPort(server_.port(), request);
+  }
+
+  // Sends |request| to the server listening on |port|.
+  // @return the connected socket, or -1 on failure.
+  int SendRequestToPort(uint16_t port, const std::string& request) {
+    const int client = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_NE(-1, client);
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    inet_pton(AF_INET, kLocalhost, &server_addr.sin_addr);
+    if (connect(client, reinterpret_cast<struct sockaddr*>(&server_addr),
+                sizeof(server_addr)) < 0) {
+      ADD_FAILURE() << "Failed to connect to the server.";
+      close(client);
+      return -1;
+    }
+    EXPECT_EQ(static_cast<ssize_t>(request.size()),
+              send(client, request.data(), request.size(), 0));
+    return client;
+  }
+
+  // Reads from |client| into |response| until |response| contains
+  // |terminator|, or until the server closes the connection if |terminator|
+  // is empty.
+  void Receive(int client, const std::string& terminator,
+               std::string* response) {
+    char buffer[4096];
+    while (terminator.empty() ||
+           response->find(terminator) == std::string::npos) {
+      const ssize_t result = recv(client, buffer, sizeof(buffer), 0);
+      if (result <= 0)
+        break;
+      response->append(buffer, result);
+    }
+  }
+
+  // Sends |request| to |server_| and returns the response, read until the
+  // server closes the connection.
+  std::string Request(const std::string& request) {
+    std::string response;
+    const int client = SendRequest(request);
+    if (client < 0)
+      return response;
+    Receive(client, std::string(), &response);
+    close(client);
+    return response;
+  }
+
+  std::string Get(const std::string& path) {
+    return Request("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  }
+
+  static std::string GetHeader(const std::string& response) {
+    return response.substr(0, response.find(kHeaderEnd) + 4);
+  }
+
+  static std::string GetBody(const std::string& response) {
+    return response.substr(response.find(kHeaderEnd) + 4);
+  }
+
+  SegmentStore store_;
+  SegmentStoreHttpServer server_;
+};
+
+TEST_F(SegmentStoreHttpServerTest, CompleteSegment) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("live/1.m4s");
+  const std::string kContent = "segment content";
+  WriteString(segment.get(), kContent);
+  segment->Finish();
+
+  const std::string response = Get("/live/1.m4s");
+  EXPECT_EQ(0u, response.find("HTTP/1.1 200 OK\r\n"));
+  const std::string header = GetHeader(response);
+  EXPECT_NE(std::string::npos, header.find("Content-Length: 15\r\n"));
+  EXPECT_NE(std::string::npos,
+            header.find("Content-Type: video/iso.segment\r\n"));
+  EXPECT_EQ(kContent, GetBody(response));
+}
+
+TEST_F(SegmentStoreHttpServerTest, QueryIgnored) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.mpd");
+  WriteString(segment.get(), "mpd");
+  segment->Finish();
+
+  const std::string response = Get("/a.mpd?t=1");
+  EXPECT_NE(std::string::npos,
+            GetHeader(response).find("Content-Type: application/dash+xml"));
+  EXPECT_EQ("mpd", GetBody(response));
+}
+
+TEST_F(SegmentStoreHttpServerTest, PathDecoded) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("live/a b.m4s");
+  WriteString(segment.get(), "abc");
+  segment->Finish();
+
+  EXPECT_EQ("abc", GetBody(Get("/live/a%20b.m4s")));
+  EXPECT_EQ("abc", GetBody(Get("/live%2fa%20b.m4s?t=1")));
+}
+
+TEST_F(SegmentStoreHttpServerTest, MalformedPath) {
+  EXPECT_EQ(0u, Get("/a%2.m4s").find("HTTP/1.1 400 Bad Request\r\n"));
+  EXPECT_EQ(0u, Get("/a%zz.m4s").find("HTTP/1.1 400 Bad Request\r\n"));
+  EXPECT_EQ(0u, Get("/a%00.m4s").find("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+TEST_F(SegmentStoreHttpServerTest, HeaderTooLarge) {
+  const std::string request = "GET /1.m4s HTTP/1.1\r\nHost: localhost\r\n"
+                              "X-Padding: " + std::string(10000, 'a') +
+                              "\r\n\r\n";
+  EXPECT_EQ(0u, Request(request).find(
+                    "HTTP/1.1 431 Request Header Fields Too Large\r\n"));
+}
+
+TEST_F(SegmentStoreHttpServerTest, RequestBodyRejected) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.m4s");
+  WriteString(segment.get(), "abc");
+  segment->Finish();
+
+  EXPECT_EQ(0u, Request("GET /1.m4s HTTP/1.1\r\ncontent-length: 3\r\n\r\n"
+                        "abc")
+                    .find("HTTP/1.1 413 Payload Too Large\r\n"));
+  EXPECT_EQ(0u, Request("GET /1.m4s HTTP/1.1\r\nContent-Length: 0\r\n\r\n")
+                    .find("HTTP/1.1 200 OK\r\n"));
+}
+
+TEST_F(SegmentStoreHttpServerTest, SegmentBeingWritten) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.m4s");
+  WriteString(segment.get(), "abc");
+
+  const int client = SendRequest("GET /1.m4s HTTP/1.1\r\n\r\n");
+  ASSERT_NE(-1, client);
+  std::string response;
+  // The data written so far is sent right away.
+  Receive(client, "abc\r\n", &response);
+  WriteString(segment.get(), "defghij");
+  segment->Finish();
+  Receive(client, std::string(), &response);
+  close(client);
+
+  EXPECT_NE(std::string::npos,
+            GetHeader(response).find("Transfer-Encoding: chunked\r\n"));
+  EXPECT_EQ("abcdefghij", DecodeChunks(GetBody(response)));
+}
+
+TEST_F(SegmentStoreHttpServerTest, SegmentBeingWrittenHttp10) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.ts");
+  WriteString(segment.get(), "abc");
+
+  const int client = SendRequest("GET /1.ts HTTP/1.0\r\n\r\n");
+  ASSERT_NE(-1, client);
+  std::string response;
+  Receive(client, "abc", &response);
+  WriteString(segment.get(), "defghij");
+  segment->Finish();
+  Receive(client, std::string(), &response);
+  close(client);
+
+  EXPECT_EQ(std::string::npos, GetHeader(response).find("Transfer-Encoding"));
+  EXPECT_EQ("abcdefghij", GetBody(response));
+}
+
+TEST_F(SegmentStoreHttpServerTest, SegmentAbandoned) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.m4s");
+  WriteString(segment.get(), "abc");
+
+  const int client = SendRequest("GET /1.m4s HTTP/1.1\r\n\r\n");
+  ASSERT_NE(-1, client);
+  std::string response;
+  Receive(client, "abc\r\n", &response);
+  EXPECT_TRUE(store_.Delete("1.m4s"));
+  Receive(client, std::string(), &response);
+  close(client);
+
+  // The last chunk is not sent, so the response is seen as truncated.
+  EXPECT_EQ("3\r\nabc\r\n", GetBody(response));
+}
+
+TEST_F(SegmentStoreHttpServerTest, TooManyConnections) {
+  SegmentStoreHttpServer server(&store_);
+  server.set_max_connections(1);
+  ASSERT_TRUE(server.Start(kLocalhost, 0));
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.m4s");
+  WriteString(segment.get(), "abc");
+
+  const int client =
+      SendRequestToPort(server.port(), "GET /1.m4s HTTP/1.1\r\n\r\n");
+  ASSERT_NE(-1, client);
+  std::string response;
+  Receive(client, "abc\r\n", &response);
+
+  // The first connection waits for the segment to be written.
+  const int rejected_client =
+      SendRequestToPort(server.port(), "GET /1.m4s HTTP/1.1\r\n\r\n");
+  ASSERT_NE(-1, rejected_client);
+  std::string rejected_response;
+  Receive(rejected_client, std::string(), &rejected_response);
+  close(rejected_client);
+  EXPECT_EQ(0u,
+            rejected_response.find("HTTP/1.1 503 Service Unavailable\r\n"));
+
+  segment->Finish();
+  Receive(client, std::string(), &response);
+  close(client);
+  EXPECT_EQ("abc", DecodeChunks(GetBody(response)));
+}
+
+TEST_F(SegmentStoreHttpServerTest, Head) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("1.m4s");
+  WriteString(segment.get(), "abc");
+  segment->Finish();
+
+  const std::string response =
+      Request("HEAD /1.m4s HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  EXPECT_NE(std::string::npos, response.find("Content-Length: 3\r\n"));
+  EXPECT_EQ("", GetBody(response));
+}
+
+TEST_F(SegmentStoreHttpServerTest, NotFound) {
+  EXPECT_EQ(0u, Get("/missing.m4s").find("HTTP/1.1 404 Not Found\r\n"));
+}
+
+TEST_F(SegmentStoreHttpServerTest, MethodNotAllowed) {
+  EXPECT_EQ(0u, Request("POST /1.m4s HTTP/1.1\r\n\r\n")
+                    .find("HTTP/1.1 405 Method Not Allowed\r\n"));
+}
+
+TEST_F(SegmentStoreHttpServerTest, BadRequest) {
+  EXPECT_EQ(0u, Request("GET\r\n\r\n").find("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,58 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/segment_store_http_server.h"
+
+#include "packager/base/logging.h"
+#include "packager/media/base/closure_thread.h"
+
+namespace shaka {
+namespace media {
+
+SegmentStoreHttpServer::SegmentStoreHttpServer(SegmentStore* store)
+    : store_(store),
+      socket_(0),
+      port_(0),
+      max_connections_(kDefaultMaxConnections),
+      stopping_(0) {}
+
+SegmentStoreHttpServer::~SegmentStoreHttpServer() {}
+
+SegmentStoreHttpServer::ConnectionCounter::ConnectionCounter() : count_(0) {}
+
+SegmentStoreHttpServer::ConnectionCounter::~ConnectionCounter() {}
+
+bool SegmentStoreHttpServer::ConnectionCounter::TryAdd(int max_connections) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+void SegmentStoreHttpServer::ConnectionCounter::Remove() {
+  NOTIMPLEMENTED();
+}
+
+bool SegmentStoreHttpServer::Start(const std::string& address,
+                                   uint16_t port) {
+  NOTIMPLEMENTED();
+  return false;
+}
+
+void SegmentStoreHttpServer::Stop() {}
+
+// static
+void SegmentStoreHttpServer::ServeConnection(
+    SegmentStore* store,
+    int socket,
+    const scoped_refptr<ConnectionCounter>& connections) {
+  NOTIMPLEMENTED();
+}
+
+void SegmentStoreHttpServer::AcceptLoop() {
+  NOTIMPLEMENTED();
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,282 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/file_closer.h"
+#include "packager/media/file/segment_store.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+const size_t kSegmentSize = 3 * SegmentStore::kChunkSize + 100;
+
+std::string GetContent(size_t size) {
+  std::string content(size, 0);
+  for (size_t i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>(i * 13);
+  return content;
+}
+
+std::string ReadAll(SegmentStore::Segment* segment) {
+  std::string content;
+  char buffer[1000];
+  while (true) {
+    const int64_t bytes_read =
+        segment->Read(content.size(), true, buffer, sizeof(buffer));
+    if (bytes_read == 0)
+      break;
+    content.append(buffer, bytes_read);
+  }
+  return content;
+}
+}  // namespace
+
+class SegmentStoreTest : public testing::Test {
+ public:
+  // Writes |content| in pieces of |write_size| to |segment|, then finishes it.
+  void WriteSegment(const std::string& content,
+                    size_t write_size,
+                    const scoped_refptr<SegmentStore::Segment>& segment) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(content.data());
+    for (size_t offset = 0; offset < content.size(); offset += write_size) {
+      segment->Write(offset, data + offset,
+                     std::min(write_size, content.size() - offset));
+    }
+    segment->Finish();
+  }
+
+  void DeleteSegment(const std::string& name) { store_.Delete(name); }
+
+ protected:
+  void TearDown() override { SegmentStore::GetInstance()->Clear(); }
+
+  SegmentStore store_;
+};
+
+TEST_F(SegmentStoreTest, WriteAndRead) {
+  const std::string content = GetContent(kSegmentSize);
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  WriteSegment(content, 1000, segment);
+
+  scoped_refptr<SegmentStore::Segment> read_segment = store_.Get("a.m4s");
+  ASSERT_TRUE(read_segment);
+  EXPECT_TRUE(read_segment->IsComplete());
+  EXPECT_EQ(kSegmentSize, read_segment->Size());
+  EXPECT_EQ(content, ReadAll(read_segment.get()));
+  EXPECT_FALSE(store_.Get("b.m4s"));
+}
+
+TEST_F(SegmentStoreTest, ReadWhileWriting) {
+  const std::string content = GetContent(kSegmentSize);
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  ClosureThread writer(
+      "Writer", base::Bind(&SegmentStoreTest::WriteSegment,
+                           base::Unretained(this), content, 100, segment));
+  writer.Start();
+  // Reads wait for the data not written yet.
+  EXPECT_EQ(content, ReadAll(store_.Get("a.m4s").get()));
+  writer.Join();
+}
+
+TEST_F(SegmentStoreTest, NoWait) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  uint8_t data[10] = {};
+  segment->Write(0, data, sizeof(data));
+
+  uint8_t buffer[20];
+  EXPECT_EQ(10, segment->Read(0, false, buffer, sizeof(buffer)));
+  EXPECT_EQ(0, segment->Read(10, false, buffer, sizeof(buffer)));
+  EXPECT_FALSE(segment->IsComplete());
+}
+
+TEST_F(SegmentStoreTest, OverwriteChunkHeldByReader) {
+  const std::string content = GetContent(kSegmentSize);
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.mp4");
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(content.data());
+  segment->Write(0, data, content.size());
+
+  scoped_refptr<base::RefCountedBytes> chunk;
+  const uint8_t* chunk_data = NULL;
+  size_t length = 0;
+  ASSERT_TRUE(segment->GetData(0, false, &chunk, &chunk_data, &length));
+  EXPECT_EQ(SegmentStore::kChunkSize, length);
+
+  // Overwrite the header, as done by muxers once the segment is written.
+  const std::string kUpdate = "header update";
+  segment->Write(10, reinterpret_cast<const uint8_t*>(kUpdate.data()),
+                 kUpdate.size());
+  segment->Finish();
+
+  // The data held by the reader is not modified.
+  EXPECT_EQ(content.substr(0, length),
+            std::string(reinterpret_cast<const char*>(chunk_data), length));
+  std::string expected = content;
+  expected.replace(10, kUpdate.size(), kUpdate);
+  EXPECT_EQ(expected, ReadAll(segment.get()));
+}
+
+TEST_F(SegmentStoreTest, ReplaceWhileReading) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.mpd");
+  WriteSegment("old", 10, segment);
+  scoped_refptr<SegmentStore::Segment> old_segment = store_.Get("a.mpd");
+
+  WriteSegment("new", 10, store_.Create("a.mpd").get());
+  EXPECT_EQ("old", ReadAll(old_segment.get()));
+  EXPECT_EQ("new", ReadAll(store_.Get("a.mpd").get()));
+}
+
+TEST_F(SegmentStoreTest, Reopen) {
+  // Appending starts at the end of the existing data, which ends in a partial
+  // chunk.
+  const std::string content = GetContent(kSegmentSize);
+  WriteSegment(content.substr(0, 100), 10, store_.Create("a.mp4"));
+  scoped_refptr<SegmentStore::Segment> old_segment = store_.Get("a.mp4");
+  scoped_refptr<SegmentStore::Segment> segment = store_.Reopen("a.mp4");
+  EXPECT_EQ(100u, segment->Size());
+  EXPECT_FALSE(segment->IsComplete());
+  segment->Write(100, reinterpret_cast<const uint8_t*>(content.data()) + 100,
+                 content.size() - 100);
+  segment->Finish();
+
+  EXPECT_EQ(content, ReadAll(store_.Get("a.mp4").get()));
+  // The readers of the replaced segment do not see the new data.
+  EXPECT_EQ(content.substr(0, 100), ReadAll(old_segment.get()));
+
+  // Reopening a missing segment creates it.
+  EXPECT_EQ(0u, store_.Reopen("b.mp4")->Size());
+}
+
+TEST_F(SegmentStoreTest, ReplaceAbandonsSegment) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  segment->Write(0, reinterpret_cast<const uint8_t*>("abc"), 3);
+  WriteSegment("new", 10, store_.Create("a.m4s"));
+
+  // The reader gets the data written so far instead of waiting for the
+  // replaced segment to be completed.
+  EXPECT_TRUE(segment->IsAbandoned());
+  EXPECT_FALSE(segment->IsComplete());
+  EXPECT_EQ("abc", ReadAll(segment.get()));
+}
+
+TEST_F(SegmentStoreTest, DeleteWakesReaders) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  segment->Write(0, reinterpret_cast<const uint8_t*>("abc"), 3);
+  ClosureThread deleter(
+      "Deleter", base::Bind(&SegmentStoreTest::DeleteSegment,
+                            base::Unretained(this), std::string("a.m4s")));
+  deleter.Start();
+  EXPECT_EQ("abc", ReadAll(segment.get()));
+  deleter.Join();
+  EXPECT_TRUE(segment->IsAbandoned());
+}
+
+TEST_F(SegmentStoreTest, MaxWait) {
+  store_.set_max_wait(base::TimeDelta::FromMilliseconds(10));
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  segment->Write(0, reinterpret_cast<const uint8_t*>("abc"), 3);
+
+  // The writer never completes the segment.
+  EXPECT_EQ("abc", ReadAll(segment.get()));
+  EXPECT_FALSE(segment->IsComplete());
+  EXPECT_FALSE(segment->IsAbandoned());
+}
+
+TEST_F(SegmentStoreTest, AbandonCompleteSegment) {
+  scoped_refptr<SegmentStore::Segment> segment = store_.Create("a.m4s");
+  WriteSegment("abc", 10, segment);
+  segment->Abandon();
+  EXPECT_FALSE(segment->IsAbandoned());
+  EXPECT_EQ("abc", ReadAll(segment.get()));
+}
+
+TEST_F(SegmentStoreTest, EvictExpiredSegments) {
+  const base::TimeDelta kRetention = base::TimeDelta::FromSeconds(30);
+  store_.set_retention(kRetention);
+  store_.AddEvictionPattern("live/video_$Number$.m4s");
+  WriteSegment("init", 10, store_.Create("live/video_init.mp4").get());
+  WriteSegment("1", 10, store_.Create("live/video_1.m4s").get());
+  WriteSegment("2", 10, store_.Create("live/video_2.m4s").get());
+  // Not complete.
+  store_.Create("live/video_3.m4s");
+  // Identifiers do not match '/'.
+  WriteSegment("x", 10, store_.Create("live/video_x/1.m4s").get());
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  EXPECT_EQ(0u, store_.EvictExpiredSegments(now));
+  EXPECT_EQ(2u, store_.EvictExpiredSegments(now + kRetention));
+
+  std::vector<std::string> expected;
+  expected.push_back("live/video_3.m4s");
+  expected.push_back("live/video_init.mp4");
+  expected.push_back("live/video_x/1.m4s");
+  EXPECT_EQ(expected, store_.GetNames());
+}
+
+TEST_F(SegmentStoreTest, NoEvictionWithoutRetention) {
+  store_.AddEvictionPattern("$Number$.m4s");
+  WriteSegment("1", 10, store_.Create("1.m4s").get());
+  EXPECT_EQ(0u, store_.EvictExpiredSegments(base::TimeTicks::Now() +
+                                            base::TimeDelta::FromDays(1)));
+  EXPECT_TRUE(store_.Get("1.m4s"));
+}
+
+TEST_F(SegmentStoreTest, Delete) {
+  store_.Create("a.m4s");
+  EXPECT_TRUE(store_.Delete("a.m4s"));
+  EXPECT_FALSE(store_.Delete("a.m4s"));
+  EXPECT_FALSE(store_.Get("a.m4s"));
+}
+
+TEST_F(SegmentStoreTest, File) {
+  const std::string content = GetContent(kSegmentSize);
+  const std::string kFileName = std::string(kSegmentStoreFilePrefix) + "a.m4s";
+
+  scoped_ptr<File, FileCloser> writer(File::Open(kFileName.c_str(), "w"));
+  ASSERT_TRUE(writer);
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            writer->Write(content.data(), content.size()));
+  // The file can be read while it is written.
+  scoped_ptr<File, FileCloser> reader(File::Open(kFileName.c_str(), "r"));
+  ASSERT_TRUE(reader);
+  EXPECT_FALSE(SegmentStore::GetInstance()->Get("a.m4s")->IsComplete());
+  ASSERT_TRUE(writer.release()->Close());
+
+  std::string read_content(content.size() + 1, 0);
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            reader->Read(&read_content[0], read_content.size()));
+  read_content.resize(content.size());
+  EXPECT_EQ(content, read_content);
+  EXPECT_EQ(0, reader->Read(&read_content[0], read_content.size()));
+
+  EXPECT_TRUE(File::Delete(kFileName.c_str()));
+  EXPECT_FALSE(File::Open(kFileName.c_str(), "r"));
+}
+
+TEST_F(SegmentStoreTest, FileAppend) {
+  const std::string kFileName = std::string(kSegmentStoreFilePrefix) + "a.mp4";
+  for (const char* data : {"abc", "de"}) {
+    scoped_ptr<File, FileCloser> writer(File::Open(kFileName.c_str(), "a"));
+    ASSERT_TRUE(writer);
+    EXPECT_EQ(static_cast<int64_t>(strlen(data)),
+              writer->Write(data, strlen(data)));
+  }
+  EXPECT_EQ("abcde", ReadAll(SegmentStore::GetInstance()->Get("a.mp4").get()));
+  EXPECT_TRUE(SegmentStore::GetInstance()->Get("a.mp4")->IsComplete());
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -6,6 +6,10 @@
 
 #include "packager/media/file/threaded_io_file.h"
 
+#include <string.h>
+
+#include <algorithm>
+
 #include "packager/base/bind.h"
 #include "packager/base/bind_helpers.h"
 #include "packager/base/location.h"
@@ -17,6 +21,17 @@ namespace media {
 using base::subtle::NoBarrier_Load;
 using base::subtle::NoBarrier_Store;
 
+namespace {
+// A block is read from or written to |internal_file_| while another one is
+// processed by the ThreadedIoFile user, so at least two blocks are needed.
+const uint64_t kMinNumBlocks = 2;
+
+size_t GetNumBlocks(uint64_t io_cache_size, uint64_t io_block_size) {
+  DCHECK_GT(io_block_size, 0u);
+  return std::max(kMinNumBlocks, io_cache_size / io_block_size);
+}
+}  // namespace
+
 ThreadedIoFile::ThreadedIoFile(scoped_ptr<File, FileCloser> internal_file,
                                Mode mode,
                                uint64_t io_cache_size,
@@ -24,13 +39,12 @@ ThreadedIoFile::ThreadedIoFile(scoped_ptr<File, FileCloser> internal_file,
     : File(internal_file->file_name()),
       internal_file_(internal_file.Pass()),
       mode_(mode),
-      cache_(io_cache_size),
-      io_buffer_(io_block_size),
+      ring_(GetNumBlocks(io_cache_size, io_block_size), io_block_size),
+      write_block_(NULL),
+      write_block_size_(0),
       position_(0),
       size_(0),
       eof_(false),
-      flushing_(false),
-      flush_complete_event_(false, false),
       internal_file_error_(0),
       task_exit_event_(false, false) {
   DCHECK(internal_file_);
@@ -43,6 +57,9 @@ bool ThreadedIoFile::Open() {
 
   if (!internal_file_->Open())
     return false;
+  // Input is read sequentially by the I/O thread.
+  if (mode_ == kInputMode)
+    internal_file_->AdviseSequentialRead();
 
   position_ = 0;
   size_ = internal_file_->Size();
@@ -59,7 +76,7 @@ bool ThreadedIoFile::Close() {
   if (mode_ == kOutputMode)
     Flush();
 
-  cache_.Close();
+  ring_.Close();
   task_exit_event_.Wait();
 
   bool result = internal_file_.release()->Close();
@@ -71,14 +88,13 @@ int64_t ThreadedIoFile::Read(void* buffer, uint64_t length) {
   DCHECK(internal_file_);
   DCHECK_EQ(kInputMode, mode_);
 
-  if (NoBarrier_Load(&eof_) && !cache_.BytesCached())
+  if (NoBarrier_Load(&eof_) && ring_.IsEmpty())
     return 0;
 
   if (NoBarrier_Load(&internal_file_error_))
     return NoBarrier_Load(&internal_file_error_);
 
-
-  uint64_t bytes_read = cache_.Read(buffer, length);
+  uint64_t bytes_read = ring_.Read(buffer, length);
   position_ += bytes_read;
 
   return bytes_read;
@@ -91,7 +107,25 @@ int64_t ThreadedIoFile::Write(const void* buffer, uint64_t length) {
   if (NoBarrier_Load(&internal_file_error_))
     return NoBarrier_Load(&internal_file_error_);
 
-  uint64_t bytes_written = cache_.Write(buffer, length);
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_written = 0;
+  while (bytes_written < length) {
+    if (!write_block_) {
+      write_block_ = ring_.AcquireFreeBlock();
+      if (!write_block_) {
+        // The ring is closed, following a write error.
+        return NoBarrier_Load(&internal_file_error_);
+      }
+      write_block_size_ = 0;
+    }
+    const size_t copy_size = std::min<uint64_t>(
+        length - bytes_written, ring_.block_size() - write_block_size_);
+    memcpy(write_block_ + write_block_size_, data + bytes_written, copy_size);
+    write_block_size_ += copy_size;
+    bytes_written += copy_size;
+    if (write_block_size_ == ring_.block_size())
+      CommitWriteBlock();
+  }
   position_ += bytes_written;
   if (position_ > size_)
     size_ = position_;
@@ -109,9 +143,11 @@ bool ThreadedIoFile::Flush() {
   DCHECK(internal_file_);
   DCHECK_EQ(kOutputMode, mode_);
 
-  flushing_ = true;
-  cache_.Close();
-  flush_complete_event_.Wait();
+  if (write_block_)
+    CommitWriteBlock();
+  ring_.WaitUntilEmptyOrClosed();
+  if (NoBarrier_Load(&internal_file_error_))
+    return false;
   return internal_file_->Flush();
 }
 
@@ -123,7 +159,7 @@ bool ThreadedIoFile::Seek(uint64_t position) {
   } else {
     // Reading. Close cache, wait for thread task to exit, seek, and re-post
     // the task.
-    cache_.Close();
+    ring_.Close();
     task_exit_event_.Wait();
     bool result = internal_file_->Seek(position);
     if (!result) {
@@ -132,7 +168,7 @@ bool ThreadedIoFile::Seek(uint64_t position) {
         LOG(WARNING) << "Seek failed. ThreadedIoFile left in invalid state.";
       }
     }
-    cache_.Reopen();
+    ring_.Reopen();
     eof_ = false;
     base::WorkerPool::PostTask(
         FROM_HERE,
@@ -151,6 +187,14 @@ bool ThreadedIoFile::Tell(uint64_t* position) {
   return true;
 }
 
+void ThreadedIoFile::CommitWriteBlock() {
+  DCHECK(write_block_);
+  DCHECK_GT(write_block_size_, 0u);
+  ring_.CommitBlock(write_block_size_);
+  write_block_ = NULL;
+  write_block_size_ = 0;
+}
+
 void ThreadedIoFile::TaskHandler() {
   if (mode_ == kInputMode)
     RunInInputMode();
@@ -164,17 +208,17 @@ void ThreadedIoFile::RunInInputMode() {
   DCHECK_EQ(kInputMode, mode_);
 
   while (true) {
-    int64_t read_result = internal_file_->Read(&io_buffer_[0],
-                                               io_buffer_.size());
+    uint8_t* block = ring_.AcquireFreeBlock();
+    if (!block)
+      return;
+    int64_t read_result = internal_file_->Read(block, ring_.block_size());
     if (read_result <= 0) {
       NoBarrier_Store(&eof_, read_result == 0);
       NoBarrier_Store(&internal_file_error_, read_result);
-      cache_.Close();
-      return;
-    }
-    if (cache_.Write(&io_buffer_[0], read_result) == 0) {
+      ring_.Close();
       return;
     }
+    ring_.CommitBlock(read_result);
   }
 }
 
@@ -183,28 +227,22 @@ void ThreadedIoFile::RunInOutputMode() {
   DCHECK_EQ(kOutputMode, mode_);
 
   while (true) {
-    uint64_t write_bytes = cache_.Read(&io_buffer_[0], io_buffer_.size());
-    if (write_bytes == 0) {
-      if (flushing_) {
-        cache_.Reopen();
-        flushing_ = false;
-        flush_complete_event_.Signal();
-      } else {
+    size_t write_bytes = 0;
+    const uint8_t* block = ring_.PeekFilledBlock(&write_bytes);
+    if (!block)
+      return;
+    uint64_t bytes_written(0);
+    while (bytes_written < write_bytes) {
+      int64_t write_result = internal_file_->Write(
+          block + bytes_written, write_bytes - bytes_written);
+      if (write_result < 0) {
+        NoBarrier_Store(&internal_file_error_, write_result);
+        ring_.Close();
         return;
       }
-    } else {
-      uint64_t bytes_written(0);
-      while (bytes_written < write_bytes) {
-        int64_t write_result = internal_file_->Write(
-            &io_buffer_[bytes_written], write_bytes - bytes_written);
-        if (write_result < 0) {
-          NoBarrier_Store(&internal_file_error_, write_result);
-          cache_.Close();
-          return;
-        }
-        bytes_written += write_result;
-      }
+      bytes_written += write_result;
     }
+    ring_.Consume(write_bytes);
   }
 }
 
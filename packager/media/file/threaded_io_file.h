@@ -12,7 +12,7 @@
 #include "packager/base/synchronization/waitable_event.h"
 #include "packager/media/file/file.h"
 #include "packager/media/file/file_closer.h"
-#include "packager/media/file/io_cache.h"
+#include "packager/media/file/io_block_ring.h"
 
 namespace shaka {
 namespace media {
@@ -53,15 +53,20 @@ class ThreadedIoFile : public File {
   void RunInInputMode();
   void RunInOutputMode();
 
+  // Hands the pending output block to the I/O thread.
+  void CommitWriteBlock();
+
   scoped_ptr<File, FileCloser> internal_file_;
   const Mode mode_;
-  IoCache cache_;
-  std::vector<uint8_t> io_buffer_;
+  // In input mode, the I/O thread reads directly into the ring blocks. In
+  // output mode, the I/O thread writes directly from the ring blocks.
+  IoBlockRing ring_;
+  // Output block being filled by Write(), and the number of bytes in it.
+  uint8_t* write_block_;
+  size_t write_block_size_;
   uint64_t position_;
   uint64_t size_;
   base::subtle::Atomic32 eof_;
-  bool flushing_;
-  base::WaitableEvent flush_complete_event_;
   base::subtle::Atomic32 internal_file_error_;
   // Signalled when thread task exits.
   base::WaitableEvent task_exit_event_;
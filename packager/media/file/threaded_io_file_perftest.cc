@@ -0,0 +1,80 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Read throughput of threaded local files at several I/O block sizes. Run
+// them with:
+//   packager_perftest --gtest_filter=*ThreadedIoFilePerfTest*
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/time/time.h"
+#include "packager/media/file/file.h"
+
+DECLARE_uint64(io_cache_size);
+DECLARE_uint64(io_block_size);
+
+namespace shaka {
+namespace media {
+
+namespace {
+const uint64_t kFileSize = 256 * 1024 * 1024;
+// Typical read size of the demuxer.
+const uint64_t kReadSize = 64 * 1024;
+}  // namespace
+
+class ThreadedIoFilePerfTest : public ::testing::TestWithParam<uint64_t> {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateTemporaryFile(&file_path_));
+    std::string data(kFileSize, 0);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = static_cast<char>(i * 31);
+    ASSERT_EQ(static_cast<int>(data.size()),
+              base::WriteFile(file_path_, data.data(), data.size()));
+  }
+
+  void TearDown() override { base::DeleteFile(file_path_, false); }
+
+  base::FilePath file_path_;
+};
+
+TEST_P(ThreadedIoFilePerfTest, Read) {
+  google::FlagSaver flag_saver;
+  FLAGS_io_block_size = GetParam();
+
+  std::vector<uint8_t> buffer(kReadSize);
+  uint64_t bytes_read = 0;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  File* file = File::Open(file_path_.value().c_str(), "r");
+  ASSERT_TRUE(file);
+  while (true) {
+    int64_t result = file->Read(buffer.data(), buffer.size());
+    ASSERT_GE(result, 0);
+    if (result == 0)
+      break;
+    bytes_read += result;
+  }
+  ASSERT_TRUE(file->Close());
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  EXPECT_EQ(kFileSize, bytes_read);
+  LOG(INFO) << "io_block_size " << GetParam() << ": "
+            << bytes_read / elapsed.InSecondsF() / (1024 * 1024) << " MB/s";
+}
+
+INSTANTIATE_TEST_CASE_P(IoBlockSizes,
+                        ThreadedIoFilePerfTest,
+                        ::testing::Values(64u * 1024,
+                                          256u * 1024,
+                                          1024u * 1024,
+                                          2u * 1024 * 1024,
+                                          8u * 1024 * 1024));
+
+}  // namespace media
+}  // namespace shaka
@@ -11,15 +11,47 @@
 
 #include <string>
 
+#include "packager/base/atomicops.h"
 #include "packager/base/compiler_specific.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
 #include "packager/media/file/file.h"
 
+namespace base {
+class WaitableEvent;
+}  // namespace base
+
 namespace shaka {
 namespace media {
 
+class IoBlockRing;
+
 /// Implements UdpFile, which receives UDP unicast and multicast streams.
+/// Datagrams are received in batches on a dedicated thread into a ring of
+/// preallocated datagram buffers, which Read() drains.
 class UdpFile : public File {
  public:
+  /// Receive counters.
+  struct Stats {
+    Stats();
+
+    /// Number of datagrams received.
+    uint64_t datagrams;
+    /// Number of bytes received.
+    uint64_t bytes;
+    /// Number of datagrams dropped by the system because the socket receive
+    /// buffer was full. Only available on Linux.
+    uint64_t kernel_drops;
+    /// Number of times the receive thread found the datagram ring full and
+    /// had to wait for Read() to drain it.
+    uint64_t ring_overruns;
+    /// Number of datagrams larger than the ring buffers, and truncated.
+    uint64_t truncated_datagrams;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
   /// @param file_name C string containing the address of the stream to receive.
   ///        It should be of the form "<ip_address>:<port>".
   explicit UdpFile(const char* address_and_port);
@@ -35,13 +67,26 @@ class UdpFile : public File {
   bool Tell(uint64_t* position) override;
   /// @}
 
+  /// @return a snapshot of the receive counters.
+  Stats GetStats() const;
+
  protected:
   ~UdpFile() override;
 
   bool Open() override;
 
  private:
+  // Receives datagrams into |ring_| until it is closed.
+  void ReceiveTask();
+
   int socket_;
+  scoped_ptr<IoBlockRing> ring_;
+  // Signalled when ReceiveTask() exits.
+  scoped_ptr<base::WaitableEvent> receive_exit_event_;
+  // Set by ReceiveTask() on a socket error.
+  base::subtle::Atomic32 receive_error_;
+  mutable base::Lock stats_lock_;
+  Stats stats_;
 
   DISALLOW_COPY_AND_ASSIGN(UdpFile);
 };
@@ -9,14 +9,27 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <gflags/gflags.h>
+#include <inttypes.h>
+#include <string.h>
 #include <strings.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/location.h"
 #include "packager/base/logging.h"
 #include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/worker_pool.h"
+#include "packager/build/build_config.h"
+#include "packager/media/file/io_block_ring.h"
 
 // TODO(tinskip): Adapt to work with winsock.
 
@@ -24,13 +37,36 @@ DEFINE_string(udp_interface_address,
               "0.0.0.0",
               "IP address of the interface over which to receive UDP unicast"
               " or multicast streams");
+DEFINE_uint64(udp_receive_buffer_size,
+              0,
+              "Size of the socket receive buffer (SO_RCVBUF) of UDP inputs, in "
+              "bytes. Specify 0 to keep the system default. The system may "
+              "cap the size, e.g. to net.core.rmem_max on Linux.");
+DEFINE_uint64(udp_ring_datagrams,
+              2048,
+              "Number of datagrams buffered between the receive thread of a "
+              "UDP input and the demuxer. Rounded up to a power of two.");
+DEFINE_uint64(udp_max_datagram_size,
+              9216,
+              "Size of each datagram buffer of UDP inputs, in bytes. Larger "
+              "datagrams are truncated.");
 
 namespace shaka {
 namespace media {
 
+using base::subtle::Acquire_Load;
+using base::subtle::Release_Store;
+
 namespace {
 
 const int kInvalidSocket(-1);
+// Maximum number of datagrams received in a single system call.
+const size_t kMaxBatchSize = 64;
+// Receive timeout, so that the receive thread notices when the file is closed
+// even if no datagram arrives.
+const int kReceiveTimeoutMs = 100;
+// Minimum number of datagrams in the ring, see IoBlockRing.
+const uint64_t kMinRingDatagrams = 2;
 
 bool StringToIpv4Address(const std::string& addr_in, uint32_t* addr_out) {
   DCHECK(addr_out);
@@ -79,15 +115,134 @@ bool IsIpv4MulticastAddress(uint32_t addr) {
   return (addr & 0xf0000000) == 0xe0000000;
 }
 
+// Receives batches of datagrams into caller provided buffers, with recvmmsg
+// where available and one datagram at a time otherwise.
+class DatagramBatchReceiver {
+ public:
+  DatagramBatchReceiver()
+      : iovecs_(kMaxBatchSize),
+#if defined(OS_LINUX)
+        messages_(kMaxBatchSize),
+        control_(kMaxBatchSize * kControlSize),
+#else
+        headers_(kMaxBatchSize),
+#endif
+        sizes_(kMaxBatchSize) {
+  }
+
+  // Receives up to |buffers.size()| datagrams, waiting for the first one only.
+  // Returns the number of datagrams received, or -1 on error with errno set.
+  int Receive(int socket, const std::vector<uint8_t*>& buffers,
+              size_t buffer_size) {
+    DCHECK(!buffers.empty());
+    DCHECK_LE(buffers.size(), kMaxBatchSize);
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      iovecs_[i].iov_base = buffers[i];
+      iovecs_[i].iov_len = buffer_size;
+      struct msghdr* header = GetHeader(i);
+      bzero(header, sizeof(*header));
+      header->msg_iov = &iovecs_[i];
+      header->msg_iovlen = 1;
+#if defined(OS_LINUX)
+      header->msg_control = &control_[i * kControlSize];
+      header->msg_controllen = kControlSize;
+#endif
+    }
+#if defined(OS_LINUX)
+    int result = recvmmsg(socket, &messages_[0], buffers.size(),
+                          MSG_WAITFORONE, NULL);
+    for (int i = 0; i < result; ++i)
+      sizes_[i] = messages_[i].msg_len;
+#else
+    ssize_t size = recvmsg(socket, GetHeader(0), 0);
+    int result = size < 0 ? -1 : 1;
+    if (result == 1)
+      sizes_[0] = size;
+#endif
+    return result;
+  }
+
+  // Accessors for the datagram |index| of the last Receive().
+  const size_t* sizes() const { return &sizes_[0]; }
+  bool IsTruncated(size_t index) {
+    return (GetHeader(index)->msg_flags & MSG_TRUNC) != 0;
+  }
+  // Gets the cumulative count of datagrams dropped by the system on the
+  // socket, if reported with the datagram |index|.
+  bool GetDropCount(size_t index, uint32_t* drop_count) {
+#if defined(OS_LINUX)
+    struct msghdr* header = GetHeader(index);
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(header); cmsg;
+         cmsg = CMSG_NXTHDR(header, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+        memcpy(drop_count, CMSG_DATA(cmsg), sizeof(*drop_count));
+        return true;
+      }
+    }
+#endif
+    return false;
+  }
+
+ private:
+  struct msghdr* GetHeader(size_t index) {
+#if defined(OS_LINUX)
+    return &messages_[index].msg_hdr;
+#else
+    return &headers_[index];
+#endif
+  }
+
+#if defined(OS_LINUX)
+  // Room for the SO_RXQ_OVFL drop count of a datagram.
+  static const size_t kControlSize;
+#endif
+
+  std::vector<struct iovec> iovecs_;
+#if defined(OS_LINUX)
+  std::vector<struct mmsghdr> messages_;
+  std::vector<uint8_t> control_;
+#else
+  std::vector<struct msghdr> headers_;
+#endif
+  std::vector<size_t> sizes_;
+
+  DISALLOW_COPY_AND_ASSIGN(DatagramBatchReceiver);
+};
+
+#if defined(OS_LINUX)
+const size_t DatagramBatchReceiver::kControlSize =
+    CMSG_SPACE(sizeof(uint32_t));
+#endif
+
 }  // anonymous namespace
 
+UdpFile::Stats::Stats()
+    : datagrams(0),
+      bytes(0),
+      kernel_drops(0),
+      ring_overruns(0),
+      truncated_datagrams(0) {}
+
+std::string UdpFile::Stats::ToString() const {
+  return base::StringPrintf(
+      "datagrams: %" PRIu64 " bytes: %" PRIu64 " kernel_drops: %" PRIu64
+      " ring_overruns: %" PRIu64 " truncated_datagrams: %" PRIu64,
+      datagrams, bytes, kernel_drops, ring_overruns, truncated_datagrams);
+}
+
 UdpFile::UdpFile(const char* file_name) :
     File(file_name),
-    socket_(kInvalidSocket) {}
+    socket_(kInvalidSocket),
+    receive_error_(0) {}
 
 UdpFile::~UdpFile() {}
 
 bool UdpFile::Close() {
+  if (ring_) {
+    ring_->Close();
+    receive_exit_event_->Wait();
+    VLOG(1) << "UDP input '" << file_name() << "' " << GetStats().ToString();
+  }
   if (socket_ != kInvalidSocket) {
     close(socket_);
     socket_ = kInvalidSocket;
@@ -98,18 +253,15 @@ bool UdpFile::Close() {
 
 int64_t UdpFile::Read(void* buffer, uint64_t length) {
   DCHECK(buffer);
-  DCHECK_GE(length, 65535u)
-      << "Buffer may be too small to read entire datagram.";
 
   if (socket_ == kInvalidSocket)
     return -1;
 
-  int64_t result;
-  do {
-    result = recvfrom(socket_, buffer, length, 0, NULL, 0);
-  } while ((result == -1) && (errno == EINTR));
-
-  return result;
+  // Whole datagrams are returned as long as |length| allows.
+  const size_t bytes_read = ring_->Read(buffer, length);
+  if (bytes_read == 0 && Acquire_Load(&receive_error_))
+    return -1;
+  return bytes_read;
 }
 
 int64_t UdpFile::Write(const void* buffer, uint64_t length) {
@@ -182,6 +334,45 @@ bool UdpFile::Open() {
     return false;
   }
 
+  if (FLAGS_udp_receive_buffer_size > 0) {
+    const int receive_buffer_size = static_cast<int>(std::min<uint64_t>(
+        FLAGS_udp_receive_buffer_size, std::numeric_limits<int>::max()));
+    if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RCVBUF,
+                   &receive_buffer_size, sizeof(receive_buffer_size)) < 0) {
+      LOG(WARNING) << "Failed to set UDP socket receive buffer size.";
+    }
+    int actual_size = 0;
+    socklen_t option_size = sizeof(actual_size);
+    if (getsockopt(new_socket.get(), SOL_SOCKET, SO_RCVBUF, &actual_size,
+                   &option_size) == 0) {
+      // Linux reports twice the size set, to account for its bookkeeping.
+      LOG_IF(WARNING, actual_size < receive_buffer_size)
+          << "UDP socket receive buffer size is " << actual_size
+          << " bytes, less than the " << receive_buffer_size
+          << " bytes requested. It may be capped by the system.";
+    }
+  }
+
+  // Receive calls time out so that the receive thread can exit once the file
+  // is closed.
+  struct timeval receive_timeout;
+  receive_timeout.tv_sec = 0;
+  receive_timeout.tv_usec = kReceiveTimeoutMs * 1000;
+  if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RCVTIMEO, &receive_timeout,
+                 sizeof(receive_timeout)) < 0) {
+    LOG(ERROR) << "Failed to set UDP socket receive timeout.";
+    return false;
+  }
+
+#if defined(OS_LINUX)
+  // Have the number of datagrams dropped by the system reported.
+  const int enable = 1;
+  if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RXQ_OVFL, &enable,
+                 sizeof(enable)) < 0) {
+    LOG(WARNING) << "Failed to enable UDP socket drop counter.";
+  }
+#endif
+
   struct sockaddr_in local_sock_addr;
   bzero(&local_sock_addr, sizeof(local_sock_addr));
   local_sock_addr.sin_family = AF_INET;
@@ -214,8 +405,69 @@ bool UdpFile::Open() {
   }
 
   socket_ = new_socket.release();
+
+  ring_.reset(new IoBlockRing(
+      std::max(kMinRingDatagrams, FLAGS_udp_ring_datagrams),
+      FLAGS_udp_max_datagram_size));
+  receive_exit_event_.reset(new base::WaitableEvent(false, false));
+  base::WorkerPool::PostTask(
+      FROM_HERE, base::Bind(&UdpFile::ReceiveTask, base::Unretained(this)),
+      true /* task_is_slow */);
   return true;
 }
 
+void UdpFile::ReceiveTask() {
+  DatagramBatchReceiver receiver;
+  std::vector<uint8_t*> buffers;
+  while (true) {
+    if (ring_->NumFilledBlocks() == ring_->num_blocks()) {
+      base::AutoLock auto_lock(stats_lock_);
+      ++stats_.ring_overruns;
+    }
+    if (!ring_->AcquireFreeBlocks(kMaxBatchSize, &buffers))
+      break;  // Closed.
+
+    const int num_datagrams =
+        receiver.Receive(socket_, buffers, ring_->block_size());
+    if (num_datagrams < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+        continue;
+      PLOG(ERROR) << "Failed to receive from UDP socket.";
+      Release_Store(&receive_error_, 1);
+      ring_->Close();
+      break;
+    }
+
+    Stats batch_stats;
+    bool has_drop_count = false;
+    uint32_t drop_count = 0;
+    for (int i = 0; i < num_datagrams; ++i) {
+      batch_stats.bytes += receiver.sizes()[i];
+      if (receiver.IsTruncated(i))
+        ++batch_stats.truncated_datagrams;
+      if (receiver.GetDropCount(i, &drop_count))
+        has_drop_count = true;
+    }
+    ring_->CommitBlocks(receiver.sizes(), num_datagrams);
+
+    base::AutoLock auto_lock(stats_lock_);
+    LOG_IF(WARNING, stats_.truncated_datagrams == 0 &&
+                        batch_stats.truncated_datagrams > 0)
+        << "UDP datagram larger than " << ring_->block_size()
+        << " bytes truncated. See --udp_max_datagram_size.";
+    stats_.datagrams += num_datagrams;
+    stats_.bytes += batch_stats.bytes;
+    stats_.truncated_datagrams += batch_stats.truncated_datagrams;
+    if (has_drop_count)
+      stats_.kernel_drops = drop_count;
+  }
+  receive_exit_event_->Signal();
+}
+
+UdpFile::Stats UdpFile::GetStats() const {
+  base::AutoLock auto_lock(stats_lock_);
+  return stats_;
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -0,0 +1,222 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// UdpFile tests with a loopback sender. The sustained rate test is disabled
+// by default. Run it with:
+//   file_unittest --gtest_filter=UdpFileTest.DISABLED_SustainedRate
+//                 --gtest_also_run_disabled_tests
+//                 --udp_test_rate_mbps=<rate> --udp_receive_buffer_size=<size>
+
+#include <arpa/inet.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/bind_helpers.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/base/time/time.h"
+#include "packager/media/base/closure_thread.h"
+#include "packager/media/file/file.h"
+#include "packager/media/file/udp_file.h"
+
+DECLARE_uint64(udp_max_datagram_size);
+DEFINE_uint64(udp_test_rate_mbps,
+              100,
+              "Rate of the loopback sender of "
+              "UdpFileTest.DISABLED_SustainedRate, in Mbps.");
+DEFINE_uint64(udp_test_duration_seconds,
+              10,
+              "Duration of UdpFileTest.DISABLED_SustainedRate, in seconds.");
+
+namespace shaka {
+namespace media {
+
+namespace {
+// Seven MPEG-2 TS packets, as commonly sent over UDP.
+const size_t kDatagramSize = 7 * 188;
+// Time to wait for sent datagrams to be received.
+const int kReceiveTimeoutMs = 5000;
+
+// Stamps |datagram| with |sequence_number| and a matching pattern.
+void FillDatagram(uint32_t sequence_number, std::vector<uint8_t>* datagram) {
+  datagram->resize(kDatagramSize);
+  memcpy(&(*datagram)[0], &sequence_number, sizeof(sequence_number));
+  for (size_t i = sizeof(sequence_number); i < datagram->size(); ++i)
+    (*datagram)[i] = static_cast<uint8_t>(sequence_number + i);
+}
+}  // namespace
+
+class UdpFileTest : public testing::Test {
+ public:
+  UdpFileTest() : sender_socket_(-1), port_(0), file_(NULL) {}
+
+  // Sends |num_datagrams| datagrams at |rate_mbps|, or with short pauses if
+  // |rate_mbps| is 0.
+  void SendDatagrams(uint32_t num_datagrams, uint64_t rate_mbps) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const base::TimeTicks start = base::TimeTicks::Now();
+    std::vector<uint8_t> datagram;
+    for (uint32_t i = 0; i < num_datagrams; ++i) {
+      FillDatagram(i, &datagram);
+      ASSERT_EQ(static_cast<ssize_t>(datagram.size()),
+                sendto(sender_socket_, datagram.data(), datagram.size(), 0,
+                       reinterpret_cast<struct sockaddr*>(&address),
+                       sizeof(address)));
+      if (rate_mbps == 0) {
+        if (i % 16 == 15)
+          base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+        continue;
+      }
+      // Pace the datagrams.
+      const base::TimeTicks due =
+          start + base::TimeDelta::FromMicroseconds(
+                      (i + 1) * kDatagramSize * 8 / rate_mbps);
+      const base::TimeDelta wait = due - base::TimeTicks::Now();
+      if (wait > base::TimeDelta())
+        base::PlatformThread::Sleep(wait);
+    }
+  }
+
+  // Reads and checks |num_datagrams| datagrams from |file_|.
+  void ReceiveDatagrams(uint32_t num_datagrams) {
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> buffer(64 * 1024);
+    std::vector<uint8_t> received;
+    uint32_t sequence_number = 0;
+    while (sequence_number < num_datagrams) {
+      const int64_t bytes_read = file_->Read(buffer.data(), buffer.size());
+      ASSERT_GT(bytes_read, 0);
+      received.insert(received.end(), buffer.begin(),
+                      buffer.begin() + bytes_read);
+      size_t offset = 0;
+      while (received.size() - offset >= kDatagramSize) {
+        FillDatagram(sequence_number, &expected);
+        ASSERT_EQ(0,
+                  memcmp(expected.data(), &received[offset], kDatagramSize))
+            << "datagram " << sequence_number;
+        ++sequence_number;
+        offset += kDatagramSize;
+      }
+      received.erase(received.begin(), received.begin() + offset);
+    }
+  }
+
+ protected:
+  void SetUp() override {
+    sender_socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(-1, sender_socket_);
+
+    // Find a free port by binding to port 0.
+    int probe_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(-1, probe_socket);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(probe_socket,
+                      reinterpret_cast<struct sockaddr*>(&address),
+                      sizeof(address)));
+    socklen_t address_size = sizeof(address);
+    ASSERT_EQ(0, getsockname(probe_socket,
+                             reinterpret_cast<struct sockaddr*>(&address),
+                             &address_size));
+    port_ = ntohs(address.sin_port);
+    close(probe_socket);
+
+    const std::string file_name =
+        "udp://127.0.0.1:" + base::UintToString(port_);
+    file_ = static_cast<UdpFile*>(File::Open(file_name.c_str(), "r"));
+    ASSERT_TRUE(file_);
+  }
+
+  void TearDown() override {
+    if (file_)
+      EXPECT_TRUE(file_->Close());
+    if (sender_socket_ != -1)
+      close(sender_socket_);
+  }
+
+  // Waits until |num_datagrams| datagrams are received or a timeout.
+  bool WaitForDatagrams(uint32_t num_datagrams) {
+    const base::TimeTicks deadline =
+        base::TimeTicks::Now() +
+        base::TimeDelta::FromMilliseconds(kReceiveTimeoutMs);
+    while (file_->GetStats().datagrams < num_datagrams) {
+      if (base::TimeTicks::Now() > deadline)
+        return false;
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+    }
+    return true;
+  }
+
+  int sender_socket_;
+  uint16_t port_;
+  UdpFile* file_;
+};
+
+TEST_F(UdpFileTest, Receive) {
+  const uint32_t kNumDatagrams = 256;
+  SendDatagrams(kNumDatagrams, 0);
+  ASSERT_TRUE(WaitForDatagrams(kNumDatagrams));
+
+  ReceiveDatagrams(kNumDatagrams);
+  const UdpFile::Stats stats = file_->GetStats();
+  EXPECT_EQ(kNumDatagrams, stats.datagrams);
+  EXPECT_EQ(kNumDatagrams * kDatagramSize, stats.bytes);
+  EXPECT_EQ(0u, stats.kernel_drops);
+  EXPECT_EQ(0u, stats.truncated_datagrams);
+}
+
+TEST_F(UdpFileTest, TruncatedDatagram) {
+  google::FlagSaver flag_saver;
+  FLAGS_udp_max_datagram_size = 100;
+  UdpFile* file = file_;
+  file_ = NULL;
+  EXPECT_TRUE(file->Close());
+  const std::string file_name = "udp://127.0.0.1:" + base::UintToString(port_);
+  file_ = static_cast<UdpFile*>(File::Open(file_name.c_str(), "r"));
+  ASSERT_TRUE(file_);
+
+  SendDatagrams(1, 0);
+  ASSERT_TRUE(WaitForDatagrams(1));
+  std::vector<uint8_t> buffer(kDatagramSize);
+  EXPECT_EQ(100, file_->Read(buffer.data(), buffer.size()));
+  EXPECT_EQ(1u, file_->GetStats().truncated_datagrams);
+}
+
+TEST_F(UdpFileTest, DISABLED_SustainedRate) {
+  const uint32_t num_datagrams = static_cast<uint32_t>(
+      FLAGS_udp_test_rate_mbps * 1000000 * FLAGS_udp_test_duration_seconds /
+      (kDatagramSize * 8));
+  ClosureThread sender_thread(
+      "UdpSender", base::Bind(&UdpFileTest::SendDatagrams,
+                              base::Unretained(this), num_datagrams,
+                              FLAGS_udp_test_rate_mbps));
+  const base::TimeTicks start = base::TimeTicks::Now();
+  sender_thread.Start();
+  ReceiveDatagrams(num_datagrams);
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  sender_thread.Join();
+
+  const UdpFile::Stats stats = file_->GetStats();
+  LOG(INFO) << "Received " << stats.datagrams << " datagrams at "
+            << stats.bytes * 8 / elapsed.InSecondsF() / 1000000 << " Mbps. "
+            << stats.ToString();
+  EXPECT_EQ(0u, stats.kernel_drops);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -11,9 +11,21 @@
 namespace shaka {
 namespace media {
 
-UdpFile::UdpFile(const char* file_name) : File(file_name), socket_(0) {
+UdpFile::Stats::Stats()
+    : datagrams(0),
+      bytes(0),
+      kernel_drops(0),
+      ring_overruns(0),
+      truncated_datagrams(0) {}
+
+std::string UdpFile::Stats::ToString() const {
+  NOTIMPLEMENTED();
+  return std::string();
 }
 
+UdpFile::UdpFile(const char* file_name)
+    : File(file_name), socket_(0), receive_error_(0) {}
+
 UdpFile::~UdpFile() {}
 
 bool UdpFile::Close() {
@@ -52,6 +64,11 @@ bool UdpFile::Tell(uint64_t* position) {
   return false;
 }
 
+UdpFile::Stats UdpFile::GetStats() const {
+  NOTIMPLEMENTED();
+  return Stats();
+}
+
 bool UdpFile::Open() {
   NOTIMPLEMENTED();
   return false;
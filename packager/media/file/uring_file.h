@@ -0,0 +1,124 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_URING_FILE_H_
+#define PACKAGER_FILE_URING_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packager/base/macros.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/media/file/file.h"
+
+namespace shaka {
+namespace media {
+
+class IoUring;
+
+/// Implements UringFile, which accesses local storage through Linux io_uring.
+/// Input files keep several reads ahead in flight and output files keep
+/// several block writes in flight, without an I/O thread per file.
+class UringFile : public File {
+ public:
+  /// @param file_name C string containing the name of the file to be accessed.
+  /// @param mode C string containing a file access mode: "r", "w" or "a".
+  /// @param queue_depth is the maximum number of reads or writes in flight.
+  /// @param block_size is the size of each read or write, in bytes.
+  UringFile(const char* file_name,
+            const char* mode,
+            uint32_t queue_depth,
+            uint64_t block_size);
+
+  /// @name File implementation overrides.
+  /// @{
+  bool Close() override;
+  int64_t Read(void* buffer, uint64_t length) override;
+  int64_t Write(const void* buffer, uint64_t length) override;
+  int64_t Size() override;
+  bool Flush() override;
+  bool Seek(uint64_t position) override;
+  bool Tell(uint64_t* position) override;
+  /// @}
+
+  /// @param mode is a file access mode.
+  /// @return true if io_uring is available on this system and @a mode is
+  ///         supported by UringFile, false otherwise.
+  static bool IsSupported(const char* mode);
+
+ protected:
+  ~UringFile() override;
+
+  bool Open() override;
+
+ private:
+  // A read or write request. Requests are used in order, as a circular queue.
+  struct Request {
+    Request();
+    ~Request();
+
+    std::vector<uint8_t> buffer;
+    // File offset of the request.
+    uint64_t offset;
+    // Number of bytes to transfer. Reads reaching the end of the file set it
+    // to the number of bytes read.
+    uint64_t size;
+    // Number of bytes transferred so far.
+    uint64_t completed;
+    bool in_flight;
+    // Result of the request once completed: bytes transferred or -errno.
+    int64_t result;
+  };
+
+  Request* GetRequest(size_t index_from_head);
+  // Queues the request at |index_from_head| for submission.
+  void SubmitRequest(size_t index_from_head);
+  // Queues the bytes of |requests_[index]| not transferred yet.
+  void QueueTransfer(size_t index);
+  // Waits for the request at the head of the queue to complete.
+  bool WaitForHeadRequest();
+  // Waits for all the requests in flight to complete.
+  bool WaitForAllRequests();
+  // Reaps completions, waiting for at least one if |wait| is true.
+  bool ReapCompletions(bool wait);
+  void PopHeadRequest();
+  // Discards the requests queued after the head request.
+  bool DiscardReadAhead();
+  // Submits reads until |queue_depth_| reads are in flight.
+  bool FillReadAhead();
+  // Submits the write request being filled.
+  bool SubmitPendingWrite();
+  // Completes the write request at the head of the queue.
+  bool CompleteHeadWrite();
+
+  const std::string file_mode_;
+  const uint64_t block_size_;
+  int fd_;
+  scoped_ptr<IoUring> ring_;
+  std::vector<Request> requests_;
+  // Index of the oldest request and number of requests in use.
+  size_t head_;
+  size_t num_requests_;
+  // File offset of the next request to be submitted.
+  uint64_t next_offset_;
+  // Input mode: bytes consumed from the head request.
+  uint64_t read_offset_;
+  // Output mode: bytes in the request being filled, which is the last one in
+  // use when not zero.
+  uint64_t pending_write_size_;
+  // Input mode: logical position in the file.
+  uint64_t position_;
+  bool error_;
+
+  DISALLOW_COPY_AND_ASSIGN(UringFile);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_URING_FILE_H_
@@ -0,0 +1,584 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/media/file/uring_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "packager/base/logging.h"
+#include "packager/base/posix/eintr_wrapper.h"
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+// IORING_OP_READ and IORING_OP_WRITE were added in Linux 5.6, along with the
+// IORING_FEAT_RW_CUR_POS feature flag. With older kernel headers io_uring is
+// reported as not supported and LocalFile is used instead.
+#if defined(IORING_FEAT_RW_CUR_POS)
+#define HAS_IORING_READ_WRITE 1
+#else
+#define HAS_IORING_READ_WRITE 0
+#endif
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+int IoUringSetup(uint32_t entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int IoUringEnter(int ring_fd,
+                 uint32_t to_submit,
+                 uint32_t min_complete,
+                 uint32_t flags) {
+  return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                 NULL, 0);
+}
+
+bool ProbeIoUring() {
+#if !HAS_IORING_READ_WRITE
+  VLOG(1) << "io_uring is not supported by this build.";
+  return false;
+#else
+  // io_uring gained IORING_OP_READ and IORING_OP_WRITE in the same kernel
+  // release as this feature.
+  const uint32_t kRequiredFeatures = IORING_FEAT_RW_CUR_POS;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = IoUringSetup(1, &params);
+  if (ring_fd < 0) {
+    VLOG(1) << "io_uring is not available: " << strerror(errno);
+    return false;
+  }
+  close(ring_fd);
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    VLOG(1) << "io_uring does not support IORING_OP_READ/IORING_OP_WRITE.";
+    return false;
+  }
+  return true;
+#endif  // !HAS_IORING_READ_WRITE
+}
+
+}  // namespace
+
+/// Minimal io_uring submission and completion queue wrapper.
+class IoUring {
+ public:
+  IoUring()
+      : ring_fd_(-1),
+        sq_ring_(MAP_FAILED),
+        sq_ring_size_(0),
+        cq_ring_(MAP_FAILED),
+        cq_ring_size_(0),
+        sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+        sqes_size_(0),
+        sq_head_(NULL),
+        sq_tail_(NULL),
+        sq_mask_(NULL),
+        sq_array_(NULL),
+        cq_head_(NULL),
+        cq_tail_(NULL),
+        cq_mask_(NULL),
+        cqes_(NULL),
+        num_queued_(0) {}
+
+  ~IoUring() {
+    if (sqes_ != MAP_FAILED)
+      munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+      munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0)
+      close(ring_fd_);
+  }
+
+  bool Initialize(uint32_t entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = IoUringSetup(entries, &params);
+    if (ring_fd_ < 0) {
+      LOG(ERROR) << "io_uring_setup failed: " << strerror(errno);
+      return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(
+        mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED ||
+        sqes_ == MAP_FAILED) {
+      LOG(ERROR) << "Failed to map io_uring queues: " << strerror(errno);
+      return false;
+    }
+
+    uint8_t* sq_ring = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+    uint8_t* cq_ring = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq_ring +
+                                                   params.cq_off.cqes);
+    return true;
+  }
+
+  /// Queue a read or write. The caller must not have more requests in flight
+  /// than the number of entries of the ring.
+  void QueueRequest(uint8_t opcode,
+                    int fd,
+                    void* buffer,
+                    uint32_t length,
+                    uint64_t offset,
+                    uint64_t user_data) {
+    // Only this thread writes the tail.
+    const uint32_t tail = *sq_tail_;
+    const uint32_t index = tail & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    // Make the entry visible to the kernel before the new tail.
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++num_queued_;
+  }
+
+  /// Submit the queued requests and wait for @a min_complete completions.
+  bool Enter(uint32_t min_complete) {
+    while (num_queued_ > 0 || min_complete > 0) {
+      const int result = IoUringEnter(
+          ring_fd_, num_queued_, min_complete,
+          min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG(ERROR) << "io_uring_enter failed: " << strerror(errno);
+        return false;
+      }
+      num_queued_ -= std::min<uint32_t>(result, num_queued_);
+      if (min_complete > 0)
+        break;
+    }
+    return true;
+  }
+
+  /// Pop a completion, if any.
+  bool PopCompletion(uint64_t* user_data, int32_t* result) {
+    const uint32_t head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+      return false;
+    const struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+    // Hand the entry back to the kernel once it is read.
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  int ring_fd_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t* sq_mask_;
+  uint32_t* sq_array_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t* cq_mask_;
+  struct io_uring_cqe* cqes_;
+  // Number of requests queued but not submitted yet.
+  uint32_t num_queued_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+UringFile::Request::Request()
+    : offset(0), size(0), completed(0), in_flight(false), result(0) {}
+
+UringFile::Request::~Request() {}
+
+UringFile::UringFile(const char* file_name,
+                     const char* mode,
+                     uint32_t queue_depth,
+                     uint64_t block_size)
+    : File(file_name),
+      file_mode_(mode),
+      block_size_(block_size),
+      fd_(-1),
+      requests_(std::max(queue_depth, 1u)),
+      head_(0),
+      num_requests_(0),
+      next_offset_(0),
+      read_offset_(0),
+      pending_write_size_(0),
+      position_(0),
+      error_(false) {
+  DCHECK(IsSupported(mode));
+  DCHECK_GT(block_size, 0u);
+  // Each request is a single read or write, which takes a 32-bit length.
+  DCHECK_LE(block_size, 0x7fffffffu);
+}
+
+bool UringFile::Close() {
+  bool result = true;
+  if (fd_ >= 0) {
+    if (file_mode_ == "r")
+      result = WaitForAllRequests();
+    else
+      result = Flush();
+    if (close(fd_) < 0)
+      result = false;
+    fd_ = -1;
+  }
+  delete this;
+  return result;
+}
+
+int64_t UringFile::Read(void* buffer, uint64_t length) {
+  DCHECK(buffer != NULL);
+  DCHECK_EQ(file_mode_, "r");
+  if (error_)
+    return -1;
+
+  uint8_t* data = static_cast<uint8_t*>(buffer);
+  uint64_t bytes_read = 0;
+  while (bytes_read < length) {
+    // Failures set |error_|.
+    if (!FillReadAhead() || !WaitForHeadRequest())
+      break;
+    Request* request = GetRequest(0);
+    if (request->result < 0) {
+      LOG(ERROR) << "Failed to read " << file_name() << ": "
+                 << strerror(-request->result);
+      error_ = true;
+      break;
+    }
+
+    const bool end_of_file = request->size < block_size_;
+    if (end_of_file && num_requests_ > 1) {
+      // Reads past the end of the file are dropped, so that reads resume right
+      // after the data read so far if the file grows.
+      if (!DiscardReadAhead())
+        break;
+      next_offset_ = request->offset + request->size;
+    }
+
+    const uint64_t copy_size =
+        std::min(request->size - read_offset_, length - bytes_read);
+    memcpy(data + bytes_read, &request->buffer[read_offset_], copy_size);
+    bytes_read += copy_size;
+    read_offset_ += copy_size;
+    if (read_offset_ == request->size) {
+      PopHeadRequest();
+      read_offset_ = 0;
+      if (end_of_file)
+        break;
+    }
+  }
+  // Like LocalFile, return the bytes read before an error. The error is
+  // returned by the next call.
+  if (error_ && bytes_read == 0)
+    return -1;
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+int64_t UringFile::Write(const void* buffer, uint64_t length) {
+  DCHECK(buffer != NULL);
+  DCHECK_NE(file_mode_, "r");
+  if (error_)
+    return -1;
+
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_written = 0;
+  while (bytes_written < length) {
+    if (pending_write_size_ == 0) {
+      // Start a new request, after the oldest one completes if all of them
+      // are in flight.
+      if (num_requests_ == requests_.size() && !CompleteHeadWrite())
+        return -1;
+      ++num_requests_;
+    }
+    Request* request = GetRequest(num_requests_ - 1);
+    const uint64_t copy_size =
+        std::min(block_size_ - pending_write_size_, length - bytes_written);
+    memcpy(&request->buffer[pending_write_size_], data + bytes_written,
+           copy_size);
+    pending_write_size_ += copy_size;
+    bytes_written += copy_size;
+    if (pending_write_size_ == block_size_ && !SubmitPendingWrite())
+      return -1;
+  }
+  return bytes_written;
+}
+
+int64_t UringFile::Size() {
+  DCHECK_GE(fd_, 0);
+  if (file_mode_ != "r" && !Flush()) {
+    LOG(ERROR) << "Cannot flush file.";
+    return -1;
+  }
+
+  struct stat stat_buffer;
+  if (fstat(fd_, &stat_buffer) < 0) {
+    LOG(ERROR) << "Cannot get file size.";
+    return -1;
+  }
+  return stat_buffer.st_size;
+}
+
+bool UringFile::Flush() {
+  DCHECK_GE(fd_, 0);
+  if (file_mode_ == "r")
+    return !error_;
+  if (pending_write_size_ > 0 && !SubmitPendingWrite())
+    return false;
+  while (num_requests_ > 0) {
+    if (!CompleteHeadWrite())
+      return false;
+  }
+  return !error_;
+}
+
+bool UringFile::Seek(uint64_t position) {
+  if (file_mode_ == "r") {
+    if (!WaitForAllRequests())
+      return false;
+    num_requests_ = 0;
+    read_offset_ = 0;
+    position_ = position;
+  } else if (!Flush()) {
+    return false;
+  }
+  next_offset_ = position;
+  return true;
+}
+
+bool UringFile::Tell(uint64_t* position) {
+  DCHECK(position);
+  *position =
+      file_mode_ == "r" ? position_ : next_offset_ + pending_write_size_;
+  return true;
+}
+
+bool UringFile::IsSupported(const char* mode) {
+  if (strcmp(mode, "r") && strcmp(mode, "w") && strcmp(mode, "a"))
+    return false;
+  static const bool io_uring_available = ProbeIoUring();
+  return io_uring_available;
+}
+
+UringFile::~UringFile() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool UringFile::Open() {
+  int flags = O_CLOEXEC;
+  if (file_mode_ == "r") {
+    flags |= O_RDONLY;
+  } else {
+    // Requests complete in any order, so appends are done at explicit
+    // offsets rather than with O_APPEND.
+    flags |= O_WRONLY | O_CREAT;
+    if (file_mode_ == "w")
+      flags |= O_TRUNC;
+  }
+  fd_ = HANDLE_EINTR(open(file_name().c_str(), flags, 0666));
+  if (fd_ < 0)
+    return false;
+
+  if (file_mode_ == "a") {
+    struct stat stat_buffer;
+    if (fstat(fd_, &stat_buffer) < 0)
+      return false;
+    next_offset_ = stat_buffer.st_size;
+  }
+
+  ring_.reset(new IoUring);
+  if (!ring_->Initialize(requests_.size()))
+    return false;
+  for (size_t i = 0; i < requests_.size(); ++i)
+    requests_[i].buffer.resize(block_size_);
+  return true;
+}
+
+UringFile::Request* UringFile::GetRequest(size_t index_from_head) {
+  DCHECK_LT(index_from_head, requests_.size());
+  return &requests_[(head_ + index_from_head) % requests_.size()];
+}
+
+void UringFile::SubmitRequest(size_t index_from_head) {
+  GetRequest(index_from_head)->completed = 0;
+  QueueTransfer((head_ + index_from_head) % requests_.size());
+}
+
+void UringFile::QueueTransfer(size_t index) {
+  Request* request = &requests_[index];
+  DCHECK(!request->in_flight);
+  DCHECK_LT(request->completed, request->size);
+  request->in_flight = true;
+#if HAS_IORING_READ_WRITE
+  const bool is_read = file_mode_ == "r";
+  ring_->QueueRequest(is_read ? IORING_OP_READ : IORING_OP_WRITE, fd_,
+                      &request->buffer[request->completed],
+                      request->size - request->completed,
+                      request->offset + request->completed, index);
+#else
+  // IsSupported() returns false, so no UringFile is created.
+  NOTREACHED();
+#endif
+}
+
+bool UringFile::WaitForHeadRequest() {
+  DCHECK_GT(num_requests_, 0u);
+  while (GetRequest(0)->in_flight) {
+    if (!ReapCompletions(true))
+      return false;
+  }
+  return true;
+}
+
+bool UringFile::WaitForAllRequests() {
+  for (size_t i = 0; i < num_requests_; ++i) {
+    while (GetRequest(i)->in_flight) {
+      if (!ReapCompletions(true))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool UringFile::ReapCompletions(bool wait) {
+  if (!ring_->Enter(wait ? 1 : 0)) {
+    error_ = true;
+    return false;
+  }
+  uint64_t index;
+  int32_t result;
+  while (ring_->PopCompletion(&index, &result)) {
+    DCHECK_LT(index, requests_.size());
+    Request* request = &requests_[index];
+    DCHECK(request->in_flight);
+    request->in_flight = false;
+    request->result = result;
+    if (result > 0) {
+      request->completed += result;
+      // Short reads and writes transfer the rest with another request, which
+      // is submitted on the next io_uring_enter.
+      if (request->completed < request->size)
+        QueueTransfer(index);
+    } else if (result == 0) {
+      if (file_mode_ == "r") {
+        // End of file.
+        request->size = request->completed;
+      } else {
+        request->result = -EIO;
+      }
+    }
+  }
+  return true;
+}
+
+void UringFile::PopHeadRequest() {
+  DCHECK_GT(num_requests_, 0u);
+  DCHECK(!GetRequest(0)->in_flight);
+  head_ = (head_ + 1) % requests_.size();
+  --num_requests_;
+}
+
+bool UringFile::DiscardReadAhead() {
+  if (!WaitForAllRequests())
+    return false;
+  num_requests_ = 1;
+  return true;
+}
+
+bool UringFile::FillReadAhead() {
+  if (num_requests_ == requests_.size())
+    return true;
+  while (num_requests_ < requests_.size()) {
+    Request* request = GetRequest(num_requests_);
+    request->offset = next_offset_;
+    request->size = block_size_;
+    SubmitRequest(num_requests_);
+    next_offset_ += block_size_;
+    ++num_requests_;
+  }
+  if (!ring_->Enter(0)) {
+    error_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool UringFile::SubmitPendingWrite() {
+  DCHECK_GT(pending_write_size_, 0u);
+  Request* request = GetRequest(num_requests_ - 1);
+  request->offset = next_offset_;
+  request->size = pending_write_size_;
+  SubmitRequest(num_requests_ - 1);
+  next_offset_ += pending_write_size_;
+  pending_write_size_ = 0;
+  if (!ring_->Enter(0)) {
+    error_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool UringFile::CompleteHeadWrite() {
+  if (!WaitForHeadRequest())
+    return false;
+  Request* request = GetRequest(0);
+  if (request->result < 0) {
+    LOG(ERROR) << "Failed to write " << file_name() << ": "
+               << strerror(-request->result);
+    error_ = true;
+    return false;
+  }
+  PopHeadRequest();
+  return true;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -27,7 +27,11 @@ void Box::Write(BufferWriter* writer) {
   // Compute and update box size.
   uint32_t size = ComputeSize();
   DCHECK_EQ(size, box_size_);
+  WriteWithComputedSize(writer);
+}
 
+void Box::WriteWithComputedSize(BufferWriter* writer) {
+  DCHECK(writer);
   size_t buffer_size_before_write = writer->Size();
   BoxBuffer buffer(writer);
   CHECK(ReadWriteInternal(&buffer));
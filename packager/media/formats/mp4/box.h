@@ -36,6 +36,12 @@ struct Box {
   /// @param writer points to a BufferWriter object which wraps the buffer for
   ///        writing.
   void Write(BufferWriter* writer);
+  /// Write the box to buffer with the box sizes computed by the last
+  /// ComputeSize call, instead of computing them again. The box must not be
+  /// modified in a way which changes its size in between.
+  /// @param writer points to a BufferWriter object which wraps the buffer for
+  ///        writing.
+  void WriteWithComputedSize(BufferWriter* writer);
   /// Write the box header to buffer. This function calls ComputeSize internally
   /// to compute and update box size.
   /// @param writer points to a BufferWriter object which wraps the buffer for
@@ -4,10 +4,14 @@
 
 #include "packager/media/formats/mp4/box_definitions.h"
 
+#include <string.h>
+
 #include <limits>
 
 #include "packager/base/logging.h"
+#include "packager/base/sys_byteorder.h"
 #include "packager/media/base/bit_reader.h"
+#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/macros.h"
 #include "packager/media/base/rcheck.h"
 #include "packager/media/formats/mp4/box_buffer.h"
@@ -131,6 +135,56 @@ bool IsProtectionSchemeSupported(FourCC scheme) {
          scheme == FOURCC_cbc1 || scheme == FOURCC_cbcs;
 }
 
+// Writes big endian fields into a block of |size| bytes grown at the end of
+// |writer|. The boxes written once per fragment with per sample tables, which
+// know their sizes from ComputeSize, are serialized with it in a single pass
+// instead of appending each field through BoxBuffer.
+class FieldWriter {
+ public:
+  FieldWriter(BufferWriter* writer, size_t size)
+      : pos_(writer->Grow(size)), end_(pos_ + size) {}
+  ~FieldWriter() { DCHECK_EQ(pos_, end_); }
+
+  void Write8(uint8_t v) {
+    DCHECK_LT(pos_, end_);
+    *pos_++ = v;
+  }
+  void Write16(uint16_t v) { Store(base::HostToNet16(v)); }
+  void Write32(uint32_t v) { Store(base::HostToNet32(v)); }
+  void Write64(uint64_t v) { Store(base::HostToNet64(v)); }
+  // Writes |v| in 8 bytes if |num_bytes| is 8, or 4 bytes otherwise.
+  void WriteNBytes(uint64_t v, size_t num_bytes) {
+    if (num_bytes == sizeof(uint64_t))
+      Write64(v);
+    else
+      Write32(static_cast<uint32_t>(v));
+  }
+  void WriteArray(const uint8_t* data, size_t size) {
+    DCHECK_LE(size, static_cast<size_t>(end_ - pos_));
+    if (size > 0)
+      memcpy(pos_, data, size);
+    pos_ += size;
+  }
+
+ private:
+  template <typename T>
+  void Store(T v) {
+    DCHECK_LE(sizeof(v), static_cast<size_t>(end_ - pos_));
+    memcpy(pos_, &v, sizeof(v));
+    pos_ += sizeof(v);
+  }
+
+  uint8_t* pos_;
+  uint8_t* const end_;
+
+  DISALLOW_COPY_AND_ASSIGN(FieldWriter);
+};
+
+// @return The size of |box| excluding its header, from the last ComputeSize.
+size_t BodySize(Box* box) {
+  return box->box_size() - box->HeaderSize();
+}
+
 }  // namespace
 
 FileType::FileType() : major_brand(FOURCC_NULL), minor_version(0) {}
@@ -216,6 +270,19 @@ FourCC SampleAuxiliaryInformationSize::BoxType() const { return FOURCC_saiz; }
 
 bool SampleAuxiliaryInformationSize::ReadWriteInternal(BoxBuffer* buffer) {
   RCHECK(ReadWriteHeaderInternal(buffer));
+  if (!buffer->Reading()) {
+    FieldWriter writer(buffer->writer(), BodySize(this));
+    if (flags & 1)
+      writer.Write64(0);
+    writer.Write8(default_sample_info_size);
+    writer.Write32(sample_count);
+    if (default_sample_info_size == 0) {
+      DCHECK_EQ(sample_count, sample_info_sizes.size());
+      writer.WriteArray(sample_info_sizes.data(), sample_info_sizes.size());
+    }
+    return true;
+  }
+
   if (flags & 1)
     RCHECK(buffer->IgnoreBytes(8));
 
@@ -230,8 +297,8 @@ uint32_t SampleAuxiliaryInformationSize::ComputeSizeInternal() {
   // This box is optional. Skip it if it is empty.
   if (sample_count == 0)
     return 0;
-  return HeaderSize() + sizeof(default_sample_info_size) +
-         sizeof(sample_count) +
+  return HeaderSize() + (flags & 1 ? sizeof(uint64_t) : 0) +
+         sizeof(default_sample_info_size) + sizeof(sample_count) +
          (default_sample_info_size == 0 ? sample_info_sizes.size() : 0);
 }
 
@@ -326,6 +393,29 @@ bool SampleEncryption::ReadWriteInternal(BoxBuffer* buffer) {
   }
 
   uint32_t sample_count = sample_encryption_entries.size();
+  if (!buffer->Reading()) {
+    const bool has_subsamples = (flags & kUseSubsampleEncryption) != 0;
+    FieldWriter writer(buffer->writer(), BodySize(this));
+    writer.Write32(sample_count);
+    for (SampleEncryptionEntry& entry : sample_encryption_entries) {
+      DCHECK_EQ(iv_size, entry.initialization_vector.size());
+      writer.WriteArray(entry.initialization_vector.data(),
+                        entry.initialization_vector.size());
+      if (!has_subsamples) {
+        entry.subsamples.clear();
+        continue;
+      }
+      // Subsample encryption requires at least one subsample entry per sample.
+      CHECK(!entry.subsamples.empty());
+      writer.Write16(entry.subsamples.size());
+      for (const SubsampleEntry& subsample : entry.subsamples) {
+        writer.Write16(subsample.clear_bytes);
+        writer.Write32(subsample.cipher_bytes);
+      }
+    }
+    return true;
+  }
+
   RCHECK(buffer->ReadWriteUInt32(&sample_count));
 
   sample_encryption_entries.resize(sample_count);
@@ -2243,6 +2333,11 @@ FourCC TrackFragmentDecodeTime::BoxType() const { return FOURCC_tfdt; }
 bool TrackFragmentDecodeTime::ReadWriteInternal(BoxBuffer* buffer) {
   RCHECK(ReadWriteHeaderInternal(buffer));
   size_t num_bytes = (version == 1) ? sizeof(uint64_t) : sizeof(uint32_t);
+  if (!buffer->Reading()) {
+    FieldWriter writer(buffer->writer(), BodySize(this));
+    writer.WriteNBytes(decode_time, num_bytes);
+    return true;
+  }
   RCHECK(buffer->ReadWriteUInt64NBytes(&decode_time, num_bytes));
   return true;
 }
@@ -2346,20 +2441,19 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
     }
   }
 
-  RCHECK(ReadWriteHeaderInternal(buffer) &&
-         buffer->ReadWriteUInt32(&sample_count));
+  RCHECK(ReadWriteHeaderInternal(buffer));
 
-  bool data_offset_present = (flags & kDataOffsetPresentMask) != 0;
-  bool first_sample_flags_present = (flags & kFirstSampleFlagsPresentMask) != 0;
-  bool sample_duration_present = (flags & kSampleDurationPresentMask) != 0;
-  bool sample_size_present = (flags & kSampleSizePresentMask) != 0;
-  bool sample_flags_present = (flags & kSampleFlagsPresentMask) != 0;
-  bool sample_composition_time_offsets_present =
+  const bool data_offset_present = (flags & kDataOffsetPresentMask) != 0;
+  const bool first_sample_flags_present =
+      (flags & kFirstSampleFlagsPresentMask) != 0;
+  const bool sample_duration_present =
+      (flags & kSampleDurationPresentMask) != 0;
+  const bool sample_size_present = (flags & kSampleSizePresentMask) != 0;
+  const bool sample_flags_present = (flags & kSampleFlagsPresentMask) != 0;
+  const bool sample_composition_time_offsets_present =
       (flags & kSampleCompTimeOffsetsPresentMask) != 0;
 
-  if (data_offset_present) {
-    RCHECK(buffer->ReadWriteUInt32(&data_offset));
-  } else {
+  if (!data_offset_present) {
     // NOTE: If the data-offset is not present, then the data for this run
     // starts immediately after the data of the previous run, or at the
     // base-data-offset defined by the track fragment header if this is the
@@ -2369,27 +2463,9 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
     NOTIMPLEMENTED();
   }
 
-  uint32_t first_sample_flags;
-
-  if (buffer->Reading()) {
+  if (!buffer->Reading()) {
     if (first_sample_flags_present)
-      RCHECK(buffer->ReadWriteUInt32(&first_sample_flags));
-
-    if (sample_duration_present)
-      sample_durations.resize(sample_count);
-    if (sample_size_present)
-      sample_sizes.resize(sample_count);
-    if (sample_flags_present)
-      sample_flags.resize(sample_count);
-    if (sample_composition_time_offsets_present)
-      sample_composition_time_offsets.resize(sample_count);
-  } else {
-    if (first_sample_flags_present) {
-      first_sample_flags = sample_flags[0];
       DCHECK(sample_flags.size() == 1);
-      RCHECK(buffer->ReadWriteUInt32(&first_sample_flags));
-    }
-
     if (sample_duration_present)
       DCHECK(sample_durations.size() == sample_count);
     if (sample_size_present)
@@ -2398,8 +2474,48 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
       DCHECK(sample_flags.size() == sample_count);
     if (sample_composition_time_offsets_present)
       DCHECK(sample_composition_time_offsets.size() == sample_count);
+
+    // The sample table is written in a single pass. Version 1 composition
+    // offsets are signed, but have the same 32-bit two's complement
+    // representation as version 0 offsets.
+    FieldWriter writer(buffer->writer(), BodySize(this));
+    writer.Write32(sample_count);
+    if (data_offset_present)
+      writer.Write32(data_offset);
+    if (first_sample_flags_present)
+      writer.Write32(sample_flags[0]);
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      if (sample_duration_present)
+        writer.Write32(sample_durations[i]);
+      if (sample_size_present)
+        writer.Write32(sample_sizes[i]);
+      if (sample_flags_present)
+        writer.Write32(sample_flags[i]);
+      if (sample_composition_time_offsets_present) {
+        writer.Write32(
+            static_cast<uint32_t>(sample_composition_time_offsets[i]));
+      }
+    }
+    return true;
   }
 
+  RCHECK(buffer->ReadWriteUInt32(&sample_count));
+  if (data_offset_present)
+    RCHECK(buffer->ReadWriteUInt32(&data_offset));
+
+  uint32_t first_sample_flags = 0;
+  if (first_sample_flags_present)
+    RCHECK(buffer->ReadWriteUInt32(&first_sample_flags));
+
+  if (sample_duration_present)
+    sample_durations.resize(sample_count);
+  if (sample_size_present)
+    sample_sizes.resize(sample_count);
+  if (sample_flags_present)
+    sample_flags.resize(sample_count);
+  if (sample_composition_time_offsets_present)
+    sample_composition_time_offsets.resize(sample_count);
+
   for (uint32_t i = 0; i < sample_count; ++i) {
     if (sample_duration_present)
       RCHECK(buffer->ReadWriteUInt32(&sample_durations[i]));
@@ -2410,24 +2526,22 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
 
     if (sample_composition_time_offsets_present) {
       if (version == 0) {
-        uint32_t sample_offset = sample_composition_time_offsets[i];
+        uint32_t sample_offset;
         RCHECK(buffer->ReadWriteUInt32(&sample_offset));
         sample_composition_time_offsets[i] = sample_offset;
       } else {
-        int32_t sample_offset = sample_composition_time_offsets[i];
+        int32_t sample_offset;
         RCHECK(buffer->ReadWriteInt32(&sample_offset));
         sample_composition_time_offsets[i] = sample_offset;
       }
     }
   }
 
-  if (buffer->Reading()) {
-    if (first_sample_flags_present) {
-      if (sample_flags.size() == 0) {
-        sample_flags.push_back(first_sample_flags);
-      } else {
-        sample_flags[0] = first_sample_flags;
-      }
+  if (first_sample_flags_present) {
+    if (sample_flags.size() == 0) {
+      sample_flags.push_back(first_sample_flags);
+    } else {
+      sample_flags[0] = first_sample_flags;
     }
   }
   return true;
@@ -2532,12 +2646,33 @@ SegmentIndex::~SegmentIndex() {}
 FourCC SegmentIndex::BoxType() const { return FOURCC_sidx; }
 
 bool SegmentIndex::ReadWriteInternal(BoxBuffer* buffer) {
-  RCHECK(ReadWriteHeaderInternal(buffer) &&
-         buffer->ReadWriteUInt32(&reference_id) &&
-         buffer->ReadWriteUInt32(&timescale));
-
+  RCHECK(ReadWriteHeaderInternal(buffer));
   size_t num_bytes = (version == 1) ? sizeof(uint64_t) : sizeof(uint32_t);
+  if (!buffer->Reading()) {
+    FieldWriter writer(buffer->writer(), BodySize(this));
+    writer.Write32(reference_id);
+    writer.Write32(timescale);
+    writer.WriteNBytes(earliest_presentation_time, num_bytes);
+    writer.WriteNBytes(first_offset, num_bytes);
+    writer.Write16(0);  // reserved.
+    writer.Write16(references.size());
+    for (const SegmentReference& reference : references) {
+      uint32_t reference_type_size = reference.referenced_size;
+      if (reference.reference_type)
+        reference_type_size |= (1 << 31);
+      uint32_t sap = (reference.sap_type << 28) | reference.sap_delta_time;
+      if (reference.starts_with_sap)
+        sap |= (1 << 31);
+      writer.Write32(reference_type_size);
+      writer.Write32(reference.subsegment_duration);
+      writer.Write32(sap);
+    }
+    return true;
+  }
+
   RCHECK(
+      buffer->ReadWriteUInt32(&reference_id) &&
+      buffer->ReadWriteUInt32(&timescale) &&
       buffer->ReadWriteUInt64NBytes(&earliest_presentation_time, num_bytes) &&
       buffer->ReadWriteUInt64NBytes(&first_offset, num_bytes));
 
@@ -2549,25 +2684,15 @@ bool SegmentIndex::ReadWriteInternal(BoxBuffer* buffer) {
   uint32_t reference_type_size;
   uint32_t sap;
   for (uint32_t i = 0; i < reference_count; ++i) {
-    if (!buffer->Reading()) {
-      reference_type_size = references[i].referenced_size;
-      if (references[i].reference_type)
-        reference_type_size |= (1 << 31);
-      sap = (references[i].sap_type << 28) | references[i].sap_delta_time;
-      if (references[i].starts_with_sap)
-        sap |= (1 << 31);
-    }
     RCHECK(buffer->ReadWriteUInt32(&reference_type_size) &&
            buffer->ReadWriteUInt32(&references[i].subsegment_duration) &&
            buffer->ReadWriteUInt32(&sap));
-    if (buffer->Reading()) {
-      references[i].reference_type = (reference_type_size >> 31) ? true : false;
-      references[i].referenced_size = reference_type_size & ~(1 << 31);
-      references[i].starts_with_sap = (sap >> 31) ? true : false;
-      references[i].sap_type =
-          static_cast<SegmentReference::SAPType>((sap >> 28) & 0x07);
-      references[i].sap_delta_time = sap & ~(0xF << 28);
-    }
+    references[i].reference_type = (reference_type_size >> 31) ? true : false;
+    references[i].referenced_size = reference_type_size & ~(1 << 31);
+    references[i].starts_with_sap = (sap >> 31) ? true : false;
+    references[i].sap_type =
+        static_cast<SegmentReference::SAPType>((sap >> 28) & 0x07);
+    references[i].sap_delta_time = sap & ~(0xF << 28);
   }
   return true;
 }
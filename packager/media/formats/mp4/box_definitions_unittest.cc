@@ -1334,6 +1334,96 @@ TEST_F(BoxDefinitionsTest, SampleEncryptionWithIvUnknownWhenReading) {
   ASSERT_EQ(senc.sample_encryption_entries, sample_encryption_entries);
 }
 
+// The boxes written once per fragment are serialized in a single pass. Check
+// them byte for byte against their fields appended one by one.
+TEST_F(BoxDefinitionsTest, TrackFragmentRunSerialization) {
+  TrackFragmentRun trun;
+  Fill(&trun);
+  trun.Write(buffer_.get());
+
+  BufferWriter expected;
+  expected.AppendInt(trun.ComputeSize());
+  expected.AppendInt(static_cast<uint32_t>(FOURCC_trun));
+  expected.AppendInt(static_cast<uint32_t>((1 << 24) | trun.flags));
+  expected.AppendInt(trun.sample_count);
+  expected.AppendInt(trun.data_offset);
+  for (uint32_t i = 0; i < trun.sample_count; ++i) {
+    expected.AppendInt(trun.sample_durations[i]);
+    expected.AppendInt(trun.sample_sizes[i]);
+    expected.AppendInt(trun.sample_flags[i]);
+    expected.AppendInt(
+        static_cast<int32_t>(trun.sample_composition_time_offsets[i]));
+  }
+  ASSERT_EQ(expected.Size(), buffer_->Size());
+  EXPECT_EQ(0, memcmp(expected.Buffer(), buffer_->Buffer(), expected.Size()));
+}
+
+TEST_F(BoxDefinitionsTest, SampleEncryptionSerialization) {
+  SampleEncryption senc;
+  Fill(&senc);
+  senc.Write(buffer_.get());
+
+  BufferWriter expected;
+  expected.AppendInt(senc.ComputeSize());
+  expected.AppendInt(static_cast<uint32_t>(FOURCC_senc));
+  expected.AppendInt(static_cast<uint32_t>(senc.flags));
+  expected.AppendInt(
+      static_cast<uint32_t>(senc.sample_encryption_entries.size()));
+  for (const SampleEncryptionEntry& entry : senc.sample_encryption_entries) {
+    expected.AppendVector(entry.initialization_vector);
+    expected.AppendInt(static_cast<uint16_t>(entry.subsamples.size()));
+    for (const SubsampleEntry& subsample : entry.subsamples) {
+      expected.AppendInt(subsample.clear_bytes);
+      expected.AppendInt(subsample.cipher_bytes);
+    }
+  }
+  ASSERT_EQ(expected.Size(), buffer_->Size());
+  EXPECT_EQ(0, memcmp(expected.Buffer(), buffer_->Buffer(), expected.Size()));
+}
+
+TEST_F(BoxDefinitionsTest, SegmentIndexSerialization) {
+  SegmentIndex sidx;
+  Fill(&sidx);
+  Modify(&sidx);
+  sidx.Write(buffer_.get());
+  ASSERT_EQ(1u, sidx.version);
+
+  BufferWriter expected;
+  expected.AppendInt(sidx.ComputeSize());
+  expected.AppendInt(static_cast<uint32_t>(FOURCC_sidx));
+  expected.AppendInt(static_cast<uint32_t>(1 << 24));
+  expected.AppendInt(sidx.reference_id);
+  expected.AppendInt(sidx.timescale);
+  expected.AppendInt(sidx.earliest_presentation_time);
+  expected.AppendInt(sidx.first_offset);
+  expected.AppendInt(static_cast<uint16_t>(0));
+  expected.AppendInt(static_cast<uint16_t>(sidx.references.size()));
+  for (const SegmentReference& reference : sidx.references) {
+    expected.AppendInt(reference.referenced_size |
+                       (reference.reference_type ? 1u << 31 : 0));
+    expected.AppendInt(reference.subsegment_duration);
+    expected.AppendInt((reference.starts_with_sap ? 1u << 31 : 0) |
+                       (static_cast<uint32_t>(reference.sap_type) << 28) |
+                       reference.sap_delta_time);
+  }
+  ASSERT_EQ(expected.Size(), buffer_->Size());
+  EXPECT_EQ(0, memcmp(expected.Buffer(), buffer_->Buffer(), expected.Size()));
+}
+
+TEST_F(BoxDefinitionsTest, WriteWithComputedSize) {
+  MovieFragment moof;
+  Fill(&moof);
+  const uint32_t size = moof.ComputeSize();
+  // Offsets can be updated after the sizes are computed.
+  moof.tracks[0].runs[0].data_offset += 100;
+  moof.WriteWithComputedSize(buffer_.get());
+  EXPECT_EQ(size, buffer_->Size());
+
+  MovieFragment moof_readback;
+  ASSERT_TRUE(ReadBack(&moof_readback));
+  ASSERT_EQ(moof, moof_readback);
+}
+
 }  // namespace mp4
 }  // namespace media
 }  // namespace shaka
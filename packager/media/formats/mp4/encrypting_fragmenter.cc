@@ -6,11 +6,18 @@
 
 #include "packager/media/formats/mp4/encrypting_fragmenter.h"
 
+#include <algorithm>
 #include <limits>
 
+#include "packager/base/bind.h"
+#include "packager/base/location.h"
+#include "packager/base/stl_util.h"
+#include "packager/base/synchronization/waitable_event.h"
+#include "packager/base/threading/worker_pool.h"
 #include "packager/media/base/aes_encryptor.h"
 #include "packager/media/base/aes_pattern_cryptor.h"
 #include "packager/media/base/buffer_reader.h"
+#include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/codecs/nalu_reader.h"
@@ -49,6 +56,49 @@ VideoCodec GetVideoCodec(const StreamInfo& stream_info) {
   return video_stream_info.codec();
 }
 
+scoped_ptr<AesCryptor> CreateAesCryptor(FourCC protection_scheme,
+                                        uint8_t crypt_byte_block,
+                                        uint8_t skip_byte_block) {
+  scoped_ptr<AesCryptor> encryptor;
+  switch (protection_scheme) {
+    case FOURCC_cenc:
+      encryptor.reset(new AesCtrEncryptor);
+      break;
+    case FOURCC_cbc1:
+      encryptor.reset(new AesCbcEncryptor(kNoPadding));
+      break;
+    case FOURCC_cens:
+      encryptor.reset(new AesPatternCryptor(
+          crypt_byte_block, skip_byte_block,
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kDontUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCtrEncryptor())));
+      break;
+    case FOURCC_cbcs:
+      encryptor.reset(new AesPatternCryptor(
+          crypt_byte_block, skip_byte_block,
+          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
+          AesCryptor::kUseConstantIv,
+          scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding))));
+      break;
+    default:
+      break;
+  }
+  return encryptor.Pass();
+}
+
+// Signals |event| when it goes out of scope.
+class ScopedSignal {
+ public:
+  explicit ScopedSignal(base::WaitableEvent* event) : event_(event) {}
+  ~ScopedSignal() { event_->Signal(); }
+
+ private:
+  base::WaitableEvent* event_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSignal);
+};
+
 uint8_t GetNaluLengthSize(const StreamInfo& stream_info) {
   if (stream_info.stream_type() != kStreamVideo)
     return 0;
@@ -59,6 +109,98 @@ uint8_t GetNaluLengthSize(const StreamInfo& stream_info) {
 }
 }  // namespace
 
+class EncryptingFragmenter::FragmentEncryption
+    : public GatherBuffer::PendingWork {
+ public:
+  // |fragment_data| is where the samples are encrypted in place.
+  // |pending_samples| is moved into the new object.
+  FragmentEncryption(FourCC protection_scheme,
+                     uint8_t crypt_byte_block,
+                     uint8_t skip_byte_block,
+                     const std::vector<uint8_t>& key,
+                     uint8_t* fragment_data,
+                     std::vector<PendingSample>* pending_samples)
+      : protection_scheme_(protection_scheme),
+        crypt_byte_block_(crypt_byte_block),
+        skip_byte_block_(skip_byte_block),
+        key_(key),
+        fragment_data_(fragment_data) {
+    pending_samples_.swap(*pending_samples);
+  }
+
+  // Split the samples into up to |num_tasks| contiguous ranges, encrypted on
+  // the worker pool. The first range is encrypted on the current thread
+  // instead if |use_current_thread| is set.
+  void Start(size_t num_tasks, bool use_current_thread) {
+    const size_t num_samples = pending_samples_.size();
+    num_tasks = std::max<size_t>(1, std::min(num_tasks, num_samples));
+    for (size_t i = use_current_thread ? 1 : 0; i < num_tasks; ++i) {
+      // Manual reset, so that the event can be waited for more than once.
+      base::WaitableEvent* task_done_event = new base::WaitableEvent(
+          true /* manual_reset */, false /* initially_signaled */);
+      task_done_events_.push_back(task_done_event);
+      base::WorkerPool::PostTask(
+          FROM_HERE,
+          base::Bind(&FragmentEncryption::EncryptRangeTask, this,
+                     i * num_samples / num_tasks,
+                     (i + 1) * num_samples / num_tasks,
+                     base::Unretained(task_done_event)),
+          false /* task_is_slow */);
+    }
+    if (use_current_thread)
+      EncryptRange(0, num_samples / num_tasks);
+  }
+
+  // GatherBuffer::PendingWork implementation.
+  void Wait() override {
+    for (base::WaitableEvent* task_done_event : task_done_events_)
+      task_done_event->Wait();
+  }
+
+ private:
+  ~FragmentEncryption() override { STLDeleteElements(&task_done_events_); }
+
+  // Worker pool task running EncryptRange. Signals |done| when completed.
+  void EncryptRangeTask(size_t begin, size_t end, base::WaitableEvent* done) {
+    ScopedSignal signal_on_exit(done);
+    EncryptRange(begin, end);
+  }
+
+  // Encrypt |pending_samples_| in [|begin|, |end|) with a new cryptor.
+  void EncryptRange(size_t begin, size_t end) {
+    if (begin == end)
+      return;
+
+    // AesCryptor is not thread safe, so every task uses its own cryptor.
+    scoped_ptr<AesCryptor> cryptor = CreateAesCryptor(
+        protection_scheme_, crypt_byte_block_, skip_byte_block_);
+    CHECK(cryptor);
+    CHECK(cryptor->InitializeWithIv(key_, pending_samples_[begin].iv));
+
+    for (size_t i = begin; i < end; ++i) {
+      const PendingSample& pending_sample = pending_samples_[i];
+      if (i != begin)
+        CHECK(cryptor->SetIv(pending_sample.iv));
+      uint8_t* sample_data = fragment_data_ + pending_sample.data_offset;
+      for (const CipherRange& range : pending_sample.cipher_ranges) {
+        uint8_t* data = sample_data + range.offset;
+        CHECK(cryptor->Crypt(data, range.size, data));
+      }
+    }
+  }
+
+  const FourCC protection_scheme_;
+  const uint8_t crypt_byte_block_;
+  const uint8_t skip_byte_block_;
+  // The key is copied, as it changes with key rotation.
+  const std::vector<uint8_t> key_;
+  uint8_t* const fragment_data_;
+  std::vector<PendingSample> pending_samples_;
+  std::vector<base::WaitableEvent*> task_done_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(FragmentEncryption);
+};
+
 EncryptingFragmenter::EncryptingFragmenter(
     scoped_refptr<StreamInfo> info,
     TrackFragment* traf,
@@ -75,7 +217,9 @@ EncryptingFragmenter::EncryptingFragmenter(
       clear_time_(clear_time),
       protection_scheme_(protection_scheme),
       crypt_byte_block_(crypt_byte_block),
-      skip_byte_block_(skip_byte_block) {
+      skip_byte_block_(skip_byte_block),
+      num_encryption_threads_(0),
+      async_encryption_(false) {
   DCHECK(encryption_key_);
   switch (video_codec_) {
     case kCodecVP8:
@@ -102,6 +246,9 @@ EncryptingFragmenter::EncryptingFragmenter(
 
 EncryptingFragmenter::~EncryptingFragmenter() {}
 
+EncryptingFragmenter::PendingSample::PendingSample() : data_offset(0) {}
+EncryptingFragmenter::PendingSample::~PendingSample() {}
+
 Status EncryptingFragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   DCHECK(sample);
   if (!fragment_initialized()) {
@@ -148,14 +295,20 @@ Status EncryptingFragmenter::InitializeFragment(int64_t first_sample_dts) {
 }
 
 void EncryptingFragmenter::FinalizeFragment() {
+  scoped_refptr<GatherBuffer::PendingWork> encryption;
   if (encryptor_) {
     DCHECK_LE(clear_time_, 0);
+    encryption = EncryptPendingSamples();
     FinalizeFragmentForEncryption();
   } else {
     DCHECK_GT(clear_time_, 0);
     clear_time_ -= fragment_duration();
   }
   Fragmenter::FinalizeFragment();
+  // The fragment data, now moved to data(), is written out once the
+  // encryption is complete.
+  if (encryption)
+    data()->AddPendingWork(encryption);
 }
 
 Status EncryptingFragmenter::PrepareFragmentForEncryption(
@@ -202,31 +355,10 @@ void EncryptingFragmenter::FinalizeFragmentForEncryption() {
 
 Status EncryptingFragmenter::CreateEncryptor() {
   DCHECK(encryption_key_);
-  scoped_ptr<AesCryptor> encryptor;
-  switch (protection_scheme_) {
-    case FOURCC_cenc:
-      encryptor.reset(new AesCtrEncryptor);
-      break;
-    case FOURCC_cbc1:
-      encryptor.reset(new AesCbcEncryptor(kNoPadding));
-      break;
-    case FOURCC_cens:
-      encryptor.reset(new AesPatternCryptor(
-          crypt_byte_block(), skip_byte_block(),
-          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-          AesCryptor::kDontUseConstantIv,
-          scoped_ptr<AesCryptor>(new AesCtrEncryptor())));
-      break;
-    case FOURCC_cbcs:
-      encryptor.reset(new AesPatternCryptor(
-          crypt_byte_block(), skip_byte_block(),
-          AesPatternCryptor::kEncryptIfCryptByteBlockRemaining,
-          AesCryptor::kUseConstantIv,
-          scoped_ptr<AesCryptor>(new AesCbcEncryptor(kNoPadding))));
-      break;
-    default:
-      return Status(error::MUXER_FAILURE, "Unsupported protection scheme.");
-  }
+  scoped_ptr<AesCryptor> encryptor = CreateAesCryptor(
+      protection_scheme_, crypt_byte_block_, skip_byte_block_);
+  if (!encryptor)
+    return Status(error::MUXER_FAILURE, "Unsupported protection scheme.");
 
   DCHECK(!encryption_key_->iv.empty());
   const bool initialized =
@@ -237,9 +369,24 @@ Status EncryptingFragmenter::CreateEncryptor() {
   return Status::OK;
 }
 
-void EncryptingFragmenter::EncryptBytes(uint8_t* data, uint32_t size) {
+void EncryptingFragmenter::EncryptBytes(const uint8_t* sample_data,
+                                        const uint8_t* data,
+                                        uint32_t size,
+                                        uint8_t* writable_sample_data) {
   DCHECK(encryptor_);
-  CHECK(encryptor_->Crypt(data, size, data));
+  const size_t offset = data - sample_data;
+  if (UseParallelEncryption()) {
+    // Defer the encryption to EncryptPendingSamples. The iv still needs to be
+    // advanced as if the bytes were encrypted.
+    DCHECK(!pending_samples_.empty());
+    CipherRange range = {offset, size};
+    pending_samples_.back().cipher_ranges.push_back(range);
+    encryptor_->AddCryptBytes(size);
+    return;
+  }
+  DCHECK(writable_sample_data);
+  uint8_t* writable_data = writable_sample_data + offset;
+  CHECK(encryptor_->Crypt(writable_data, size, writable_data));
 }
 
 Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
@@ -249,7 +396,18 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
   // For 'cbcs' scheme, Constant IVs SHALL be used.
   if (protection_scheme_ != FOURCC_cbcs)
     sample_encryption_entry.initialization_vector = encryptor_->iv();
-  uint8_t* data = sample->writable_data();
+  if (UseParallelEncryption()) {
+    pending_samples_.resize(pending_samples_.size() + 1);
+    pending_samples_.back().data_offset = sample_buffer()->Size();
+    pending_samples_.back().iv = encryptor_->iv();
+  }
+  // Serial encryption is done in place in the sample. In parallel mode, the
+  // sample is encrypted in the fragment buffer instead, so avoid copying the
+  // sample data if it is shared.
+  uint8_t* writable_sample_data =
+      UseParallelEncryption() ? NULL : sample->writable_data();
+  const uint8_t* const sample_data = sample->data();
+  const uint8_t* data = sample_data;
   if (IsSubsampleEncryptionRequired()) {
     if (vpx_parser_) {
       std::vector<VPxFrameInfo> vpx_frames;
@@ -282,7 +440,8 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
 
         sample_encryption_entry.subsamples.push_back(subsample);
         if (subsample.cipher_bytes > 0)
-          EncryptBytes(data + subsample.clear_bytes, subsample.cipher_bytes);
+          EncryptBytes(sample_data, data + subsample.clear_bytes,
+                       subsample.cipher_bytes, writable_sample_data);
         data += frame.frame_size;
       }
     } else {
@@ -324,7 +483,8 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
           }
 
           const uint8_t* nalu_data = nalu.data() + current_clear_bytes;
-          EncryptBytes(const_cast<uint8_t*>(nalu_data), cipher_bytes);
+          EncryptBytes(sample_data, nalu_data, cipher_bytes,
+                       writable_sample_data);
 
           AddSubsamples(
               accumulated_clear_bytes + nalu_length_size_ + current_clear_bytes,
@@ -348,7 +508,7 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
   } else {
     DCHECK_LE(crypt_byte_block(), 1u);
     DCHECK_EQ(skip_byte_block(), 0u);
-    EncryptBytes(data, sample->data_size());
+    EncryptBytes(sample_data, data, sample->data_size(), writable_sample_data);
   }
 
   traf()->sample_encryption.sample_encryption_entries.push_back(
@@ -357,6 +517,26 @@ Status EncryptingFragmenter::EncryptSample(scoped_refptr<MediaSample> sample) {
   return Status::OK;
 }
 
+scoped_refptr<GatherBuffer::PendingWork>
+EncryptingFragmenter::EncryptPendingSamples() {
+  if (pending_samples_.empty())
+    return NULL;
+  DCHECK(UseParallelEncryption());
+
+  scoped_refptr<FragmentEncryption> encryption(new FragmentEncryption(
+      protection_scheme_, crypt_byte_block_, skip_byte_block_,
+      encryption_key_->key, sample_buffer()->MutableBuffer(),
+      &pending_samples_));
+  DCHECK(pending_samples_.empty());
+  if (async_encryption_) {
+    encryption->Start(num_encryption_threads_, false /* use_current_thread */);
+    return encryption;
+  }
+  encryption->Start(num_encryption_threads_, true /* use_current_thread */);
+  encryption->Wait();
+  return NULL;
+}
+
 bool EncryptingFragmenter::IsSubsampleEncryptionRequired() {
   return vpx_parser_ || nalu_length_size_ != 0;
 }
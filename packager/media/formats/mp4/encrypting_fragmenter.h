@@ -7,9 +7,12 @@
 #ifndef MEDIA_FORMATS_MP4_ENCRYPTING_FRAGMENTER_H_
 #define MEDIA_FORMATS_MP4_ENCRYPTING_FRAGMENTER_H_
 
+#include <vector>
+
 #include "packager/base/memory/ref_counted.h"
 #include "packager/base/memory/scoped_ptr.h"
 #include "packager/media/base/fourccs.h"
+#include "packager/media/base/gather_buffer.h"
 #include "packager/media/codecs/video_slice_header_parser.h"
 #include "packager/media/codecs/vpx_parser.h"
 #include "packager/media/formats/mp4/fragmenter.h"
@@ -54,6 +57,29 @@ class EncryptingFragmenter : public Fragmenter {
   void FinalizeFragment() override;
   /// @}
 
+  /// Set the number of threads used to encrypt samples. If it is more than 1,
+  /// subsample maps and ivs are still computed as samples are added, but the
+  /// cipher work for all samples in a fragment is done in parallel when the
+  /// fragment is finalized. The output is identical either way. Default 0,
+  /// i.e. samples are encrypted as they are added.
+  void set_num_encryption_threads(size_t num_encryption_threads) {
+    num_encryption_threads_ = num_encryption_threads;
+    // The deferred encryption is done in place in the fragment data.
+    set_copy_sample_data(UseParallelEncryption());
+  }
+
+  /// Encrypt the samples of a fragment on the worker pool without waiting for
+  /// it when the fragment is finalized. The fragment data, data(), waits for
+  /// the encryption before it is written out instead, so that the encryption
+  /// overlaps with the following fragments. Only the cipher work leaves the
+  /// muxer thread: ivs and subsample maps are still computed as samples are
+  /// added. The output is identical either way. The encryption is split in
+  /// max(1, num_encryption_threads) tasks. Default false.
+  void set_async_encryption(bool async_encryption) {
+    async_encryption_ = async_encryption;
+    set_copy_sample_data(UseParallelEncryption());
+  }
+
  protected:
   /// Prepare current fragment for encryption.
   /// @return OK on success, an error status otherwise.
@@ -77,8 +103,46 @@ class EncryptingFragmenter : public Fragmenter {
   }
 
  private:
-  void EncryptBytes(uint8_t* data, uint32_t size);
+  // A range of sample data to be encrypted, relative to the start of sample.
+  struct CipherRange {
+    size_t offset;
+    size_t size;
+  };
+
+  // Encryption of the samples of a fragment in the fragment data, running on
+  // the worker pool.
+  class FragmentEncryption;
+
+  // Encryption work of a sample deferred to the end of the fragment.
+  struct PendingSample {
+    PendingSample();
+    ~PendingSample();
+
+    // Offset of the sample in the fragment data.
+    size_t data_offset;
+    std::vector<uint8_t> iv;
+    std::vector<CipherRange> cipher_ranges;
+  };
+
+  // Encrypt |size| bytes at |data|, where |data| points into the sample
+  // starting at |sample_data|. The bytes are encrypted in place in
+  // |writable_sample_data|, the writable copy of the sample, or at the end of
+  // the fragment if parallel encryption is enabled, in which case
+  // |writable_sample_data| is NULL.
+  void EncryptBytes(const uint8_t* sample_data,
+                    const uint8_t* data,
+                    uint32_t size,
+                    uint8_t* writable_sample_data);
   Status EncryptSample(scoped_refptr<MediaSample> sample);
+  bool UseParallelEncryption() const {
+    return num_encryption_threads_ > 1 || async_encryption_;
+  }
+
+  // Encrypt |pending_samples_| in the fragment data using up to
+  // |num_encryption_threads_| threads. Waits for them to complete unless
+  // |async_encryption_| is set.
+  // @return The encryption still running, NULL if complete.
+  scoped_refptr<GatherBuffer::PendingWork> EncryptPendingSamples();
 
   // Should we enable subsample encryption?
   bool IsSubsampleEncryptionRequired();
@@ -99,6 +163,10 @@ class EncryptingFragmenter : public Fragmenter {
   scoped_ptr<VPxParser> vpx_parser_;
   scoped_ptr<VideoSliceHeaderParser> header_parser_;
 
+  size_t num_encryption_threads_;
+  bool async_encryption_;
+  std::vector<PendingSample> pending_samples_;
+
   DISALLOW_COPY_AND_ASSIGN(EncryptingFragmenter);
 };
 
@@ -8,8 +8,10 @@
 
 #include <limits>
 
+#include "packager/media/base/buffer_pool.h"
 #include "packager/media/base/buffer_writer.h"
 #include "packager/media/base/audio_stream_info.h"
+#include "packager/media/base/gather_buffer.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/formats/mp4/box_definitions.h"
 
@@ -36,11 +38,15 @@ Fragmenter::Fragmenter(scoped_refptr<StreamInfo> info, TrackFragment* traf)
       fragment_duration_(0),
       presentation_start_time_(kInvalidTime),
       earliest_presentation_time_(kInvalidTime),
-      first_sap_time_(kInvalidTime) {
+      first_sap_time_(kInvalidTime),
+      data_(new GatherBuffer),
+      last_sample_buffer_size_(0) {
   DCHECK(traf);
 }
 
-Fragmenter::~Fragmenter() {}
+Fragmenter::~Fragmenter() {
+  set_copy_sample_data(false);
+}
 
 Status Fragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   DCHECK(sample);
@@ -61,7 +67,10 @@ Status Fragmenter::AddSample(scoped_refptr<MediaSample> sample) {
   traf_->runs[0].sample_flags.push_back(
       sample->is_key_frame() ? 0 : TrackFragmentHeader::kNonKeySampleMask);
 
-  data_->AppendArray(sample->data(), sample->data_size());
+  if (sample_buffer_)
+    sample_buffer_->AppendArray(sample->data(), sample->data_size());
+  else
+    data_->AppendSample(sample);
   fragment_duration_ += sample->duration();
 
   int64_t pts = sample->pts();
@@ -97,7 +106,19 @@ Status Fragmenter::InitializeFragment(int64_t first_sample_dts) {
   fragment_duration_ = 0;
   earliest_presentation_time_ = kInvalidTime;
   first_sap_time_ = kInvalidTime;
-  data_.reset(new BufferWriter());
+
+  // The data of the previous fragment has been moved out by now, unless the
+  // fragment was dropped.
+  data_->Clear();
+  if (sample_buffer_) {
+    // The buffer of the previous fragment is recycled once written out. The
+    // new fragment is likely to be about the same size.
+    std::vector<uint8_t> buffer;
+    sample_buffer_->SwapBuffer(&buffer);
+    BufferPool::GetInstance()->Release(&buffer);
+    BufferPool::GetInstance()->Acquire(last_sample_buffer_size_, &buffer);
+    sample_buffer_->SwapBuffer(&buffer);
+  }
   return Status::OK;
 }
 
@@ -153,6 +174,11 @@ void Fragmenter::FinalizeFragment() {
         SampleToGroupEntry::kTrackFragmentGroupDescriptionIndexBase + 1;
   }
 
+  if (sample_buffer_) {
+    last_sample_buffer_size_ = sample_buffer_->Size();
+    data_->AppendBuffer(sample_buffer_.get());
+  }
+
   fragment_finalized_ = true;
   fragment_initialized_ = false;
 }
@@ -172,6 +198,19 @@ void Fragmenter::GenerateSegmentReference(SegmentReference* reference) {
   reference->earliest_presentation_time = earliest_presentation_time_;
 }
 
+void Fragmenter::set_copy_sample_data(bool copy_sample_data) {
+  if (copy_sample_data == (sample_buffer_.get() != NULL))
+    return;
+  if (copy_sample_data) {
+    sample_buffer_.reset(new BufferWriter());
+    return;
+  }
+  std::vector<uint8_t> buffer;
+  sample_buffer_->SwapBuffer(&buffer);
+  BufferPool::GetInstance()->Release(&buffer);
+  sample_buffer_.reset();
+}
+
 bool Fragmenter::StartsWithSAP() {
   DCHECK(!traf_->runs.empty());
   uint32_t start_sample_flag;
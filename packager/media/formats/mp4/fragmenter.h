@@ -18,6 +18,7 @@ namespace shaka {
 namespace media {
 
 class BufferWriter;
+class GatherBuffer;
 class MediaSample;
 class StreamInfo;
 
@@ -60,11 +61,22 @@ class Fragmenter {
   }
   bool fragment_initialized() const { return fragment_initialized_; }
   bool fragment_finalized() const { return fragment_finalized_; }
-  BufferWriter* data() { return data_.get(); }
+  /// @return the sample data of the fragment. The samples are referenced
+  ///         instead of copied, unless set_copy_sample_data(true) is set.
+  GatherBuffer* data() { return data_.get(); }
 
  protected:
   TrackFragment* traf() { return traf_; }
 
+  /// Copy the sample data into a contiguous buffer, sample_buffer(), as
+  /// samples are added, e.g. to modify it in place before the fragment is
+  /// finalized. Should be set before any sample is added.
+  void set_copy_sample_data(bool copy_sample_data);
+  /// @return the sample data of the current fragment copied so far, if
+  ///         set_copy_sample_data(true) is set, NULL otherwise. It is moved
+  ///         to data() when the fragment is finalized.
+  BufferWriter* sample_buffer() { return sample_buffer_.get(); }
+
   /// Optimize sample entries table. If all values in @a entries are identical,
   /// then @a entries is cleared and the value is assigned to @a default_value;
   /// otherwise it is a NOP. Return true if the table is optimized.
@@ -83,7 +95,11 @@ class Fragmenter {
   int64_t presentation_start_time_;
   int64_t earliest_presentation_time_;
   int64_t first_sap_time_;
-  scoped_ptr<BufferWriter> data_;
+  scoped_ptr<GatherBuffer> data_;
+  scoped_ptr<BufferWriter> sample_buffer_;
+  // Size of the previous fragment in |sample_buffer_|, used to size the
+  // next one.
+  size_t last_sample_buffer_size_;
 
   DISALLOW_COPY_AND_ASSIGN(Fragmenter);
 };
@@ -4,12 +4,14 @@
 
 #include "packager/media/formats/mp4/mp4_media_parser.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "packager/base/callback.h"
 #include "packager/base/callback_helpers.h"
 #include "packager/base/logging.h"
 #include "packager/base/memory/ref_counted.h"
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/media/base/audio_stream_info.h"
 #include "packager/media/base/buffer_reader.h"
@@ -88,6 +90,70 @@ AudioCodec FourCCToAudioCodec(FourCC fourcc) {
 const uint8_t kDtsAudioNumChannels = 6;
 const uint64_t kNanosecondsPerSecond = 1000000000ull;
 
+// Read exactly |size| bytes from |file| into |buffer|.
+bool ReadFully(File* file, uint8_t* buffer, uint64_t size) {
+  while (size > 0) {
+    int64_t bytes_read = file->Read(buffer, size);
+    if (bytes_read <= 0)
+      return false;
+    buffer += bytes_read;
+    size -= bytes_read;
+  }
+  return true;
+}
+
+// Position |file| at the start of its 'moov' box.
+// |box_size| receives the size of the 'moov' box. |mdat_seen| is set to true
+// if the 'moov' box is after an 'mdat' box.
+bool SeekToMoov(File* file,
+                const std::string& file_path,
+                uint64_t* box_size,
+                bool* mdat_seen) {
+  if (!file->Seek(0)) {
+    LOG(WARNING) << "Filesystem does not support seeking on file '" << file_path
+               << "'";
+    return false;
+  }
+
+  uint64_t file_position(0);
+  *mdat_seen = false;
+  while (true) {
+    const uint32_t kBoxHeaderReadSize(16);
+    std::vector<uint8_t> buffer(kBoxHeaderReadSize);
+    int64_t bytes_read = file->Read(&buffer[0], kBoxHeaderReadSize);
+    if (bytes_read == 0) {
+      LOG(ERROR) << "Could not find 'moov' box in file '" << file_path << "'";
+      return false;
+    }
+    if (bytes_read < kBoxHeaderReadSize) {
+      LOG(ERROR) << "Error reading media file '" << file_path << "'";
+      return false;
+    }
+    FourCC box_type;
+    bool err;
+    if (!BoxReader::StartBox(&buffer[0], kBoxHeaderReadSize, &box_type,
+                             box_size, &err)) {
+      LOG(ERROR) << "Could not start box from file '" << file_path << "'";
+      return false;
+    }
+    if (box_type == FOURCC_mdat) {
+      *mdat_seen = true;
+    } else if (box_type == FOURCC_moov) {
+      break;
+    }
+    file_position += *box_size;
+    if (!file->Seek(file_position)) {
+      LOG(ERROR) << "Error skipping box in mp4 file '" << file_path << "'";
+      return false;
+    }
+  }
+  if (!file->Seek(file_position)) {
+    LOG(ERROR) << "Error seeking to 'moov' in mp4 file '" << file_path << "'";
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 MP4MediaParser::MP4MediaParser()
@@ -135,7 +201,24 @@ bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
     return false;
 
   queue_.Push(buf, size);
+  return ParseQueue();
+}
+
+bool MP4MediaParser::ParseShared(
+    const scoped_refptr<base::RefCountedMemory>& buffer,
+    size_t offset,
+    int size) {
+  DCHECK_NE(state_, kWaitingForInit);
 
+  if (state_ == kError)
+    return false;
+
+  // The samples reference |buffer| through |queue_|, see EnqueueSample().
+  queue_.PushShared(buffer, offset, size);
+  return ParseQueue();
+}
+
+bool MP4MediaParser::ParseQueue() {
   bool result, err = false;
 
   do {
@@ -169,70 +252,133 @@ bool MP4MediaParser::LoadMoov(const std::string& file_path) {
     LOG(ERROR) << "Unable to open media file '" << file_path << "'";
     return false;
   }
-  if (!file->Seek(0)) {
-    LOG(WARNING) << "Filesystem does not support seeking on file '" << file_path
-               << "'";
+
+  uint64_t box_size;
+  bool mdat_seen;
+  if (!SeekToMoov(file.get(), file_path, &box_size, &mdat_seen))
     return false;
+  if (!mdat_seen) {
+    // 'moov' is before 'mdat'. Nothing to do.
+    return true;
   }
 
-  uint64_t file_position(0);
-  bool mdat_seen(false);
-  while (true) {
-    const uint32_t kBoxHeaderReadSize(16);
-    std::vector<uint8_t> buffer(kBoxHeaderReadSize);
-    int64_t bytes_read = file->Read(&buffer[0], kBoxHeaderReadSize);
-    if (bytes_read == 0) {
-      LOG(ERROR) << "Could not find 'moov' box in file '" << file_path << "'";
+  // 'mdat' before 'moov'. Read and parse 'moov'.
+  const uint64_t kReadSize = 0x10000;
+  std::vector<uint8_t> buffer(std::min(box_size, kReadSize));
+  uint64_t bytes_to_read = box_size;
+  while (bytes_to_read > 0) {
+    int64_t bytes_read =
+        file->Read(&buffer[0], std::min(bytes_to_read, kReadSize));
+    if (bytes_read <= 0) {
+      LOG(ERROR) << "Error reading 'moov' contents from file '" << file_path
+                 << "'";
       return false;
     }
-    if (bytes_read < kBoxHeaderReadSize) {
-      LOG(ERROR) << "Error reading media file '" << file_path << "'";
+    if (!Parse(&buffer[0], bytes_read)) {
+      LOG(ERROR) << "Error parsing mp4 file '" << file_path << "'";
       return false;
     }
-    uint64_t box_size;
-    FourCC box_type;
-    bool err;
-    if (!BoxReader::StartBox(&buffer[0], kBoxHeaderReadSize, &box_type,
-                             &box_size, &err)) {
-      LOG(ERROR) << "Could not start box from file '" << file_path << "'";
-      return false;
+    bytes_to_read -= bytes_read;
+  }
+  queue_.Reset();  // So that we don't need to adjust data offsets.
+  mdat_tail_ = 0;  // So it will skip boxes until mdat.
+  return true;
+}
+
+bool MP4MediaParser::InitRandomAccess(const std::string& file_path) {
+  DCHECK_EQ(state_, kParsingBoxes);
+  DCHECK(!moov_);
+
+  scoped_ptr<File, FileCloser> file(
+      File::OpenWithNoBuffering(file_path.c_str(), "r"));
+  if (!file) {
+    LOG(ERROR) << "Unable to open media file '" << file_path << "'";
+    return false;
+  }
+
+  uint64_t box_size;
+  bool mdat_seen;
+  if (!SeekToMoov(file.get(), file_path, &box_size, &mdat_seen))
+    return false;
+
+  std::vector<uint8_t> buffer(box_size);
+  if (!ReadFully(file.get(), &buffer[0], box_size)) {
+    LOG(ERROR) << "Error reading 'moov' contents from file '" << file_path
+               << "'";
+    return false;
+  }
+
+  bool err = false;
+  scoped_ptr<BoxReader> reader(
+      BoxReader::ReadBox(&buffer[0], buffer.size(), &err));
+  scoped_ptr<Movie> moov(new Movie);
+  if (!reader || !moov->Parse(reader.get())) {
+    LOG(ERROR) << "Error parsing 'moov' in mp4 file '" << file_path << "'";
+    return false;
+  }
+  // The samples of fragmented files are described in the 'moof' boxes, which
+  // are parsed from the data passed to Parse().
+  if (!moov->extends.tracks.empty())
+    return false;
+
+  random_access_file_ = file.Pass();
+  if (!InitializeMoov(moov.Pass())) {
+    moov_.reset();
+    Reset();
+    ChangeState(kError);
+    return false;
+  }
+  runs_->SortRunsByDecodingTime();
+  return true;
+}
+
+bool MP4MediaParser::ReadSamples(int64_t min_bytes, bool* end_of_stream) {
+  DCHECK(random_access_file_);
+  DCHECK(end_of_stream);
+
+  *end_of_stream = false;
+  if (state_ == kError)
+    return false;
+
+  int64_t bytes_read = 0;
+  while (bytes_read < min_bytes) {
+    if (!runs_->IsRunValid()) {
+      *end_of_stream = true;
+      return true;
     }
-    if (box_type == FOURCC_mdat) {
-      mdat_seen = true;
-    } else if (box_type == FOURCC_moov) {
-      if (!mdat_seen) {
-        // 'moov' is before 'mdat'. Nothing to do.
-        break;
-      }
-      // 'mdat' before 'moov'. Read and parse 'moov'.
-      if (!Parse(&buffer[0], bytes_read)) {
-        LOG(ERROR) << "Error parsing mp4 file '" << file_path << "'";
-        return false;
-      }
-      uint64_t bytes_to_read = box_size - bytes_read;
-      buffer.resize(bytes_to_read);
-      while (bytes_to_read > 0) {
-        bytes_read = file->Read(&buffer[0], bytes_to_read);
-        if (bytes_read <= 0) {
-          LOG(ERROR) << "Error reading 'moov' contents from file '" << file_path
-                     << "'";
-          return false;
-        }
-        if (!Parse(&buffer[0], bytes_read)) {
-          LOG(ERROR) << "Error parsing mp4 file '" << file_path << "'";
-          return false;
-        }
-        bytes_to_read -= bytes_read;
-      }
-      queue_.Reset();  // So that we don't need to adjust data offsets.
-      mdat_tail_ = 0;  // So it will skip boxes until mdat.
-      break;  // Done.
+    if (!runs_->IsSampleValid()) {
+      runs_->AdvanceRun();
+      continue;
     }
-    file_position += box_size;
-    if (!file->Seek(file_position)) {
-      LOG(ERROR) << "Error skipping box in mp4 file '" << file_path << "'";
+
+    // Read the data of as many consecutive samples of the run as allowed in
+    // a single read.
+    const int64_t size = runs_->GetContiguousSampleDataSize(min_bytes);
+    std::vector<uint8_t> data(size);
+    if (!random_access_file_->Seek(runs_->sample_offset()) ||
+        !ReadFully(random_access_file_.get(), data.data(), size)) {
+      LOG(ERROR) << "Error reading samples at offset "
+                 << runs_->sample_offset();
+      ChangeState(kError);
       return false;
     }
+    scoped_refptr<base::RefCountedBytes> buffer(
+        base::RefCountedBytes::TakeVector(&data));
+
+    // At least one sample is emitted, even if it is empty.
+    int64_t offset = 0;
+    do {
+      DCHECK(runs_->IsSampleValid());
+      const int sample_size = runs_->sample_size();
+      scoped_refptr<MediaSample> sample = MediaSample::CreateFromSharedBuffer(
+          buffer, offset, sample_size, runs_->is_keyframe());
+      if (!EmitSample(sample)) {
+        ChangeState(kError);
+        return false;
+      }
+      offset += sample_size;
+    } while (offset < size);
+    bytes_read += size;
   }
   return true;
 }
@@ -283,8 +429,13 @@ bool MP4MediaParser::ParseMoov(BoxReader* reader) {
   if (moov_)
     return true;  // Already parsed the 'moov' box.
 
-  moov_.reset(new Movie);
-  RCHECK(moov_->Parse(reader));
+  scoped_ptr<Movie> moov(new Movie);
+  RCHECK(moov->Parse(reader));
+  return InitializeMoov(moov.Pass());
+}
+
+bool MP4MediaParser::InitializeMoov(scoped_ptr<Movie> moov) {
+  moov_ = moov.Pass();
   runs_.reset();
 
   std::vector<scoped_refptr<StreamInfo> > streams;
@@ -697,8 +848,7 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
     return false;
   }
 
-  scoped_refptr<MediaSample> stream_sample(MediaSample::CopyFrom(
-      buf, runs_->sample_size(), runs_->is_keyframe()));
+  scoped_refptr<MediaSample> stream_sample;
   if (runs_->is_encrypted()) {
     if (!decryptor_source_) {
       *err = true;
@@ -706,6 +856,9 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
                     "enabled";
       return false;
     }
+    // The sample is decrypted in place, so it needs its own copy of the data.
+    stream_sample = MediaSample::CopyFrom(buf, runs_->sample_size(),
+                                          runs_->is_keyframe());
 
     scoped_ptr<DecryptConfig> decrypt_config = runs_->GetDecryptConfig();
     if (!decrypt_config ||
@@ -716,11 +869,33 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
       LOG(ERROR) << "Cannot decrypt samples.";
       return false;
     }
+  } else if (runs_->sample_size() >= queue_.MinSharedSize()) {
+    // Reference the sample data in |queue_| instead of copying it.
+    scoped_refptr<base::RefCountedMemory> buffer;
+    size_t buffer_offset = 0;
+    int buffer_size = 0;
+    const bool peeked = queue_.PeekSharedAt(sample_offset, &buffer,
+                                            &buffer_offset, &buffer_size);
+    DCHECK(peeked);
+    DCHECK_GE(buffer_size, runs_->sample_size());
+    stream_sample = MediaSample::CreateFromSharedBuffer(
+        buffer, buffer_offset, runs_->sample_size(), runs_->is_keyframe());
+  } else {
+    stream_sample = MediaSample::CopyFrom(buf, runs_->sample_size(),
+                                          runs_->is_keyframe());
+  }
+
+  if (!EmitSample(stream_sample)) {
+    *err = true;
+    return false;
   }
+  return true;
+}
 
-  stream_sample->set_dts(runs_->dts());
-  stream_sample->set_pts(runs_->cts());
-  stream_sample->set_duration(runs_->duration());
+bool MP4MediaParser::EmitSample(const scoped_refptr<MediaSample>& sample) {
+  sample->set_dts(runs_->dts());
+  sample->set_pts(runs_->cts());
+  sample->set_duration(runs_->duration());
 
   DVLOG(3) << "Pushing frame: "
            << ", key=" << runs_->is_keyframe()
@@ -729,8 +904,7 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
            << ", cts=" << runs_->cts()
            << ", size=" << runs_->sample_size();
 
-  if (!new_sample_cb_.Run(runs_->track_id(), stream_sample)) {
-    *err = true;
+  if (!new_sample_cb_.Run(runs_->track_id(), sample)) {
     LOG(ERROR) << "Failed to process the sample.";
     return false;
   }
@@ -20,6 +20,7 @@
 #include "packager/media/base/decryptor_source.h"
 #include "packager/media/base/media_parser.h"
 #include "packager/media/base/offset_byte_queue.h"
+#include "packager/media/file/file_closer.h"
 
 namespace shaka {
 namespace media {
@@ -42,6 +43,9 @@ class MP4MediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   bool Flush() override WARN_UNUSED_RESULT;
   bool Parse(const uint8_t* buf, int size) override WARN_UNUSED_RESULT;
+  bool ParseShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                   size_t offset,
+                   int size) override WARN_UNUSED_RESULT;
   /// @}
 
   /// Handles ISO-BMFF containers which have the 'moov' box trailing the
@@ -52,6 +56,27 @@ class MP4MediaParser : public MediaParser {
   /// @return true if successful, false otherwise.
   bool LoadMoov(const std::string& file_path);
 
+  /// Sets up the parser to read the samples of a non-fragmented ISO-BMFF file
+  /// directly from the file, seeking to each chunk, instead of from the data
+  /// passed to Parse(). The samples are emitted in decoding time order across
+  /// the tracks, and memory use does not depend on how the tracks are
+  /// interleaved in the file. Call after Init(), instead of LoadMoov().
+  /// @param file_path is the path to the media file to be parsed. The file
+  ///        must support seeking.
+  /// @return true if the samples are to be read with ReadSamples(). false if
+  ///         the file is fragmented, cannot be read by random access or on
+  ///         error; the file data must then be passed to Parse() as usual.
+  bool InitRandomAccess(const std::string& file_path);
+
+  /// Read the next samples from the file and emit them. Only valid after
+  /// InitRandomAccess() returned true.
+  /// @param min_bytes is the amount of sample data to read before returning,
+  ///        unless the end of the file is reached.
+  /// @param[out] end_of_stream is set to true once all the samples have been
+  ///             emitted.
+  /// @return true if successful, false otherwise.
+  bool ReadSamples(int64_t min_bytes, bool* end_of_stream);
+
  private:
   enum State {
     kWaitingForInit,
@@ -60,8 +85,12 @@ class MP4MediaParser : public MediaParser {
     kError
   };
 
+  // Parse the data in |queue_|, emitting the samples which are complete.
+  bool ParseQueue();
   bool ParseBox(bool* err);
   bool ParseMoov(mp4::BoxReader* reader);
+  // Set up the streams and the track runs of |moov|.
+  bool InitializeMoov(scoped_ptr<Movie> moov);
   bool ParseMoof(mp4::BoxReader* reader);
 
   bool FetchKeysIfNecessary(
@@ -80,6 +109,8 @@ class MP4MediaParser : public MediaParser {
   bool EmitConfigs();
 
   bool EnqueueSample(bool* err);
+  // Emit |sample|, the current sample of |runs_|, and advance to the next.
+  bool EmitSample(const scoped_refptr<MediaSample>& sample);
 
   void Reset();
 
@@ -104,6 +135,10 @@ class MP4MediaParser : public MediaParser {
   scoped_ptr<Movie> moov_;
   scoped_ptr<TrackRunIterator> runs_;
 
+  // The media file if the samples are read by random access, see
+  // InitRandomAccess().
+  scoped_ptr<File, FileCloser> random_access_file_;
+
   DISALLOW_COPY_AND_ASSIGN(MP4MediaParser);
 };
 
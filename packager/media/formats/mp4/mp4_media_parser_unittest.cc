@@ -9,6 +9,7 @@
 
 #include "packager/base/bind.h"
 #include "packager/base/logging.h"
+#include "packager/base/memory/ref_counted_memory.h"
 #include "packager/media/base/fixed_key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/stream_info.h"
@@ -41,7 +42,8 @@ namespace mp4 {
 
 class MP4MediaParserTest : public testing::Test {
  public:
-  MP4MediaParserTest() : num_streams_(0), num_samples_(0) {
+  MP4MediaParserTest()
+      : num_streams_(0), num_samples_(0), retain_samples_(false) {
     parser_.reset(new MP4MediaParser());
   }
 
@@ -51,6 +53,12 @@ class MP4MediaParserTest : public testing::Test {
   scoped_ptr<MP4MediaParser> parser_;
   size_t num_streams_;
   size_t num_samples_;
+  // If set, the received samples and a copy of their data at the time they
+  // were received are kept in |samples_| and |sample_data_|.
+  bool retain_samples_;
+  std::vector<scoped_refptr<MediaSample> > samples_;
+  std::vector<std::vector<uint8_t> > sample_data_;
+  std::vector<uint32_t> sample_track_ids_;
 
   bool AppendData(const uint8_t* data, size_t length) {
     return parser_->Parse(data, length);
@@ -87,9 +95,24 @@ class MP4MediaParserTest : public testing::Test {
     DVLOG(2) << "Track Id: " << track_id << " "
              << sample->ToString();
     ++num_samples_;
+    if (retain_samples_) {
+      samples_.push_back(sample);
+      sample_data_.push_back(std::vector<uint8_t>(
+          sample->data(), sample->data() + sample->data_size()));
+      sample_track_ids_.push_back(track_id);
+    }
     return true;
   }
 
+  // @return the data of the retained samples, grouped by track.
+  std::map<uint32_t, std::vector<std::vector<uint8_t> > >
+  GetSampleDataByTrack() const {
+    std::map<uint32_t, std::vector<std::vector<uint8_t> > > data_by_track;
+    for (size_t i = 0; i < sample_data_.size(); ++i)
+      data_by_track[sample_track_ids_[i]].push_back(sample_data_[i]);
+    return data_by_track;
+  }
+
   void InitializeParser(KeySource* decryption_key_source) {
     parser_->Init(
         base::Bind(&MP4MediaParserTest::InitF, base::Unretained(this)),
@@ -104,6 +127,19 @@ class MP4MediaParserTest : public testing::Test {
     std::vector<uint8_t> buffer = ReadTestDataFile(filename);
     return AppendDataInPieces(buffer.data(), buffer.size(), append_bytes);
   }
+
+  bool ReadMP4FileByRandomAccess(const std::string& filename,
+                                 int64_t read_bytes) {
+    InitializeParser(NULL);
+    if (!parser_->InitRandomAccess(GetTestDataFilePath(filename).value()))
+      return false;
+    bool end_of_stream = false;
+    while (!end_of_stream) {
+      if (!parser_->ReadSamples(read_bytes, &end_of_stream))
+        return false;
+    }
+    return true;
+  }
 };
 
 TEST_F(MP4MediaParserTest, UnalignedAppend) {
@@ -182,6 +218,54 @@ TEST_F(MP4MediaParserTest, MultiFragmentAppend) {
   EXPECT_EQ(201u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, SmallSamplesAreCopiedFromParserBuffer) {
+  // Referencing small samples would keep the whole parser buffer alive.
+  retain_samples_ = true;
+  EXPECT_TRUE(ParseMP4File("bear-640x360-av_frag.mp4", 512));
+  ASSERT_EQ(201u, samples_.size());
+  parser_.reset();
+
+  for (size_t i = 0; i < samples_.size(); ++i) {
+    EXPECT_FALSE(samples_[i]->is_data_shared());
+    EXPECT_EQ(sample_data_[i],
+              std::vector<uint8_t>(
+                  samples_[i]->data(),
+                  samples_[i]->data() + samples_[i]->data_size()));
+  }
+}
+
+TEST_F(MP4MediaParserTest, SharedSampleDataOutlivesParserBuffer) {
+  // Samples reference the shared input buffer instead of copying it. Keep
+  // them while the parser buffer is appended, trimmed and reset.
+  retain_samples_ = true;
+  InitializeParser(NULL);
+  std::vector<uint8_t> data = ReadTestDataFile("bear-640x360-av_frag.mp4");
+  const size_t data_size = data.size();
+  scoped_refptr<base::RefCountedMemory> buffer(
+      base::RefCountedBytes::TakeVector(&data));
+  for (size_t offset = 0; offset < data_size; offset += 512) {
+    ASSERT_TRUE(parser_->ParseShared(
+        buffer, offset, std::min<size_t>(512, data_size - offset)));
+  }
+  ASSERT_EQ(201u, samples_.size());
+  parser_.reset();
+  buffer = NULL;
+
+  for (size_t i = 0; i < samples_.size(); ++i) {
+    EXPECT_TRUE(samples_[i]->is_data_shared());
+    EXPECT_EQ(sample_data_[i],
+              std::vector<uint8_t>(
+                  samples_[i]->data(),
+                  samples_[i]->data() + samples_[i]->data_size()));
+  }
+
+  // Writing to the sample copies the data first.
+  scoped_refptr<MediaSample> sample = samples_[0];
+  sample->writable_data()[0] ^= 0xFF;
+  EXPECT_FALSE(sample->is_data_shared());
+  EXPECT_EQ(sample_data_[0][0] ^ 0xFF, sample->data()[0]);
+}
+
 TEST_F(MP4MediaParserTest, TrailingMoov) {
   EXPECT_TRUE(ParseMP4File("bear-640x360-trailing-moov.mp4", 1024));
   EXPECT_EQ(2u, num_streams_);
@@ -227,6 +311,45 @@ TEST_F(MP4MediaParserTest, NON_FRAGMENTED_MP4) {
   EXPECT_EQ(201u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, RandomAccessNonFragmented) {
+  retain_samples_ = true;
+  EXPECT_TRUE(ParseMP4File("bear-640x360.mp4", 512));
+  std::map<uint32_t, std::vector<std::vector<uint8_t> > > parsed_data =
+      GetSampleDataByTrack();
+
+  parser_.reset(new MP4MediaParser());
+  samples_.clear();
+  sample_data_.clear();
+  sample_track_ids_.clear();
+  EXPECT_TRUE(ReadMP4FileByRandomAccess("bear-640x360.mp4", 4096));
+  EXPECT_EQ(2u, num_streams_);
+  EXPECT_EQ(201u, num_samples_);
+
+  // The tracks may be interleaved differently, but each track has the same
+  // samples in the same order.
+  EXPECT_EQ(parsed_data, GetSampleDataByTrack());
+  for (size_t i = 0; i < samples_.size(); ++i)
+    EXPECT_TRUE(samples_[i]->is_data_shared());
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessTrailingMoov) {
+  EXPECT_TRUE(ReadMP4FileByRandomAccess("bear-640x360-trailing-moov.mp4", 1));
+  EXPECT_EQ(2u, num_streams_);
+  EXPECT_EQ(201u, num_samples_);
+}
+
+TEST_F(MP4MediaParserTest, RandomAccessNotUsedForFragmented) {
+  InitializeParser(NULL);
+  EXPECT_FALSE(parser_->InitRandomAccess(
+      GetTestDataFilePath("bear-640x360-av_frag.mp4").value()));
+  EXPECT_EQ(0u, num_streams_);
+
+  // The file is parsed from the data as usual.
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360-av_frag.mp4");
+  EXPECT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_EQ(201u, num_samples_);
+}
+
 TEST_F(MP4MediaParserTest, CencWithoutDecryptionSource) {
   // Parsing should fail but it will get the streams successfully.
   EXPECT_FALSE(ParseMP4File("bear-640x360-v_frag-cenc-aux.mp4", 512));
@@ -6,9 +6,11 @@
 
 #include "packager/media/formats/mp4/multi_segment_segmenter.h"
 
+#include "packager/base/stl_util.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/string_util.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/gather_buffer.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/base/muxer_util.h"
@@ -20,18 +22,29 @@ namespace shaka {
 namespace media {
 namespace mp4 {
 
+struct MultiSegmentSegmenter::PendingSegment {
+  uint64_t start_time;
+  uint64_t duration;
+  // The 'sidx' box, if any, and the fragments of the segment.
+  GatherBuffer data;
+};
+
 MultiSegmentSegmenter::MultiSegmentSegmenter(const MuxerOptions& options,
                                              scoped_ptr<FileType> ftyp,
                                              scoped_ptr<Movie> moov)
     : Segmenter(options, ftyp.Pass(), moov.Pass()),
       styp_(new SegmentType),
-      num_segments_(0) {
+      num_segments_(0),
+      segment_start_time_(0),
+      segment_size_(0) {
   // Use the same brands for styp as ftyp.
   styp_->major_brand = Segmenter::ftyp()->major_brand;
   styp_->compatible_brands = Segmenter::ftyp()->compatible_brands;
 }
 
-MultiSegmentSegmenter::~MultiSegmentSegmenter() {}
+MultiSegmentSegmenter::~MultiSegmentSegmenter() {
+  STLDeleteElements(&pending_segments_);
+}
 
 bool MultiSegmentSegmenter::GetInitRange(size_t* offset, size_t* size) {
   DLOG(INFO) << "MultiSegmentSegmenter outputs init segment: "
@@ -65,6 +78,12 @@ Status MultiSegmentSegmenter::DoInitialize() {
 }
 
 Status MultiSegmentSegmenter::DoFinalize() {
+  Status status = WritePendingSegments(0);
+  if (!status.ok())
+    return status;
+  status = CheckClosedSegmentFiles(true);
+  if (!status.ok())
+    return status;
   SetComplete();
   return Status::OK;
 }
@@ -130,51 +149,74 @@ Status MultiSegmentSegmenter::DoFinalizeSegment() {
   return WriteSegment();
 }
 
-Status MultiSegmentSegmenter::WriteSegment() {
-  DCHECK(sidx());
-  DCHECK(fragment_buffer());
+Status MultiSegmentSegmenter::DoFinalizeFragment() {
+  // Failures to write the segments closed meanwhile are reported as soon as
+  // they are known.
+  Status status = CheckClosedSegmentFiles(false);
+  if (!status.ok() || !options().low_latency_mode)
+    return status;
+
+  GatherBuffer chunk;
+  if (!segment_file_) {
+    // The first chunk of the segment opens the segment file.
+    DCHECK_EQ(1u, sidx()->references.size());
+    BufferWriter header;
+    status = OpenSegmentFile(
+        sidx()->references[0].earliest_presentation_time, &header);
+    if (!status.ok())
+      return status;
+    chunk.AppendBuffer(&header);
+  }
+  chunk.Append(fragment_buffer());
+  segment_size_ += chunk.Size();
+
+  // The chunk is flushed so that it can be served before the segment is
+  // complete.
+  status = chunk.WriteToFile(segment_file_.get());
+  if (status.ok() && !segment_file_->Flush()) {
+    status = Status(error::FILE_FAILURE,
+                    "Cannot flush file " + segment_file_name_);
+  }
+  return status;
+}
+
+Status MultiSegmentSegmenter::OpenSegmentFile(uint64_t start_time,
+                                              BufferWriter* header) {
+  DCHECK(!segment_file_);
   DCHECK(styp_);
 
-  scoped_ptr<BufferWriter> buffer(new BufferWriter());
-  File* file;
-  std::string file_name;
+  segment_start_time_ = start_time;
+  segment_size_ = 0;
   if (options().segment_template.empty()) {
     // Append the segment to output file if segment template is not specified.
-    file_name = options().output_file_name.c_str();
-    file = File::Open(file_name.c_str(), "a");
-    if (file == NULL) {
-      return Status(
-          error::FILE_FAILURE,
-          "Cannot open file for append " + options().output_file_name);
+    // The segments before it are checked first, as opening the file again
+    // clears the errors of its previous writes.
+    Status status = CheckClosedSegmentFiles(true);
+    if (!status.ok())
+      return status;
+    segment_file_name_ = options().output_file_name;
+    segment_file_.reset(File::Open(segment_file_name_.c_str(), "a"));
+    if (!segment_file_) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot open file for append " + segment_file_name_);
     }
   } else {
-    file_name = GetSegmentName(options().segment_template,
-                               sidx()->earliest_presentation_time,
-                               num_segments_++, options().bandwidth);
-    file = File::Open(file_name.c_str(), "w");
-    if (file == NULL) {
+    segment_file_name_ =
+        GetSegmentName(options().segment_template, start_time,
+                       num_segments_++, options().bandwidth);
+    segment_file_.reset(File::Open(segment_file_name_.c_str(), "w"));
+    if (!segment_file_) {
       return Status(error::FILE_FAILURE,
-                    "Cannot open file for write " + file_name);
+                    "Cannot open file for write " + segment_file_name_);
     }
-    styp_->Write(buffer.get());
+    styp_->Write(header);
   }
+  return Status::OK;
+}
 
-  // If num_subsegments_per_sidx is negative, no SIDX box is generated.
-  if (options().num_subsegments_per_sidx >= 0)
-    sidx()->Write(buffer.get());
-
-  const size_t segment_size = buffer->Size() + fragment_buffer()->Size();
-  DCHECK_NE(segment_size, 0u);
-
-  Status status = buffer->WriteToFile(file);
-  if (status.ok())
-    status = fragment_buffer()->WriteToFile(file);
-
-  if (!file->Close())
-    LOG(WARNING) << "Failed to close the file properly: " << file_name;
-
-  if (!status.ok())
-    return status;
+Status MultiSegmentSegmenter::WriteSegment() {
+  DCHECK(sidx());
+  DCHECK(fragment_buffer());
 
   uint64_t segment_duration = 0;
   // ISO/IEC 23009-1:2012: the value shall be identical to sum of the the
@@ -182,14 +224,95 @@ Status MultiSegmentSegmenter::WriteSegment() {
   for (size_t i = 0; i < sidx()->references.size(); ++i)
     segment_duration += sidx()->references[i].subsegment_duration;
 
-  UpdateProgress(segment_duration);
+  if (options().low_latency_mode) {
+    DCHECK(segment_file_);
+    return CloseSegmentFile(segment_duration);
+  }
+
+  scoped_ptr<PendingSegment> segment(new PendingSegment);
+  segment->start_time = sidx()->earliest_presentation_time;
+  segment->duration = segment_duration;
+  // If num_subsegments_per_sidx is negative, no SIDX box is generated.
+  if (options().num_subsegments_per_sidx >= 0) {
+    BufferWriter buffer;
+    sidx()->Write(&buffer);
+    segment->data.AppendBuffer(&buffer);
+  }
+  segment->data.Append(fragment_buffer());
+  pending_segments_.push_back(segment.release());
+
+  // The segments still being encrypted are held, up to the number of segments
+  // in flight.
+  const size_t num_parallel_segments = options().num_parallel_segments;
+  return WritePendingSegments(
+      num_parallel_segments > 1 ? num_parallel_segments - 1 : 0);
+}
+
+Status MultiSegmentSegmenter::WritePendingSegments(
+    size_t max_pending_segments) {
+  while (pending_segments_.size() > max_pending_segments) {
+    scoped_ptr<PendingSegment> segment(pending_segments_.front());
+    pending_segments_.pop_front();
+
+    BufferWriter header;
+    Status status = OpenSegmentFile(segment->start_time, &header);
+    if (!status.ok())
+      return status;
+
+    // The segment header and the fragments are written with a single vectored
+    // write, once the encryption of the fragments is complete.
+    GatherBuffer data;
+    data.AppendBuffer(&header);
+    data.Append(&segment->data);
+    segment_size_ = data.Size();
+    DCHECK_NE(segment_size_, 0u);
+
+    status = data.WriteToFile(segment_file_.get());
+    if (!status.ok())
+      return status;
+    status = CloseSegmentFile(segment->duration);
+    if (!status.ok())
+      return status;
+  }
+  return Status::OK;
+}
+
+Status MultiSegmentSegmenter::CloseSegmentFile(uint64_t duration) {
+  DCHECK(segment_file_);
+
+  // Nothing reads the segment back, so it is left to be written in the
+  // background.
+  if (!segment_file_.release()->CloseInBackground()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot close file " + segment_file_name_);
+  }
+
+  closed_segment_files_.push_back(segment_file_name_);
+
+  // The segment is reported as soon as it is queued for writing, so that the
+  // manifests are not delayed by the background write.
+  UpdateProgress(duration);
   if (muxer_listener()) {
     muxer_listener()->OnSampleDurationReady(sample_duration());
-    muxer_listener()->OnNewSegment(file_name,
-                                   sidx()->earliest_presentation_time,
-                                   segment_duration, segment_size);
+    muxer_listener()->OnNewSegment(segment_file_name_, segment_start_time_,
+                                   duration, segment_size_);
   }
+  return CheckClosedSegmentFiles(false);
+}
 
+Status MultiSegmentSegmenter::CheckClosedSegmentFiles(bool wait) {
+  while (!closed_segment_files_.empty()) {
+    const char* file_name = closed_segment_files_.front().c_str();
+    if (!wait && File::HasPendingWritesToFile(file_name))
+      break;
+    // Only the files of this segmenter are waited for, so that the failures
+    // of other outputs are neither waited for nor reported here.
+    if (!File::WaitForPendingWritesToFile(file_name)) {
+      return Status(error::FILE_FAILURE,
+                    "Failed to write segment " + closed_segment_files_.front());
+    }
+    closed_segment_files_.pop_front();
+  }
   return Status::OK;
 }
 
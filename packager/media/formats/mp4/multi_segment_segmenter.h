@@ -7,10 +7,18 @@
 #ifndef MEDIA_FORMATS_MP4_MULTI_SEGMENT_SEGMENTER_H_
 #define MEDIA_FORMATS_MP4_MULTI_SEGMENT_SEGMENTER_H_
 
+#include <deque>
+#include <string>
+
+#include "packager/media/file/file_closer.h"
 #include "packager/media/formats/mp4/segmenter.h"
 
 namespace shaka {
 namespace media {
+
+class BufferWriter;
+class GatherBuffer;
+
 namespace mp4 {
 
 struct SegmentType;
@@ -28,6 +36,17 @@ struct SegmentType;
 /// defined by @b MuxerOptions.segment_template if specified; otherwise,
 /// the segments are appended to the main output file specified by @b
 /// MuxerOptions.output_file_name.
+/// In @b MuxerOptions.low_latency_mode, the segment file is opened with the
+/// first fragment of the segment, and every fragment is written and flushed as
+/// a chunk as soon as it is complete. No 'sidx' box is generated then.
+/// Otherwise, with @b MuxerOptions.num_parallel_segments larger than 1, the
+/// complete segments are held until the encryption of the segments following
+/// them is started, so that the encryption of several segments overlaps with
+/// the fragmenting of the next one. Only the encryption runs on other threads:
+/// the segments are still fragmented and written in order.
+/// A segment is reported to the listener once its file is closed, while it may
+/// still be written in the background, see File::CloseInBackground(). Write
+/// failures are reported by the following fragments and by Finalize().
 class MultiSegmentSegmenter : public Segmenter {
  public:
   MultiSegmentSegmenter(const MuxerOptions& options,
@@ -46,12 +65,46 @@ class MultiSegmentSegmenter : public Segmenter {
   Status DoInitialize() override;
   Status DoFinalize() override;
   Status DoFinalizeSegment() override;
+  Status DoFinalizeFragment() override;
+
+  // Open the file of a new segment starting at |start_time| in
+  // |segment_file_|. |header| receives the 'styp' box if the segment has a
+  // file of its own.
+  Status OpenSegmentFile(uint64_t start_time, BufferWriter* header);
 
-  // Write segment to file.
+  // Write segment to file, unless already written chunk by chunk, then close
+  // the segment file. The segment may be held in |pending_segments_| to be
+  // written later.
   Status WriteSegment();
 
+  // Write the segments in |pending_segments_|, in order, until at most
+  // |max_pending_segments| are left.
+  Status WritePendingSegments(size_t max_pending_segments);
+
+  // Close the segment file, which may still be written in the background, and
+  // report the segment of |duration| to the listener.
+  Status CloseSegmentFile(uint64_t duration);
+
+  // Check that the files in |closed_segment_files_| were written. If |wait| is
+  // true, wait for all of them; otherwise stop at the first file still being
+  // written.
+  // @return an error if a file could not be written.
+  Status CheckClosedSegmentFiles(bool wait);
+
+  // A complete segment waiting to be written.
+  struct PendingSegment;
+
   scoped_ptr<SegmentType> styp_;
   uint32_t num_segments_;
+  // The file of the current segment, opened by OpenSegmentFile().
+  scoped_ptr<File, FileCloser> segment_file_;
+  std::string segment_file_name_;
+  uint64_t segment_start_time_;
+  uint64_t segment_size_;
+  std::deque<PendingSegment*> pending_segments_;
+  // Files of the closed segments which may still be written in the
+  // background.
+  std::deque<std::string> closed_segment_files_;
 
   DISALLOW_COPY_AND_ASSIGN(MultiSegmentSegmenter);
 };
@@ -12,6 +12,7 @@
 #include "packager/base/stl_util.h"
 #include "packager/media/base/aes_cryptor.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/gather_buffer.h"
 #include "packager/media/base/key_source.h"
 #include "packager/media/base/media_sample.h"
 #include "packager/media/base/media_stream.h"
@@ -151,7 +152,7 @@ Segmenter::Segmenter(const MuxerOptions& options,
       ftyp_(ftyp.Pass()),
       moov_(moov.Pass()),
       moof_(new MovieFragment()),
-      fragment_buffer_(new BufferWriter()),
+      fragment_buffer_(new GatherBuffer()),
       sidx_(new SegmentIndex()),
       muxer_listener_(NULL),
       progress_listener_(NULL),
@@ -218,13 +219,16 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
             encryption_key.iv, encryption_key.key_system_info);
       }
 
-      fragmenters_[i] = new KeyRotationFragmenter(
+      KeyRotationFragmenter* fragmenter = new KeyRotationFragmenter(
           moof_.get(), streams[i]->info(), &moof_->tracks[i],
           encryption_key_source, track_type,
           crypto_period_duration_in_seconds * streams[i]->info()->time_scale(),
           clear_lead_in_seconds * streams[i]->info()->time_scale(),
           protection_scheme, pattern.crypt_byte_block, pattern.skip_byte_block,
           muxer_listener_);
+      fragmenter->set_num_encryption_threads(options_.num_encryption_threads);
+      fragmenter->set_async_encryption(options_.num_parallel_segments > 1);
+      fragmenters_[i] = fragmenter;
       continue;
     }
 
@@ -256,10 +260,13 @@ Status Segmenter::Initialize(const std::vector<MediaStream*>& streams,
       }
     }
 
-    fragmenters_[i] = new EncryptingFragmenter(
+    EncryptingFragmenter* fragmenter = new EncryptingFragmenter(
         streams[i]->info(), &moof_->tracks[i], encryption_key.Pass(),
         clear_lead_in_seconds * streams[i]->info()->time_scale(),
         protection_scheme, pattern.crypt_byte_block, pattern.skip_byte_block);
+    fragmenter->set_num_encryption_threads(options_.num_encryption_threads);
+    fragmenter->set_async_encryption(options_.num_parallel_segments > 1);
+    fragmenters_[i] = fragmenter;
   }
 
   // Choose the first stream if there is no VIDEO.
@@ -457,15 +464,25 @@ Status Segmenter::FinalizeFragment(bool finalize_segment,
   sidx_->references[sidx_->references.size() - 1].referenced_size =
       data_offset + mdat.data_size;
 
-  // Write the fragment to buffer.
-  moof_->Write(fragment_buffer_.get());
-  mdat.WriteHeader(fragment_buffer_.get());
+  // Write the fragment to buffer. The sample data is referenced rather than
+  // copied, and gathered from the samples when the buffer is written out.
+  // The moof box sizes are already computed above, and only the offsets in it
+  // have changed since, so the headers are serialized in a single pass into a
+  // buffer of the exact size.
+  BufferWriter header(data_offset);
+  moof_->WriteWithComputedSize(&header);
+  mdat.WriteHeader(&header);
+  fragment_buffer_->AppendBuffer(&header);
   for (Fragmenter* fragmenter : fragmenters_)
-    fragment_buffer_->AppendBuffer(*fragmenter->data());
+    fragment_buffer_->Append(fragmenter->data());
 
   // Increase sequence_number for next fragment.
   ++moof_->header.sequence_number;
 
+  Status status = DoFinalizeFragment();
+  if (!status.ok())
+    return status;
+
   if (finalize_segment)
     return FinalizeSegment();
 
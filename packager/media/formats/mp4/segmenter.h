@@ -21,7 +21,7 @@ namespace media {
 
 struct MuxerOptions;
 
-class BufferWriter;
+class GatherBuffer;
 class KeySource;
 class MediaSample;
 class MediaStream;
@@ -109,7 +109,7 @@ class Segmenter {
   const MuxerOptions& options() const { return options_; }
   FileType* ftyp() { return ftyp_.get(); }
   Movie* moov() { return moov_.get(); }
-  BufferWriter* fragment_buffer() { return fragment_buffer_.get(); }
+  GatherBuffer* fragment_buffer() { return fragment_buffer_.get(); }
   SegmentIndex* sidx() { return sidx_.get(); }
   MuxerListener* muxer_listener() { return muxer_listener_; }
   uint64_t progress_target() { return progress_target_; }
@@ -122,6 +122,9 @@ class Segmenter {
   virtual Status DoInitialize() = 0;
   virtual Status DoFinalize() = 0;
   virtual Status DoFinalizeSegment() = 0;
+  // Called when a fragment has been added to fragment_buffer(), before the
+  // segment is finalized if it ends with the fragment.
+  virtual Status DoFinalizeFragment() { return Status::OK; }
 
   Status FinalizeSegment();
   uint32_t GetReferenceStreamId();
@@ -132,7 +135,7 @@ class Segmenter {
   scoped_ptr<FileType> ftyp_;
   scoped_ptr<Movie> moov_;
   scoped_ptr<MovieFragment> moof_;
-  scoped_ptr<BufferWriter> fragment_buffer_;
+  scoped_ptr<GatherBuffer> fragment_buffer_;
   scoped_ptr<SegmentIndex> sidx_;
   std::vector<Fragmenter*> fragmenters_;
   std::vector<uint64_t> segment_durations_;
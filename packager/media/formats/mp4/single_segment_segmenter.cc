@@ -10,11 +10,15 @@
 #include <openssl/err.h>
 #include <openssl/rand.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "packager/base/files/file_util.h"
 #include "packager/base/strings/stringprintf.h"
 #include "packager/base/threading/platform_thread.h"
 #include "packager/base/time/time.h"
 #include "packager/media/base/buffer_writer.h"
+#include "packager/media/base/gather_buffer.h"
 #include "packager/media/base/media_stream.h"
 #include "packager/media/base/muxer_options.h"
 #include "packager/media/event/muxer_listener.h"
@@ -26,6 +30,18 @@ namespace shaka {
 namespace media {
 namespace mp4 {
 namespace {
+// Size of the header of a 'free' box, which is also its minimum size.
+const uint64_t kFreeBoxHeaderSize = 8;
+const int kBufSize = 0x200000;  // 2MB.
+
+// Writes the header of a 'free' box of |box_size| bytes to |buffer|.
+void WriteFreeBoxHeader(uint64_t box_size, BufferWriter* buffer) {
+  DCHECK_GE(box_size, kFreeBoxHeaderSize);
+  DCHECK_LE(box_size, std::numeric_limits<uint32_t>::max());
+  buffer->AppendInt(static_cast<uint32_t>(box_size));
+  buffer->AppendInt(static_cast<uint32_t>(FOURCC_free));
+}
+
 // Create a temp file name using process/thread id and current time.
 std::string TempFileName() {
   int32_t tid = static_cast<int32_t>(base::PlatformThread::CurrentId());
@@ -42,11 +58,13 @@ std::string TempFileName() {
 SingleSegmentSegmenter::SingleSegmentSegmenter(const MuxerOptions& options,
                                                scoped_ptr<FileType> ftyp,
                                                scoped_ptr<Movie> moov)
-    : Segmenter(options, ftyp.Pass(), moov.Pass()) {}
+    : Segmenter(options, ftyp.Pass(), moov.Pass()), free_box_size_(0) {}
 
 SingleSegmentSegmenter::~SingleSegmentSegmenter() {
   if (temp_file_)
     temp_file_.release()->Close();
+  if (output_file_)
+    output_file_.release()->Close();
   if (!temp_file_name_.empty()) {
     if (!File::Delete(temp_file_name_.c_str()))
       LOG(ERROR) << "Unable to delete temporary file " << temp_file_name_;
@@ -61,14 +79,20 @@ bool SingleSegmentSegmenter::GetInitRange(size_t* offset, size_t* size) {
 }
 
 bool SingleSegmentSegmenter::GetIndexRange(size_t* offset, size_t* size) {
-  // Index range is right after init range so the offset must be the size of
-  // ftyp and moov.
-  *offset = ftyp()->ComputeSize() + moov()->ComputeSize();
+  // Index range is right after init range, and the 'free' box filling the
+  // reserved space if any, so the offset must be the size of ftyp, moov and
+  // free.
+  *offset = ftyp()->ComputeSize() + moov()->ComputeSize() + free_box_size_;
   *size = vod_sidx_->ComputeSize();
   return true;
 }
 
 Status SingleSegmentSegmenter::DoInitialize() {
+  // With space reserved for the header, the fragments are written to the
+  // output directly, in a single stage.
+  if (options().header_reserve_size > 0 && OpenOutputWithReservedHeader())
+    return Status::OK;
+
   // Single segment segmentation involves two stages:
   //   Stage 1: Create media subsegments from media samples
   //   Stage 2: Update media header (moov) which involves copying of media
@@ -96,6 +120,9 @@ Status SingleSegmentSegmenter::DoInitialize() {
 }
 
 Status SingleSegmentSegmenter::DoFinalize() {
+  if (output_file_)
+    return FinalizeWithReservedHeader();
+
   DCHECK(temp_file_);
   DCHECK(ftyp());
   DCHECK(moov());
@@ -137,7 +164,6 @@ Status SingleSegmentSegmenter::DoFinalize() {
   // The target of 2nd stage of single segment segmentation.
   const uint64_t re_segment_progress_target = progress_target() * 0.5;
 
-  const int kBufSize = 0x200000;  // 2MB.
   scoped_ptr<uint8_t[]> buf(new uint8_t[kBufSize]);
   while (true) {
     int64_t size = temp_file->Read(buf.get(), kBufSize);
@@ -159,6 +185,149 @@ Status SingleSegmentSegmenter::DoFinalize() {
   return Status::OK;
 }
 
+bool SingleSegmentSegmenter::OpenOutputWithReservedHeader() {
+  const uint64_t reserve_size = options().header_reserve_size;
+  if (reserve_size < kFreeBoxHeaderSize ||
+      reserve_size > std::numeric_limits<uint32_t>::max()) {
+    LOG(WARNING) << "Ignoring invalid header reserve size " << reserve_size
+                 << ".";
+    return false;
+  }
+
+  output_file_.reset(File::Open(options().output_file_name.c_str(), "w"));
+  if (!output_file_)
+    return false;
+  if (!output_file_->Seek(0)) {
+    LOG(WARNING) << "Cannot reserve space for the header in '"
+                 << options().output_file_name
+                 << "', which is not seekable. Using a temp file.";
+    output_file_.release()->Close();
+    return false;
+  }
+
+  // Fill the reserved space with a 'free' box, so that the output is valid
+  // even if it is not finalized.
+  BufferWriter buffer(reserve_size);
+  WriteFreeBoxHeader(reserve_size, &buffer);
+  buffer.AppendVector(std::vector<uint8_t>(reserve_size - kFreeBoxHeaderSize));
+  Status status = buffer.WriteToFile(output_file_.get());
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot reserve space for the header in '"
+                 << options().output_file_name << "': " << status
+                 << ". Using a temp file.";
+    output_file_.release()->Close();
+    return false;
+  }
+  return true;
+}
+
+Status SingleSegmentSegmenter::FinalizeWithReservedHeader() {
+  DCHECK(output_file_);
+  DCHECK(ftyp());
+  DCHECK(moov());
+  DCHECK(vod_sidx_);
+
+  const uint64_t reserve_size = options().header_reserve_size;
+  const uint64_t init_size = ftyp()->ComputeSize() + moov()->ComputeSize();
+  const uint64_t header_size = init_size + vod_sidx_->ComputeSize();
+
+  // The space left after the header must hold at least a 'free' box header.
+  uint64_t media_data_offset = reserve_size;
+  if (header_size > reserve_size) {
+    media_data_offset = header_size;
+  } else if (header_size < reserve_size &&
+             reserve_size - header_size < kFreeBoxHeaderSize) {
+    media_data_offset = header_size + kFreeBoxHeaderSize;
+  }
+  if (media_data_offset != reserve_size) {
+    LOG(WARNING) << "The " << header_size << " bytes header does not fit in "
+                 << "the " << reserve_size << " bytes reserved in '"
+                 << options().output_file_name
+                 << "'. Moving the media data. Consider a larger header "
+                    "reserve size.";
+    Status status = MoveMediaData(reserve_size, media_data_offset);
+    if (!status.ok())
+      return status;
+  }
+  free_box_size_ = media_data_offset - header_size;
+
+  LOG(INFO) << "Update media header (moov) in '" << options().output_file_name
+            << "'.";
+
+  // Write ftyp, moov, free and sidx at the start of the output. The content
+  // of the 'free' box is left as is.
+  if (!output_file_->Seek(0)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in file " + options().output_file_name);
+  }
+  scoped_ptr<BufferWriter> buffer(new BufferWriter());
+  ftyp()->Write(buffer.get());
+  moov()->Write(buffer.get());
+  if (free_box_size_ > 0)
+    WriteFreeBoxHeader(free_box_size_, buffer.get());
+  Status status = buffer->WriteToFile(output_file_.get());
+  if (!status.ok())
+    return status;
+
+  if (!output_file_->Seek(init_size + free_box_size_)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in file " + options().output_file_name);
+  }
+  vod_sidx_->Write(buffer.get());
+  status = buffer->WriteToFile(output_file_.get());
+  if (!status.ok())
+    return status;
+
+  if (!output_file_.release()->Close()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot close file " + options().output_file_name);
+  }
+  SetComplete();
+  return Status::OK;
+}
+
+Status SingleSegmentSegmenter::MoveMediaData(uint64_t from, uint64_t to) {
+  DCHECK_LT(from, to);
+  if (!output_file_->Flush()) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot flush file " + options().output_file_name);
+  }
+  scoped_ptr<File, FileCloser> reader(
+      File::OpenWithNoBuffering(options().output_file_name.c_str(), "r"));
+  if (!reader) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot open file to read " + options().output_file_name);
+  }
+
+  // Move the data one block at a time, starting from the end, so that no
+  // block is overwritten before it is moved.
+  scoped_ptr<uint8_t[]> buf(new uint8_t[kBufSize]);
+  uint64_t position = output_file_->Size();
+  while (position > from) {
+    const uint64_t size = std::min<uint64_t>(kBufSize, position - from);
+    position -= size;
+    if (!reader->Seek(position)) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot seek in file " + options().output_file_name);
+    }
+    uint64_t bytes_read = 0;
+    while (bytes_read < size) {
+      int64_t result = reader->Read(buf.get() + bytes_read, size - bytes_read);
+      if (result <= 0) {
+        return Status(error::FILE_FAILURE,
+                      "Failed to read file " + options().output_file_name);
+      }
+      bytes_read += result;
+    }
+    if (!output_file_->Seek(position + to - from) ||
+        output_file_->Write(buf.get(), size) != static_cast<int64_t>(size)) {
+      return Status(error::FILE_FAILURE,
+                    "Failed to write file " + options().output_file_name);
+    }
+  }
+  return Status::OK;
+}
+
 Status SingleSegmentSegmenter::DoFinalizeSegment() {
   DCHECK(sidx());
   DCHECK(fragment_buffer());
@@ -218,9 +387,10 @@ Status SingleSegmentSegmenter::DoFinalizeSegment() {
   }
   vod_sidx_->references.push_back(vod_ref);
 
-  // Append fragment buffer to temp file.
+  // Append fragment buffer to the output or to the temp file.
   size_t segment_size = fragment_buffer()->Size();
-  Status status = fragment_buffer()->WriteToFile(temp_file_.get());
+  Status status = fragment_buffer()->WriteToFile(
+      output_file_ ? output_file_.get() : temp_file_.get());
   if (!status.ok()) return status;
 
   UpdateProgress(vod_ref.subsegment_duration);
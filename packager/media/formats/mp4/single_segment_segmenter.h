@@ -44,9 +44,25 @@ class SingleSegmentSegmenter : public Segmenter {
   Status DoFinalize() override;
   Status DoFinalizeSegment() override;
 
+  // Opens the output and reserves MuxerOptions.header_reserve_size bytes at
+  // its start for the header, if the output is seekable.
+  bool OpenOutputWithReservedHeader();
+  // Writes the header to the space reserved by OpenOutputWithReservedHeader()
+  // and closes the output.
+  Status FinalizeWithReservedHeader();
+  // Moves the media data written to the output at |from| to |to|, which is
+  // after |from|.
+  Status MoveMediaData(uint64_t from, uint64_t to);
+
   scoped_ptr<SegmentIndex> vod_sidx_;
   std::string temp_file_name_;
   scoped_ptr<File, FileCloser> temp_file_;
+  // The output, if the fragments are written to it directly, after the space
+  // reserved for the header. |temp_file_| is not used then.
+  scoped_ptr<File, FileCloser> output_file_;
+  // Size of the 'free' box filling the reserved space left between 'moov'
+  // and 'sidx'.
+  uint64_t free_box_size_;
 
   DISALLOW_COPY_AND_ASSIGN(SingleSegmentSegmenter);
 };
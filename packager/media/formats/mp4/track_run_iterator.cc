@@ -142,6 +142,19 @@ class CompareMinTrackRunDataOffset {
   }
 };
 
+// Orders track runs by start time, across tracks, for the runs to be read by
+// random access with the tracks interleaved, see SortRunsByDecodingTime().
+class CompareTrackRunStartTime {
+ public:
+  bool operator()(const TrackRunInfo& a, const TrackRunInfo& b) {
+    const double a_start_time = static_cast<double>(a.start_dts) / a.timescale;
+    const double b_start_time = static_cast<double>(b.start_dts) / b.timescale;
+    if (a_start_time == b_start_time)
+      return a.sample_start_offset < b.sample_start_offset;
+    return a_start_time < b_start_time;
+  }
+};
+
 bool TrackRunIterator::Init() {
   runs_.clear();
 
@@ -425,6 +438,22 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
   return true;
 }
 
+void TrackRunIterator::SortRunsByDecodingTime() {
+  std::sort(runs_.begin(), runs_.end(), CompareTrackRunStartTime());
+  run_itr_ = runs_.begin();
+  ResetRun();
+}
+
+int64_t TrackRunIterator::GetContiguousSampleDataSize(int64_t max_size) const {
+  DCHECK(IsSampleValid());
+  int64_t size = sample_itr_->size;
+  for (std::vector<SampleInfo>::const_iterator it = sample_itr_ + 1;
+       it != run_itr_->samples.end() && size + it->size <= max_size; ++it) {
+    size += it->size;
+  }
+  return size;
+}
+
 void TrackRunIterator::AdvanceRun() {
   ++run_itr_;
   ResetRun();
@@ -39,6 +39,12 @@ class TrackRunIterator {
   /// @return true on success, false otherwise.
   bool Init(const MovieFragment& moof);
 
+  /// Order the runs by decoding start time across the tracks, instead of by
+  /// data offset, and rewind the iterator to the first run. Only useful if
+  /// the sample data is read by random access, since the data offsets of the
+  /// runs are no longer increasing. Call after Init().
+  void SortRunsByDecodingTime();
+
   /// @return true if the iterator points to a valid run, false if past the
   ///         last run.
   bool IsRunValid() const;
@@ -96,6 +102,12 @@ class TrackRunIterator {
   bool is_keyframe() const;
   /// @}
 
+  /// @return the size of the data of the current sample and of the following
+  ///         samples of the current run, which is contiguous, without
+  ///         exceeding @a max_size unless the current sample alone does. Only
+  ///         valid if IsSampleValid().
+  int64_t GetContiguousSampleDataSize(int64_t max_size) const;
+
   /// Only call when is_encrypted() is true and AuxInfoNeedsToBeCached() is
   /// false. Result is owned by caller.
   scoped_ptr<DecryptConfig> GetDecryptConfig();
@@ -144,6 +144,18 @@ int WebMClusterParser::Parse(const uint8_t* buf, int size) {
   return result;
 }
 
+int WebMClusterParser::ParseShared(
+    const uint8_t* buf,
+    int size,
+    const scoped_refptr<base::RefCountedMemory>& shared_buffer,
+    int min_shared_size) {
+  shared_buffer_ = shared_buffer;
+  min_shared_size_ = min_shared_size;
+  const int result = Parse(buf, size);
+  shared_buffer_ = NULL;
+  return result;
+}
+
 WebMParserClient* WebMClusterParser::OnListStart(int id) {
   if (id == kWebMIdCluster) {
     cluster_timecode_ = -1;
@@ -387,8 +399,22 @@ bool WebMClusterParser::OnBlock(bool is_simple_block,
       return false;
     }
 
-    buffer = MediaSample::CopyFrom(data + data_offset, size - data_offset,
-                                   additional, additional_size, is_keyframe);
+    const uint8_t* sample_data = data + data_offset;
+    const int sample_size = size - data_offset;
+    if (shared_buffer_ && additional_size == 0 &&
+        sample_size >= min_shared_size_ &&
+        sample_data >= shared_buffer_->front() &&
+        sample_data + sample_size <=
+            shared_buffer_->front() + shared_buffer_->size()) {
+      // Reference the sample data in the parsed buffer instead of copying it.
+      // Block data of BlockGroups is buffered in |block_data_| and copied.
+      buffer = MediaSample::CreateFromSharedBuffer(
+          shared_buffer_, sample_data - shared_buffer_->front(), sample_size,
+          is_keyframe);
+    } else {
+      buffer = MediaSample::CopyFrom(sample_data, sample_size, additional,
+                                     additional_size, is_keyframe);
+    }
 
     // An empty iv indicates that this sample is not encrypted.
     if (decrypt_config && !decrypt_config->iv().empty()) {
@@ -145,6 +145,16 @@ class WebMClusterParser : public WebMParserClient {
   /// @return The number of bytes parsed on success.
   int Parse(const uint8_t* buf, int size);
 
+  /// Like Parse(), but @a buf lies in @a shared_buffer, which is referenced
+  /// by the new samples instead of copying their data when possible.
+  /// @param shared_buffer is an immutable buffer containing @a buf.
+  /// @param min_shared_size is the minimum size of the samples referencing
+  ///        @a shared_buffer. Smaller samples are copied.
+  int ParseShared(const uint8_t* buf,
+                  int size,
+                  const scoped_refptr<base::RefCountedMemory>& shared_buffer,
+                  int min_shared_size);
+
   int64_t cluster_start_time() const { return cluster_start_time_; }
 
   /// @return true if the last Parse() call stopped at the end of a cluster.
@@ -201,6 +211,11 @@ class WebMClusterParser : public WebMParserClient {
   bool initialized_;
   MediaParser::InitCB init_cb_;
 
+  // Buffer containing the data passed to ParseShared(), and the minimum size
+  // of the samples referencing it, during the call.
+  scoped_refptr<base::RefCountedMemory> shared_buffer_;
+  int min_shared_size_ = 0;
+
   int64_t last_block_timecode_ = -1;
   scoped_ptr<uint8_t[]> block_data_;
   int block_data_size_ = -1;
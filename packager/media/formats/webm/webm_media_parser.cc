@@ -60,13 +60,33 @@ bool WebMMediaParser::Parse(const uint8_t* buf, int size) {
     return false;
 
   byte_queue_.Push(buf, size);
+  return ParseQueue();
+}
+
+bool WebMMediaParser::ParseShared(
+    const scoped_refptr<base::RefCountedMemory>& buffer,
+    size_t offset,
+    int size) {
+  DCHECK_NE(state_, kWaitingForInit);
+
+  if (state_ == kError)
+    return false;
+
+  byte_queue_.PushShared(buffer, offset, size);
+  return ParseQueue();
+}
 
+bool WebMMediaParser::ParseQueue() {
   int result = 0;
   int bytes_parsed = 0;
   const uint8_t* cur = NULL;
   int cur_size = 0;
+  scoped_refptr<base::RefCountedMemory> shared_buffer;
+  size_t shared_offset = 0;
 
   byte_queue_.Peek(&cur, &cur_size);
+  byte_queue_.PeekShared(&shared_buffer, &shared_offset);
+  const int min_shared_size = byte_queue_.MinSharedSize();
   while (cur_size > 0) {
     State oldState = state_;
     switch (state_) {
@@ -75,7 +95,7 @@ bool WebMMediaParser::Parse(const uint8_t* buf, int size) {
         break;
 
       case kParsingClusters:
-        result = ParseCluster(cur, cur_size);
+        result = ParseCluster(cur, cur_size, shared_buffer, min_shared_size);
         break;
 
       case kWaitingForInit:
@@ -97,6 +117,7 @@ bool WebMMediaParser::Parse(const uint8_t* buf, int size) {
     bytes_parsed += result;
   }
 
+  shared_buffer = NULL;
   byte_queue_.Pop(bytes_parsed);
   return true;
 }
@@ -217,11 +238,16 @@ int WebMMediaParser::ParseInfoAndTracks(const uint8_t* data, int size) {
   return bytes_parsed;
 }
 
-int WebMMediaParser::ParseCluster(const uint8_t* data, int size) {
+int WebMMediaParser::ParseCluster(
+    const uint8_t* data,
+    int size,
+    const scoped_refptr<base::RefCountedMemory>& shared_buffer,
+    int min_shared_size) {
   if (!cluster_parser_)
     return -1;
 
-  int bytes_parsed = cluster_parser_->Parse(data, size);
+  int bytes_parsed = cluster_parser_->ParseShared(data, size, shared_buffer,
+                                                  min_shared_size);
   if (bytes_parsed < 0)
     return bytes_parsed;
 
@@ -28,6 +28,9 @@ class WebMMediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   bool Flush() override WARN_UNUSED_RESULT;
   bool Parse(const uint8_t* buf, int size) override WARN_UNUSED_RESULT;
+  bool ParseShared(const scoped_refptr<base::RefCountedMemory>& buffer,
+                   size_t offset,
+                   int size) override WARN_UNUSED_RESULT;
   /// @}
 
  private:
@@ -40,6 +43,9 @@ class WebMMediaParser : public MediaParser {
 
   void ChangeState(State new_state);
 
+  // Parses the data in |byte_queue_|.
+  bool ParseQueue();
+
   // Parses WebM Header, Info, Tracks elements. It also skips other level 1
   // elements that are not used right now. Once the Info & Tracks elements have
   // been parsed, this method will transition the parser from PARSING_HEADERS to
@@ -57,7 +63,13 @@ class WebMMediaParser : public MediaParser {
   // Returns < 0 if the parse fails.
   // Returns 0 if more data is needed.
   // Returning > 0 indicates success & the number of bytes parsed.
-  int ParseCluster(const uint8_t* data, int size);
+  // The new samples of at least |min_shared_size| bytes reference
+  // |shared_buffer|, which contains |data|, instead of copying their data when
+  // possible.
+  int ParseCluster(const uint8_t* data,
+                   int size,
+                   const scoped_refptr<base::RefCountedMemory>& shared_buffer,
+                   int min_shared_size);
 
   // Fetch keys for the input key ids. Returns true on success, false otherwise.
   bool FetchKeysIfNecessary(const std::string& audio_encryption_key_id,
@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Demuxing throughput and peak resident set size with the input read through
+// the Demuxer copy buffer, read by random access (non-fragmented MP4 only) or
+// mapped in memory. Run them one at a time, since the peak resident set size is
+// tracked per process, on a large input:
+//   packager_perftest --gtest_filter=DemuxerPerfTest.Read
+//                     --demuxer_perftest_input=<multi-GB file>
+//   packager_perftest --gtest_filter=DemuxerPerfTest.SequentialRead
+//                     --demuxer_perftest_input=<multi-GB file>
+//   packager_perftest --gtest_filter=DemuxerPerfTest.MmapRead
+//                     --demuxer_perftest_input=<multi-GB file>
+// The peak resident set size of MmapRead includes the pages of the mapped
+// file, which are clean and can be dropped by the kernel at any time.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/time/time.h"
+#include "packager/build/build_config.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/test/test_data_util.h"
+
+#if defined(OS_LINUX)
+#include <sys/resource.h>
+#endif
+
+DEFINE_string(demuxer_perftest_input,
+              "",
+              "Input file demuxed by DemuxerPerfTest. A small test file is "
+              "demuxed if empty.");
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+const char kDefaultInput[] = "bear-640x360.mp4";
+
+void DemuxInput(bool mmap_input, bool mp4_random_access) {
+  const std::string input = FLAGS_demuxer_perftest_input.empty()
+                                ? GetTestDataFilePath(kDefaultInput).value()
+                                : FLAGS_demuxer_perftest_input;
+  int64_t input_size = 0;
+  ASSERT_TRUE(base::GetFileSize(base::FilePath(input), &input_size));
+
+  const base::TimeTicks start = base::TimeTicks::Now();
+  Demuxer demuxer(input);
+  demuxer.set_mmap_input(mmap_input);
+  demuxer.set_mp4_random_access(mp4_random_access);
+  ASSERT_OK(demuxer.Initialize());
+  // The streams are not connected to muxers, so the samples are dropped as
+  // soon as they are parsed.
+  ASSERT_OK(demuxer.Run());
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  LOG(INFO) << (mmap_input ? "Mapped"
+                            : mp4_random_access ? "Read" : "Sequentially read")
+            << " " << input_size
+            << " bytes in " << elapsed.InMillisecondsF() << " ms ("
+            << input_size / elapsed.InSecondsF() / (1 << 20) << " MB/s).";
+#if defined(OS_LINUX)
+  struct rusage usage;
+  ASSERT_EQ(0, getrusage(RUSAGE_SELF, &usage));
+  // |ru_maxrss| is in kilobytes.
+  LOG(INFO) << "Peak resident set size: " << usage.ru_maxrss / 1024 << " MB.";
+#endif
+}
+
+}  // namespace
+
+TEST(DemuxerPerfTest, Read) {
+  DemuxInput(false, true);
+}
+
+TEST(DemuxerPerfTest, SequentialRead) {
+  DemuxInput(false, false);
+}
+
+TEST(DemuxerPerfTest, MmapRead) {
+  DemuxInput(true, true);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -19,6 +19,18 @@
         '../../testing/gtest.gyp:gtest',
       ],
     },
+    {
+      'target_name': 'run_perftests',
+      'type': '<(component)',
+      'sources': [
+        'run_perftests.cc',
+      ],
+      'dependencies': [
+        '../../base/base.gyp:base',
+        '../../testing/gtest.gyp:gtest',
+        '../../third_party/gflags/gflags.gyp:gflags',
+      ],
+    },
     {
       'target_name': 'media_test_support',
       'type': '<(component)',
@@ -0,0 +1,159 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// Wall time of encrypted MP4 remuxing with different muxer options, and the
+// number of bytes written on Linux. Run them on a large input, e.g. a 2-hour
+// title:
+//   packager_perftest --gtest_filter=*MuxerPerfTest*
+//                     --muxer_perftest_input=<multi-GB file>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/logging.h"
+#include "packager/base/strings/string_number_conversions.h"
+#include "packager/base/time/time.h"
+#include "packager/build/build_config.h"
+#include "packager/media/base/demuxer.h"
+#include "packager/media/base/fixed_key_source.h"
+#include "packager/media/base/fourccs.h"
+#include "packager/media/base/media_stream.h"
+#include "packager/media/base/muxer_options.h"
+#include "packager/media/base/stream_info.h"
+#include "packager/media/base/test/status_test_util.h"
+#include "packager/media/formats/mp4/mp4_muxer.h"
+#include "packager/media/test/test_data_util.h"
+
+DEFINE_string(muxer_perftest_input,
+              "",
+              "Input file remuxed by MuxerPerfTest. A small test file is "
+              "remuxed if empty.");
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+const char kDefaultInput[] = "bear-640x360.mp4";
+const char kKeyIdHex[] = "e5007e6e9dcd5ac095202ed3758382cd";
+const char kKeyHex[] = "6fc96fe628a265b13aeddec0bc421f4d";
+const uint32_t kMaxSdPixels = 768 * 576;
+// Large enough for the header of a 2-hour title.
+const uint64_t kHeaderReserveSize = 1024 * 1024;
+
+// @return the number of bytes written by the process so far, or 0 if it is
+//         not known.
+uint64_t GetBytesWritten() {
+#if defined(OS_LINUX)
+  std::string io;
+  if (!base::ReadFileToString(base::FilePath("/proc/self/io"), &io))
+    return 0;
+  const char kWchar[] = "wchar: ";
+  const size_t start = io.find(kWchar);
+  if (start == std::string::npos)
+    return 0;
+  const size_t value_start = start + strlen(kWchar);
+  uint64_t bytes_written = 0;
+  base::StringToUint64(
+      io.substr(value_start, io.find('\n', value_start) - value_start),
+      &bytes_written);
+  return bytes_written;
+#else
+  return 0;
+#endif
+}
+
+}  // namespace
+
+class MuxerPerfTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("muxer_perftest_", &temp_dir_));
+    input_ = FLAGS_muxer_perftest_input.empty()
+                 ? GetTestDataFilePath(kDefaultInput).value()
+                 : FLAGS_muxer_perftest_input;
+  }
+
+  void TearDown() override { base::DeleteFile(temp_dir_, true); }
+
+  MuxerOptions SetupOptions(bool single_segment) {
+    MuxerOptions options;
+    options.single_segment = single_segment;
+    options.segment_duration = 10;
+    options.fragment_duration = 2;
+    options.segment_sap_aligned = true;
+    options.fragment_sap_aligned = true;
+    options.output_file_name = temp_dir_.AppendASCII("output.mp4").value();
+    options.segment_template =
+        temp_dir_.AppendASCII("segment$Number$.m4s").value();
+    options.temp_dir = temp_dir_.value();
+    return options;
+  }
+
+  // Remux the first video stream of the input, or the first stream if there
+  // is no video, with |options|, and log the elapsed time and bytes written
+  // as |description|.
+  void Remux(const std::string& description, const MuxerOptions& options) {
+    const uint64_t bytes_written_before = GetBytesWritten();
+    const base::TimeTicks start = base::TimeTicks::Now();
+
+    Demuxer demuxer(input_);
+    ASSERT_OK(demuxer.Initialize());
+    ASSERT_FALSE(demuxer.streams().empty());
+    MediaStream* stream = demuxer.streams()[0];
+    for (size_t i = 0; i < demuxer.streams().size(); ++i) {
+      if (demuxer.streams()[i]->info()->stream_type() == kStreamVideo) {
+        stream = demuxer.streams()[i];
+        break;
+      }
+    }
+
+    scoped_ptr<KeySource> key_source(
+        FixedKeySource::CreateFromHexStrings(kKeyIdHex, kKeyHex, "", ""));
+    ASSERT_TRUE(key_source);
+    mp4::MP4Muxer muxer(options);
+    muxer.AddStream(stream);
+    muxer.SetKeySource(key_source.get(), kMaxSdPixels, 0, 0, FOURCC_cenc);
+    ASSERT_OK(demuxer.Run());
+
+    const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    LOG(INFO) << description << ": " << elapsed.InMillisecondsF() << " ms, "
+              << (GetBytesWritten() - bytes_written_before) / (1 << 20)
+              << " MB written.";
+  }
+
+ private:
+  base::FilePath temp_dir_;
+  std::string input_;
+};
+
+// Single segment outputs written to a temp file which is then copied after
+// the header, or written once after a reserved header.
+TEST_F(MuxerPerfTest, SingleSegmentHeaderReserve) {
+  MuxerOptions options = SetupOptions(true);
+  ASSERT_NO_FATAL_FAILURE(Remux("Temp file", options));
+  options.header_reserve_size = kHeaderReserveSize;
+  ASSERT_NO_FATAL_FAILURE(Remux("Reserved header", options));
+}
+
+// Multiple segment outputs with the encryption of up to
+// |num_parallel_segments| segments in flight. The speedup depends on the
+// number of cores.
+TEST_F(MuxerPerfTest, MultipleSegmentsParallelEncryption) {
+  const size_t kNumParallelSegments[] = {0, 2, 4, 8};
+  for (size_t i = 0; i < arraysize(kNumParallelSegments); ++i) {
+    MuxerOptions options = SetupOptions(false);
+    options.num_parallel_segments = kNumParallelSegments[i];
+    ASSERT_NO_FATAL_FAILURE(Remux(
+        base::SizeTToString(kNumParallelSegments[i]) + " parallel segments",
+        options));
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
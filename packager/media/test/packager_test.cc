@@ -6,6 +6,9 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 #include "packager/base/files/file_util.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/stringprintf.h"
@@ -40,6 +43,8 @@ const char kOutputVideo[] = "output_video";
 const char kOutputVideo2[] = "output_video_2";
 const char kOutputAudio[] = "output_audio";
 const char kOutputAudio2[] = "output_audio_2";
+const char kOutputVideo3[] = "output_video_3";
+const char kOutputVideo4[] = "output_video_4";
 const char kOutputNone[] = "";
 
 const char kSegmentTemplate[] = "template$Number$.m4s";
@@ -54,6 +59,9 @@ const char kNoLanguageOverride[] = "";
 // Encryption constants.
 const char kKeyIdHex[] = "e5007e6e9dcd5ac095202ed3758382cd";
 const char kKeyHex[] = "6fc96fe628a265b13aeddec0bc421f4d";
+// A fixed iv makes the encrypted output deterministic, for tests comparing
+// the outputs of different runs.
+const char kIvHex[] = "3a2c45f1e4d7b8a9";
 const double kClearLeadInSeconds = 1.5;
 const double kCryptoDurationInSeconds = 0;  // Key rotation is disabled.
 
@@ -83,7 +91,14 @@ class FakeClock : public base::Clock {
 
 class PackagerTestBasic : public ::testing::TestWithParam<const char*> {
  public:
-  PackagerTestBasic() {}
+  PackagerTestBasic()
+      : num_encryption_threads_(0),
+        async_push_(false),
+        mmap_input_(false),
+        mp4_random_access_(false),
+        header_reserve_size_(0),
+        num_parallel_segments_(0),
+        fixed_iv_(false) {}
 
   void SetUp() override {
     // Create a test directory for testing, will be deleted after test.
@@ -115,6 +130,14 @@ class PackagerTestBasic : public ::testing::TestWithParam<const char*> {
  protected:
   base::FilePath test_directory_;
   FakeClock fake_clock_;
+  size_t num_encryption_threads_;
+  bool async_push_;
+  bool mmap_input_;
+  bool mp4_random_access_;
+  uint64_t header_reserve_size_;
+  size_t num_parallel_segments_;
+  // Encrypt with kIvHex instead of a random iv.
+  bool fixed_iv_;
 };
 
 std::string PackagerTestBasic::GetFullPath(const std::string& file_name) {
@@ -141,6 +164,9 @@ MuxerOptions PackagerTestBasic::SetupOptions(const std::string& output,
   options.output_file_name = GetFullPath(output);
   options.segment_template = GetFullPath(kSegmentTemplate);
   options.temp_dir = test_directory_.value();
+  options.num_encryption_threads = num_encryption_threads_;
+  options.header_reserve_size = header_reserve_size_;
+  options.num_parallel_segments = num_parallel_segments_;
   return options;
 }
 
@@ -153,10 +179,14 @@ void PackagerTestBasic::Remux(const std::string& input,
   CHECK(!video_output.empty() || !audio_output.empty());
 
   Demuxer demuxer(GetFullPath(input));
+  demuxer.set_async_push(async_push_);
+  demuxer.set_mmap_input(mmap_input_);
+  demuxer.set_mp4_random_access(mp4_random_access_);
   ASSERT_OK(demuxer.Initialize());
 
   scoped_ptr<KeySource> encryption_key_source(
-      FixedKeySource::CreateFromHexStrings(kKeyIdHex, kKeyHex, "", ""));
+      FixedKeySource::CreateFromHexStrings(kKeyIdHex, kKeyHex, "",
+                                           fixed_iv_ ? kIvHex : ""));
   DCHECK(encryption_key_source);
 
   scoped_ptr<Muxer> muxer_video;
@@ -280,6 +310,162 @@ TEST_P(PackagerTestBasic, MP4MuxerSingleSegmentEncryptedAudio) {
                                   kOutputAudio2));
 }
 
+TEST_P(PackagerTestBasic, MP4MuxerParallelEncryptionMatchesSerial) {
+  fixed_iv_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputAudio,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  num_encryption_threads_ = 4;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo2,
+                                kOutputAudio2,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
+}
+
+TEST_P(PackagerTestBasic, MP4MuxerAsyncPushMatchesPush) {
+  fixed_iv_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputAudio,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  async_push_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo2,
+                                kOutputAudio2,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
+}
+
+TEST_P(PackagerTestBasic, MP4MuxerParallelSegmentsMatchesSerial) {
+  fixed_iv_ = true;
+  std::vector<std::string> segments[2];
+  for (int i = 0; i < 2; ++i) {
+    num_parallel_segments_ = i == 0 ? 0 : 2;
+    ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                  i == 0 ? kOutputVideo : kOutputVideo2,
+                                  kOutputNone,
+                                  kMultipleSegments,
+                                  kEnableEncryption,
+                                  kNoLanguageOverride));
+
+    // The segments of both runs are written with the same template.
+    for (int segment_index = 1;; ++segment_index) {
+      base::FilePath segment_path = test_directory_.AppendASCII(
+          base::StringPrintf(kSegmentTemplateOutputPattern, segment_index));
+      if (!base::PathExists(segment_path))
+        break;
+      std::string segment_content;
+      ASSERT_TRUE(base::ReadFileToString(segment_path, &segment_content));
+      segments[i].push_back(segment_content);
+      ASSERT_TRUE(base::DeleteFile(segment_path, false));
+    }
+  }
+
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  // The segments are held while the following segment is encrypted.
+  ASSERT_LT(1u, segments[0].size());
+  EXPECT_EQ(segments[0], segments[1]);
+}
+
+TEST_P(PackagerTestBasic, MP4MuxerMmapInputMatchesRead) {
+  fixed_iv_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputAudio,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  mmap_input_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo2,
+                                kOutputAudio2,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
+}
+
+TEST_P(PackagerTestBasic, MP4MuxerRandomAccessMatchesRead) {
+  fixed_iv_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputAudio,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  mp4_random_access_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo2,
+                                kOutputAudio2,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+
+  EXPECT_TRUE(ContentsEqual(kOutputVideo, kOutputVideo2));
+  EXPECT_TRUE(ContentsEqual(kOutputAudio, kOutputAudio2));
+}
+
+TEST_P(PackagerTestBasic, MmapEmptyInput) {
+  const std::string kEmptyInput = GetFullPath("empty.mp4");
+  ASSERT_EQ(0, base::WriteFile(base::FilePath(kEmptyInput), "", 0));
+
+  Demuxer demuxer(kEmptyInput);
+  demuxer.set_mmap_input(true);
+  EXPECT_FALSE(demuxer.Initialize().ok());
+}
+
+// Outputs written after a reserved header, including when the reserved space
+// is too small and the media data is moved, have the same content.
+TEST_P(PackagerTestBasic, MP4MuxerHeaderReserveMatchesTempFile) {
+  fixed_iv_ = true;
+  ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                kOutputVideo,
+                                kOutputNone,
+                                kSingleSegment,
+                                kEnableEncryption,
+                                kNoLanguageOverride));
+  ASSERT_NO_FATAL_FAILURE(Decrypt(kOutputVideo,
+                                  kOutputVideo2,
+                                  kOutputNone));
+
+  const uint64_t kHeaderReserveSizes[] = {64 * 1024, 16};
+  for (size_t i = 0; i < arraysize(kHeaderReserveSizes); ++i) {
+    header_reserve_size_ = kHeaderReserveSizes[i];
+    ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
+                                  kOutputVideo3,
+                                  kOutputNone,
+                                  kSingleSegment,
+                                  kEnableEncryption,
+                                  kNoLanguageOverride));
+    header_reserve_size_ = 0;
+    ASSERT_NO_FATAL_FAILURE(Decrypt(kOutputVideo3,
+                                    kOutputVideo4,
+                                    kOutputNone));
+    EXPECT_TRUE(ContentsEqual(kOutputVideo2, kOutputVideo4))
+        << "header reserve size " << kHeaderReserveSizes[i];
+  }
+}
+
 TEST_P(PackagerTestBasic, MP4MuxerLanguageWithoutSubtag) {
   ASSERT_NO_FATAL_FAILURE(Remux(GetParam(),
                                 kOutputNone,
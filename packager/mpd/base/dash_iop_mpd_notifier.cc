@@ -6,6 +6,8 @@
 
 #include "packager/mpd/base/dash_iop_mpd_notifier.h"
 
+#include <set>
+
 #include "packager/mpd/base/media_info.pb.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 #include "packager/mpd/base/mpd_utils.h"
@@ -44,24 +46,11 @@ DashIopMpdNotifier::DashIopMpdNotifier(
     const MpdOptions& mpd_options,
     const std::vector<std::string>& base_urls,
     const std::string& output_path)
-    : MpdNotifier(dash_profile),
-      output_path_(output_path),
-      mpd_builder_(new MpdBuilder(dash_profile == kLiveProfile
-                                      ? MpdBuilder::kDynamic
-                                      : MpdBuilder::kStatic,
-                                  mpd_options)),
-      next_group_id_(kStartingGroupId) {
-  DCHECK(dash_profile == kLiveProfile || dash_profile == kOnDemandProfile);
-  for (size_t i = 0; i < base_urls.size(); ++i)
-    mpd_builder_->AddBaseUrl(base_urls[i]);
-}
+    : MpdBuilderNotifier(dash_profile, mpd_options, base_urls, output_path),
+      next_group_id_(kStartingGroupId) {}
 
 DashIopMpdNotifier::~DashIopMpdNotifier() {}
 
-bool DashIopMpdNotifier::Init() {
-  return true;
-}
-
 bool DashIopMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
                                             uint32_t* container_id) {
   DCHECK(container_id);
@@ -70,7 +59,7 @@ bool DashIopMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   if (content_type == kContentTypeUnknown)
     return false;
 
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   const std::string key = GetAdaptationSetKey(media_info);
   AdaptationSet* adaptation_set = GetAdaptationSetForMediaInfo(key, media_info);
   DCHECK(adaptation_set);
@@ -82,7 +71,7 @@ bool DashIopMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   }
 
   MediaInfo adjusted_media_info(media_info);
-  MpdBuilder::MakePathsRelativeToMpd(output_path_, &adjusted_media_info);
+  MpdBuilder::MakePathsRelativeToMpd(output_path(), &adjusted_media_info);
   Representation* representation =
       adaptation_set->AddRepresentation(adjusted_media_info);
   if (!representation)
@@ -100,7 +89,7 @@ bool DashIopMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
 
 bool DashIopMpdNotifier::NotifySampleDuration(uint32_t container_id,
                                               uint32_t sample_duration) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
@@ -114,13 +103,14 @@ bool DashIopMpdNotifier::NotifyNewSegment(uint32_t container_id,
                                           uint64_t start_time,
                                           uint64_t duration,
                                           uint64_t size) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
     return false;
   }
   it->second->AddNewSegment(start_time, duration, size);
+  OnNewSegment(container_id);
   return true;
 }
 
@@ -129,7 +119,7 @@ bool DashIopMpdNotifier::NotifyEncryptionUpdate(
     const std::string& drm_uuid,
     const std::vector<uint8_t>& new_key_id,
     const std::vector<uint8_t>& new_pssh) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
@@ -153,9 +143,8 @@ bool DashIopMpdNotifier::AddContentProtectionElement(
   return false;
 }
 
-bool DashIopMpdNotifier::Flush() {
-  base::AutoLock auto_lock(lock_);
-  return WriteMpdToFile(output_path_, mpd_builder_.get());
+size_t DashIopMpdNotifier::NumRepresentations() const {
+  return representation_map_.size();
 }
 
 AdaptationSet* DashIopMpdNotifier::GetAdaptationSetForMediaInfo(
@@ -259,7 +248,7 @@ AdaptationSet* DashIopMpdNotifier::NewAdaptationSet(
     const MediaInfo& media_info,
     std::list<AdaptationSet*>* adaptation_sets) {
   std::string language = GetLanguage(media_info);
-  AdaptationSet* new_adaptation_set = mpd_builder_->AddAdaptationSet(language);
+  AdaptationSet* new_adaptation_set = mpd_builder()->AddAdaptationSet(language);
   if (media_info.has_protected_content()) {
     DCHECK(!ContainsKey(protected_content_map_, new_adaptation_set->id()));
     protected_content_map_[new_adaptation_set->id()] =
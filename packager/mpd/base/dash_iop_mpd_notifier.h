@@ -7,14 +7,14 @@
 #ifndef MPD_BASE_DASH_IOP_MPD_NOTIFIER_H_
 #define MPD_BASE_DASH_IOP_MPD_NOTIFIER_H_
 
-#include "packager/mpd/base/mpd_notifier.h"
+#include "packager/mpd/base/mpd_builder_notifier.h"
 
 #include <list>
 #include <map>
 #include <string>
 #include <vector>
 
-#include "packager/base/synchronization/lock.h"
+#include "packager/base/memory/scoped_ptr.h"
 #include "packager/mpd/base/mpd_builder.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 #include "packager/mpd/base/mpd_options.h"
@@ -27,7 +27,7 @@ namespace shaka {
 /// All <ContentProtection> elements must be right under
 /// <AdaptationSet> and cannot be under <Representation>.
 /// All video Adaptation Sets have Role set to "main".
-class DashIopMpdNotifier : public MpdNotifier {
+class DashIopMpdNotifier : public MpdBuilderNotifier {
  public:
   DashIopMpdNotifier(DashProfile dash_profile,
                      const MpdOptions& mpd_options,
@@ -38,7 +38,6 @@ class DashIopMpdNotifier : public MpdNotifier {
   /// None of the methods write out the MPD file until Flush() is called.
   /// @name MpdNotifier implemetation overrides.
   /// @{
-  bool Init() override;
   bool NotifyNewContainer(const MediaInfo& media_info, uint32_t* id) override;
   bool NotifySampleDuration(uint32_t container_id,
                             uint32_t sample_duration) override;
@@ -53,7 +52,6 @@ class DashIopMpdNotifier : public MpdNotifier {
   bool AddContentProtectionElement(
       uint32_t id,
       const ContentProtectionElement& content_protection_element) override;
-  bool Flush() override;
   /// @}
 
  private:
@@ -83,14 +81,17 @@ class DashIopMpdNotifier : public MpdNotifier {
   AdaptationSet* NewAdaptationSet(const MediaInfo& media_info,
                                   std::list<AdaptationSet*>* adaptation_sets);
 
+  // MpdBuilderNotifier implementation overrides.
+  size_t NumRepresentations() const override;
+
   // Testing only method. Returns a pointer to MpdBuilder.
   MpdBuilder* MpdBuilderForTesting() const {
-    return mpd_builder_.get();
+    return mpd_builder();
   }
 
-  // Testing only method. Sets mpd_builder_.
+  // Testing only method. Sets the MPD builder.
   void SetMpdBuilderForTesting(scoped_ptr<MpdBuilder> mpd_builder) {
-    mpd_builder_ = mpd_builder.Pass();
+    set_mpd_builder(mpd_builder.Pass());
   }
 
   std::map<std::string, std::list<AdaptationSet*>> adaptation_set_list_map_;
@@ -99,11 +100,6 @@ class DashIopMpdNotifier : public MpdNotifier {
   // Used to check whether a Representation should be added to an AdaptationSet.
   ProtectedContentMap protected_content_map_;
 
-  // MPD output path.
-  std::string output_path_;
-  scoped_ptr<MpdBuilder> mpd_builder_;
-  base::Lock lock_;
-
   // Next group ID to use for AdapationSets that can be grouped.
   int next_group_id_;
 
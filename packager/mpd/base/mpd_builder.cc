@@ -9,10 +9,12 @@
 #include <libxml/tree.h>
 #include <libxml/xmlstring.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iterator>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "packager/base/base64.h"
 #include "packager/base/bind.h"
@@ -41,6 +43,14 @@ namespace {
 
 const int kAdaptationSetGroupNotSet = -1;
 
+// Content of the comments standing in for <Representation> elements in
+// documents generated with serialized Representations.
+const char kRepresentationPlaceholder[] = "shaka-packager:Representation";
+// Depth of <Representation> elements in the MPD: MPD/Period/AdaptationSet.
+const int kRepresentationXmlLevel = 3;
+// Use the same formatting as xmlDocDumpFormatMemoryEnc() for the MPD.
+const int kNiceFormat = 1;
+
 AdaptationSet::Role MediaInfoTextTypeToRole(
     MediaInfo::TextInfo::TextType type) {
   switch (type) {
@@ -190,7 +200,7 @@ int SearchTimedOutRepeatIndex(uint64_t timeshift_limit,
 // Overload this function to support different types of |output|.
 // Note that this could be done by call MpdBuilder::ToString() and use the
 // result to write to a file, it requires an extra copy.
-bool WriteXmlCharArrayToOutput(xmlChar* doc,
+bool WriteXmlCharArrayToOutput(const xmlChar* doc,
                                int doc_size,
                                std::string* output) {
   DCHECK(doc);
@@ -199,7 +209,7 @@ bool WriteXmlCharArrayToOutput(xmlChar* doc,
   return true;
 }
 
-bool WriteXmlCharArrayToOutput(xmlChar* doc,
+bool WriteXmlCharArrayToOutput(const xmlChar* doc,
                                int doc_size,
                                media::File* output) {
   DCHECK(doc);
@@ -210,6 +220,69 @@ bool WriteXmlCharArrayToOutput(xmlChar* doc,
   return output->Flush();
 }
 
+// Serializes |node| the way it is serialized at depth |level| of an MPD.
+bool SerializeXmlNode(xml::scoped_xml_ptr<xmlNode> node,
+                      int level,
+                      std::string* output) {
+  DCHECK(node);
+  DCHECK(output);
+  // The escaping of attributes depends on the encoding of the document they
+  // belong to, so serialize |node| in a document with the MPD encoding.
+  static const char kXmlVersion[] = "1.0";
+  xml::scoped_xml_ptr<xmlDoc> doc(xmlNewDoc(BAD_CAST kXmlVersion));
+  doc->encoding = xmlStrdup(BAD_CAST "UTF-8");
+  xmlNodePtr root = node.release();
+  xmlDocSetRootElement(doc.get(), root);
+
+  xmlBufferPtr buffer = xmlBufferCreate();
+  if (!buffer)
+    return false;
+  const bool result =
+      xmlNodeDump(buffer, doc.get(), root, level, kNiceFormat) >= 0;
+  if (result) {
+    output->assign(reinterpret_cast<const char*>(xmlBufferContent(buffer)),
+                   xmlBufferLength(buffer));
+  }
+  xmlBufferFree(buffer);
+  return result;
+}
+
+// Replaces the kRepresentationPlaceholder comments in |doc| with
+// |serialized_representations|, in order, and writes the result to |output|.
+bool ReplaceRepresentationPlaceholders(
+    const xmlChar* doc,
+    int doc_size,
+    const std::vector<const std::string*>& serialized_representations,
+    std::string* output) {
+  DCHECK(doc);
+  DCHECK(output);
+  const std::string placeholder =
+      std::string("<!--") + kRepresentationPlaceholder + "-->";
+  const char* const begin = reinterpret_cast<const char*>(doc);
+  const char* const end = begin + doc_size;
+
+  size_t total_size = doc_size;
+  for (const std::string* representation : serialized_representations)
+    total_size += representation->size();
+  output->clear();
+  output->reserve(total_size);
+
+  const char* pos = begin;
+  for (const std::string* representation : serialized_representations) {
+    const char* found =
+        std::search(pos, end, placeholder.begin(), placeholder.end());
+    if (found == end) {
+      LOG(ERROR) << "Missing Representation placeholder in the MPD.";
+      return false;
+    }
+    output->append(pos, found);
+    output->append(*representation);
+    pos = found + placeholder.size();
+  }
+  output->append(pos, end);
+  return true;
+}
+
 std::string MakePathRelative(const std::string& path,
                              const std::string& mpd_dir) {
   return (path.find(mpd_dir) == 0) ? path.substr(mpd_dir.size()) : path;
@@ -433,17 +506,31 @@ template <typename OutputType>
 bool MpdBuilder::WriteMpdToOutput(OutputType* output) {
   static LibXmlInitializer lib_xml_initializer;
 
-  xml::scoped_xml_ptr<xmlDoc> doc(GenerateMpd());
+  // A dynamic MPD is regenerated for every new segment, but only the
+  // Representations with the new segment change. Reuse the serialized XML of
+  // the other Representations instead of rebuilding their SegmentTimeline.
+  std::vector<const std::string*> serialized_representations;
+  xml::scoped_xml_ptr<xmlDoc> doc(GenerateMpd(
+      type_ == kDynamic ? &serialized_representations : NULL));
   if (!doc.get())
     return false;
 
-  static const int kNiceFormat = 1;
   int doc_str_size = 0;
   xmlChar* doc_str = NULL;
   xmlDocDumpFormatMemoryEnc(doc.get(), &doc_str, &doc_str_size, "UTF-8",
                             kNiceFormat);
 
-  bool result = WriteXmlCharArrayToOutput(doc_str, doc_str_size, output);
+  bool result;
+  if (serialized_representations.empty()) {
+    result = WriteXmlCharArrayToOutput(doc_str, doc_str_size, output);
+  } else {
+    std::string mpd;
+    result = ReplaceRepresentationPlaceholders(
+                 doc_str, doc_str_size, serialized_representations, &mpd) &&
+             WriteXmlCharArrayToOutput(
+                 reinterpret_cast<const xmlChar*>(mpd.data()), mpd.size(),
+                 output);
+  }
   xmlFree(doc_str);
 
   // Cleanup, free the doc.
@@ -451,7 +538,8 @@ bool MpdBuilder::WriteMpdToOutput(OutputType* output) {
   return result;
 }
 
-xmlDocPtr MpdBuilder::GenerateMpd() {
+xmlDocPtr MpdBuilder::GenerateMpd(
+    std::vector<const std::string*>* serialized_representations) {
   // Setup nodes.
   static const char kXmlVersion[] = "1.0";
   xml::scoped_xml_ptr<xmlDoc> doc(xmlNewDoc(BAD_CAST kXmlVersion));
@@ -467,7 +555,8 @@ xmlDocPtr MpdBuilder::GenerateMpd() {
   std::list<AdaptationSet*>::iterator adaptation_sets_it =
       adaptation_sets_.begin();
   for (; adaptation_sets_it != adaptation_sets_.end(); ++adaptation_sets_it) {
-    xml::scoped_xml_ptr<xmlNode> child((*adaptation_sets_it)->GetXml());
+    xml::scoped_xml_ptr<xmlNode> child(
+        (*adaptation_sets_it)->GetXmlInternal(serialized_representations));
     if (!child.get() || !period.AddChild(child.Pass()))
       return NULL;
   }
@@ -752,6 +841,11 @@ void AdaptationSet::AddRole(Role role) {
 // example, if AdaptationSet@width is set, then Representation@width is
 // redundant and should not be set.
 xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXml() {
+  return GetXmlInternal(NULL);
+}
+
+xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXmlInternal(
+    std::vector<const std::string*>* serialized_representations) {
   AdaptationSetXmlNode adaptation_set;
 
   bool suppress_representation_width = false;
@@ -820,6 +914,18 @@ xml::scoped_xml_ptr<xmlNode> AdaptationSet::GetXml() {
       representation->SuppressOnce(Representation::kSuppressHeight);
     if (suppress_representation_frame_rate)
       representation->SuppressOnce(Representation::kSuppressFrameRate);
+    if (serialized_representations) {
+      const std::string* serialized_representation =
+          representation->GetSerializedXml();
+      xml::scoped_xml_ptr<xmlNode> placeholder(
+          xmlNewComment(BAD_CAST kRepresentationPlaceholder));
+      if (!serialized_representation ||
+          !adaptation_set.AddChild(placeholder.Pass())) {
+        return xml::scoped_xml_ptr<xmlNode>();
+      }
+      serialized_representations->push_back(serialized_representation);
+      continue;
+    }
     xml::scoped_xml_ptr<xmlNode> child(representation->GetXml());
     if (!child || !adaptation_set.AddChild(child.Pass()))
       return xml::scoped_xml_ptr<xmlNode>();
@@ -1038,7 +1144,9 @@ Representation::Representation(
       mpd_options_(mpd_options),
       start_number_(1),
       state_change_listener_(state_change_listener.Pass()),
-      output_suppression_flags_(0) {}
+      output_suppression_flags_(0),
+      serialized_xml_valid_(false),
+      serialized_xml_suppression_flags_(0) {}
 
 Representation::~Representation() {}
 
@@ -1086,12 +1194,14 @@ bool Representation::Init() {
 
 void Representation::AddContentProtectionElement(
     const ContentProtectionElement& content_protection_element) {
+  serialized_xml_valid_ = false;
   content_protection_elements_.push_back(content_protection_element);
   RemoveDuplicateAttributes(&content_protection_elements_.back());
 }
 
 void Representation::UpdateContentProtectionPssh(const std::string& drm_uuid,
                                                  const std::string& pssh) {
+  serialized_xml_valid_ = false;
   UpdateContentProtectionPsshHelper(drm_uuid, pssh,
                                     &content_protection_elements_);
 }
@@ -1104,6 +1214,7 @@ void Representation::AddNewSegment(uint64_t start_time,
     return;
   }
 
+  serialized_xml_valid_ = false;
   if (state_change_listener_)
     state_change_listener_->OnNewSegmentForRepresentation(start_time, duration);
   if (IsContiguous(start_time, duration, size)) {
@@ -1122,6 +1233,7 @@ void Representation::AddNewSegment(uint64_t start_time,
 
 void Representation::SetSampleDuration(uint32_t sample_duration) {
   if (media_info_.has_video_info()) {
+    serialized_xml_valid_ = false;
     media_info_.mutable_video_info()->set_frame_duration(sample_duration);
     if (state_change_listener_) {
       state_change_listener_->OnSetFrameRateForRepresentation(
@@ -1187,8 +1299,9 @@ xml::scoped_xml_ptr<xmlNode> Representation::GetXml() {
   }
 
   if (HasLiveOnlyFields(media_info_) &&
-      !representation.AddLiveOnlyInfo(media_info_, segment_infos_,
-                                      start_number_)) {
+      !representation.AddLiveOnlyInfo(
+          media_info_, segment_infos_, start_number_,
+          mpd_options_.segment_availability_time_offset)) {
     LOG(ERROR) << "Failed to add Live info.";
     return xml::scoped_xml_ptr<xmlNode>();
   }
@@ -1203,6 +1316,25 @@ void Representation::SuppressOnce(SuppressFlag flag) {
   output_suppression_flags_ |= flag;
 }
 
+const std::string* Representation::GetSerializedXml() {
+  if (serialized_xml_valid_ &&
+      serialized_xml_suppression_flags_ == output_suppression_flags_) {
+    output_suppression_flags_ = 0;
+    return &serialized_xml_;
+  }
+
+  serialized_xml_valid_ = false;
+  serialized_xml_suppression_flags_ = output_suppression_flags_;
+  xml::scoped_xml_ptr<xmlNode> representation(GetXml());
+  if (!representation ||
+      !SerializeXmlNode(representation.Pass(), kRepresentationXmlLevel,
+                        &serialized_xml_)) {
+    return NULL;
+  }
+  serialized_xml_valid_ = true;
+  return &serialized_xml_;
+}
+
 bool Representation::HasRequiredMediaInfoFields() {
   if (HasVODOnlyFields(media_info_) && HasLiveOnlyFields(media_info_)) {
     LOG(ERROR) << "MediaInfo cannot have both VOD and Live fields.";
@@ -21,6 +21,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "packager/base/atomic_sequence_num.h"
 #include "packager/base/callback.h"
@@ -120,8 +121,13 @@ class MpdBuilder {
 
   // Returns the document pointer to the MPD. This must be freed by the caller
   // using appropriate xmlDocPtr freeing function.
+  // If |serialized_representations| is not NULL, <Representation> elements
+  // are replaced with placeholders in the document and their serialized XML
+  // is appended to |serialized_representations| in document order. See
+  // AdaptationSet::GetXmlInternal().
   // On failure, this returns NULL.
-  xmlDocPtr GenerateMpd();
+  xmlDocPtr GenerateMpd(
+      std::vector<const std::string*>* serialized_representations);
 
   // Set MPD attributes common to all profiles. Uses non-zero |mpd_options_| to
   // set attributes for the MPD.
@@ -322,6 +328,14 @@ class AdaptationSet {
   // successful, false otherwise.
   bool GetEarliestTimestamp(double* timestamp_seconds);
 
+  // Implementation of GetXml(). If |serialized_representations| is not NULL,
+  // the <Representation> elements are replaced with placeholder comments and
+  // their serialized XML (see Representation::GetSerializedXml()) is appended
+  // to |serialized_representations|. The strings are owned by the
+  // Representations and stay valid until they are modified.
+  xml::scoped_xml_ptr<xmlNode> GetXmlInternal(
+      std::vector<const std::string*>* serialized_representations);
+
   /// Called from OnNewSegmentForRepresentation(). Checks whether the segments
   /// are aligned. Sets segments_aligned_.
   /// This is only for Live. For VOD, CheckVodSegmentAlignment() should be used.
@@ -524,6 +538,14 @@ class Representation {
 
   bool AddLiveInfo(xml::RepresentationXmlNode* representation);
 
+  // Returns the <Representation> element, as it is serialized in an MPD, i.e.
+  // indented for its depth in the document. This honors the SuppressOnce()
+  // flags like GetXml(). The result is cached until the Representation is
+  // modified, so that the live MPD can be regenerated without rebuilding and
+  // reserializing the SegmentTimeline of every Representation.
+  // Returns NULL on failure. The returned string is owned by this instance.
+  const std::string* GetSerializedXml();
+
   // Returns true if |media_info_| has required fields to generate a valid
   // Representation. Otherwise returns false.
   bool HasRequiredMediaInfoFields();
@@ -572,6 +594,13 @@ class Representation {
   // Bit vector for tracking witch attributes should not be output.
   int output_suppression_flags_;
 
+  // Cached result of GetSerializedXml(), generated with
+  // |serialized_xml_suppression_flags_|. Cleared when this instance is
+  // modified.
+  std::string serialized_xml_;
+  bool serialized_xml_valid_;
+  int serialized_xml_suppression_flags_;
+
   DISALLOW_COPY_AND_ASSIGN(Representation);
 };
 
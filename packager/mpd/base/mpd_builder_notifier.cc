@@ -0,0 +1,93 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/mpd_builder_notifier.h"
+
+#include "packager/base/bind.h"
+#include "packager/base/logging.h"
+#include "packager/mpd/base/mpd_builder.h"
+#include "packager/mpd/base/mpd_notifier_util.h"
+#include "packager/mpd/base/mpd_options.h"
+#include "packager/mpd/base/mpd_publisher.h"
+
+namespace shaka {
+
+MpdBuilderNotifier::MpdBuilderNotifier(
+    DashProfile dash_profile,
+    const MpdOptions& mpd_options,
+    const std::vector<std::string>& base_urls,
+    const std::string& output_path)
+    : MpdNotifier(dash_profile),
+      output_path_(output_path),
+      mpd_builder_(new MpdBuilder(dash_profile == kLiveProfile
+                                      ? MpdBuilder::kDynamic
+                                      : MpdBuilder::kStatic,
+                                  mpd_options)),
+      flush_coalescing_window_(mpd_options.flush_coalescing_window) {
+  DCHECK(dash_profile == kLiveProfile || dash_profile == kOnDemandProfile);
+  for (size_t i = 0; i < base_urls.size(); ++i)
+    mpd_builder_->AddBaseUrl(base_urls[i]);
+}
+
+MpdBuilderNotifier::~MpdBuilderNotifier() {
+  if (publisher_) {
+    VLOG(1) << "MPD publisher " << publisher_->GetStats().ToString();
+    // Flush the pending request, if any, while the MPD builder is alive.
+    publisher_.reset();
+  }
+}
+
+bool MpdBuilderNotifier::Init() {
+  if (dash_profile() == kLiveProfile && flush_coalescing_window_ >= 0) {
+    publisher_.reset(new MpdPublisher(
+        output_path_,
+        base::Bind(&MpdBuilderNotifier::GenerateMpd, base::Unretained(this)),
+        base::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+            flush_coalescing_window_ * base::Time::kMicrosecondsPerSecond))));
+    publisher_->Start();
+  }
+  return true;
+}
+
+bool MpdBuilderNotifier::Flush() {
+  if (publisher_)
+    return publisher_->Publish();
+  base::AutoLock auto_lock(lock_);
+  return WriteMpdToFile(output_path_, mpd_builder_.get());
+}
+
+bool MpdBuilderNotifier::RequestFlush() {
+  if (!publisher_)
+    return Flush();
+  bool all_representations_updated;
+  {
+    base::AutoLock auto_lock(lock_);
+    // Do not wait for the end of the window once every Representation has
+    // reported its new segment.
+    all_representations_updated =
+        updated_representations_.size() >= NumRepresentations();
+    if (all_representations_updated)
+      updated_representations_.clear();
+  }
+  publisher_->RequestPublish(all_representations_updated);
+  return true;
+}
+
+void MpdBuilderNotifier::OnNewSegment(uint32_t representation_id) {
+  lock_.AssertAcquired();
+  updated_representations_.insert(representation_id);
+}
+
+void MpdBuilderNotifier::set_mpd_builder(scoped_ptr<MpdBuilder> mpd_builder) {
+  mpd_builder_ = mpd_builder.Pass();
+}
+
+bool MpdBuilderNotifier::GenerateMpd(std::string* mpd) {
+  base::AutoLock auto_lock(lock_);
+  return mpd_builder_->ToString(mpd);
+}
+
+}  // namespace shaka
@@ -0,0 +1,88 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_MPD_BUILDER_NOTIFIER_H_
+#define MPD_BASE_MPD_BUILDER_NOTIFIER_H_
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/mpd/base/mpd_notifier.h"
+
+namespace shaka {
+
+class MpdBuilder;
+class MpdPublisher;
+
+struct MpdOptions;
+
+/// Base class of the MpdNotifiers which generate the MPD with an MpdBuilder
+/// and write it to a file. For live profile, flush requests made within
+/// MpdOptions::flush_coalescing_window are coalesced and written out on a
+/// publisher thread, see MpdPublisher.
+class MpdBuilderNotifier : public MpdNotifier {
+ public:
+  ~MpdBuilderNotifier() override;
+
+  /// @name MpdNotifier implemetation overrides.
+  /// @{
+  bool Init() override;
+  bool Flush() override;
+  bool RequestFlush() override;
+  /// @}
+
+ protected:
+  MpdBuilderNotifier(DashProfile dash_profile,
+                     const MpdOptions& mpd_options,
+                     const std::vector<std::string>& base_urls,
+                     const std::string& output_path);
+
+  /// Record that the Representation @a representation_id got a new segment,
+  /// so that the MPD is written without waiting for the end of the coalescing
+  /// window once every Representation got its new segment. Call it with
+  /// lock() held.
+  void OnNewSegment(uint32_t representation_id);
+
+  /// @return the number of Representations. Called with lock() held.
+  virtual size_t NumRepresentations() const = 0;
+
+  /// @return the lock protecting the MPD builder and the state of the
+  ///         notifier.
+  base::Lock& lock() { return lock_; }
+  const std::string& output_path() const { return output_path_; }
+  MpdBuilder* mpd_builder() const { return mpd_builder_.get(); }
+  /// Replace the MPD builder, for testing.
+  void set_mpd_builder(scoped_ptr<MpdBuilder> mpd_builder);
+
+ private:
+  // Generates the MPD. Called by |publisher_| on the publisher thread.
+  bool GenerateMpd(std::string* mpd);
+
+  // MPD output path.
+  const std::string output_path_;
+  scoped_ptr<MpdBuilder> mpd_builder_;
+  base::Lock lock_;
+
+  // Flush requests are coalesced within this window, in seconds. Negative
+  // values disable coalescing.
+  const double flush_coalescing_window_;
+  // Writes out the MPD if flush requests are coalesced.
+  scoped_ptr<MpdPublisher> publisher_;
+  // Representations which got new segments since the latest flush request
+  // written immediately.
+  std::set<uint32_t> updated_representations_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpdBuilderNotifier);
+};
+
+}  // namespace shaka
+
+#endif  // MPD_BASE_MPD_BUILDER_NOTIFIER_H_
@@ -2075,6 +2075,20 @@ TEST_F(SegmentTemplateTest, OneSegmentNormal) {
   EXPECT_NO_FATAL_FAILURE(CheckMpd(kFileNameExpectedMpdOutputDynamicNormal));
 }
 
+// The serialized Representation is cached between MPD updates. Verify that
+// every update reflects the new segment.
+TEST_F(SegmentTemplateTest, CheckMpdAfterEachSegment) {
+  const uint64_t kSize = 128;
+  uint64_t start_time = 0;
+  for (uint64_t duration = 10; duration < 15; ++duration) {
+    AddSegments(start_time, duration, kSize, 0);
+    start_time += duration;
+    ASSERT_NO_FATAL_FAILURE(CheckMpdAgainstExpectedResult());
+    // Again, with no change.
+    ASSERT_NO_FATAL_FAILURE(CheckMpdAgainstExpectedResult());
+  }
+}
+
 TEST_F(SegmentTemplateTest, NormalRepeatedSegmentDuration) {
   const uint64_t kSize = 256;
   uint64_t start_time = 0;
@@ -104,6 +104,14 @@ class MpdNotifier {
   /// forces a flush.
   virtual bool Flush() = 0;
 
+  /// Call this method to request a flush without waiting for the MPD to be
+  /// written. Implementations may coalesce the requests made within a short
+  /// window into a single write. The default implementation flushes
+  /// synchronously.
+  /// @return true on success, false otherwise. Write failures are not reported
+  ///         by asynchronous implementations.
+  virtual bool RequestFlush() { return Flush(); }
+
   /// @return The dash profile for this object.
   DashProfile dash_profile() const { return dash_profile_; }
 
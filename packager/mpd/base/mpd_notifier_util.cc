@@ -6,8 +6,12 @@
 
 #include "packager/mpd/base/mpd_notifier_util.h"
 
+#include <string.h>
+
+#include "packager/base/files/file_util.h"
 #include "packager/base/strings/string_number_conversions.h"
 #include "packager/base/strings/string_util.h"
+#include "packager/build/build_config.h"
 #include "packager/media/file/file_closer.h"
 #include "packager/media/file/file.h"
 #include "packager/mpd/base/mpd_utils.h"
@@ -17,37 +21,95 @@ namespace shaka {
 using media::File;
 using media::FileCloser;
 
-bool WriteMpdToFile(const std::string& output_path, MpdBuilder* mpd_builder) {
-  CHECK(!output_path.empty());
+namespace {
 
-  std::string mpd;
-  if (!mpd_builder->ToString(&mpd)) {
-    LOG(ERROR) << "Failed to write MPD to string.";
-    return false;
+// Local files are written to a temporary file which is then renamed, so that
+// readers never see a partially written MPD.
+bool IsLocalFile(const std::string& path) {
+  return path.find("://") == std::string::npos ||
+         base::StartsWith(path, media::kLocalFilePrefix,
+                          base::CompareCase::INSENSITIVE_ASCII);
+}
+
+std::string GetLocalFilePath(const std::string& path) {
+  if (base::StartsWith(path, media::kLocalFilePrefix,
+                       base::CompareCase::INSENSITIVE_ASCII)) {
+    return path.substr(strlen(media::kLocalFilePrefix));
   }
+  return path;
+}
 
+bool WriteStringToFile(const std::string& output_path,
+                       const std::string& content) {
   scoped_ptr<File, FileCloser> file(File::Open(output_path.c_str(), "w"));
   if (!file) {
     LOG(ERROR) << "Failed to open file for writing: " << output_path;
     return false;
   }
 
-  const char* mpd_char_ptr = mpd.data();
-  size_t mpd_bytes_left = mpd.size();
-  while (mpd_bytes_left > 0) {
-    int64_t length = file->Write(mpd_char_ptr, mpd_bytes_left);
+  const char* content_ptr = content.data();
+  size_t bytes_left = content.size();
+  while (bytes_left > 0) {
+    int64_t length = file->Write(content_ptr, bytes_left);
     if (length <= 0) {
       LOG(ERROR) << "Failed to write to file '" << output_path << "' ("
                  << length << ").";
       return false;
     }
-    mpd_char_ptr += length;
-    mpd_bytes_left -= length;
+    content_ptr += length;
+    bytes_left -= length;
   }
   // Release the pointer because Close() destructs itself.
   return file.release()->Close();
 }
 
+}  // namespace
+
+bool WriteMpdToFile(const std::string& output_path, MpdBuilder* mpd_builder) {
+  CHECK(!output_path.empty());
+
+  std::string mpd;
+  if (!mpd_builder->ToString(&mpd)) {
+    LOG(ERROR) << "Failed to write MPD to string.";
+    return false;
+  }
+  return WriteMpdStringToFile(output_path, mpd);
+}
+
+bool WriteMpdStringToFile(const std::string& output_path,
+                          const std::string& mpd) {
+  CHECK(!output_path.empty());
+
+  if (!IsLocalFile(output_path))
+    return WriteStringToFile(output_path, mpd);
+
+  const base::FilePath local_path(GetLocalFilePath(output_path));
+  // The temporary file is unique, so that the writers of the same MPD do not
+  // collide, and is in the directory of the MPD, so that it can be renamed.
+  base::FilePath temp_path;
+  if (!base::CreateTemporaryFileInDir(local_path.DirName(), &temp_path)) {
+    LOG(ERROR) << "Failed to create a temporary file in '"
+               << local_path.DirName().value() << "'.";
+    return false;
+  }
+#if defined(OS_POSIX)
+  // Temporary files are only readable by their owner.
+  base::SetPosixFilePermissions(temp_path, 0644);
+#endif
+  if (!WriteStringToFile(temp_path.value(), mpd)) {
+    base::DeleteFile(temp_path, false);
+    return false;
+  }
+  base::File::Error error = base::File::FILE_OK;
+  if (!base::ReplaceFile(temp_path, local_path, &error)) {
+    LOG(ERROR) << "Failed to rename '" << temp_path.value() << "' to '"
+               << local_path.value() << "' (" << error << ").";
+    base::DeleteFile(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
 ContentType GetContentType(const MediaInfo& media_info) {
   const bool has_video = media_info.has_video_info();
   const bool has_audio = media_info.has_audio_info();
@@ -31,6 +31,13 @@ enum ContentType {
 /// @param mpd_builder is the MPD builder instance.
 bool WriteMpdToFile(const std::string& output_path, MpdBuilder* mpd_builder);
 
+/// Outputs @a mpd to @a output_path. Local files are replaced atomically: the
+/// MPD is written to a temporary file which is then renamed to @a output_path.
+/// @param output_path is the path to the MPD output location.
+/// @param mpd is the MPD to write.
+bool WriteMpdStringToFile(const std::string& output_path,
+                          const std::string& mpd);
+
 /// Determines the content type of |media_info|.
 /// @param media_info is the information about the media.
 /// @return content type of the @a media_info.
@@ -22,6 +22,8 @@ struct MpdOptions {
         min_buffer_time(2.0),
         time_shift_buffer_depth(0),
         suggested_presentation_delay(0),
+        flush_coalescing_window(-1),
+        segment_availability_time_offset(0),
         packager_version_string(kPackagerVersion) {}
 
   ~MpdOptions() {};
@@ -31,6 +33,17 @@ struct MpdOptions {
   double min_buffer_time;
   double time_shift_buffer_depth;
   double suggested_presentation_delay;
+  /// Window in seconds within which live MPD flush requests are coalesced into
+  /// a single write, done on a separate thread. Negative values disable
+  /// coalescing: the MPD is written on every flush request, on the calling
+  /// thread.
+  double flush_coalescing_window;
+  /// How many seconds before the end of a segment it can be requested, for
+  /// segments written chunk by chunk. Advertised as
+  /// SegmentTemplate@availabilityTimeOffset, with
+  /// SegmentTemplate@availabilityTimeComplete set to false. 0 if segments
+  /// are only available once complete.
+  double segment_availability_time_offset;
   std::string packager_version_string;
 };
 
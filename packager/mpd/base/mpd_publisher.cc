@@ -0,0 +1,131 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "packager/mpd/base/mpd_publisher.h"
+
+#include <inttypes.h>
+
+#include "packager/base/logging.h"
+#include "packager/base/strings/stringprintf.h"
+#include "packager/mpd/base/mpd_notifier_util.h"
+
+namespace shaka {
+
+MpdPublisher::Stats::Stats() : requests(0), writes(0), failed_writes(0) {}
+
+std::string MpdPublisher::Stats::ToString() const {
+  return base::StringPrintf(
+      "requests: %" PRIu64 " writes: %" PRIu64 " failed writes: %" PRIu64,
+      requests, writes, failed_writes);
+}
+
+MpdPublisher::MpdPublisher(const std::string& output_path,
+                           const MpdGenerator& mpd_generator,
+                           base::TimeDelta coalescing_window)
+    : output_path_(output_path),
+      mpd_generator_(mpd_generator),
+      coalescing_window_(coalescing_window),
+      condition_(&lock_),
+      pending_(false),
+      publish_now_(false),
+      stopping_(false),
+      requested_sequence_number_(0),
+      published_sequence_number_(0),
+      last_write_result_(true) {
+  DCHECK(!mpd_generator_.is_null());
+}
+
+MpdPublisher::~MpdPublisher() {
+  if (!thread_)
+    return;
+  {
+    base::AutoLock auto_lock(lock_);
+    stopping_ = true;
+    condition_.Broadcast();
+  }
+  thread_->Join();
+}
+
+void MpdPublisher::Start() {
+  DCHECK(!thread_);
+  thread_.reset(new base::DelegateSimpleThread(this, "MpdPublisher"));
+  thread_->Start();
+}
+
+void MpdPublisher::RequestPublish(bool publish_now) {
+  base::AutoLock auto_lock(lock_);
+  ++stats_.requests;
+  ++requested_sequence_number_;
+  if (!pending_) {
+    pending_ = true;
+    publish_deadline_ = base::TimeTicks::Now() + coalescing_window_;
+  }
+  publish_now_ |= publish_now;
+  condition_.Broadcast();
+}
+
+bool MpdPublisher::Publish() {
+  DCHECK(thread_);
+  base::AutoLock auto_lock(lock_);
+  ++stats_.requests;
+  const uint64_t sequence_number = ++requested_sequence_number_;
+  pending_ = true;
+  publish_now_ = true;
+  condition_.Broadcast();
+  while (published_sequence_number_ < sequence_number)
+    condition_.Wait();
+  return last_write_result_;
+}
+
+MpdPublisher::Stats MpdPublisher::GetStats() const {
+  base::AutoLock auto_lock(lock_);
+  return stats_;
+}
+
+void MpdPublisher::Run() {
+  base::AutoLock auto_lock(lock_);
+  while (true) {
+    while (!pending_ && !stopping_)
+      condition_.Wait();
+    if (!pending_)
+      return;
+
+    // Coalesce the requests made until the deadline.
+    while (!publish_now_ && !stopping_) {
+      const base::TimeDelta time_left =
+          publish_deadline_ - base::TimeTicks::Now();
+      if (time_left <= base::TimeDelta())
+        break;
+      condition_.TimedWait(time_left);
+    }
+
+    pending_ = false;
+    publish_now_ = false;
+    const uint64_t sequence_number = requested_sequence_number_;
+    bool result;
+    {
+      base::AutoUnlock auto_unlock(lock_);
+      result = WriteMpd();
+    }
+    ++stats_.writes;
+    if (!result)
+      ++stats_.failed_writes;
+    last_write_result_ = result;
+    published_sequence_number_ = sequence_number;
+    condition_.Broadcast();
+  }
+}
+
+bool MpdPublisher::WriteMpd() {
+  std::string mpd;
+  if (!mpd_generator_.Run(&mpd)) {
+    LOG(ERROR) << "Failed to generate MPD.";
+    return false;
+  }
+  return WriteMpdStringToFile(output_path_, mpd);
+}
+
+}  // namespace shaka
@@ -0,0 +1,108 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef MPD_BASE_MPD_PUBLISHER_H_
+#define MPD_BASE_MPD_PUBLISHER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packager/base/callback.h"
+#include "packager/base/memory/scoped_ptr.h"
+#include "packager/base/synchronization/condition_variable.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/simple_thread.h"
+#include "packager/base/time/time.h"
+
+namespace shaka {
+
+/// Writes out the MPD on a dedicated thread, so that the threads updating the
+/// MPD never wait for the MPD to be written. Publish requests are coalesced:
+/// the MPD is written once for all the requests made within a coalescing
+/// window.
+class MpdPublisher : public base::DelegateSimpleThread::Delegate {
+ public:
+  /// Publishing counters.
+  struct Stats {
+    Stats();
+
+    /// Number of publish requests.
+    uint64_t requests;
+    /// Number of times the MPD was written.
+    uint64_t writes;
+    /// Number of failed writes.
+    uint64_t failed_writes;
+
+    /// @return a human-readable string describing |*this|.
+    std::string ToString() const;
+  };
+
+  /// Generates the current MPD in @a mpd. Returns true on success.
+  typedef base::Callback<bool(std::string* mpd)> MpdGenerator;
+
+  /// @param output_path is the path of the MPD.
+  /// @param mpd_generator generates the MPD to write. It is called on the
+  ///        publisher thread.
+  /// @param coalescing_window is how long to wait for more requests after a
+  ///        request, before writing the MPD.
+  MpdPublisher(const std::string& output_path,
+               const MpdGenerator& mpd_generator,
+               base::TimeDelta coalescing_window);
+  /// Writes the MPD if a request is pending and stops the thread.
+  ~MpdPublisher() override;
+
+  /// Starts the publisher thread.
+  void Start();
+
+  /// Requests the MPD to be written. Returns without waiting for the write.
+  /// @param publish_now is true to write the MPD without waiting for the end
+  ///        of the coalescing window.
+  void RequestPublish(bool publish_now);
+
+  /// Writes the MPD and waits for the write to complete.
+  /// @return true if the MPD was written successfully, false otherwise.
+  bool Publish();
+
+  /// @return a snapshot of the publishing counters.
+  Stats GetStats() const;
+
+ private:
+  // base::DelegateSimpleThread::Delegate implementation.
+  void Run() override;
+
+  // Generates and writes out the MPD.
+  bool WriteMpd();
+
+  const std::string output_path_;
+  const MpdGenerator mpd_generator_;
+  const base::TimeDelta coalescing_window_;
+  scoped_ptr<base::DelegateSimpleThread> thread_;
+
+  mutable base::Lock lock_;  // Lock protecting the variables below.
+  base::ConditionVariable condition_;
+  // True if a request is pending, i.e. was made after the latest write
+  // started.
+  bool pending_;
+  // True to write the pending request without waiting for the deadline.
+  bool publish_now_;
+  // True when the publisher is being destroyed.
+  bool stopping_;
+  // The pending request is written at this time.
+  base::TimeTicks publish_deadline_;
+  // Sequence number of the latest request, and of the latest request written.
+  uint64_t requested_sequence_number_;
+  uint64_t published_sequence_number_;
+  // Result of the latest write.
+  bool last_write_result_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpdPublisher);
+};
+
+}  // namespace shaka
+
+#endif  // MPD_BASE_MPD_PUBLISHER_H_
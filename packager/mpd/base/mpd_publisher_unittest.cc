@@ -0,0 +1,146 @@
+// Copyright 2016 Google Inc. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <gtest/gtest.h>
+
+#include "packager/base/bind.h"
+#include "packager/base/files/file_enumerator.h"
+#include "packager/base/files/file_path.h"
+#include "packager/base/files/file_util.h"
+#include "packager/base/synchronization/lock.h"
+#include "packager/base/threading/platform_thread.h"
+#include "packager/mpd/base/mpd_publisher.h"
+
+namespace shaka {
+
+namespace {
+const char kMpd[] = "<MPD/>";
+// Long enough for the requests not to be written before the end of a test,
+// unless they are written immediately.
+const int64_t kLongWindowInSeconds = 600;
+}  // namespace
+
+class MpdPublisherTest : public ::testing::Test {
+ protected:
+  MpdPublisherTest() : num_generated_mpds_(0), generate_mpd_result_(true) {}
+
+  void SetUp() override {
+    ASSERT_TRUE(base::CreateNewTempDirectory("mpd_publisher_", &temp_dir_));
+    temp_file_path_ = temp_dir_.AppendASCII("output.mpd");
+  }
+
+  void TearDown() override {
+    base::DeleteFile(temp_dir_, true);
+  }
+
+  scoped_ptr<MpdPublisher> CreatePublisher(base::TimeDelta coalescing_window) {
+    scoped_ptr<MpdPublisher> publisher(new MpdPublisher(
+        temp_file_path_.value(),
+        base::Bind(&MpdPublisherTest::GenerateMpd, base::Unretained(this)),
+        coalescing_window));
+    publisher->Start();
+    return publisher.Pass();
+  }
+
+  bool GenerateMpd(std::string* mpd) {
+    base::AutoLock auto_lock(lock_);
+    ++num_generated_mpds_;
+    *mpd = kMpd;
+    return generate_mpd_result_;
+  }
+
+  int num_generated_mpds() {
+    base::AutoLock auto_lock(lock_);
+    return num_generated_mpds_;
+  }
+
+  std::string ReadMpd() {
+    std::string mpd;
+    EXPECT_TRUE(base::ReadFileToString(temp_file_path_, &mpd));
+    return mpd;
+  }
+
+  // @return the number of files in |temp_dir_|.
+  int CountFiles() {
+    int num_files = 0;
+    base::FileEnumerator files(temp_dir_, false, base::FileEnumerator::FILES);
+    for (base::FilePath path = files.Next(); !path.empty(); path = files.Next())
+      ++num_files;
+    return num_files;
+  }
+
+  base::FilePath temp_dir_;
+  base::FilePath temp_file_path_;
+  base::Lock lock_;
+  int num_generated_mpds_;
+  bool generate_mpd_result_;
+};
+
+TEST_F(MpdPublisherTest, PublishWritesMpd) {
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromSeconds(kLongWindowInSeconds));
+  ASSERT_TRUE(publisher->Publish());
+  EXPECT_EQ(kMpd, ReadMpd());
+  // The temporary file is renamed to the MPD.
+  EXPECT_EQ(1, CountFiles());
+
+  MpdPublisher::Stats stats = publisher->GetStats();
+  EXPECT_EQ(1u, stats.requests);
+  EXPECT_EQ(1u, stats.writes);
+  EXPECT_EQ(0u, stats.failed_writes);
+}
+
+TEST_F(MpdPublisherTest, CoalesceRequests) {
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromSeconds(kLongWindowInSeconds));
+  publisher->RequestPublish(false);
+  publisher->RequestPublish(false);
+  publisher->RequestPublish(false);
+  EXPECT_EQ(0, num_generated_mpds());
+  ASSERT_TRUE(publisher->Publish());
+  EXPECT_EQ(1, num_generated_mpds());
+
+  MpdPublisher::Stats stats = publisher->GetStats();
+  EXPECT_EQ(4u, stats.requests);
+  EXPECT_EQ(1u, stats.writes);
+}
+
+TEST_F(MpdPublisherTest, PendingRequestWrittenOnDestruction) {
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromSeconds(kLongWindowInSeconds));
+  publisher->RequestPublish(false);
+  publisher.reset();
+  EXPECT_EQ(1, num_generated_mpds());
+  EXPECT_EQ(kMpd, ReadMpd());
+}
+
+TEST_F(MpdPublisherTest, NothingWrittenWithoutRequest) {
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromSeconds(kLongWindowInSeconds));
+  publisher.reset();
+  EXPECT_EQ(0, num_generated_mpds());
+  EXPECT_FALSE(base::PathExists(temp_file_path_));
+}
+
+TEST_F(MpdPublisherTest, RequestWrittenAfterWindow) {
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromMilliseconds(1));
+  publisher->RequestPublish(false);
+  while (publisher->GetStats().writes == 0)
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(1, num_generated_mpds());
+  EXPECT_EQ(kMpd, ReadMpd());
+}
+
+TEST_F(MpdPublisherTest, GenerateMpdFailure) {
+  generate_mpd_result_ = false;
+  scoped_ptr<MpdPublisher> publisher =
+      CreatePublisher(base::TimeDelta::FromSeconds(kLongWindowInSeconds));
+  EXPECT_FALSE(publisher->Publish());
+  EXPECT_EQ(1u, publisher->GetStats().failed_writes);
+}
+
+}  // namespace shaka
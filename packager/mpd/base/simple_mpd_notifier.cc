@@ -17,23 +17,9 @@ SimpleMpdNotifier::SimpleMpdNotifier(DashProfile dash_profile,
                                      const MpdOptions& mpd_options,
                                      const std::vector<std::string>& base_urls,
                                      const std::string& output_path)
-    : MpdNotifier(dash_profile),
-      output_path_(output_path),
-      mpd_builder_(new MpdBuilder(dash_profile == kLiveProfile
-                                      ? MpdBuilder::kDynamic
-                                      : MpdBuilder::kStatic,
-                                  mpd_options)) {
-  DCHECK(dash_profile == kLiveProfile || dash_profile == kOnDemandProfile);
-  for (size_t i = 0; i < base_urls.size(); ++i)
-    mpd_builder_->AddBaseUrl(base_urls[i]);
-}
-
-SimpleMpdNotifier::~SimpleMpdNotifier() {
-}
+    : MpdBuilderNotifier(dash_profile, mpd_options, base_urls, output_path) {}
 
-bool SimpleMpdNotifier::Init() {
-  return true;
-}
+SimpleMpdNotifier::~SimpleMpdNotifier() {}
 
 bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
                                            uint32_t* container_id) {
@@ -43,7 +29,7 @@ bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   if (content_type == kContentTypeUnknown)
     return false;
 
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
 
   // TODO(kqyang): Consider adding a new method MpdBuilder::AddRepresentation.
   // Most of the codes here can be moved inside.
@@ -51,11 +37,11 @@ bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
   std::string lang = GetLanguage(media_info);
   AdaptationSet** adaptation_set = &adaptation_set_map_[key];
   if (*adaptation_set == NULL)
-    *adaptation_set = mpd_builder_->AddAdaptationSet(lang);
+    *adaptation_set = mpd_builder()->AddAdaptationSet(lang);
 
   DCHECK(*adaptation_set);
   MediaInfo adjusted_media_info(media_info);
-  MpdBuilder::MakePathsRelativeToMpd(output_path_, &adjusted_media_info);
+  MpdBuilder::MakePathsRelativeToMpd(output_path(), &adjusted_media_info);
   Representation* representation =
       (*adaptation_set)->AddRepresentation(adjusted_media_info);
   if (representation == NULL)
@@ -72,7 +58,7 @@ bool SimpleMpdNotifier::NotifyNewContainer(const MediaInfo& media_info,
 
 bool SimpleMpdNotifier::NotifySampleDuration(uint32_t container_id,
                                              uint32_t sample_duration) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
@@ -86,13 +72,14 @@ bool SimpleMpdNotifier::NotifyNewSegment(uint32_t container_id,
                                          uint64_t start_time,
                                          uint64_t duration,
                                          uint64_t size) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
     return false;
   }
   it->second->AddNewSegment(start_time, duration, size);
+  OnNewSegment(container_id);
   return true;
 }
 
@@ -101,7 +88,7 @@ bool SimpleMpdNotifier::NotifyEncryptionUpdate(
     const std::string& drm_uuid,
     const std::vector<uint8_t>& new_key_id,
     const std::vector<uint8_t>& new_pssh) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
@@ -115,7 +102,7 @@ bool SimpleMpdNotifier::NotifyEncryptionUpdate(
 bool SimpleMpdNotifier::AddContentProtectionElement(
     uint32_t container_id,
     const ContentProtectionElement& content_protection_element) {
-  base::AutoLock auto_lock(lock_);
+  base::AutoLock auto_lock(lock());
   RepresentationMap::iterator it = representation_map_.find(container_id);
   if (it == representation_map_.end()) {
     LOG(ERROR) << "Unexpected container_id: " << container_id;
@@ -125,9 +112,8 @@ bool SimpleMpdNotifier::AddContentProtectionElement(
   return true;
 }
 
-bool SimpleMpdNotifier::Flush() {
-  base::AutoLock auto_lock(lock_);
-  return WriteMpdToFile(output_path_, mpd_builder_.get());
+size_t SimpleMpdNotifier::NumRepresentations() const {
+  return representation_map_.size();
 }
 
 }  // namespace shaka
@@ -13,8 +13,7 @@
 
 #include "packager/base/gtest_prod_util.h"
 #include "packager/base/memory/scoped_ptr.h"
-#include "packager/base/synchronization/lock.h"
-#include "packager/mpd/base/mpd_notifier.h"
+#include "packager/mpd/base/mpd_builder_notifier.h"
 #include "packager/mpd/base/mpd_notifier_util.h"
 
 namespace shaka {
@@ -28,7 +27,7 @@ struct MpdOptions;
 
 /// A simple MpdNotifier implementation which receives muxer listener event and
 /// generates an Mpd file.
-class SimpleMpdNotifier : public MpdNotifier {
+class SimpleMpdNotifier : public MpdBuilderNotifier {
  public:
   SimpleMpdNotifier(DashProfile dash_profile,
                     const MpdOptions& mpd_options,
@@ -38,7 +37,6 @@ class SimpleMpdNotifier : public MpdNotifier {
 
   /// @name MpdNotifier implemetation overrides.
   /// @{
-  bool Init() override;
   bool NotifyNewContainer(const MediaInfo& media_info, uint32_t* id) override;
   bool NotifySampleDuration(uint32_t container_id,
                             uint32_t sample_duration) override;
@@ -53,27 +51,24 @@ class SimpleMpdNotifier : public MpdNotifier {
   bool AddContentProtectionElement(
       uint32_t id,
       const ContentProtectionElement& content_protection_element) override;
-  bool Flush() override;
   /// @}
 
  private:
   friend class SimpleMpdNotifierTest;
 
+  // MpdBuilderNotifier implementation overrides.
+  size_t NumRepresentations() const override;
+
   // Testing only method. Returns a pointer to MpdBuilder.
   MpdBuilder* MpdBuilderForTesting() const {
-    return mpd_builder_.get();
+    return mpd_builder();
   }
 
-  // Testing only method. Sets mpd_builder_.
+  // Testing only method. Sets the MPD builder.
   void SetMpdBuilderForTesting(scoped_ptr<MpdBuilder> mpd_builder) {
-    mpd_builder_ = mpd_builder.Pass();
+    set_mpd_builder(mpd_builder.Pass());
   }
 
-  // MPD output path.
-  std::string output_path_;
-  scoped_ptr<MpdBuilder> mpd_builder_;
-  base::Lock lock_;
-
   typedef std::map<std::string, AdaptationSet*> AdaptationSetMap;
   AdaptationSetMap adaptation_set_map_;
 
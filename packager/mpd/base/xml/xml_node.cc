@@ -298,13 +298,20 @@ bool RepresentationXmlNode::AddVODOnlyInfo(const MediaInfo& media_info) {
 bool RepresentationXmlNode::AddLiveOnlyInfo(
     const MediaInfo& media_info,
     const std::list<SegmentInfo>& segment_infos,
-    uint32_t start_number) {
+    uint32_t start_number,
+    double availability_time_offset) {
   XmlNode segment_template("SegmentTemplate");
   if (media_info.has_reference_time_scale()) {
     segment_template.SetIntegerAttribute("timescale",
                                          media_info.reference_time_scale());
   }
 
+  if (availability_time_offset > 0) {
+    segment_template.SetFloatingPointAttribute("availabilityTimeOffset",
+                                               availability_time_offset);
+    segment_template.SetStringAttribute("availabilityTimeComplete", "false");
+  }
+
   if (media_info.has_init_segment_name()) {
     // The spec does not allow '$Number$' and '$Time$' in initialization
     // attribute.
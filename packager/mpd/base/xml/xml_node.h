@@ -156,9 +156,13 @@ class RepresentationXmlNode : public RepresentationBaseXmlNode {
 
   /// @param segment_infos is a set of SegmentInfos. This method assumes that
   ///        SegmentInfos are sorted by its start time.
+  /// @param availability_time_offset is how many seconds before their end
+  ///        segments are available, if they are written chunk by chunk. 0
+  ///        otherwise.
   bool AddLiveOnlyInfo(const MediaInfo& media_info,
                        const std::list<SegmentInfo>& segment_infos,
-                       uint32_t start_number);
+                       uint32_t start_number,
+                       double availability_time_offset);
 
  private:
   // Add AudioChannelConfiguration element. Note that it is a required element
@@ -243,17 +243,43 @@ TEST_F(RepresentationTest, InvalidLiveInitSegmentName) {
   // $Number$ cannot be used for segment name.
   media_info.set_init_segment_name("$Number$.mp4");
   ASSERT_FALSE(representation_.AddLiveOnlyInfo(
-      media_info, segment_infos_, kDefaultStartNumber));
+      media_info, segment_infos_, kDefaultStartNumber, 0));
 
   // $Time$ as well.
   media_info.set_init_segment_name("$Time$.mp4");
   ASSERT_FALSE(representation_.AddLiveOnlyInfo(
-      media_info, segment_infos_, kDefaultStartNumber));
+      media_info, segment_infos_, kDefaultStartNumber, 0));
 
   // This should be valid.
   media_info.set_init_segment_name("some_non_template_name.mp4");
   ASSERT_TRUE(representation_.AddLiveOnlyInfo(
-      media_info, segment_infos_, kDefaultStartNumber));
+      media_info, segment_infos_, kDefaultStartNumber, 0));
+}
+
+// Segments written chunk by chunk are advertised before they are complete.
+TEST_F(RepresentationTest, LiveInfoWithAvailabilityTimeOffset) {
+  MediaInfo media_info;
+  media_info.set_reference_time_scale(1000);
+  media_info.set_segment_template("$Number$.m4s");
+  const uint32_t kStartNumber = 1;
+  const double kAvailabilityTimeOffset = 5.5;
+  SegmentInfo segment_info = {0, 6000, 0};
+  segment_infos_.push_back(segment_info);
+
+  ASSERT_TRUE(representation_.AddLiveOnlyInfo(
+      media_info, segment_infos_, kStartNumber, kAvailabilityTimeOffset));
+  scoped_xml_ptr<xmlDoc> doc(MakeDoc(representation_.PassScopedPtr()));
+  ASSERT_TRUE(XmlEqual(
+      "<Representation>\n"
+      "  <SegmentTemplate timescale=\"1000\" media=\"$Number$.m4s\"\n"
+      "   startNumber=\"1\" availabilityTimeOffset=\"5.5\"\n"
+      "   availabilityTimeComplete=\"false\">\n"
+      "    <SegmentTimeline>\n"
+      "      <S t=\"0\" d=\"6000\"/>\n"
+      "    </SegmentTimeline>\n"
+      "  </SegmentTemplate>\n"
+      "</Representation>\n",
+      doc.get()));
 }
 
 }  // namespace xml
@@ -43,10 +43,14 @@
         'base/language_utils.h',
         'base/mpd_builder.cc',
         'base/mpd_builder.h',
+        'base/mpd_builder_notifier.cc',
+        'base/mpd_builder_notifier.h',
         'base/mpd_notifier_util.cc',
         'base/mpd_notifier_util.h',
         'base/mpd_notifier.h',
         'base/mpd_options.h',
+        'base/mpd_publisher.cc',
+        'base/mpd_publisher.h',
         'base/mpd_utils.cc',
         'base/mpd_utils.h',
         'base/segment_info.h',
@@ -89,6 +93,7 @@
         'base/bandwidth_estimator_unittest.cc',
         'base/dash_iop_mpd_notifier_unittest.cc',
         'base/mpd_builder_unittest.cc',
+        'base/mpd_publisher_unittest.cc',
         'base/simple_mpd_notifier_unittest.cc',
         'base/xml/xml_node_unittest.cc',
         'test/mpd_builder_test_helper.cc',
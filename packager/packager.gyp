@@ -26,6 +26,8 @@
         'app/packager_main.cc',
         'app/packager_util.cc',
         'app/packager_util.h',
+        'app/segment_store_flags.cc',
+        'app/segment_store_flags.h',
         'app/stream_descriptor.cc',
         'app/stream_descriptor.h',
         'app/validate_flag.cc',
@@ -90,6 +92,37 @@
         'media/formats/wvm/wvm.gyp:wvm',
         'media/test/media_test.gyp:media_test_support',
         'testing/gtest.gyp:gtest',
+        'third_party/gflags/gflags.gyp:gflags',
+      ],
+    },
+    {
+      # Performance tests. They are not run by the builders.
+      'target_name': 'packager_perftest',
+      'type': '<(gtest_target_type)',
+      'sources': [
+        'media/base/aes_cryptor_perftest.cc',
+        'media/codecs/h26x_bit_reader_perftest.cc',
+        'media/codecs/nalu_reader_perftest.cc',
+        'media/file/threaded_io_file_perftest.cc',
+        'media/test/demuxer_perftest.cc',
+        'media/test/muxer_perftest.cc',
+        # media_test_support brings its own main().
+        'media/test/test_data_util.cc',
+        'media/test/test_data_util.h',
+      ],
+      'dependencies': [
+        'media/base/media_base.gyp:media_base',
+        'media/codecs/codecs.gyp:codecs',
+        'media/file/file.gyp:file',
+        'media/formats/mp2t/mp2t.gyp:mp2t',
+        'media/formats/mp4/mp4.gyp:mp4',
+        'media/formats/mpeg/mpeg.gyp:mpeg',
+        'media/formats/webm/webm.gyp:webm',
+        'media/formats/webvtt/webvtt.gyp:webvtt',
+        'media/formats/wvm/wvm.gyp:wvm',
+        'media/test/media_test.gyp:run_perftests',
+        'testing/gtest.gyp:gtest',
+        'third_party/gflags/gflags.gyp:gflags',
       ],
     },
     {